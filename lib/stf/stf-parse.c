@@ -807,6 +807,25 @@ GPtrArray *
 stf_parse_general (StfParseOptions_t *parseoptions,
 		   GStringChunk *lines_chunk,
 		   char const *data, char const *data_end)
+{
+	return stf_parse_general_offsets (parseoptions, lines_chunk,
+					  data, data_end, NULL);
+}
+
+/**
+ * stf_parse_general_offsets:
+ *
+ * Like stf_parse_general, but when @row_ends is not NULL the offset
+ * (relative to @data) just past the end of each parsed row, including
+ * its terminator, is appended to it as a gsize.  This lets a caller
+ * parse a buffer piecewise and carry any unparsed or partial tail
+ * over to the next call.
+ **/
+GPtrArray *
+stf_parse_general_offsets (StfParseOptions_t *parseoptions,
+			   GStringChunk *lines_chunk,
+			   char const *data, char const *data_end,
+			   GArray *row_ends)
 {
 	GPtrArray *lines;
 	Source_t src;
@@ -834,6 +853,11 @@ stf_parse_general (StfParseOptions_t *parseoptions,
 		if (parseoptions->parsetype != PARSE_TYPE_CSV)
 			src.position += compare_terminator (src.position, parseoptions);
 
+		if (row_ends != NULL) {
+			gsize end = src.position - data;
+			g_array_append_val (row_ends, end);
+		}
+
 		if (++row == SHEET_MAX_ROWS)
 			break;
 	}
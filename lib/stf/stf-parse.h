@@ -94,6 +94,11 @@ GPtrArray	*stf_parse_general			(StfParseOptions_t *parseoptions,
 							 GStringChunk *lines_chunk,
 							 char const *data,
 							 char const *data_end);
+GPtrArray	*stf_parse_general_offsets		(StfParseOptions_t *parseoptions,
+							 GStringChunk *lines_chunk,
+							 char const *data,
+							 char const *data_end,
+							 GArray *row_ends);
 void		 stf_parse_general_free			(GPtrArray *lines);
 GPtrArray	*stf_parse_lines			(StfParseOptions_t *parseoptions,
 							 GStringChunk *lines_chunk,
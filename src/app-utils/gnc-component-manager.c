@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include "gnc-component-manager.h"
 #include "qof.h"
@@ -40,8 +41,6 @@ typedef struct
 {
     GHashTable * event_masks;
     GHashTable * entity_events;
-
-    gboolean match;
 } ComponentEventInfo;
 
 typedef struct
@@ -64,8 +63,25 @@ static guint  suspend_counter = 0;
 static gint   next_component_id = 1;
 static GList *components = NULL;
 
-static ComponentEventInfo changes = { NULL, NULL, FALSE };
-static ComponentEventInfo changes_backup = { NULL, NULL, FALSE };
+static ComponentEventInfo changes = { NULL, NULL };
+static ComponentEventInfo changes_backup = { NULL, NULL };
+
+/* Inverted indexes of the component watches. entity_watchers maps a
+ * watched GncGUID to a GList of the ComponentInfos watching it, and
+ * type_watchers maps an entity type (in the string cache) to a GList
+ * of the ComponentInfos watching that type. They let a refresh find
+ * the interested components by looking up each change, instead of
+ * testing every component against the whole change set. */
+static GHashTable *entity_watchers = NULL;
+static GHashTable *type_watchers = NULL;
+
+/* Event coalescing. When turned on, events arriving while refreshes
+ * are not suspended only schedule a refresh from the main loop idle
+ * handler, so a burst of events results in a single refresh. */
+static gboolean coalesce_events = FALSE;
+static guint idle_refresh_id = 0;
+
+static GNCComponentManagerStats cm_stats;
 
 
 /* This static indicates the debugging module that this .o belongs to.  */
@@ -238,6 +254,24 @@ add_event_type (ComponentEventInfo *cei, QofIdTypeConst entity_type,
     g_return_if_fail (cei->event_masks);
     g_return_if_fail (entity_type);
 
+    if (event_mask == 0)
+    {
+        gpointer key;
+        gpointer value;
+
+        if (or_in)
+            return;
+
+        if (g_hash_table_lookup_extended (cei->event_masks, entity_type,
+                                          &key, &value))
+        {
+            g_hash_table_remove (cei->event_masks, entity_type);
+            qof_string_cache_remove (key);
+            g_free (value);
+        }
+        return;
+    }
+
     mask = g_hash_table_lookup (cei->event_masks, entity_type);
     if (!mask)
     {
@@ -253,19 +287,163 @@ add_event_type (ComponentEventInfo *cei, QofIdTypeConst entity_type,
 }
 
 static void
-gnc_cm_event_handler (QofInstance *entity,
-                      QofEventId event_type,
-                      gpointer user_data,
-                      gpointer event_data)
+index_watch_entity (ComponentInfo *ci, const GncGUID *entity)
+{
+    gpointer key;
+    gpointer value;
+
+    if (!entity_watchers)
+        entity_watchers = guid_hash_table_new ();
+
+    if (g_hash_table_lookup_extended (entity_watchers, entity, &key, &value))
+    {
+        GList *list = value;
+
+        if (g_list_find (list, ci))
+            return;
+
+        g_hash_table_insert (entity_watchers, key, g_list_prepend (list, ci));
+    }
+    else
+    {
+        GncGUID *guid;
+
+        guid = guid_malloc ();
+        *guid = *entity;
+
+        g_hash_table_insert (entity_watchers, guid, g_list_prepend (NULL, ci));
+    }
+}
+
+static void
+unindex_watch_entity (ComponentInfo *ci, const GncGUID *entity)
+{
+    gpointer key;
+    gpointer value;
+    GList *list;
+
+    if (!entity_watchers)
+        return;
+
+    if (!g_hash_table_lookup_extended (entity_watchers, entity, &key, &value))
+        return;
+
+    list = g_list_remove (value, ci);
+    if (list)
+    {
+        g_hash_table_insert (entity_watchers, key, list);
+        return;
+    }
+
+    g_hash_table_remove (entity_watchers, key);
+    guid_free (key);
+}
+
+static void
+index_watch_type (ComponentInfo *ci, QofIdTypeConst entity_type)
+{
+    gpointer key;
+    gpointer value;
+
+    if (!type_watchers)
+        type_watchers = g_hash_table_new (g_str_hash, g_str_equal);
+
+    if (g_hash_table_lookup_extended (type_watchers, entity_type, &key, &value))
+    {
+        GList *list = value;
+
+        if (g_list_find (list, ci))
+            return;
+
+        g_hash_table_insert (type_watchers, key, g_list_prepend (list, ci));
+    }
+    else
+    {
+        key = qof_string_cache_insert ((gpointer) entity_type);
+        g_hash_table_insert (type_watchers, key, g_list_prepend (NULL, ci));
+    }
+}
+
+static void
+unindex_watch_type (ComponentInfo *ci, QofIdTypeConst entity_type)
+{
+    gpointer key;
+    gpointer value;
+    GList *list;
+
+    if (!type_watchers)
+        return;
+
+    if (!g_hash_table_lookup_extended (type_watchers, entity_type, &key, &value))
+        return;
+
+    list = g_list_remove (value, ci);
+    if (list)
+    {
+        g_hash_table_insert (type_watchers, key, list);
+        return;
+    }
+
+    g_hash_table_remove (type_watchers, key);
+    qof_string_cache_remove (key);
+}
+
+static void
+unindex_entity_helper (gpointer key, gpointer value, gpointer user_data)
+{
+    unindex_watch_entity (user_data, key);
+}
+
+static void
+unindex_type_helper (gpointer key, gpointer value, gpointer user_data)
+{
+    unindex_watch_type (user_data, key);
+}
+
+static gboolean
+destroy_entity_watchers_helper (gpointer key, gpointer value,
+                                gpointer user_data)
+{
+    guid_free (key);
+    g_list_free (value);
+
+    return TRUE;
+}
+
+static gboolean
+destroy_type_watchers_helper (gpointer key, gpointer value,
+                              gpointer user_data)
+{
+    qof_string_cache_remove (key);
+    g_list_free (value);
+
+    return TRUE;
+}
+
+static gboolean
+gnc_cm_idle_refresh (gpointer unused)
+{
+    idle_refresh_id = 0;
+
+    /* If refreshes were suspended in the meantime, the final resume
+     * takes care of the pending changes. */
+    if (suspend_counter == 0)
+        gnc_gui_refresh_internal (FALSE);
+
+    return FALSE;
+}
+
+static void
+gnc_cm_record_event (const GncGUID *guid, QofIdTypeConst entity_type,
+                     QofEventId event_type)
 {
-    const GncGUID *guid = qof_entity_get_guid(entity);
 #if CM_DEBUG
-    fprintf (stderr, "event_handler: event %d, entity %p, guid %s\n", event_type,
-             entity, guid_to_string(guid));
+    fprintf (stderr, "event_handler: event %d, type %s, guid %s\n", event_type,
+             entity_type, guid_to_string(guid));
 #endif
     add_event (&changes, guid, event_type, TRUE);
 
-    if (QOF_CHECK_TYPE(entity, GNC_ID_SPLIT))
+    if (safe_strcmp (entity_type, GNC_ID_SPLIT) == 0)
     {
         /* split events are never generated by the engine, but might
          * be generated by a backend (viz. the postgres backend.)
@@ -273,14 +451,61 @@ gnc_cm_event_handler (QofInstance *entity,
         add_event_type (&changes, GNC_ID_TRANS, QOF_EVENT_MODIFY, TRUE);
     }
     else
-        add_event_type (&changes, entity->e_type, event_type, TRUE);
+        add_event_type (&changes, entity_type, event_type, TRUE);
 
     got_events = TRUE;
+    cm_stats.events_received++;
+}
 
-    if (suspend_counter == 0)
+/* Events that arrive while refreshes are suspended, or while an idle
+ * refresh is already scheduled, are coalesced into that pending
+ * refresh. Otherwise the components are refreshed once per event
+ * batch, either right away or from the idle handler when coalescing
+ * is turned on. */
+static void
+gnc_cm_events_recorded (guint n_events)
+{
+    if (suspend_counter != 0 || idle_refresh_id != 0)
+    {
+        cm_stats.events_coalesced += n_events;
+        return;
+    }
+
+    cm_stats.events_coalesced += n_events - 1;
+
+    if (coalesce_events)
+        idle_refresh_id = g_idle_add (gnc_cm_idle_refresh, NULL);
+    else
         gnc_gui_refresh_internal (FALSE);
 }
 
+static void
+gnc_cm_event_handler (QofInstance *entity,
+                      QofEventId event_type,
+                      gpointer user_data,
+                      gpointer event_data)
+{
+    gnc_cm_record_event (qof_entity_get_guid (entity), entity->e_type,
+                         event_type);
+    gnc_cm_events_recorded (1);
+}
+
+static void
+gnc_cm_batch_handler (const QofEventBatchEntry *entries, guint n_entries,
+                      gpointer user_data)
+{
+    guint i;
+
+    if (n_entries == 0)
+        return;
+
+    for (i = 0; i < n_entries; i++)
+        gnc_cm_record_event (&entries[i].guid, entries[i].type,
+                             entries[i].event_id);
+
+    gnc_cm_events_recorded (n_entries);
+}
+
 static gint handler_id;
 
 void
@@ -298,7 +523,10 @@ gnc_component_manager_init (void)
     changes_backup.event_masks = g_hash_table_new (g_str_hash, g_str_equal);
     changes_backup.entity_events = guid_hash_table_new ();
 
-    handler_id = qof_event_register_handler (gnc_cm_event_handler, NULL);
+    handler_id = qof_event_register_batch_handler (gnc_cm_event_handler,
+                 gnc_cm_batch_handler,
+                 NULL,
+                 QOF_EVENT_PRIORITY_DEFAULT);
 }
 
 void
@@ -322,9 +550,67 @@ gnc_component_manager_shutdown (void)
     destroy_event_hash (changes_backup.entity_events);
     changes_backup.entity_events = NULL;
 
+    if (entity_watchers)
+    {
+        g_hash_table_foreach_remove (entity_watchers,
+                                     destroy_entity_watchers_helper, NULL);
+        g_hash_table_destroy (entity_watchers);
+        entity_watchers = NULL;
+    }
+
+    if (type_watchers)
+    {
+        g_hash_table_foreach_remove (type_watchers,
+                                     destroy_type_watchers_helper, NULL);
+        g_hash_table_destroy (type_watchers);
+        type_watchers = NULL;
+    }
+
+    if (idle_refresh_id)
+    {
+        g_source_remove (idle_refresh_id);
+        idle_refresh_id = 0;
+    }
+
     qof_event_unregister_handler (handler_id);
 }
 
+void
+gnc_component_manager_set_coalesce (gboolean coalesce)
+{
+    coalesce_events = coalesce;
+
+    if (coalesce || !idle_refresh_id)
+        return;
+
+    /* Run the refresh that was waiting for the idle handler. */
+    g_source_remove (idle_refresh_id);
+    idle_refresh_id = 0;
+
+    if (suspend_counter == 0)
+        gnc_gui_refresh_internal (FALSE);
+}
+
+gboolean
+gnc_component_manager_get_coalesce (void)
+{
+    return coalesce_events;
+}
+
+void
+gnc_component_manager_get_stats (GNCComponentManagerStats *stats)
+{
+    g_return_if_fail (stats);
+
+    *stats = cm_stats;
+}
+
+void
+gnc_component_manager_reset_stats (void)
+{
+    memset (&cm_stats, 0, sizeof (cm_stats));
+}
+
 static ComponentInfo *
 find_component (gint component_id)
 {
@@ -464,6 +750,11 @@ gnc_gui_component_watch_entity (gint component_id,
     }
 
     add_event (&ci->watch_info, entity, event_mask, FALSE);
+
+    if (event_mask == 0)
+        unindex_watch_entity (ci, entity);
+    else
+        index_watch_entity (ci, entity);
 }
 
 void
@@ -489,6 +780,11 @@ gnc_gui_component_watch_entity_type (gint component_id,
     }
 
     add_event_type (&ci->watch_info, entity_type, event_mask, FALSE);
+
+    if (event_mask == 0)
+        unindex_watch_type (ci, entity_type);
+    else
+        index_watch_type (ci, entity_type);
 }
 
 const EventInfo *
@@ -512,6 +808,13 @@ gnc_gui_component_clear_watches (gint component_id)
         return;
     }
 
+    if (ci->watch_info.entity_events)
+        g_hash_table_foreach (ci->watch_info.entity_events,
+                              unindex_entity_helper, ci);
+    if (ci->watch_info.event_masks)
+        g_hash_table_foreach (ci->watch_info.event_masks,
+                              unindex_type_helper, ci);
+
     clear_event_info (&ci->watch_info);
 }
 
@@ -537,6 +840,7 @@ gnc_unregister_gui_component (gint component_id)
 
     components = g_list_remove (components, ci);
 
+    g_hash_table_foreach (ci->watch_info.event_masks, unindex_type_helper, ci);
     destroy_mask_hash (ci->watch_info.event_masks);
     ci->watch_info.event_masks = NULL;
 
@@ -605,72 +909,71 @@ gnc_resume_gui_refresh (void)
 static void
 match_type_helper (gpointer key, gpointer value, gpointer user_data)
 {
-    ComponentEventInfo *cei = user_data;
+    GHashTable *matched = user_data;
     QofIdType id_type = key;
     QofEventId * et = value;
-    QofEventId * et_2;
+    GList *node;
 
-    et_2 = g_hash_table_lookup (cei->event_masks, id_type);
-    if (!et_2)
+    if (*et == 0)
         return;
 
-    if (*et & *et_2)
-        cei->match = TRUE;
+    node = g_hash_table_lookup (type_watchers, id_type);
+    for ( ; node; node = node->next)
+    {
+        ComponentInfo *ci = node->data;
+        QofEventId * et_2;
+
+        et_2 = g_hash_table_lookup (ci->watch_info.event_masks, id_type);
+        if (et_2 && (*et & *et_2))
+            g_hash_table_insert (matched, GINT_TO_POINTER (ci->component_id),
+                                 ci);
+    }
 }
 
 static void
 match_helper (gpointer key, gpointer value, gpointer user_data)
 {
+    GHashTable *matched = user_data;
     GncGUID *guid = key;
     EventInfo *ei_1 = value;
-    EventInfo *ei_2;
-    ComponentEventInfo *cei = user_data;
+    GList *node;
 
-    ei_2 = g_hash_table_lookup (cei->entity_events, guid);
-    if (!ei_2)
-        return;
+    node = g_hash_table_lookup (entity_watchers, guid);
+    for ( ; node; node = node->next)
+    {
+        ComponentInfo *ci = node->data;
+        EventInfo *ei_2;
 
-    if (ei_1->event_mask & ei_2->event_mask)
-        cei->match = TRUE;
+        ei_2 = g_hash_table_lookup (ci->watch_info.entity_events, guid);
+        if (ei_2 && (ei_1->event_mask & ei_2->event_mask))
+            g_hash_table_insert (matched, GINT_TO_POINTER (ci->component_id),
+                                 ci);
+    }
 }
 
-static gboolean
-changes_match (ComponentEventInfo *cei, ComponentEventInfo *changes)
+/* Collect the ids of all components whose watches match the given
+ * changes. The cost is proportional to the number of changes plus the
+ * number of watches on the changed entities and types. */
+static GHashTable *
+find_matching_components (ComponentEventInfo *changes)
 {
-    ComponentEventInfo *big_cei;
-    GHashTable *smalltable;
+    GHashTable *matched;
 
-    if (cei == NULL)
-        return FALSE;
+    matched = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-    /* check types first, for efficiency */
-    cei->match = FALSE;
-    g_hash_table_foreach (changes->event_masks, match_type_helper, cei);
-    if (cei->match)
-        return TRUE;
+    if (type_watchers)
+        g_hash_table_foreach (changes->event_masks, match_type_helper, matched);
 
-    if (g_hash_table_size (cei->entity_events) <=
-            g_hash_table_size (changes->entity_events))
-    {
-        smalltable = cei->entity_events;
-        big_cei = changes;
-    }
-    else
-    {
-        smalltable = changes->entity_events;
-        big_cei = cei;
-    }
+    if (entity_watchers)
+        g_hash_table_foreach (changes->entity_events, match_helper, matched);
 
-    big_cei->match = FALSE;
-
-    g_hash_table_foreach (smalltable, match_helper, big_cei);
-
-    return big_cei->match;
+    return matched;
 }
 
 static void
 gnc_gui_refresh_internal (gboolean force)
 {
+    GHashTable *matched = NULL;
     GList *list;
     GList *node;
 
@@ -695,11 +998,31 @@ gnc_gui_refresh_internal (gboolean force)
     fprintf (stderr, "%srefresh!\n", force ? "forced " : "");
 #endif
 
-    list = find_component_ids_by_class (NULL);
+    cm_stats.refreshes++;
+
+    if (!force)
+        matched = find_matching_components (&changes_backup);
+
+    /* Walk the components in registration order; without a match
+     * there is nothing to dispatch at all. */
+    if (force || g_hash_table_size (matched) > 0)
+        list = find_component_ids_by_class (NULL);
+    else
+        list = NULL;
 
     for (node = list; node; node = node->next)
     {
-        ComponentInfo *ci = find_component (GPOINTER_TO_INT (node->data));
+        ComponentInfo *ci;
+
+        if (!force && !g_hash_table_lookup (matched, node->data))
+        {
+#if CM_DEBUG
+            fprintf (stderr, "no match for %d\n", GPOINTER_TO_INT (node->data));
+#endif
+            continue;
+        }
+
+        ci = find_component (GPOINTER_TO_INT (node->data));
 
         if (!ci)
             continue;
@@ -720,9 +1043,10 @@ gnc_gui_refresh_internal (gboolean force)
                 fprintf (stderr, "calling %s:%d C handler\n", ci->component_class, ci->component_id);
 #endif
                 ci->refresh_handler (NULL, ci->user_data);
+                cm_stats.dispatched++;
             }
         }
-        else if (changes_match (&ci->watch_info, &changes_backup))
+        else
         {
             if (ci->refresh_handler)
             {
@@ -730,20 +1054,17 @@ gnc_gui_refresh_internal (gboolean force)
                 fprintf (stderr, "calling %s:%d C handler\n", ci->component_class, ci->component_id);
 #endif
                 ci->refresh_handler (changes_backup.entity_events, ci->user_data);
+                cm_stats.dispatched++;
             }
         }
-        else
-        {
-#if CM_DEBUG
-            fprintf (stderr, "no match for %s:%d\n", ci->component_class, ci->component_id);
-#endif
-        }
     }
 
     clear_event_info (&changes_backup);
     got_events = FALSE;
 
     g_list_free (list);
+    if (matched)
+        g_hash_table_destroy (matched);
 
     gnc_resume_gui_refresh ();
 }
@@ -33,6 +33,24 @@ typedef struct
     QofEventId event_mask;
 } EventInfo;
 
+/* Counters kept by the component manager.
+ *
+ * events_received:  number of engine events seen
+ * events_coalesced: number of those events which did not get a refresh
+ *                   of their own, because refreshes were suspended, an
+ *                   idle refresh was already pending, or they came in
+ *                   the same event batch
+ * refreshes:        number of refresh passes run
+ * dispatched:       number of component refresh handlers invoked
+ */
+typedef struct
+{
+    guint64 events_received;
+    guint64 events_coalesced;
+    guint64 refreshes;
+    guint64 dispatched;
+} GNCComponentManagerStats;
+
 
 /* GNCComponentRefreshHandler
  *   Handler invoked to inform the component that a refresh
@@ -120,6 +138,32 @@ void gnc_component_manager_init (void);
  */
 void gnc_component_manager_shutdown (void);
 
+/* gnc_component_manager_set_coalesce
+ *   Turn event coalescing on or off. It is off by default. When
+ *   coalescing, events that arrive while refreshes are not suspended
+ *   do not refresh the components immediately. Instead a single
+ *   refresh is run from the main loop once it becomes idle, covering
+ *   all events received up to that point. This requires a running
+ *   glib main loop. Turning coalescing off runs any refresh that is
+ *   still pending.
+ */
+void gnc_component_manager_set_coalesce (gboolean coalesce);
+
+/* gnc_component_manager_get_coalesce
+ *   Return TRUE if event coalescing is turned on.
+ */
+gboolean gnc_component_manager_get_coalesce (void);
+
+/* gnc_component_manager_get_stats
+ *   Copy the current component manager counters into 'stats'.
+ */
+void gnc_component_manager_get_stats (GNCComponentManagerStats *stats);
+
+/* gnc_component_manager_reset_stats
+ *   Reset all component manager counters to zero.
+ */
+void gnc_component_manager_reset_stats (void);
+
 /* gnc_register_gui_component
  *   Register a GUI component with the manager.
  *
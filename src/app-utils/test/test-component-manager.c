@@ -0,0 +1,183 @@
+#include "config.h"
+#include <glib.h>
+#include <stdlib.h>
+
+#include "qof.h"
+#include "cashobjects.h"
+#include "Account.h"
+#include "Transaction.h"
+#include "gnc-component-manager.h"
+#include "test-stuff.h"
+
+typedef struct
+{
+    gint id;
+    gint refreshes;
+} Watcher;
+
+static void
+refresh_handler (GHashTable *changes, gpointer user_data)
+{
+    Watcher *w = user_data;
+
+    w->refreshes++;
+}
+
+static void
+register_watcher (Watcher *w)
+{
+    w->refreshes = 0;
+    w->id = gnc_register_gui_component ("test-component-manager",
+                                        refresh_handler, NULL, w);
+}
+
+static void
+reset_watchers (Watcher *w, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        w[i].refreshes = 0;
+}
+
+static void
+run_tests (void)
+{
+    QofBook *book;
+    Account *acct_a, *acct_b;
+    Transaction *trans;
+    GNCComponentManagerStats stats;
+    Watcher w[4];
+    Watcher *by_type = &w[0], *unwatched = &w[1], *by_entity = &w[2],
+             *on_destroy = &w[3];
+
+    book = qof_book_new ();
+    acct_a = xaccMallocAccount (book);
+    acct_b = xaccMallocAccount (book);
+    trans = xaccMallocTransaction (book);
+
+    gnc_component_manager_init ();
+
+    register_watcher (by_type);
+    gnc_gui_component_watch_entity_type (by_type->id, GNC_ID_ACCOUNT,
+                                         QOF_EVENT_MODIFY);
+
+    /* Watching with a mask of 0 is the same as not watching at all. */
+    register_watcher (unwatched);
+    gnc_gui_component_watch_entity_type (unwatched->id, GNC_ID_ACCOUNT,
+                                         QOF_EVENT_MODIFY);
+    gnc_gui_component_watch_entity_type (unwatched->id, GNC_ID_ACCOUNT, 0);
+    gnc_gui_component_watch_entity_type (unwatched->id, GNC_ID_TRANS, 0);
+
+    register_watcher (by_entity);
+    gnc_gui_component_watch_entity (by_entity->id,
+                                    xaccAccountGetGUID (acct_b),
+                                    QOF_EVENT_MODIFY);
+
+    register_watcher (on_destroy);
+    gnc_gui_component_watch_entity (on_destroy->id,
+                                    xaccAccountGetGUID (acct_a),
+                                    QOF_EVENT_DESTROY);
+
+    qof_event_gen (&acct_a->inst, QOF_EVENT_MODIFY, NULL);
+    do_test (by_type->refreshes == 1 && unwatched->refreshes == 0 &&
+             by_entity->refreshes == 0 && on_destroy->refreshes == 0,
+             "account change reaches the type watcher only");
+
+    reset_watchers (w, 4);
+    qof_event_gen (&acct_b->inst, QOF_EVENT_MODIFY, NULL);
+    do_test (by_type->refreshes == 1 && unwatched->refreshes == 0 &&
+             by_entity->refreshes == 1 && on_destroy->refreshes == 0,
+             "watched account change reaches type and entity watchers");
+
+    reset_watchers (w, 4);
+    qof_event_gen (&trans->inst, QOF_EVENT_MODIFY, NULL);
+    do_test (by_type->refreshes == 0 && unwatched->refreshes == 0 &&
+             by_entity->refreshes == 0 && on_destroy->refreshes == 0,
+             "change of an unwatched type reaches nobody");
+
+    reset_watchers (w, 4);
+    gnc_component_manager_reset_stats ();
+    gnc_suspend_gui_refresh ();
+    qof_event_gen (&acct_a->inst, QOF_EVENT_MODIFY, NULL);
+    qof_event_gen (&acct_b->inst, QOF_EVENT_MODIFY, NULL);
+    qof_event_gen (&acct_a->inst, QOF_EVENT_MODIFY, NULL);
+    do_test (by_type->refreshes == 0 && by_entity->refreshes == 0,
+             "no refresh while suspended");
+    gnc_resume_gui_refresh ();
+    gnc_component_manager_get_stats (&stats);
+    do_test (by_type->refreshes == 1 && unwatched->refreshes == 0 &&
+             by_entity->refreshes == 1 && on_destroy->refreshes == 0,
+             "suspended changes dispatched once on resume");
+    do_test (stats.events_received == 3 && stats.events_coalesced == 3 &&
+             stats.refreshes == 1 && stats.dispatched == 2,
+             "suspended changes counted as coalesced");
+
+    /* With coalescing on, a burst of events waits for the main loop to
+     * become idle and then refreshes the components once. */
+    reset_watchers (w, 4);
+    gnc_component_manager_reset_stats ();
+    gnc_component_manager_set_coalesce (TRUE);
+    qof_event_gen (&acct_a->inst, QOF_EVENT_MODIFY, NULL);
+    qof_event_gen (&acct_b->inst, QOF_EVENT_MODIFY, NULL);
+    qof_event_gen (&acct_a->inst, QOF_EVENT_MODIFY, NULL);
+    do_test (by_type->refreshes == 0 && by_entity->refreshes == 0,
+             "no refresh before the main loop is idle");
+    while (g_main_context_iteration (NULL, FALSE))
+        ;
+    gnc_component_manager_get_stats (&stats);
+    do_test (by_type->refreshes == 1 && unwatched->refreshes == 0 &&
+             by_entity->refreshes == 1 && on_destroy->refreshes == 0,
+             "coalesced changes dispatched once when idle");
+    do_test (stats.events_received == 3 && stats.events_coalesced == 2 &&
+             stats.refreshes == 1 && stats.dispatched == 2,
+             "idle refresh counts the later events as coalesced");
+
+    /* Turning coalescing off runs the refresh that is still waiting. */
+    reset_watchers (w, 4);
+    qof_event_gen (&acct_b->inst, QOF_EVENT_MODIFY, NULL);
+    gnc_component_manager_set_coalesce (FALSE);
+    do_test (by_type->refreshes == 1 && by_entity->refreshes == 1,
+             "pending refresh run when coalescing is turned off");
+    do_test (!gnc_component_manager_get_coalesce (), "coalescing is off");
+
+    reset_watchers (w, 4);
+    gnc_gui_component_clear_watches (by_type->id);
+    qof_event_gen (&acct_a->inst, QOF_EVENT_MODIFY, NULL);
+    do_test (by_type->refreshes == 0, "cleared watches no longer match");
+
+    reset_watchers (w, 4);
+    gnc_gui_component_watch_entity (by_entity->id,
+                                    xaccAccountGetGUID (acct_b), 0);
+    qof_event_gen (&acct_b->inst, QOF_EVENT_MODIFY, NULL);
+    do_test (by_entity->refreshes == 0, "entity watch removed with mask 0");
+
+    reset_watchers (w, 4);
+    qof_event_gen (&acct_a->inst, QOF_EVENT_DESTROY, NULL);
+    do_test (on_destroy->refreshes == 1 && by_type->refreshes == 0,
+             "destroy reaches the destroy watcher");
+
+    gnc_unregister_gui_component (by_type->id);
+    gnc_unregister_gui_component (unwatched->id);
+    gnc_unregister_gui_component (by_entity->id);
+    gnc_unregister_gui_component (on_destroy->id);
+    gnc_component_manager_shutdown ();
+}
+
+int
+main (int argc, char **argv)
+{
+    qof_init ();
+    if (!cashobjects_register ())
+    {
+        failure ("can't register cashobjects");
+        qof_close ();
+        return get_rv ();
+    }
+
+    run_tests ();
+
+    print_test_results ();
+    qof_close ();
+    exit (get_rv ());
+}
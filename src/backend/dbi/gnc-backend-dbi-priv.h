@@ -25,6 +25,7 @@
 
 #include <dbi/dbi.h>
 #include "gnc-backend-sql.h"
+#include "gnc-dbi-writer.h"
 
 /**
  * Options to conn_table_operation
@@ -86,6 +87,7 @@ struct GncDbiBackend_struct
     gboolean  supports_transactions;
     gboolean  is_pristine_db;	// Are we saving to a new pristine db?
     gboolean  exists;         // Does the database exist?
+    gboolean  sqlite3_profile; // SQLite performance profile in use (GNC_DBI_SQLITE_PERFORMANCE)
 
     gint obj_total;			// Total # of objects (for percentage calculation)
     gint operations_done;		// Number of operations (save/load) done
@@ -111,6 +113,10 @@ typedef struct
     // be used to prevent infinite loops.
     gboolean retry;         // Signals the calling function that it should retry (the error handler detected
     // transient error and managed to resolve it, but it can't run the original query)
+    /*@ null @*/
+    GncDbiWriter* writer;   // Applies committed writes on its own connection and thread (write-behind), or NULL
+    /*@ null @*/
+    GPtrArray* unit;        // SQL of the database transaction being collected for the writer
 
 } GncDbiSqlConnection;
 
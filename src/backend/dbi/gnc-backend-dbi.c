@@ -29,6 +29,7 @@
 #include "config.h"
 
 #include <errno.h>
+#include <stdio.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #if !HAVE_GMTIME_R
@@ -52,6 +53,8 @@
 #include "gnc-locale-utils.h"
 
 #include "gnc-backend-dbi.h"
+#include "gnc-slots-sql.h"
+#include "gnc-transaction-sql.h"
 
 #ifdef S_SPLINT_S
 #include "splint-defs.h"
@@ -99,6 +102,9 @@ static provider_functions_t provider_sqlite3 =
     conn_drop_index_sqlite3
 };
 #define SQLITE3_TIMESPEC_STR_FORMAT "%04d%02d%02d%02d%02d%02d"
+/* Page cache (in KiB, as a negative cache_size) and mmap sizes */
+#define SQLITE3_CACHE_SIZE "-65536"
+#define SQLITE3_MMAP_SIZE "268435456"
 
 static /*@ null @*/ gchar* conn_create_table_ddl_mysql( GncSqlConnection* conn,
         const gchar* table_name,
@@ -115,6 +121,8 @@ static provider_functions_t provider_mysql =
     conn_drop_index_mysql
 };
 #define MYSQL_TIMESPEC_STR_FORMAT "%04d%02d%02d%02d%02d%02d"
+/* InnoDB keys take at most 767 bytes of a column, 255 utf8 characters */
+#define MYSQL_MAX_INDEX_PREFIX 255
 
 static /*@ null @*/ gchar* conn_create_table_ddl_pgsql( GncSqlConnection* conn,
         const gchar* table_name,
@@ -153,6 +161,8 @@ static GncDbiTestResult conn_test_dbi_library( dbi_conn conn );
 
 
 #define DBI_MAX_CONN_ATTEMPTS 5
+/* Rows per INSERT when a whole book is saved */
+#define DBI_MAX_INSERT_ROWS 500
 
 /* ================================================================= */
 
@@ -239,6 +249,91 @@ sqlite3_error_fn( dbi_conn conn, /*@ unused @*/ void* user_data )
     gnc_dbi_set_error( conn, ERR_BACKEND_MISC, 0, FALSE );
 }
 
+/* SQLite takes several rows in one INSERT from 3.7.11 on. */
+static guint
+sqlite3_max_insert_rows( dbi_conn conn )
+{
+    dbi_result result;
+    guint major = 0, minor = 0, micro = 0;
+
+    result = dbi_conn_query( conn, "SELECT sqlite_version()" );
+    if ( result != NULL )
+    {
+        if ( dbi_result_next_row( result ) )
+        {
+            const gchar* version = dbi_result_get_string_idx( result, 1 );
+            if ( version != NULL )
+            {
+                (void)sscanf( version, "%u.%u.%u", &major, &minor, &micro );
+            }
+        }
+        (void)dbi_result_free( result );
+    }
+
+    if ( major > 3 || ( major == 3 && ( minor > 7 || ( minor == 7 && micro >= 11 ) ) ) )
+    {
+        return DBI_MAX_INSERT_ROWS;
+    }
+    return 1;
+}
+
+/* SQLite tuning.  Every SQLite book gets a bigger page cache, and is read
+ * through mmap where the library supports it; SQLite ignores pragmas it
+ * doesn't know.  Setting GNC_DBI_SQLITE_PERFORMANCE to anything but "0"
+ * also turns on the performance profile: the file is switched to
+ * write-ahead logging with synchronous=NORMAL, and syncing is turned off
+ * while a whole book is saved, then done once at the end. */
+
+static void
+sqlite3_run_pragma( dbi_conn conn, const gchar* pragma )
+{
+    dbi_result result;
+
+    DEBUG( "SQL: %s\n", pragma );
+    result = dbi_conn_query( conn, pragma );
+    if ( result == NULL )
+    {
+        PWARN( "%s failed\n", pragma );
+        return;
+    }
+    (void)dbi_result_free( result );
+}
+
+static void
+sqlite3_tune( GncDbiBackend* be )
+{
+    const gchar* profile = g_getenv( "GNC_DBI_SQLITE_PERFORMANCE" );
+
+    sqlite3_run_pragma( be->conn, "PRAGMA cache_size=" SQLITE3_CACHE_SIZE );
+    sqlite3_run_pragma( be->conn, "PRAGMA mmap_size=" SQLITE3_MMAP_SIZE );
+    sqlite3_run_pragma( be->conn, "PRAGMA temp_store=MEMORY" );
+
+    be->sqlite3_profile = profile != NULL && g_strcmp0( profile, "0" ) != 0;
+    if ( be->sqlite3_profile )
+    {
+        sqlite3_run_pragma( be->conn, "PRAGMA journal_mode=WAL" );
+        sqlite3_run_pragma( be->conn, "PRAGMA synchronous=NORMAL" );
+    }
+}
+
+static void
+sqlite3_begin_bulk_write( GncDbiBackend* be )
+{
+    if ( !be->sqlite3_profile ) return;
+
+    sqlite3_run_pragma( be->conn, "PRAGMA synchronous=OFF" );
+}
+
+static void
+sqlite3_end_bulk_write( GncDbiBackend* be )
+{
+    if ( !be->sqlite3_profile ) return;
+
+    /* The checkpoint syncs the log and then the database file */
+    sqlite3_run_pragma( be->conn, "PRAGMA synchronous=NORMAL" );
+    sqlite3_run_pragma( be->conn, "PRAGMA wal_checkpoint(FULL)" );
+}
+
 static void
 gnc_dbi_sqlite3_session_begin( QofBackend *qbe, QofSession *session,
                                const gchar *book_id, gboolean ignore_lock,
@@ -367,6 +462,8 @@ gnc_dbi_sqlite3_session_begin( QofBackend *qbe, QofSession *session,
     }
     be->sql_be.conn = create_dbi_connection( GNC_DBI_PROVIDER_SQLITE, qbe, be->conn );
     be->sql_be.timespec_format = SQLITE3_TIMESPEC_STR_FORMAT;
+    be->sql_be.max_insert_rows = sqlite3_max_insert_rows( be->conn );
+    sqlite3_tune( be );
 
     /* We should now have a proper session set up.
      * Let's start logging */
@@ -545,6 +642,98 @@ set_standard_connection_options( QofBackend* qbe, dbi_conn conn, const gchar* ho
     return TRUE;
 }
 
+/* ----------------------------------------------------------------- */
+/* Write-behind.  When GNC_DBI_WRITE_BEHIND is set, the statements of each
+ * committed database transaction are handed to a writer thread with a
+ * connection of its own (see gnc-dbi-writer.h) instead of being run, and
+ * the main connection is left for reads.  Anything which reads, or writes
+ * outside of a database transaction, first waits for the writer so that
+ * it sees every earlier commit. */
+
+/* Opens a second connection to the database and starts the writer on it,
+ * if write-behind is wanted.  If that fails, commits are written as they
+ * are made. */
+static void
+start_writer( QofBackend* qbe, GncDbiSqlConnection* dbi_conn, const gchar* driver,
+              const gchar* host, gint port, const gchar* dbname,
+              const gchar* username, const gchar* password )
+{
+    const gchar* write_behind = g_getenv( "GNC_DBI_WRITE_BEHIND" );
+    dbi_conn conn;
+
+    if ( write_behind == NULL || g_strcmp0( write_behind, "0" ) == 0 ) return;
+
+    conn = dbi_conn_new( driver );
+    if ( conn == NULL )
+    {
+        PWARN( "Unable to create %s dbi connection for the writer\n", driver );
+        return;
+    }
+    if ( !set_standard_connection_options( qbe, conn, host, port, dbname, username, password ) )
+    {
+        /* Writing synchronously is no reason to fail the session */
+        (void)qof_backend_get_error( qbe );
+        dbi_conn_close( conn );
+        return;
+    }
+    if ( dbi_conn_connect( conn ) < 0 )
+    {
+        PWARN( "Unable to connect the writer to database '%s'\n", dbname );
+        dbi_conn_close( conn );
+        return;
+    }
+
+    dbi_conn->writer = gnc_dbi_writer_new( conn );
+    if ( dbi_conn->writer == NULL )
+    {
+        dbi_conn_close( conn );
+    }
+}
+
+/* What the writer failed to write is still in the book, but the database
+ * is no longer in step with it.  The book is marked dirty so that it gets
+ * saved in full, and what the backend remembers about the database is
+ * dropped. */
+static void
+report_writer_error( GncDbiSqlConnection* dbi_conn, QofBackendError err )
+{
+    GncSqlBackend* be = (GncSqlBackend*)dbi_conn->qbe;
+
+    if ( err == ERR_BACKEND_NO_ERR ) return;
+
+    PERR( "The dbi writer failed to write a commit\n" );
+    qof_backend_set_error( dbi_conn->qbe, err );
+    gnc_sql_slots_forget_all( be );
+    gnc_sql_forget_persisted( be );
+    if ( be->primary_book != NULL )
+    {
+        qof_book_mark_session_dirty( be->primary_book );
+    }
+}
+
+/* Waits until everything committed is in the database. */
+static void
+conn_flush_writer( GncDbiSqlConnection* dbi_conn )
+{
+    if ( dbi_conn->writer == NULL ) return;
+
+    report_writer_error( dbi_conn, gnc_dbi_writer_flush( dbi_conn->writer ) );
+}
+
+static void
+stop_writer( GncDbiSqlConnection* dbi_conn )
+{
+    if ( dbi_conn->unit != NULL )
+    {
+        gnc_dbi_writer_free_unit( dbi_conn->unit );
+        dbi_conn->unit = NULL;
+    }
+    if ( dbi_conn->writer == NULL ) return;
+
+    conn_flush_writer( dbi_conn );
+    gnc_dbi_writer_destroy( dbi_conn->writer );
+    dbi_conn->writer = NULL;
+}
 
 static gboolean
 gnc_dbi_lock_database ( QofBackend* qbe, gboolean ignore_lock )
@@ -941,8 +1130,11 @@ gnc_dbi_mysql_session_begin( QofBackend* qbe, QofSession *session,
             gnc_sql_connection_dispose( be->sql_be.conn );
         }
         be->sql_be.conn = create_dbi_connection( GNC_DBI_PROVIDER_MYSQL, qbe, be->conn );
+        start_writer( qbe, (GncDbiSqlConnection*)be->sql_be.conn, "mysql",
+                      host, portnum, dbname, username, password );
     }
     be->sql_be.timespec_format = MYSQL_TIMESPEC_STR_FORMAT;
+    be->sql_be.max_insert_rows = DBI_MAX_INSERT_ROWS;
 
     /* We should now have a proper session set up.
      * Let's start logging */
@@ -1266,8 +1458,11 @@ gnc_dbi_postgres_session_begin( QofBackend *qbe, QofSession *session,
             gnc_sql_connection_dispose( be->sql_be.conn );
         }
         be->sql_be.conn = create_dbi_connection( GNC_DBI_PROVIDER_PGSQL, qbe, be->conn );
+        start_writer( qbe, (GncDbiSqlConnection*)be->sql_be.conn, "pgsql",
+                      host, portnum, dbnamelc, username, password );
     }
     be->sql_be.timespec_format = PGSQL_TIMESPEC_STR_FORMAT;
+    be->sql_be.max_insert_rows = DBI_MAX_INSERT_ROWS;
 
     /* We should now have a proper session set up.
      * Let's start logging */
@@ -1333,6 +1528,11 @@ gnc_dbi_session_end( QofBackend *be_start )
 
     ENTER (" ");
 
+    /* Everything committed must be in the database before the lock goes */
+    if ( be->sql_be.conn != NULL )
+    {
+        stop_writer( (GncDbiSqlConnection*)be->sql_be.conn );
+    }
     if ( be->conn != NULL )
     {
         gnc_dbi_unlock( be_start );
@@ -1345,6 +1545,9 @@ gnc_dbi_session_end( QofBackend *be_start )
         be->sql_be.conn = NULL;
     }
     gnc_sql_finalize_version_info( &be->sql_be );
+    gnc_sql_slots_forget_all( &be->sql_be );
+    gnc_sql_forget_persisted( &be->sql_be );
+    gnc_sql_transaction_forget_loaded( &be->sql_be );
 
     LEAVE (" ");
 }
@@ -1502,6 +1705,7 @@ conn_table_operation( GncSqlConnection *sql_conn, GSList *table_name_list,
     const gchar *dbname = dbi_conn_get_option( conn->conn, "dbname" );
 
     g_return_val_if_fail( table_name_list != NULL, FALSE );
+    conn_flush_writer( conn );
     if ( op == rollback )
         full_table_name_list =
             conn->provider->get_table_list( conn->conn, dbname );
@@ -1581,6 +1785,11 @@ gnc_dbi_sync_all( QofBackend* qbe, /*@ dependent @*/ QofBook *book )
     g_return_if_fail( book != NULL );
 
     ENTER( "book=%p, primary=%p", book, be->primary_book );
+    if ( !gnc_sql_load_all_for_sync( &be->sql_be, book ) )
+    {
+        LEAVE( "Failed to load all transactions" );
+        return;
+    }
 
     /* Destroy the current contents of the database */
     dbname = dbi_conn_get_option( be->conn, "dbname" );
@@ -1595,7 +1804,9 @@ gnc_dbi_sync_all( QofBackend* qbe, /*@ dependent @*/ QofBook *book )
     /* Save all contents */
     be->is_pristine_db = TRUE;
     be->primary_book = book;
+    sqlite3_begin_bulk_write( be );
     gnc_sql_sync_all( &be->sql_be, book );
+    sqlite3_end_bulk_write( be );
 
     LEAVE( "book=%p", book );
 }
@@ -1622,6 +1833,11 @@ gnc_dbi_safe_sync_all( QofBackend *qbe, QofBook *book )
     g_return_if_fail( book != NULL );
 
     ENTER( "book=%p, primary=%p", book, be->primary_book );
+    if ( !gnc_sql_load_all_for_sync( &be->sql_be, book ) )
+    {
+        LEAVE( "Failed to load all transactions" );
+        return;
+    }
     dbname = dbi_conn_get_option( be->conn, "dbname" );
     table_list = conn->provider->get_table_list( conn->conn, dbname );
     if ( !conn_table_operation( (GncSqlConnection*)conn, table_list,
@@ -1655,7 +1871,9 @@ gnc_dbi_safe_sync_all( QofBackend *qbe, QofBook *book )
     be->is_pristine_db = TRUE;
     be->primary_book = book;
 
+    sqlite3_begin_bulk_write( be );
     gnc_sql_sync_all( &be->sql_be, book );
+    sqlite3_end_bulk_write( be );
     if ( ERR_BACKEND_NO_ERR != qof_backend_get_error( qbe ) )
     {
         conn_table_operation( (GncSqlConnection*)conn, table_list,
@@ -1668,6 +1886,30 @@ gnc_dbi_safe_sync_all( QofBackend *qbe, QofBook *book )
     gnc_table_slist_free( table_list );
     LEAVE("book=%p", book);
 }
+
+/* A full save is written over the main connection as it is made, so that
+ * it can be checked and undone.  It rewrites everything, so whatever the
+ * writer failed to write before it doesn't matter. */
+static void
+gnc_dbi_safe_sync( QofBackend *qbe, QofBook *book )
+{
+    GncDbiSqlConnection *conn = (GncDbiSqlConnection*)(((GncSqlBackend*)qbe)->conn);
+    GncDbiWriter* writer = NULL;
+
+    g_return_if_fail( qbe != NULL );
+
+    if ( conn != NULL && conn->writer != NULL )
+    {
+        writer = conn->writer;
+        (void)gnc_dbi_writer_flush( writer );
+        conn->writer = NULL;
+    }
+    gnc_dbi_safe_sync_all( qbe, book );
+    if ( writer != NULL )
+    {
+        conn->writer = writer;
+    }
+}
 /* ================================================================= */
 static void
 gnc_dbi_begin_edit( QofBackend *qbe, QofInstance *inst )
@@ -1727,14 +1969,15 @@ init_sql_backend( GncDbiBackend* dbi_be )
 
 /* The SQL/DBI backend doesn't need to be synced until it is
  * configured for multiuser access. */
-    be->sync = gnc_dbi_safe_sync_all;
-    be->safe_sync = gnc_dbi_safe_sync_all;
+    be->sync = gnc_dbi_safe_sync;
+    be->safe_sync = gnc_dbi_safe_sync;
     be->load_config = NULL;
     be->get_config = NULL;
 
     be->compile_query = gnc_sql_compile_query;
     be->run_query = gnc_sql_run_query;
     be->free_query = gnc_sql_free_query;
+    be->load_related = gnc_sql_load_related;
 
     be->export_fn = NULL;
 
@@ -1969,113 +2212,167 @@ gnc_module_finalize_backend_dbi( void )
 }
 
 /* --------------------------------------------------------- */
+/* Rows are decoded through a column table built once per result: each
+ * column name is resolved to its libdbi index, type and attributes the
+ * first time it is asked for, and its value is decoded into a GValue
+ * owned by the column, which is reused from one row to the next.
+ * Strings are not copied; they stay valid until the result is freed. */
+typedef struct
+{
+    guint idx;                  /* 1-based, as libdbi numbers fields */
+    gushort type;
+    guint attrs;
+    GValue value;
+    gboolean is_null;
+    guint decoded_row;          /* Row the value was decoded for, 0 if none */
+} GncDbiColumn;
+
+static void
+column_free( GncDbiColumn* column )
+{
+    if ( G_IS_VALUE(&column->value) )
+    {
+        g_value_unset( &column->value );
+    }
+    g_free( column );
+}
+
 typedef struct
 {
     GncSqlRow base;
 
     /*@ dependent @*/
     dbi_result result;
-    GList* gvalue_list;
+    /*@ dependent @*/
+    GHashTable* columns;        /* Column name -> GncDbiColumn* */
+    guint row_num;              /* 1-based number of the current row */
 } GncDbiSqlRow;
 
 static void
 row_dispose( /*@ only @*/ GncSqlRow* row )
 {
-    GncDbiSqlRow* dbi_row = (GncDbiSqlRow*)row;
-    GList* node;
+    g_free( row );
+}
+
+static /*@ null @*/ GncDbiColumn*
+row_get_column( GncDbiSqlRow* dbi_row, const gchar* col_name )
+{
+    GncDbiColumn* column;
+    guint idx;
+
+    column = g_hash_table_lookup( dbi_row->columns, col_name );
+    if ( column != NULL ) return column;
 
-    if ( dbi_row->gvalue_list != NULL )
+    idx = dbi_result_get_field_idx( dbi_row->result, col_name );
+    if ( idx == 0 )
     {
-        for ( node = dbi_row->gvalue_list; node != NULL; node = node->next )
-        {
-            GValue* value;
-            if ( !G_IS_VALUE(node->data) )
-                continue;
-            value = (GValue*)node->data;
-            if ( G_VALUE_HOLDS_STRING(value) )
-            {
-                g_free( (gpointer)g_value_get_string( value ) );
-            }
-            g_free( value );
-        }
-        g_list_free( dbi_row->gvalue_list );
+        PERR( "Field %s: not in the result\n", col_name );
+        return NULL;
     }
-    g_free( dbi_row );
+    column = g_new0( GncDbiColumn, 1 );
+    g_assert( column != NULL );
+    column->idx = idx;
+    column->type = dbi_result_get_field_type_idx( dbi_row->result, idx );
+    column->attrs = dbi_result_get_field_attribs_idx( dbi_row->result, idx );
+    g_hash_table_insert( dbi_row->columns, g_strdup( col_name ), column );
+
+    return column;
 }
 
-static /*@ null @*/ const GValue*
-row_get_value_at_col_name( GncSqlRow* row, const gchar* col_name )
+static gboolean
+decode_column( dbi_result result, GncDbiColumn* column )
 {
-    GncDbiSqlRow* dbi_row = (GncDbiSqlRow*)row;
-    gushort type;
-    guint attrs;
-    GValue* value;
+    GValue* value = &column->value;
 
-    type = dbi_result_get_field_type( dbi_row->result, col_name );
-    attrs = dbi_result_get_field_attribs( dbi_row->result, col_name );
-    value = g_new0( GValue, 1 );
-    g_assert( value != NULL );
+    if ( G_IS_VALUE(value) )
+    {
+        g_value_unset( value );
+    }
+    column->is_null = FALSE;
 
-    switch ( type )
+    switch ( column->type )
     {
     case DBI_TYPE_INTEGER:
         (void)g_value_init( value, G_TYPE_INT64 );
-        g_value_set_int64( value, dbi_result_get_longlong( dbi_row->result, col_name ) );
+        g_value_set_int64( value, dbi_result_get_longlong_idx( result, column->idx ) );
         break;
     case DBI_TYPE_DECIMAL:
-        gnc_push_locale( LC_NUMERIC, "C" );
-        if ( (attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE4 )
+        /* The driver has already converted the value, under the locale
+           set up when the row was fetched. */
+        if ( (column->attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE4 )
         {
             (void)g_value_init( value, G_TYPE_FLOAT );
-            g_value_set_float( value, dbi_result_get_float( dbi_row->result, col_name ) );
+            g_value_set_float( value, dbi_result_get_float_idx( result, column->idx ) );
         }
-        else if ( (attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE8 )
+        else if ( (column->attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE8 )
         {
             (void)g_value_init( value, G_TYPE_DOUBLE );
-            g_value_set_double( value, dbi_result_get_double( dbi_row->result, col_name ) );
+            g_value_set_double( value, dbi_result_get_double_idx( result, column->idx ) );
         }
         else
         {
-            PERR( "Field %s: strange decimal length attrs=%d\n", col_name, attrs );
+            PERR( "Field %d: strange decimal length attrs=%d\n", column->idx, column->attrs );
+            return FALSE;
         }
-        gnc_pop_locale( LC_NUMERIC );
         break;
     case DBI_TYPE_STRING:
         (void)g_value_init( value, G_TYPE_STRING );
-        g_value_take_string( value, dbi_result_get_string_copy( dbi_row->result, col_name ) );
+        g_value_set_static_string( value, dbi_result_get_string_idx( result, column->idx ) );
         break;
     case DBI_TYPE_DATETIME:
-        if ( dbi_result_field_is_null( dbi_row->result, col_name ) )
+        if ( dbi_result_field_is_null_idx( result, column->idx ) )
         {
-            return NULL;
+            column->is_null = TRUE;
+        }
+        else
+        {
+            /* A seriously evil hack to work around libdbi bug #15
+             * https://sourceforge.net/p/libdbi/bugs/15/. When libdbi
+             * v0.9 is widely available this can be replaced with
+             * dbi_result_get_as_longlong.
+             */
+            dbi_result_t *res = (dbi_result_t*)result;
+            guint64 row = dbi_result_get_currow (res);
+            gint64 time = res->rows[row]->field_values[column->idx - 1].d_datetime;
+            (void)g_value_init( value, G_TYPE_INT64 );
+            g_value_set_int64 (value, time);
         }
-	else
-	{
-	    /* A seriously evil hack to work around libdbi bug #15
-	     * https://sourceforge.net/p/libdbi/bugs/15/. When libdbi
-	     * v0.9 is widely available this can be replaced with
-	     * dbi_result_get_as_longlong.
-	     */
-	    dbi_result_t *result = (dbi_result_t*)(dbi_row->result);
-	    guint64 row = dbi_result_get_currow (result);
-	    guint idx = dbi_result_get_field_idx (result, col_name) - 1;
-	    gint64 time = result->rows[row]->field_values[idx].d_datetime;
-	    (void)g_value_init( value, G_TYPE_INT64 );
-	    g_value_set_int64 (value, time);
-	}
         break;
     default:
-        PERR( "Field %s: unknown DBI_TYPE: %d\n", col_name, type );
-        g_free( value );
+        PERR( "Field %d: unknown DBI_TYPE: %d\n", column->idx, column->type );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static /*@ null @*/ const GValue*
+row_get_value_at_col_name( GncSqlRow* row, const gchar* col_name )
+{
+    GncDbiSqlRow* dbi_row = (GncDbiSqlRow*)row;
+    GncDbiColumn* column;
+
+    column = row_get_column( dbi_row, col_name );
+    if ( column == NULL ) return NULL;
+
+    if ( column->decoded_row != dbi_row->row_num )
+    {
+        if ( !decode_column( dbi_row->result, column ) )
+        {
+            return NULL;
+        }
+        column->decoded_row = dbi_row->row_num;
+    }
+    if ( column->is_null || !G_IS_VALUE(&column->value) )
+    {
         return NULL;
     }
 
-    dbi_row->gvalue_list = g_list_prepend( dbi_row->gvalue_list, value );
-    return value;
+    return &column->value;
 }
 
 static GncSqlRow*
-create_dbi_row( /*@ dependent @*/ dbi_result result )
+create_dbi_row( /*@ dependent @*/ dbi_result result, /*@ dependent @*/ GHashTable* columns )
 {
     GncDbiSqlRow* row;
 
@@ -2085,6 +2382,7 @@ create_dbi_row( /*@ dependent @*/ dbi_result result )
     row->base.getValueAtColName = row_get_value_at_col_name;
     row->base.dispose = row_dispose;
     row->result = result;
+    row->columns = columns;
 
     return (GncSqlRow*)row;
 }
@@ -2100,6 +2398,9 @@ typedef struct
     guint num_rows;
     guint cur_row;
     GncSqlRow* row;
+    /*@ owned @*/
+    GHashTable* columns;
+    gboolean has_decimal;
 } GncDbiSqlResult;
 
 static void
@@ -2111,6 +2412,10 @@ result_dispose( /*@ only @*/ GncSqlResult* result )
     {
         gnc_sql_row_dispose( dbi_result->row );
     }
+    if ( dbi_result->columns != NULL )
+    {
+        g_hash_table_destroy( dbi_result->columns );
+    }
     if ( dbi_result->result != NULL )
     {
         gint status;
@@ -2133,27 +2438,40 @@ result_get_num_rows( GncSqlResult* result )
     return dbi_result->num_rows;
 }
 
+/* Makes row 'row_num' (1-based) current and returns it.  The driver
+ * converts decimal fields from text when it fetches the row, so that
+ * has to happen in the C locale. */
 static /*@ null @*/ GncSqlRow*
-result_get_first_row( GncSqlResult* result )
+result_seek_row( GncDbiSqlResult* dbi_result, guint row_num )
 {
-    GncDbiSqlResult* dbi_result = (GncDbiSqlResult*)result;
+    gint status;
 
-    if ( dbi_result->row != NULL )
+    if ( dbi_result->has_decimal ) gnc_push_locale( LC_NUMERIC, "C" );
+    status = dbi_result_seek_row( dbi_result->result, row_num );
+    if ( dbi_result->has_decimal ) gnc_pop_locale( LC_NUMERIC );
+    if ( status == 0 )
     {
-        gnc_sql_row_dispose( dbi_result->row );
-        dbi_result->row = NULL;
+        PERR( "Error in dbi_result_seek_row()\n" );
+        qof_backend_set_error( dbi_result->dbi_conn->qbe, ERR_BACKEND_SERVER_ERR );
     }
+    dbi_result->cur_row = row_num;
+
+    if ( dbi_result->row == NULL )
+    {
+        dbi_result->row = create_dbi_row( dbi_result->result, dbi_result->columns );
+    }
+    ((GncDbiSqlRow*)dbi_result->row)->row_num = row_num;
+    return dbi_result->row;
+}
+
+static /*@ null @*/ GncSqlRow*
+result_get_first_row( GncSqlResult* result )
+{
+    GncDbiSqlResult* dbi_result = (GncDbiSqlResult*)result;
+
     if ( dbi_result->num_rows > 0 )
     {
-        gint status = dbi_result_first_row( dbi_result->result );
-        if ( status == 0 )
-        {
-            PERR( "Error in dbi_result_first_row()\n" );
-            qof_backend_set_error( dbi_result->dbi_conn->qbe, ERR_BACKEND_SERVER_ERR );
-        }
-        dbi_result->cur_row = 1;
-        dbi_result->row = create_dbi_row( dbi_result->result );
-        return dbi_result->row;
+        return result_seek_row( dbi_result, 1 );
     }
     else
     {
@@ -2166,22 +2484,9 @@ result_get_next_row( GncSqlResult* result )
 {
     GncDbiSqlResult* dbi_result = (GncDbiSqlResult*)result;
 
-    if ( dbi_result->row != NULL )
-    {
-        gnc_sql_row_dispose( dbi_result->row );
-        dbi_result->row = NULL;
-    }
     if ( dbi_result->cur_row < dbi_result->num_rows )
     {
-        gint status = dbi_result_next_row( dbi_result->result );
-        if ( status == 0 )
-        {
-            PERR( "Error in dbi_result_first_row()\n" );
-            qof_backend_set_error( dbi_result->dbi_conn->qbe, ERR_BACKEND_SERVER_ERR );
-        }
-        dbi_result->cur_row++;
-        dbi_result->row = create_dbi_row( dbi_result->result );
-        return dbi_result->row;
+        return result_seek_row( dbi_result, dbi_result->cur_row + 1 );
     }
     else
     {
@@ -2193,6 +2498,8 @@ static GncSqlResult*
 create_dbi_result( /*@ observer @*/ GncDbiSqlConnection* dbi_conn, /*@ owned @*/ dbi_result result )
 {
     GncDbiSqlResult* dbi_result;
+    guint num_fields;
+    guint idx;
 
     dbi_result = g_new0( GncDbiSqlResult, 1 );
     g_assert( dbi_result != NULL );
@@ -2205,6 +2512,19 @@ create_dbi_result( /*@ observer @*/ GncDbiSqlConnection* dbi_conn, /*@ owned @*/
     dbi_result->num_rows = (guint)dbi_result_get_numrows( result );
     dbi_result->cur_row = 0;
     dbi_result->dbi_conn = dbi_conn;
+    dbi_result->columns = g_hash_table_new_full( g_str_hash, g_str_equal, g_free,
+                          (GDestroyNotify)column_free );
+
+    num_fields = dbi_result_get_numfields( result );
+    if ( num_fields == DBI_FIELD_ERROR ) num_fields = 0;
+    for ( idx = 1; idx <= num_fields; idx++ )
+    {
+        if ( dbi_result_get_field_type_idx( result, idx ) == DBI_TYPE_DECIMAL )
+        {
+            dbi_result->has_decimal = TRUE;
+            break;
+        }
+    }
 
     return (GncSqlResult*)dbi_result;
 }
@@ -2274,8 +2594,9 @@ create_dbi_statement( /*@ observer @*/ GncSqlConnection* conn, const gchar* sql
 static void
 conn_dispose( /*@ only @*/ GncSqlConnection* conn )
 {
-    //GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
+    GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
 
+    stop_writer( dbi_conn );
     g_free( conn );
 }
 
@@ -2286,6 +2607,8 @@ conn_execute_select_statement( GncSqlConnection* conn, GncSqlStatement* stmt )
     GncDbiSqlStatement* dbi_stmt = (GncDbiSqlStatement*)stmt;
     dbi_result result;
 
+    conn_flush_writer( dbi_conn );
+
     DEBUG( "SQL: %s\n", dbi_stmt->sql->str );
     gnc_push_locale( LC_NUMERIC, "C" );
     do
@@ -2294,12 +2617,12 @@ conn_execute_select_statement( GncSqlConnection* conn, GncSqlStatement* stmt )
         result = dbi_conn_query( dbi_conn->conn, dbi_stmt->sql->str );
     }
     while ( dbi_conn->retry );
+    gnc_pop_locale( LC_NUMERIC );
     if ( result == NULL )
     {
         PERR( "Error executing SQL %s\n", dbi_stmt->sql->str );
         return NULL;
     }
-    gnc_pop_locale( LC_NUMERIC );
     return create_dbi_result( dbi_conn, result );
 }
 
@@ -2312,6 +2635,17 @@ conn_execute_nonselect_statement( GncSqlConnection* conn, GncSqlStatement* stmt
     gint num_rows;
     gint status;
 
+    if ( dbi_conn->writer != NULL )
+    {
+        if ( dbi_conn->unit != NULL )
+        {
+            /* The rows affected aren't known until the writer runs it */
+            g_ptr_array_add( dbi_conn->unit, g_strdup( dbi_stmt->sql->str ) );
+            return 1;
+        }
+        conn_flush_writer( dbi_conn );
+    }
+
     DEBUG( "SQL: %s\n", dbi_stmt->sql->str );
     do
     {
@@ -2368,6 +2702,7 @@ conn_does_table_exist( GncSqlConnection* conn, const gchar* table_name )
     g_return_val_if_fail( conn != NULL, FALSE );
     g_return_val_if_fail( table_name != NULL, FALSE );
 
+    conn_flush_writer( dbi_conn );
     dbname = dbi_conn_get_option( dbi_conn->conn, "dbname" );
     tables = dbi_conn_get_table_list( dbi_conn->conn, dbname, table_name );
     nTables = (gint)dbi_result_get_numrows( tables );
@@ -2398,6 +2733,16 @@ conn_begin_transaction( /*@ unused @*/ GncSqlConnection* conn )
 
     DEBUG( "BEGIN\n" );
 
+    if ( dbi_conn->writer != NULL )
+    {
+        report_writer_error( dbi_conn, gnc_dbi_writer_take_error( dbi_conn->writer ) );
+        if ( dbi_conn->unit == NULL )
+        {
+            dbi_conn->unit = g_ptr_array_new();
+        }
+        return TRUE;
+    }
+
     if ( !gnc_dbi_verify_conn (dbi_conn) )
     {
         PERR( "gnc_dbi_verify_conn() failed\n" );
@@ -2437,6 +2782,12 @@ conn_rollback_transaction( /*@ unused @*/ GncSqlConnection* conn )
     gboolean success = FALSE;
 
     DEBUG( "ROLLBACK\n" );
+    if ( dbi_conn->writer != NULL && dbi_conn->unit != NULL )
+    {
+        gnc_dbi_writer_free_unit( dbi_conn->unit );
+        dbi_conn->unit = NULL;
+        return TRUE;
+    }
     result = dbi_conn_queryf( dbi_conn->conn, "ROLLBACK" );
     success = ( result != NULL );
 
@@ -2464,6 +2815,12 @@ conn_commit_transaction( /*@ unused @*/ GncSqlConnection* conn )
     gboolean success = FALSE;
 
     DEBUG( "COMMIT\n" );
+    if ( dbi_conn->writer != NULL && dbi_conn->unit != NULL )
+    {
+        gnc_dbi_writer_push( dbi_conn->writer, dbi_conn->unit );
+        dbi_conn->unit = NULL;
+        return TRUE;
+    }
     result = dbi_conn_queryf( dbi_conn->conn, "COMMIT" );
     success = ( result != NULL );
 
@@ -2490,6 +2847,7 @@ create_index_ddl( GncSqlConnection* conn,
 {
     GString* ddl;
     const GncSqlColumnTableEntry* table_row;
+    GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
 
     g_return_val_if_fail( conn != NULL, NULL );
     g_return_val_if_fail( index_name != NULL, NULL );
@@ -2505,6 +2863,12 @@ create_index_ddl( GncSqlConnection* conn,
             (void)g_string_append( ddl, ", " );
         }
         g_string_append_printf( ddl, "%s", table_row->col_name );
+        if ( dbi_conn->provider == GNC_DBI_PROVIDER_MYSQL
+                && g_ascii_strcasecmp( table_row->col_type, CT_STRING ) == 0
+                && table_row->size > MYSQL_MAX_INDEX_PREFIX )
+        {
+            g_string_append_printf( ddl, "(%d)", MYSQL_MAX_INDEX_PREFIX );
+        }
     }
     (void)g_string_append( ddl, ")" );
 
@@ -2823,7 +3187,7 @@ conn_create_table( GncSqlConnection* conn, const gchar* table_name,
     g_return_val_if_fail( table_name != NULL, FALSE );
     g_return_val_if_fail( col_info_list != NULL, FALSE );
 
-
+    conn_flush_writer( dbi_conn );
     ddl = dbi_conn->provider->create_table_ddl( conn, table_name,
             col_info_list );
     g_list_free( col_info_list );
@@ -2863,6 +3227,7 @@ conn_create_index( /*@ unused @*/ GncSqlConnection* conn, /*@ unused @*/ const g
     g_return_val_if_fail( table_name != NULL, FALSE );
     g_return_val_if_fail( col_table != NULL, FALSE );
 
+    conn_flush_writer( dbi_conn );
     ddl = create_index_ddl( conn, index_name, table_name, col_table );
     if ( ddl != NULL )
     {
@@ -2886,6 +3251,49 @@ conn_create_index( /*@ unused @*/ GncSqlConnection* conn, /*@ unused @*/ const g
     return TRUE;
 }
 
+/* The provider lists MySQL indexes as "<index> <table>", the others by
+ * name alone; drop whichever entry is the index asked for. */
+static gboolean
+conn_drop_index( GncSqlConnection* conn, const gchar* index_name,
+                 const gchar* table_name )
+{
+    GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
+    gchar* mysql_name;
+    GSList* index_list;
+    GSList* iter;
+    gboolean ok = TRUE;
+
+    g_return_val_if_fail( conn != NULL, FALSE );
+    g_return_val_if_fail( index_name != NULL, FALSE );
+    g_return_val_if_fail( table_name != NULL, FALSE );
+
+    conn_flush_writer( dbi_conn );
+    mysql_name = g_strjoin( " ", index_name, table_name, NULL );
+    index_list = dbi_conn->provider->get_index_list( dbi_conn->conn );
+    for ( iter = index_list; iter != NULL; iter = g_slist_next( iter ) )
+    {
+        const gchar* name = iter->data;
+
+        if ( g_strcmp0( name, index_name ) == 0 || g_strcmp0( name, mysql_name ) == 0 )
+        {
+            const gchar* errmsg;
+
+            DEBUG( "Dropping index %s\n", name );
+            dbi_conn->provider->drop_index( dbi_conn->conn, name );
+            if ( dbi_conn_error( dbi_conn->conn, &errmsg ) != DBI_ERROR_NONE )
+            {
+                PERR( "Unable to drop index %s: %s\n", name, errmsg );
+                ok = FALSE;
+            }
+            break;
+        }
+    }
+    gnc_table_slist_free( index_list );
+    g_free( mysql_name );
+
+    return ok;
+}
+
 static gboolean
 conn_add_columns_to_table( /*@ unused @*/ GncSqlConnection* conn, /*@ unused @*/ const gchar* table_name,
         GList* col_info_list )
@@ -2899,6 +3307,7 @@ conn_add_columns_to_table( /*@ unused @*/ GncSqlConnection* conn, /*@ unused @*/
     g_return_val_if_fail( table_name != NULL, FALSE );
     g_return_val_if_fail( col_info_list != NULL, FALSE );
 
+    conn_flush_writer( dbi_conn );
     ddl = add_columns_ddl( conn, table_name, col_info_list );
     if ( ddl != NULL )
     {
@@ -3129,6 +3538,7 @@ create_dbi_connection( /*@ observer @*/ provider_functions_t* provider,
     dbi_conn->base.commitTransaction = conn_commit_transaction;
     dbi_conn->base.createTable = conn_create_table;
     dbi_conn->base.createIndex = conn_create_index;
+    dbi_conn->base.dropIndex = conn_drop_index;
     dbi_conn->base.addColumnsToTable = conn_add_columns_to_table;
     dbi_conn->base.quoteString = conn_quote_string;
     dbi_conn->qbe = qbe;
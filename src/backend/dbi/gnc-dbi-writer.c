@@ -0,0 +1,270 @@
+/********************************************************************
+ * gnc-dbi-writer.c: apply SQL writes on a background thread       *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gnc-dbi-writer.h"
+
+static QofLogModule log_module = G_LOG_DOMAIN;
+
+struct _GncDbiWriter
+{
+    dbi_conn conn;
+    GThread* thread;
+    GMutex* mutex;
+    GCond* cond;            /* Signalled when units are pushed or written */
+    GQueue* units;          /* GPtrArray*, in push order */
+    gboolean busy;          /* The thread is writing units it has taken */
+    gboolean stop;
+    QofBackendError error;  /* First failure not yet taken */
+};
+
+void
+gnc_dbi_writer_free_unit( GPtrArray* unit )
+{
+    g_return_if_fail( unit != NULL );
+
+    g_ptr_array_foreach( unit, (GFunc)g_free, NULL );
+    (void)g_ptr_array_free( unit, TRUE );
+}
+
+static gboolean
+run_sql( dbi_conn conn, const gchar* sql )
+{
+    dbi_result result;
+    const gchar* errmsg = NULL;
+
+    DEBUG( "SQL: %s\n", sql );
+    result = dbi_conn_query( conn, sql );
+    if ( result == NULL )
+    {
+        (void)dbi_conn_error( conn, &errmsg );
+        PERR( "Error executing SQL %s: %s\n", sql, errmsg != NULL ? errmsg : "" );
+        return FALSE;
+    }
+    if ( dbi_result_free( result ) < 0 )
+    {
+        PERR( "Error in dbi_result_free() result\n" );
+    }
+    return TRUE;
+}
+
+/* Writes a group of units in one database transaction. */
+static QofBackendError
+write_units( dbi_conn conn, GQueue* units )
+{
+    GList* node;
+    guint i;
+
+    if ( !run_sql( conn, "BEGIN" ) ) return ERR_BACKEND_SERVER_ERR;
+
+    for ( node = units->head; node != NULL; node = node->next )
+    {
+        GPtrArray* unit = node->data;
+
+        for ( i = 0; i < unit->len; i++ )
+        {
+            if ( !run_sql( conn, g_ptr_array_index( unit, i ) ) )
+            {
+                (void)run_sql( conn, "ROLLBACK" );
+                return ERR_BACKEND_SERVER_ERR;
+            }
+        }
+    }
+
+    if ( !run_sql( conn, "COMMIT" ) ) return ERR_BACKEND_SERVER_ERR;
+    return ERR_BACKEND_NO_ERR;
+}
+
+static gpointer
+writer_thread( gpointer data )
+{
+    GncDbiWriter* writer = data;
+    GQueue* units;
+    QofBackendError err;
+    gboolean failed;
+
+    g_mutex_lock( writer->mutex );
+    for ( ;; )
+    {
+        while ( g_queue_is_empty( writer->units ) && !writer->stop )
+        {
+            g_cond_wait( writer->cond, writer->mutex );
+        }
+        if ( g_queue_is_empty( writer->units ) ) break;
+
+        units = writer->units;
+        writer->units = g_queue_new();
+        writer->busy = TRUE;
+        failed = writer->error != ERR_BACKEND_NO_ERR;
+        g_mutex_unlock( writer->mutex );
+
+        /* Once a unit has been lost the database is out of step with the
+           book until it is saved in full, so don't keep writing to it
+           until the failure has been reported. */
+        err = failed ? ERR_BACKEND_NO_ERR : write_units( writer->conn, units );
+        g_queue_foreach( units, (GFunc)gnc_dbi_writer_free_unit, NULL );
+        g_queue_free( units );
+
+        g_mutex_lock( writer->mutex );
+        if ( writer->error == ERR_BACKEND_NO_ERR )
+        {
+            writer->error = err;
+        }
+        writer->busy = FALSE;
+        g_cond_broadcast( writer->cond );
+    }
+    g_mutex_unlock( writer->mutex );
+
+    return NULL;
+}
+
+GncDbiWriter*
+gnc_dbi_writer_new( dbi_conn conn )
+{
+    GncDbiWriter* writer;
+    GError* error = NULL;
+
+    g_return_val_if_fail( conn != NULL, NULL );
+
+#ifndef HAVE_GLIB_2_32
+    if ( !g_thread_supported() )
+    {
+        return NULL;
+    }
+#endif
+
+    writer = g_new0( GncDbiWriter, 1 );
+    g_assert( writer != NULL );
+
+    writer->conn = conn;
+#ifdef HAVE_GLIB_2_32
+    writer->mutex = g_new( GMutex, 1 );
+    g_mutex_init( writer->mutex );
+    writer->cond = g_new( GCond, 1 );
+    g_cond_init( writer->cond );
+#else
+    writer->mutex = g_mutex_new();
+    writer->cond = g_cond_new();
+#endif
+    writer->units = g_queue_new();
+    writer->error = ERR_BACKEND_NO_ERR;
+
+#ifdef HAVE_GLIB_2_32
+    writer->thread = g_thread_try_new( "gnc-dbi-writer", writer_thread, writer, &error );
+#else
+    writer->thread = g_thread_create( writer_thread, writer, TRUE, &error );
+#endif
+    if ( writer->thread == NULL )
+    {
+        PWARN( "Could not start the dbi writer thread: %s", error->message );
+        g_error_free( error );
+        writer->conn = NULL;
+        gnc_dbi_writer_destroy( writer );
+        return NULL;
+    }
+
+    return writer;
+}
+
+void
+gnc_dbi_writer_push( GncDbiWriter* writer, GPtrArray* unit )
+{
+    g_return_if_fail( writer != NULL );
+    g_return_if_fail( unit != NULL );
+
+    if ( unit->len == 0 )
+    {
+        gnc_dbi_writer_free_unit( unit );
+        return;
+    }
+
+    g_mutex_lock( writer->mutex );
+    g_queue_push_tail( writer->units, unit );
+    g_cond_broadcast( writer->cond );
+    g_mutex_unlock( writer->mutex );
+}
+
+QofBackendError
+gnc_dbi_writer_take_error( GncDbiWriter* writer )
+{
+    QofBackendError err;
+
+    g_return_val_if_fail( writer != NULL, ERR_BACKEND_NO_ERR );
+
+    g_mutex_lock( writer->mutex );
+    err = writer->error;
+    writer->error = ERR_BACKEND_NO_ERR;
+    g_mutex_unlock( writer->mutex );
+
+    return err;
+}
+
+QofBackendError
+gnc_dbi_writer_flush( GncDbiWriter* writer )
+{
+    g_return_val_if_fail( writer != NULL, ERR_BACKEND_NO_ERR );
+
+    g_mutex_lock( writer->mutex );
+    while ( !g_queue_is_empty( writer->units ) || writer->busy )
+    {
+        g_cond_wait( writer->cond, writer->mutex );
+    }
+    g_mutex_unlock( writer->mutex );
+
+    return gnc_dbi_writer_take_error( writer );
+}
+
+void
+gnc_dbi_writer_destroy( GncDbiWriter* writer )
+{
+    g_return_if_fail( writer != NULL );
+
+    if ( writer->thread != NULL )
+    {
+        g_mutex_lock( writer->mutex );
+        writer->stop = TRUE;
+        g_cond_broadcast( writer->cond );
+        g_mutex_unlock( writer->mutex );
+        (void)g_thread_join( writer->thread );
+    }
+    if ( writer->conn != NULL )
+    {
+        dbi_conn_close( writer->conn );
+    }
+
+    g_queue_foreach( writer->units, (GFunc)gnc_dbi_writer_free_unit, NULL );
+    g_queue_free( writer->units );
+#ifdef HAVE_GLIB_2_32
+    g_mutex_clear( writer->mutex );
+    g_free( writer->mutex );
+    g_cond_clear( writer->cond );
+    g_free( writer->cond );
+#else
+    g_mutex_free( writer->mutex );
+    g_cond_free( writer->cond );
+#endif
+    g_free( writer );
+}
+
+/* ========================== END OF FILE ===================== */
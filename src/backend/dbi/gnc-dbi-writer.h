@@ -0,0 +1,93 @@
+/********************************************************************
+ * gnc-dbi-writer.h: apply SQL writes on a background thread       *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+/* The writer owns a dbi connection of its own and a thread which
+ * applies the SQL statements pushed to it, in push order.  Each push
+ * is a unit: the statements of one committed database transaction.
+ * Whatever units are waiting when the thread gets to them are written
+ * in a single database transaction (group commit), so a failure loses
+ * the whole group.
+ *
+ * The writer never touches the engine or the backend; failures are
+ * kept until the owning thread asks for them.
+ */
+
+#ifndef GNC_DBI_WRITER_H
+#define GNC_DBI_WRITER_H
+
+#include <glib.h>
+#include <dbi/dbi.h>
+#include "qof.h"
+
+typedef struct _GncDbiWriter GncDbiWriter;
+
+/**
+ * Starts a writer over a connected dbi connection, which the writer
+ * then owns.
+ *
+ * @param conn Connection for the writer thread's exclusive use
+ * @return The writer, or NULL if no thread could be started, in which
+ * case the caller still owns the connection
+ */
+/*@ null @*/ GncDbiWriter* gnc_dbi_writer_new( dbi_conn conn );
+
+/**
+ * Queues a unit of SQL statements.  Doesn't wait for them to be written.
+ *
+ * @param writer Writer
+ * @param unit Array of gchar* SQL statements, which the writer frees
+ */
+void gnc_dbi_writer_push( GncDbiWriter* writer, /*@ only @*/ GPtrArray* unit );
+
+/**
+ * Returns the error of the first unit which failed since the error was
+ * last returned, and forgets it.  Doesn't wait.
+ *
+ * @param writer Writer
+ * @return Error, or ERR_BACKEND_NO_ERR
+ */
+QofBackendError gnc_dbi_writer_take_error( GncDbiWriter* writer );
+
+/**
+ * Waits until every unit pushed so far is in the database or has
+ * failed.
+ *
+ * @param writer Writer
+ * @return As gnc_dbi_writer_take_error()
+ */
+QofBackendError gnc_dbi_writer_flush( GncDbiWriter* writer );
+
+/**
+ * Writes anything still queued, stops the thread and closes the
+ * connection.  Errors are lost; flush first to get them.
+ *
+ * @param writer Writer
+ */
+void gnc_dbi_writer_destroy( /*@ only @*/ GncDbiWriter* writer );
+
+/**
+ * Frees a unit which isn't going to be pushed.
+ *
+ * @param unit Array of gchar* SQL statements
+ */
+void gnc_dbi_writer_free_unit( /*@ only @*/ GPtrArray* unit );
+
+#endif /* GNC_DBI_WRITER_H */
@@ -0,0 +1,253 @@
+/*
+ * bench-dbi-load.c -- Time decoding the rows of a large SQLite book.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Usage: bench-dbi-load [transactions]
+ *
+ * Writes a book with 'transactions' two-split transactions (100000 by
+ * default) to a temporary SQLite file, then opens it again and prints
+ * the time taken and the rows per second of:
+ *
+ *   - reading every column of every row of the transactions and splits
+ *     tables through the GncSqlRow interface, and
+ *   - loading the whole book with qof_session_load.
+ *
+ * This is not run as part of "make check". */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "qof.h"
+#include "cashobjects.h"
+#include "TransLog.h"
+#include "Account.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "gnc-commodity.h"
+#include "gnc-backend-sql.h"
+
+#define GNC_LIB_NAME "gncmod-backend-dbi"
+
+static const gchar* tx_cols[] =
+{
+    "guid", "currency_guid", "num", "post_date", "enter_date",
+    "description", NULL
+};
+
+static const gchar* split_cols[] =
+{
+    "guid", "tx_guid", "account_guid", "memo", "action", "reconcile_state",
+    "reconcile_date", "value_num", "value_denom", "quantity_num",
+    "quantity_denom", "lot_guid", NULL
+};
+
+static Account*
+add_account( QofBook* book, const gchar* name, gnc_commodity* currency )
+{
+    Account* acct = xaccMallocAccount( book );
+
+    xaccAccountBeginEdit( acct );
+    xaccAccountSetType( acct, ACCT_TYPE_BANK );
+    xaccAccountSetName( acct, name );
+    xaccAccountSetCommodity( acct, currency );
+    gnc_account_append_child( gnc_book_get_root_account( book ), acct );
+    xaccAccountCommitEdit( acct );
+    return acct;
+}
+
+static void
+add_split( QofBook* book, Transaction* tx, Account* acct, gint64 amount )
+{
+    Split* split = xaccMallocSplit( book );
+    gnc_numeric value = gnc_numeric_create( amount, 100 );
+
+    xaccSplitSetAccount( split, acct );
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAmount( split, value );
+    xaccSplitSetValue( split, value );
+    xaccSplitSetMemo( split, "Memo" );
+}
+
+static QofSession*
+create_book( int n_trans )
+{
+    QofSession* session = qof_session_new();
+    QofBook* book = qof_session_get_book( session );
+    gnc_commodity* currency;
+    Account* accts[4];
+    gchar* name;
+    time_t now = time( NULL );
+    int i;
+
+    currency = gnc_commodity_table_lookup( gnc_commodity_table_get_table( book ),
+                                           GNC_COMMODITY_NS_CURRENCY, "USD" );
+    for ( i = 0; i < 4; i++ )
+    {
+        name = g_strdup_printf( "Account %d", i );
+        accts[i] = add_account( book, name, currency );
+        g_free( name );
+    }
+
+    for ( i = 0; i < n_trans; i++ )
+    {
+        Transaction* tx = xaccMallocTransaction( book );
+        gint64 amount = 100 + ( i % 1000 );
+
+        xaccTransBeginEdit( tx );
+        xaccTransSetCurrency( tx, currency );
+        xaccTransSetDatePostedSecs( tx, now - ( i % 3650 ) * 86400 );
+        xaccTransSetDescription( tx, "Benchmark transaction" );
+        add_split( book, tx, accts[i % 4], amount );
+        add_split( book, tx, accts[( i + 1 ) % 4], -amount );
+        xaccTransCommitEdit( tx );
+    }
+    return session;
+}
+
+static void
+report( const char* what, GTimer* timer, guint rows )
+{
+    gdouble secs = g_timer_elapsed( timer, NULL );
+
+    printf( "%-14s %8u rows %8.3f s  %10.0f rows/s\n", what, rows, secs,
+            secs > 0 ? rows / secs : 0.0 );
+}
+
+/* Reads every listed column of every row of a table. */
+static guint
+read_table( GncSqlBackend* be, const gchar* table, const gchar** cols )
+{
+    GncSqlResult* result;
+    GncSqlRow* row;
+    gchar* sql;
+    guint rows = 0;
+    int i;
+
+    sql = g_strdup_printf( "SELECT * FROM %s", table );
+    result = gnc_sql_execute_select_sql( be, sql );
+    g_free( sql );
+    if ( result == NULL )
+    {
+        g_printerr( "Reading %s failed\n", table );
+        exit( 1 );
+    }
+    for ( row = gnc_sql_result_get_first_row( result ); row != NULL;
+            row = gnc_sql_result_get_next_row( result ) )
+    {
+        for ( i = 0; cols[i] != NULL; i++ )
+        {
+            (void)gnc_sql_row_get_value_at_col_name( row, cols[i] );
+        }
+        rows++;
+    }
+    gnc_sql_result_dispose( result );
+    return rows;
+}
+
+static QofSession*
+open_book( const gchar* url )
+{
+    QofSession* session = qof_session_new();
+
+    qof_session_begin( session, url, TRUE, FALSE, FALSE );
+    if ( qof_session_get_error( session ) != ERR_BACKEND_NO_ERR )
+    {
+        g_printerr( "Opening %s failed: %s\n", url,
+                    qof_session_get_error_message( session ) );
+        exit( 1 );
+    }
+    return session;
+}
+
+int
+main( int argc, char** argv )
+{
+    QofSession* session;
+    QofSession* saved;
+    GncSqlBackend* be;
+    GTimer* timer;
+    gchar* path;
+    gchar* url;
+    guint rows;
+    int n_trans = 100000;
+
+    if ( argc > 1 )
+        n_trans = atoi( argv[1] );
+
+    qof_init();
+    cashobjects_register();
+    xaccLogDisable();
+    qof_load_backend_library( "../.libs/", GNC_LIB_NAME );
+
+    path = g_strdup_printf( "%s/bench-dbi-load-%d.gnucash", g_get_tmp_dir(),
+                            (int)getpid() );
+    url = g_strdup_printf( "sqlite3://%s", path );
+
+    /* Write the book */
+    session = create_book( n_trans );
+    saved = qof_session_new();
+    qof_session_begin( saved, url, FALSE, TRUE, TRUE );
+    qof_session_swap_data( session, saved );
+    timer = g_timer_new();
+    qof_session_save( saved, NULL );
+    g_timer_stop( timer );
+    if ( qof_session_get_error( saved ) != ERR_BACKEND_NO_ERR )
+    {
+        g_printerr( "Saving %s failed: %s\n", url,
+                    qof_session_get_error_message( saved ) );
+        exit( 1 );
+    }
+    report( "save", timer, (guint)n_trans * 3 );
+    qof_session_end( saved );
+    qof_session_destroy( saved );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    /* Decode the rows without building any objects */
+    session = open_book( url );
+    be = (GncSqlBackend*)qof_session_get_backend( session );
+    g_timer_start( timer );
+    rows = read_table( be, "transactions", tx_cols );
+    rows += read_table( be, "splits", split_cols );
+    g_timer_stop( timer );
+    report( "decode rows", timer, rows );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    /* Load the whole book */
+    session = open_book( url );
+    g_timer_start( timer );
+    qof_session_load( session, NULL );
+    g_timer_stop( timer );
+    report( "load book", timer, rows );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    g_timer_destroy( timer );
+    g_unlink( path );
+    g_free( path );
+    g_free( url );
+    qof_close();
+    return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * bench-dbi-report.c -- Time opening a large SQLite book and the queries
+ *                       reports make of it.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Usage: bench-dbi-report [transactions]
+ *
+ * Writes a book with 'transactions' two-split transactions (500000, so
+ * a million splits, by default) across 16 accounts, 10000 prices and a
+ * notes slot on every tenth transaction to a temporary SQLite file.  It
+ * then opens the file twice, first with the default settings and then
+ * with the GNC_DBI_SQLITE_PERFORMANCE profile, and prints the time taken
+ * by:
+ *
+ *   - opening and loading the book,
+ *   - the splits of each account in each month (splits joined to
+ *     transactions on an account and a post date range),
+ *   - the latest price of each commodity in each month, and
+ *   - the notes slot of 1000 transactions.
+ *
+ * This is not run as part of "make check". */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "qof.h"
+#include "cashobjects.h"
+#include "TransLog.h"
+#include "Account.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "gnc-commodity.h"
+#include "gnc-pricedb.h"
+#include "gnc-backend-sql.h"
+
+#define GNC_LIB_NAME "gncmod-backend-dbi"
+
+#define N_ACCOUNTS 16
+#define N_COMMODITIES 20
+#define N_PRICES 500
+#define N_MONTHS 12
+#define N_NOTES 1000
+#define DAY_SECS 86400
+#define MONTH_SECS ( 30 * DAY_SECS )
+
+static GncGUID account_guids[N_ACCOUNTS];
+static GncGUID commodity_guids[N_COMMODITIES];
+static GncGUID currency_guid;
+static GncGUID notes_guids[N_NOTES];
+static time_t now;
+
+static Account*
+add_account( QofBook* book, const gchar* name, gnc_commodity* currency )
+{
+    Account* acct = xaccMallocAccount( book );
+
+    xaccAccountBeginEdit( acct );
+    xaccAccountSetType( acct, ACCT_TYPE_BANK );
+    xaccAccountSetName( acct, name );
+    xaccAccountSetCommodity( acct, currency );
+    gnc_account_append_child( gnc_book_get_root_account( book ), acct );
+    xaccAccountCommitEdit( acct );
+    return acct;
+}
+
+static void
+add_split( QofBook* book, Transaction* tx, Account* acct, gint64 amount )
+{
+    Split* split = xaccMallocSplit( book );
+    gnc_numeric value = gnc_numeric_create( amount, 100 );
+
+    xaccSplitSetAccount( split, acct );
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAmount( split, value );
+    xaccSplitSetValue( split, value );
+    xaccSplitSetMemo( split, "Memo" );
+}
+
+static void
+add_prices( QofBook* book, gnc_commodity* currency )
+{
+    gnc_commodity_table* table = gnc_commodity_table_get_table( book );
+    GNCPriceDB* db = gnc_pricedb_get_db( book );
+    gchar* name;
+    int i, j;
+
+    for ( i = 0; i < N_COMMODITIES; i++ )
+    {
+        gnc_commodity* commodity;
+
+        name = g_strdup_printf( "STK%d", i );
+        commodity = gnc_commodity_new( book, name, "NASDAQ", name, NULL, 1 );
+        commodity = gnc_commodity_table_insert( table, commodity );
+        commodity_guids[i] = *qof_entity_get_guid( QOF_INSTANCE(commodity) );
+        g_free( name );
+
+        for ( j = 0; j < N_PRICES; j++ )
+        {
+            GNCPrice* price = gnc_price_create( book );
+            Timespec ts;
+
+            ts.tv_sec = now - j * DAY_SECS;
+            ts.tv_nsec = 0;
+            gnc_price_begin_edit( price );
+            gnc_price_set_commodity( price, commodity );
+            gnc_price_set_currency( price, currency );
+            gnc_price_set_time( price, ts );
+            gnc_price_set_source( price, "user:price-editor" );
+            gnc_price_set_typestr( price, "last" );
+            gnc_price_set_value( price, gnc_numeric_create( 1000 + i * 10 + j % 7, 100 ) );
+            gnc_price_commit_edit( price );
+            (void)gnc_pricedb_add_price( db, price );
+            gnc_price_unref( price );
+        }
+    }
+}
+
+static QofSession*
+create_book( int n_trans )
+{
+    QofSession* session = qof_session_new();
+    QofBook* book = qof_session_get_book( session );
+    gnc_commodity* currency;
+    Account* accts[N_ACCOUNTS];
+    gchar* name;
+    int i;
+
+    currency = gnc_commodity_table_lookup( gnc_commodity_table_get_table( book ),
+                                           GNC_COMMODITY_NS_CURRENCY, "USD" );
+    currency_guid = *qof_entity_get_guid( QOF_INSTANCE(currency) );
+    for ( i = 0; i < N_ACCOUNTS; i++ )
+    {
+        name = g_strdup_printf( "Account %d", i );
+        accts[i] = add_account( book, name, currency );
+        account_guids[i] = *qof_entity_get_guid( QOF_INSTANCE(accts[i]) );
+        g_free( name );
+    }
+
+    for ( i = 0; i < n_trans; i++ )
+    {
+        Transaction* tx = xaccMallocTransaction( book );
+        gint64 amount = 100 + ( i % 1000 );
+
+        xaccTransBeginEdit( tx );
+        xaccTransSetCurrency( tx, currency );
+        xaccTransSetDatePostedSecs( tx, now - ( i % 3650 ) * DAY_SECS );
+        xaccTransSetDescription( tx, "Benchmark transaction" );
+        if ( i % 10 == 0 )
+        {
+            xaccTransSetNotes( tx, "Benchmark notes" );
+            if ( i / 10 < N_NOTES )
+                notes_guids[i / 10] = *qof_entity_get_guid( QOF_INSTANCE(tx) );
+        }
+        add_split( book, tx, accts[i % N_ACCOUNTS], amount );
+        add_split( book, tx, accts[( i + 1 ) % N_ACCOUNTS], -amount );
+        xaccTransCommitEdit( tx );
+    }
+
+    add_prices( book, currency );
+    return session;
+}
+
+static void
+report( const char* what, GTimer* timer, guint queries, guint rows )
+{
+    gdouble secs = g_timer_elapsed( timer, NULL );
+
+    printf( "  %-16s %6u queries %8u rows %8.3f s\n", what, queries, rows, secs );
+}
+
+/* Runs a query and returns the number of rows it gave */
+static guint
+run_query( GncSqlBackend* be, const gchar* sql )
+{
+    GncSqlResult* result;
+    guint rows;
+
+    result = gnc_sql_execute_select_sql( be, sql );
+    if ( result == NULL )
+    {
+        g_printerr( "Query failed: %s\n", sql );
+        exit( 1 );
+    }
+    rows = gnc_sql_result_get_num_rows( result );
+    gnc_sql_result_dispose( result );
+    return rows;
+}
+
+static gchar*
+date_string( GncSqlBackend* be, time_t secs )
+{
+    Timespec ts;
+
+    ts.tv_sec = secs;
+    ts.tv_nsec = 0;
+    return gnc_sql_convert_timespec_to_string( be, ts );
+}
+
+static void
+run_reports( GncSqlBackend* be, GTimer* timer )
+{
+    gchar guid_str[GUID_ENCODING_LENGTH + 1];
+    gchar currency_str[GUID_ENCODING_LENGTH + 1];
+    gchar* sql;
+    guint queries = 0;
+    guint rows = 0;
+    int i, month;
+
+    /* Account register and balance reports */
+    g_timer_start( timer );
+    for ( i = 0; i < N_ACCOUNTS; i++ )
+    {
+        (void)guid_to_string_buff( &account_guids[i], guid_str );
+        for ( month = 0; month < N_MONTHS; month++ )
+        {
+            gchar* start = date_string( be, now - ( month + 1 ) * MONTH_SECS );
+            gchar* end = date_string( be, now - month * MONTH_SECS );
+
+            sql = g_strdup_printf( "SELECT s.guid, s.value_num, s.value_denom FROM splits s"
+                                   " INNER JOIN transactions t ON t.guid = s.tx_guid"
+                                   " WHERE s.account_guid = '%s'"
+                                   " AND t.post_date >= '%s' AND t.post_date < '%s'",
+                                   guid_str, start, end );
+            rows += run_query( be, sql );
+            queries++;
+            g_free( sql );
+            g_free( start );
+            g_free( end );
+        }
+    }
+    g_timer_stop( timer );
+    report( "account by month", timer, queries, rows );
+
+    /* Price lookups, as for a portfolio report */
+    queries = rows = 0;
+    (void)guid_to_string_buff( &currency_guid, currency_str );
+    g_timer_start( timer );
+    for ( i = 0; i < N_COMMODITIES; i++ )
+    {
+        (void)guid_to_string_buff( &commodity_guids[i], guid_str );
+        for ( month = 0; month < N_MONTHS; month++ )
+        {
+            gchar* date = date_string( be, now - month * MONTH_SECS );
+
+            sql = g_strdup_printf( "SELECT * FROM prices"
+                                   " WHERE commodity_guid = '%s' AND currency_guid = '%s'"
+                                   " AND date <= '%s' ORDER BY date DESC LIMIT 1",
+                                   guid_str, currency_str, date );
+            rows += run_query( be, sql );
+            queries++;
+            g_free( sql );
+            g_free( date );
+        }
+    }
+    g_timer_stop( timer );
+    report( "latest price", timer, queries, rows );
+
+    /* Slot lookups */
+    queries = rows = 0;
+    g_timer_start( timer );
+    for ( i = 0; i < N_NOTES; i++ )
+    {
+        (void)guid_to_string_buff( &notes_guids[i], guid_str );
+        sql = g_strdup_printf( "SELECT * FROM slots WHERE obj_guid = '%s' AND name = 'notes'",
+                               guid_str );
+        rows += run_query( be, sql );
+        queries++;
+        g_free( sql );
+    }
+    g_timer_stop( timer );
+    report( "notes slot", timer, queries, rows );
+}
+
+static void
+open_and_report( const gchar* what, const gchar* url, GTimer* timer )
+{
+    QofSession* session = qof_session_new();
+
+    printf( "%s\n", what );
+    g_timer_start( timer );
+    qof_session_begin( session, url, TRUE, FALSE, FALSE );
+    if ( qof_session_get_error( session ) != ERR_BACKEND_NO_ERR )
+    {
+        g_printerr( "Opening %s failed: %s\n", url,
+                    qof_session_get_error_message( session ) );
+        exit( 1 );
+    }
+    qof_session_load( session, NULL );
+    g_timer_stop( timer );
+    report( "open", timer, 0, 0 );
+
+    run_reports( (GncSqlBackend*)qof_session_get_backend( session ), timer );
+
+    qof_session_end( session );
+    qof_session_destroy( session );
+}
+
+int
+main( int argc, char** argv )
+{
+    QofSession* session;
+    QofSession* saved;
+    GTimer* timer;
+    gchar* path;
+    gchar* url;
+    gchar* file;
+    int n_trans = 500000;
+
+    if ( argc > 1 )
+        n_trans = atoi( argv[1] );
+    if ( n_trans < N_NOTES * 10 )
+        n_trans = N_NOTES * 10;
+
+    qof_init();
+    cashobjects_register();
+    xaccLogDisable();
+    qof_load_backend_library( "../.libs/", GNC_LIB_NAME );
+
+    path = g_strdup_printf( "%s/bench-dbi-report-%d.gnucash", g_get_tmp_dir(),
+                            (int)getpid() );
+    url = g_strdup_printf( "sqlite3://%s", path );
+    now = time( NULL );
+
+    /* Write the book */
+    session = create_book( n_trans );
+    saved = qof_session_new();
+    qof_session_begin( saved, url, FALSE, TRUE, TRUE );
+    qof_session_swap_data( session, saved );
+    qof_session_save( saved, NULL );
+    if ( qof_session_get_error( saved ) != ERR_BACKEND_NO_ERR )
+    {
+        g_printerr( "Saving %s failed: %s\n", url,
+                    qof_session_get_error_message( saved ) );
+        exit( 1 );
+    }
+    qof_session_end( saved );
+    qof_session_destroy( saved );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    timer = g_timer_new();
+    g_unsetenv( "GNC_DBI_SQLITE_PERFORMANCE" );
+    open_and_report( "default", url, timer );
+    g_setenv( "GNC_DBI_SQLITE_PERFORMANCE", "1", TRUE );
+    open_and_report( "performance profile", url, timer );
+
+    g_timer_destroy( timer );
+    g_unlink( path );
+    /* The performance profile leaves the file in write-ahead log mode */
+    file = g_strconcat( path, "-wal", NULL );
+    g_unlink( file );
+    g_free( file );
+    file = g_strconcat( path, "-shm", NULL );
+    g_unlink( file );
+    g_free( file );
+    g_free( path );
+    g_free( url );
+    qof_close();
+    return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * bench-dbi-save.c -- Time saving a large book to a new SQLite file.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Usage: bench-dbi-save [transactions]
+ *
+ * Builds a book with 'transactions' two-split transactions (100000 by
+ * default) and saves it, as "Save As" does, to temporary SQLite files:
+ * once with one row per INSERT and once with the multi-row INSERTs the
+ * backend uses by default.  For each it prints the time taken, the rows
+ * per second, the rows carried by each INSERT on average and the time at which the progress callback passed 25%,
+ * 50%, 75% and 100%, which should be roughly in proportion if the
+ * progress shown to the user is to be believed.
+ *
+ * This is not run as part of "make check". */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "qof.h"
+#include "cashobjects.h"
+#include "TransLog.h"
+#include "Account.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "gnc-commodity.h"
+#include "gnc-backend-sql.h"
+
+#define GNC_LIB_NAME "gncmod-backend-dbi"
+
+/* The percentage callback has no closure, so it reports through these */
+static GTimer* progress_timer = NULL;
+static gdouble quarter_secs[4];
+static gdouble last_percent;
+static guint backwards;
+
+static void
+record_progress( const char* message, double percent )
+{
+    int quarter;
+
+    if ( percent < 0 || percent > 100 ) return;
+    if ( percent < last_percent ) backwards++;
+    last_percent = percent;
+    for ( quarter = 0; quarter < 4; quarter++ )
+    {
+        if ( percent >= 25.0 * ( quarter + 1 ) && quarter_secs[quarter] < 0 )
+            quarter_secs[quarter] = g_timer_elapsed( progress_timer, NULL );
+    }
+}
+
+static Account*
+add_account( QofBook* book, const gchar* name, gnc_commodity* currency )
+{
+    Account* acct = xaccMallocAccount( book );
+
+    xaccAccountBeginEdit( acct );
+    xaccAccountSetType( acct, ACCT_TYPE_BANK );
+    xaccAccountSetName( acct, name );
+    xaccAccountSetCommodity( acct, currency );
+    gnc_account_append_child( gnc_book_get_root_account( book ), acct );
+    xaccAccountCommitEdit( acct );
+    return acct;
+}
+
+static void
+add_split( QofBook* book, Transaction* tx, Account* acct, gint64 amount )
+{
+    Split* split = xaccMallocSplit( book );
+    gnc_numeric value = gnc_numeric_create( amount, 100 );
+
+    xaccSplitSetAccount( split, acct );
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAmount( split, value );
+    xaccSplitSetValue( split, value );
+    xaccSplitSetMemo( split, "Memo" );
+}
+
+static QofSession*
+create_book( int n_trans )
+{
+    QofSession* session = qof_session_new();
+    QofBook* book = qof_session_get_book( session );
+    gnc_commodity* currency;
+    Account* accts[4];
+    gchar* name;
+    time_t now = time( NULL );
+    int i;
+
+    currency = gnc_commodity_table_lookup( gnc_commodity_table_get_table( book ),
+                                           GNC_COMMODITY_NS_CURRENCY, "USD" );
+    for ( i = 0; i < 4; i++ )
+    {
+        name = g_strdup_printf( "Account %d", i );
+        accts[i] = add_account( book, name, currency );
+        g_free( name );
+    }
+
+    for ( i = 0; i < n_trans; i++ )
+    {
+        Transaction* tx = xaccMallocTransaction( book );
+        gint64 amount = 100 + ( i % 1000 );
+
+        xaccTransBeginEdit( tx );
+        xaccTransSetCurrency( tx, currency );
+        xaccTransSetDatePostedSecs( tx, now - ( i % 3650 ) * 86400 );
+        xaccTransSetDescription( tx, "Benchmark transaction" );
+        add_split( book, tx, accts[i % 4], amount );
+        add_split( book, tx, accts[( i + 1 ) % 4], -amount );
+        xaccTransCommitEdit( tx );
+    }
+    return session;
+}
+
+/* Saves the book in 'session' to a new file with at most 'max_rows' rows
+   per INSERT, and reports on it. */
+static void
+save_book( QofSession* session, const gchar* what, guint max_rows, guint rows )
+{
+    QofSession* saved;
+    GncSqlBackend* be;
+    gchar* path;
+    gchar* url;
+    gdouble secs;
+    int quarter;
+
+    path = g_strdup_printf( "%s/bench-dbi-save-%d-%u.gnucash", g_get_tmp_dir(),
+                            (int)getpid(), max_rows );
+    url = g_strdup_printf( "sqlite3://%s", path );
+
+    saved = qof_session_new();
+    qof_session_begin( saved, url, FALSE, TRUE, TRUE );
+    if ( qof_session_get_error( saved ) != ERR_BACKEND_NO_ERR )
+    {
+        g_printerr( "Opening %s failed: %s\n", url,
+                    qof_session_get_error_message( saved ) );
+        exit( 1 );
+    }
+    be = (GncSqlBackend*)qof_session_get_backend( saved );
+    be->max_insert_rows = max_rows;
+    qof_session_swap_data( session, saved );
+
+    for ( quarter = 0; quarter < 4; quarter++ )
+        quarter_secs[quarter] = -1;
+    last_percent = 0;
+    backwards = 0;
+    g_timer_start( progress_timer );
+    qof_session_save( saved, record_progress );
+    secs = g_timer_elapsed( progress_timer, NULL );
+    if ( qof_session_get_error( saved ) != ERR_BACKEND_NO_ERR )
+    {
+        g_printerr( "Saving %s failed: %s\n", url,
+                    qof_session_get_error_message( saved ) );
+        exit( 1 );
+    }
+
+    printf( "%-14s %8u rows %8.3f s  %10.0f rows/s  %6.1f rows/INSERT\n",
+            what, rows, secs, secs > 0 ? rows / secs : 0.0,
+            be->bulk_statements > 0 ?
+            (gdouble)be->bulk_rows / be->bulk_statements : 1.0 );
+    printf( "%-14s progress 25%% %.3f s, 50%% %.3f s, 75%% %.3f s, 100%% %.3f s",
+            "", quarter_secs[0], quarter_secs[1], quarter_secs[2],
+            quarter_secs[3] );
+    if ( backwards > 0 )
+        printf( ", went backwards %u times", backwards );
+    printf( "\n" );
+
+    /* Give the book back for the next save */
+    qof_session_swap_data( saved, session );
+    qof_session_end( saved );
+    qof_session_destroy( saved );
+    g_unlink( path );
+    g_free( path );
+    g_free( url );
+}
+
+int
+main( int argc, char** argv )
+{
+    QofSession* session;
+    guint rows;
+    int n_trans = 100000;
+
+    if ( argc > 1 )
+        n_trans = atoi( argv[1] );
+
+    qof_init();
+    cashobjects_register();
+    xaccLogDisable();
+    qof_load_backend_library( "../.libs/", GNC_LIB_NAME );
+
+    session = create_book( n_trans );
+    rows = (guint)n_trans * 3;
+    progress_timer = g_timer_new();
+
+    save_book( session, "single-row", 1, rows );
+    save_book( session, "multi-row", 500, rows );
+
+    g_timer_destroy( progress_timer );
+    qof_session_end( session );
+    qof_session_destroy( session );
+    qof_close();
+    return 0;
+}
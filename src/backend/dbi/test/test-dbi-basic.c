@@ -102,6 +102,9 @@ int main (int argc, char ** argv)
     gchar* filename;
     QofSession* session_1;
 
+#ifndef HAVE_GLIB_2_32
+    g_thread_init( NULL );
+#endif
     qof_init();
     cashobjects_register();
     xaccLogDisable();
@@ -114,6 +117,11 @@ int main (int argc, char ** argv)
     test_dbi_store_and_reload( "sqlite3", session_1, filename );
     session_1 = create_session();
     test_dbi_safe_save( "sqlite3", filename );
+    test_dbi_update_slots( "sqlite3", filename );
+    test_dbi_persisted_commodities( "sqlite3", filename );
+    test_dbi_load_as_needed( "sqlite3", filename );
+    test_dbi_safe_save_as_needed( "sqlite3", filename );
+    test_dbi_query_pushdown( "sqlite3", filename );
     test_dbi_version_control( "sqlite3", filename );
 #ifdef TEST_MYSQL_URL
     printf( "TEST_MYSQL_URL='%s'\n", TEST_MYSQL_URL );
@@ -124,6 +132,7 @@ int main (int argc, char ** argv)
         session_1 = create_session();
         test_dbi_safe_save( "mysql", filename );
         test_dbi_version_control( "mysql", filename );
+        test_dbi_write_behind( "mysql", TEST_MYSQL_URL );
     }
 #endif
 #ifdef TEST_PGSQL_URL
@@ -135,6 +144,7 @@ int main (int argc, char ** argv)
         session_1 = create_session();
         test_dbi_safe_save( "pgsql", filename );
         test_dbi_version_control( "pgsql", filename );
+        test_dbi_write_behind( "pgsql", TEST_PGSQL_URL );
     }
 #endif
     print_test_results();
@@ -24,6 +24,7 @@
  */
 
 #include "config.h"
+#include <string.h>
 #include "qof.h"
 #include "gnc-main.h"
 #include "qofsession-p.h"
@@ -35,6 +36,7 @@
 #include "Account.h"
 #include "Split.h"
 #include "Transaction.h"
+#include "Query.h"
 #include "gnc-commodity.h"
 #include "../gnc-backend-dbi-priv.h"
 
@@ -145,7 +147,7 @@ test_conn_get_index_list( QofBackend *qbe )
         do_test( FALSE, "Index List Test -- No List" );
         return;
     }
-    do_test( g_slist_length( index_list ) == 4, "Index List Test" );
+    do_test( g_slist_length( index_list ) == 8, "Index List Test" );
     g_slist_free( index_list );
 }
 
@@ -279,6 +281,782 @@ cleanup:
     return;
 }
 
+static Account*
+load_slots_account( QofSession** session, const gchar* url )
+{
+    *session = qof_session_new();
+    qof_session_begin( *session, url, TRUE, FALSE, FALSE );
+    if ( qof_session_get_error( *session ) != ERR_BACKEND_NO_ERR )
+    {
+        g_warning( "Session Error: %s", qof_session_get_error_message( *session ) );
+        return NULL;
+    }
+    qof_session_load( *session, NULL );
+    return gnc_account_lookup_by_name( gnc_book_get_root_account( qof_session_get_book( *session ) ),
+                                       "Bank 1" );
+}
+
+static gboolean
+reload_and_compare_slots( Account* acct, const gchar* url )
+{
+    QofSession* session;
+    Account* reloaded;
+    gboolean same = FALSE;
+
+    reloaded = load_slots_account( &session, url );
+    if ( reloaded != NULL )
+    {
+        same = kvp_frame_compare( qof_instance_get_slots( QOF_INSTANCE(acct) ),
+                                  qof_instance_get_slots( QOF_INSTANCE(reloaded) ) ) == 0;
+    }
+    qof_session_end( session );
+    qof_session_destroy( session );
+    return same;
+}
+
+/* Edit the slots of an account in an existing db and check that only
+ * the changes are written, nested frames included, by reloading the
+ * account and comparing its slots. */
+void
+test_dbi_update_slots( const gchar* driver, const gchar* url )
+{
+    QofSession* session;
+    Account* acct;
+    KvpFrame* frame;
+
+    printf( "Testing slot updates %s\n", driver );
+
+    acct = load_slots_account( &session, url );
+    if ( acct == NULL )
+    {
+        do_test( FALSE, "DB Session load for slot updates failed" );
+        goto cleanup;
+    }
+    frame = qof_instance_get_slots( QOF_INSTANCE(acct) );
+
+    xaccAccountBeginEdit( acct );
+    kvp_frame_set_gint64( frame, "int64-val", 200 );
+    kvp_frame_set_value( frame, "double-val", NULL );
+    kvp_frame_set_string( frame, "nested/string-val", "one" );
+    kvp_frame_set_gint64( frame, "nested/deeper/int64-val", 1 );
+    qof_instance_set_dirty( QOF_INSTANCE(acct) );
+    xaccAccountCommitEdit( acct );
+    do_test( reload_and_compare_slots( acct, url ),
+             "Changed, removed and added slots saved" );
+
+    xaccAccountBeginEdit( acct );
+    kvp_frame_set_string( frame, "nested/string-val", "two" );
+    kvp_frame_set_value( frame, "nested/deeper/int64-val", NULL );
+    kvp_frame_set_gint64( frame, "nested/deeper/other-val", 2 );
+    qof_instance_set_dirty( QOF_INSTANCE(acct) );
+    xaccAccountCommitEdit( acct );
+    do_test( reload_and_compare_slots( acct, url ),
+             "Changes to nested frames saved" );
+
+    xaccAccountBeginEdit( acct );
+    kvp_frame_set_value( frame, "nested", NULL );
+    qof_instance_set_dirty( QOF_INSTANCE(acct) );
+    xaccAccountCommitEdit( acct );
+    do_test( reload_and_compare_slots( acct, url ),
+             "Removed nested frame deleted" );
+
+    xaccAccountBeginEdit( acct );
+    xaccAccountSetCode( acct, "1000" );
+    xaccAccountCommitEdit( acct );
+    do_test( reload_and_compare_slots( acct, url ),
+             "Unchanged slots kept" );
+
+cleanup:
+    qof_session_end( session );
+    qof_session_destroy( session );
+}
+
+static void
+find_tx_cb( QofInstance* inst, gpointer user_data )
+{
+    Transaction** tx = (Transaction**)user_data;
+
+    if ( *tx == NULL ) *tx = GNC_TRANS(inst);
+}
+
+/* Edit a transaction in an existing db and check that finding its
+ * currency in the db didn't need a query. */
+void
+test_dbi_persisted_commodities( const gchar* driver, const gchar* url )
+{
+    QofSession* session;
+    QofBook* book;
+    GncSqlBackend* be;
+    Transaction* tx = NULL;
+    guint avoided;
+
+    printf( "Testing persisted commodities %s\n", driver );
+
+    session = qof_session_new();
+    qof_session_begin( session, url, TRUE, FALSE, FALSE );
+    if ( qof_session_get_error( session ) != ERR_BACKEND_NO_ERR )
+    {
+        g_warning( "Session Error: %s", qof_session_get_error_message( session ) );
+        do_test( FALSE, "DB Session Creation Failed" );
+        goto cleanup;
+    }
+    qof_session_load( session, NULL );
+    qof_session_ensure_all_data_loaded( session );
+    book = qof_session_get_book( session );
+    be = (GncSqlBackend*)qof_session_get_backend( session );
+
+    qof_collection_foreach( qof_book_get_collection( book, GNC_ID_TRANS ),
+                            find_tx_cb, &tx );
+    if ( tx == NULL )
+    {
+        do_test( FALSE, "No transaction to edit" );
+        goto cleanup;
+    }
+
+    avoided = gnc_sql_get_avoided_query_count( be );
+    xaccTransBeginEdit( tx );
+    xaccTransSetDescription( tx, "Persisted commodities" );
+    xaccTransCommitEdit( tx );
+    do_test( qof_session_get_error( session ) == ERR_BACKEND_NO_ERR,
+             "Transaction saved" );
+    do_test( gnc_sql_get_avoided_query_count( be ) > avoided,
+             "Currency found without a query" );
+
+cleanup:
+    qof_session_end( session );
+    qof_session_destroy( session );
+}
+
+static void
+add_transfer( QofBook* book, Account* from, Account* to, gint64 amount, char reconcile )
+{
+    gnc_commodity* currency = xaccAccountGetCommodity( from );
+    gnc_numeric value = gnc_numeric_create( amount, 100 );
+    Transaction* tx;
+    Split* split;
+
+    tx = xaccMallocTransaction( book );
+    xaccTransBeginEdit( tx );
+    xaccTransSetCurrency( tx, currency );
+    xaccTransSetDatePostedSecs( tx, time( NULL ) );
+    xaccTransSetDescription( tx, "Transfer" );
+
+    split = xaccMallocSplit( book );
+    xaccSplitSetAccount( split, to );
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAmount( split, value );
+    xaccSplitSetValue( split, value );
+    xaccSplitSetReconcile( split, reconcile );
+
+    split = xaccMallocSplit( book );
+    xaccSplitSetAccount( split, from );
+    xaccSplitSetParent( split, tx );
+    xaccSplitSetAmount( split, gnc_numeric_neg( value ) );
+    xaccSplitSetValue( split, gnc_numeric_neg( value ) );
+    xaccTransCommitEdit( tx );
+}
+
+static gint
+count_instances( QofBook* book, QofIdTypeConst type )
+{
+    return qof_collection_count( qof_book_get_collection( book, type ) );
+}
+
+/* Opens and loads an existing db, with GNC_SQL_LOAD_TX_AS_NEEDED set if
+ * as_needed is TRUE.  Returns NULL if the session can't be begun. */
+static QofSession*
+open_session( const gchar* url, gboolean as_needed )
+{
+    QofSession* session = qof_session_new();
+
+    if ( as_needed ) g_setenv( "GNC_SQL_LOAD_TX_AS_NEEDED", "1", TRUE );
+    qof_session_begin( session, url, TRUE, FALSE, FALSE );
+    if ( as_needed ) g_unsetenv( "GNC_SQL_LOAD_TX_AS_NEEDED" );
+    if ( qof_session_get_error( session ) != ERR_BACKEND_NO_ERR )
+    {
+        g_warning( "Session Error: %s", qof_session_get_error_message( session ) );
+        qof_session_destroy( session );
+        return NULL;
+    }
+    qof_session_load( session, NULL );
+    return session;
+}
+
+/* Open an existing db with GNC_SQL_LOAD_TX_AS_NEEDED set and check that
+ * no transactions are loaded until they are asked for, and that the
+ * account balances are right before and after they are. */
+void
+test_dbi_load_as_needed( const gchar* driver, const gchar* url )
+{
+    QofSession* session;
+    QofBook* book;
+    QofQuery* query;
+    Account* root;
+    Account* bank;
+    Account* savings;
+    GList* splits;
+    gnc_numeric balance;
+    gnc_numeric cleared;
+    gnc_numeric balances[2];
+    time_t dates[2];
+    gint i;
+
+    printf( "Testing loading transactions as needed %s\n", driver );
+
+    bank = load_slots_account( &session, url );
+    if ( bank == NULL )
+    {
+        do_test( FALSE, "DB Session load failed" );
+        goto cleanup;
+    }
+    book = qof_session_get_book( session );
+    root = gnc_book_get_root_account( book );
+
+    savings = xaccMallocAccount( book );
+    xaccAccountBeginEdit( savings );
+    xaccAccountSetType( savings, ACCT_TYPE_BANK );
+    xaccAccountSetName( savings, "Savings" );
+    xaccAccountSetCommodity( savings, xaccAccountGetCommodity( bank ) );
+    gnc_account_append_child( root, savings );
+    xaccAccountCommitEdit( savings );
+
+    add_transfer( book, bank, savings, 10000, CREC );
+    add_transfer( book, bank, savings, 2550, NREC );
+    balance = xaccAccountGetBalance( savings );
+    cleared = xaccAccountGetClearedBalance( savings );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    session = open_session( url, TRUE );
+    if ( session == NULL )
+    {
+        do_test( FALSE, "DB Session Creation Failed" );
+        return;
+    }
+    book = qof_session_get_book( session );
+    savings = gnc_account_lookup_by_name( gnc_book_get_root_account( book ), "Savings" );
+    if ( savings == NULL )
+    {
+        do_test( FALSE, "Savings account not loaded" );
+        goto cleanup;
+    }
+
+    do_test( count_instances( book, GNC_ID_TRANS ) == 0,
+             "No transactions loaded at open" );
+    do_test( gnc_numeric_equal( xaccAccountGetBalance( savings ), balance )
+             && gnc_numeric_equal( xaccAccountGetClearedBalance( savings ), cleared ),
+             "Balances loaded at open" );
+
+    query = qof_query_create_for( GNC_ID_SPLIT );
+    qof_query_set_book( query, book );
+    xaccQueryAddSingleAccountMatch( query, savings, QOF_QUERY_AND );
+    xaccQueryAddClearedMatch( query, CLEARED_CLEARED, QOF_QUERY_AND );
+    splits = qof_query_run( query );
+    do_test( g_list_length( splits ) == 1, "Query found the cleared split" );
+    do_test( count_instances( book, GNC_ID_TRANS ) == 1,
+             "Only the cleared transaction loaded" );
+    qof_query_destroy( query );
+
+    query = qof_query_create_for( GNC_ID_SPLIT );
+    qof_query_set_book( query, book );
+    xaccQueryAddSingleAccountMatch( query, savings, QOF_QUERY_AND );
+    splits = qof_query_run( query );
+    do_test( g_list_length( splits ) == 2, "Query loaded the account's splits" );
+    qof_query_destroy( query );
+    do_test( gnc_numeric_equal( xaccAccountGetBalance( savings ), balance )
+             && gnc_numeric_equal( xaccAccountGetClearedBalance( savings ), cleared ),
+             "Balances unchanged by the query" );
+
+    qof_session_ensure_all_data_loaded( session );
+    do_test( count_instances( book, GNC_ID_TRANS ) > 2,
+             "All transactions loaded" );
+    do_test( gnc_numeric_equal( xaccAccountGetBalance( savings ), balance )
+             && gnc_numeric_equal( xaccAccountGetClearedBalance( savings ), cleared ),
+             "Balances unchanged by loading everything" );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    /* A balance as of a date needs all of the account's splits, so
+     * asking for one loads the account's transactions first. */
+    dates[0] = 86400;
+    dates[1] = time( NULL ) + 86400;
+    for ( i = 0; i < 2; i++ )
+    {
+        session = open_session( url, TRUE );
+        if ( session == NULL )
+        {
+            do_test( FALSE, "DB Session Creation Failed" );
+            return;
+        }
+        book = qof_session_get_book( session );
+        savings = gnc_account_lookup_by_name( gnc_book_get_root_account( book ), "Savings" );
+        if ( savings == NULL )
+        {
+            do_test( FALSE, "Savings account not loaded" );
+            goto cleanup;
+        }
+
+        if ( i == 0 )
+        {
+            balances[0] = xaccAccountGetBalanceAsOfDate( savings, dates[0] );
+            balances[1] = xaccAccountGetBalanceAsOfDate( savings, dates[1] );
+        }
+        else
+            xaccAccountGetBalancesAsOfDates( savings, dates, 2, balances );
+        do_test( count_instances( book, GNC_ID_TRANS ) == 2,
+                 "Balance as of a date loaded the account's transactions" );
+        do_test( gnc_numeric_zero_p( balances[0] )
+                 && gnc_numeric_equal( balances[1], balance ),
+                 "Balances as of dates right before anything was loaded" );
+        do_test( gnc_numeric_equal( xaccAccountGetBalance( savings ), balance ),
+                 "Balance unchanged by loading for a date" );
+
+        if ( i == 0 )
+        {
+            qof_session_end( session );
+            qof_session_destroy( session );
+        }
+    }
+
+cleanup:
+    qof_session_end( session );
+    qof_session_destroy( session );
+}
+
+/* Safe-save a db opened with GNC_SQL_LOAD_TX_AS_NEEDED set before any
+ * transactions have been asked for, and check that none of them are lost. */
+void
+test_dbi_safe_save_as_needed( const gchar* driver, const gchar* url )
+{
+    QofSession* session;
+    gint n_trans;
+
+    printf( "Testing safe save with transactions loaded as needed %s\n", driver );
+
+    if ( load_slots_account( &session, url ) == NULL )
+    {
+        do_test( FALSE, "DB Session load failed" );
+        goto cleanup;
+    }
+    n_trans = count_instances( qof_session_get_book( session ), GNC_ID_TRANS );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    session = open_session( url, TRUE );
+    if ( session == NULL )
+    {
+        do_test( FALSE, "DB Session Creation Failed" );
+        return;
+    }
+    do_test( count_instances( qof_session_get_book( session ), GNC_ID_TRANS ) == 0,
+             "No transactions loaded before the save" );
+    qof_session_safe_save( session, NULL );
+    do_test( qof_session_get_error( session ) == ERR_BACKEND_NO_ERR,
+             "Safe save without error" );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    if ( load_slots_account( &session, url ) == NULL )
+    {
+        do_test( FALSE, "DB Session reload failed" );
+        goto cleanup;
+    }
+    do_test( count_instances( qof_session_get_book( session ), GNC_ID_TRANS ) == n_trans,
+             "All transactions saved" );
+
+cleanup:
+    qof_session_end( session );
+    qof_session_destroy( session );
+}
+
+#define PUSHDOWN_TXS 60
+#define PUSHDOWN_QUERIES 60
+#define PUSHDOWN_BASE_DATE 1262304000 /* 2010-01-01 */
+#define PUSHDOWN_KVP "pushdown-kvp"
+
+static const gchar* pushdown_words[] = { "Grocery", "Rent", "Salary", "Payment" };
+static const gchar* pushdown_memos[] = { "Weekly shop", "lunch", "Memo" };
+
+/* Adds transactions between two new accounts with a variety of text,
+ * dates, amounts, reconcile states and slots for the queries to find. */
+static gboolean
+add_pushdown_transactions( const gchar* url )
+{
+    QofSession* session;
+    QofBook* book;
+    gnc_commodity* currency;
+    Account* accts[2];
+    GncSqlBackend* be;
+    gint i;
+
+    if ( load_slots_account( &session, url ) == NULL ) return FALSE;
+    book = qof_session_get_book( session );
+    currency = xaccAccountGetCommodity(
+                   gnc_account_lookup_by_name( gnc_book_get_root_account( book ), "Bank 1" ) );
+
+    for ( i = 0; i < 2; i++ )
+    {
+        accts[i] = xaccMallocAccount( book );
+        xaccAccountBeginEdit( accts[i] );
+        xaccAccountSetType( accts[i], ACCT_TYPE_BANK );
+        xaccAccountSetName( accts[i], i == 0 ? "Pushdown A" : "Pushdown B" );
+        xaccAccountSetCommodity( accts[i], currency );
+        gnc_account_append_child( gnc_book_get_root_account( book ), accts[i] );
+        xaccAccountCommitEdit( accts[i] );
+    }
+
+    for ( i = 0; i < PUSHDOWN_TXS; i++ )
+    {
+        Transaction* tx = xaccMallocTransaction( book );
+        gnc_numeric value = gnc_numeric_create( ( i * 37 ) % 500 + 1, 100 );
+        Split* split;
+        gchar* str;
+
+        xaccTransBeginEdit( tx );
+        xaccTransSetCurrency( tx, currency );
+        xaccTransSetDatePostedSecs( tx, PUSHDOWN_BASE_DATE + i * 3 * 86400 );
+        str = g_strdup_printf( "Pushdown %d %s", i, pushdown_words[i % 4] );
+        xaccTransSetDescription( tx, str );
+        g_free( str );
+        if ( i % 3 == 0 )
+            kvp_frame_set_gint64( qof_instance_get_slots( QOF_INSTANCE(tx) ),
+                                  PUSHDOWN_KVP, i % 5 );
+
+        split = xaccMallocSplit( book );
+        xaccSplitSetAccount( split, accts[i % 2] );
+        xaccSplitSetParent( split, tx );
+        xaccSplitSetAmount( split, value );
+        xaccSplitSetValue( split, value );
+        xaccSplitSetReconcile( split, "ncy"[i % 3] );
+        xaccSplitSetMemo( split, pushdown_memos[i % 3] );
+        if ( i % 4 == 0 )
+            kvp_frame_set_gint64( qof_instance_get_slots( QOF_INSTANCE(split) ),
+                                  PUSHDOWN_KVP, i % 5 );
+
+        split = xaccMallocSplit( book );
+        xaccSplitSetAccount( split, accts[( i + 1 ) % 2] );
+        xaccSplitSetParent( split, tx );
+        xaccSplitSetAmount( split, gnc_numeric_neg( value ) );
+        xaccSplitSetValue( split, gnc_numeric_neg( value ) );
+        xaccTransCommitEdit( tx );
+    }
+
+    /* Older databases may have transactions without a date posted, which
+       the engine treats as the epoch. */
+    be = (GncSqlBackend*)qof_session_get_backend( session );
+    gnc_sql_execute_nonselect_sql( be,
+                                   "UPDATE transactions SET post_date=NULL WHERE description='Pushdown 0 Grocery'" );
+
+    qof_session_end( session );
+    qof_session_destroy( session );
+    return TRUE;
+}
+
+static void
+add_pushdown_term( QofQuery* q, QofBook* book, GRand* rand )
+{
+    static const gchar* descriptions[] =
+    { "Grocery", "grocery", "^Pushdown 1", "Pay.ent", "Rent$", "[Ss]alary" };
+    static const gchar* memos[] = { "Weekly", "weekly", "^Memo", "lunch|Memo" };
+    static const QofQueryCompare hows[] =
+    { QOF_COMPARE_LT, QOF_COMPARE_LTE, QOF_COMPARE_EQUAL, QOF_COMPARE_GT, QOF_COMPARE_GTE };
+    static const cleared_match_t cleared[] =
+    { CLEARED_NO, CLEARED_CLEARED, CLEARED_NO | CLEARED_RECONCILED };
+    const gchar* str;
+    time_t start, end;
+    gboolean use_start;
+    gint amount;
+    QofNumericMatch sign;
+    QofQueryCompare how;
+    GSList* path;
+    KvpValue* value;
+
+    switch ( g_rand_int_range( rand, 0, 7 ) )
+    {
+    case 0:
+        str = descriptions[g_rand_int_range( rand, 0, G_N_ELEMENTS(descriptions) )];
+        xaccQueryAddDescriptionMatch( q, str, g_rand_boolean( rand ),
+                                      strpbrk( str, "^$.[|" ) != NULL, QOF_QUERY_AND );
+        break;
+
+    case 1:
+        str = memos[g_rand_int_range( rand, 0, G_N_ELEMENTS(memos) )];
+        xaccQueryAddMemoMatch( q, str, g_rand_boolean( rand ),
+                               strpbrk( str, "^|" ) != NULL, QOF_QUERY_AND );
+        break;
+
+    case 2:
+        /* A start at the epoch must find the transaction without a date */
+        start = g_rand_boolean( rand ) ? 0 :
+                PUSHDOWN_BASE_DATE + g_rand_int_range( rand, -5, 3 * PUSHDOWN_TXS ) * 86400;
+        end = start + g_rand_int_range( rand, 0, 60 ) * 86400;
+        use_start = g_rand_boolean( rand );
+        xaccQueryAddDateMatchTT( q, use_start, start,
+                                 !use_start || g_rand_boolean( rand ), end, QOF_QUERY_AND );
+        break;
+
+    case 3:
+        amount = g_rand_int_range( rand, -500, 500 );
+        sign = g_rand_int_range( rand, QOF_NUMERIC_MATCH_DEBIT, QOF_NUMERIC_MATCH_ANY + 1 );
+        how = hows[g_rand_int_range( rand, 0, G_N_ELEMENTS(hows) )];
+        xaccQueryAddValueMatch( q, gnc_numeric_create( amount, 100 ), sign, how,
+                                QOF_QUERY_AND );
+        break;
+
+    case 4:
+        path = g_slist_prepend( NULL, PUSHDOWN_KVP );
+        value = kvp_value_new_gint64( g_rand_int_range( rand, 0, 5 ) );
+        how = hows[g_rand_int_range( rand, 0, G_N_ELEMENTS(hows) )];
+        xaccQueryAddKVPMatch( q, path, value, how,
+                              g_rand_boolean( rand ) ? GNC_ID_TRANS : GNC_ID_SPLIT,
+                              QOF_QUERY_AND );
+        kvp_value_delete( value );
+        g_slist_free( path );
+        break;
+
+    case 5:
+        xaccQueryAddSingleAccountMatch( q,
+                                        gnc_account_lookup_by_name( gnc_book_get_root_account( book ),
+                                                g_rand_boolean( rand ) ? "Pushdown A" : "Pushdown B" ),
+                                        QOF_QUERY_AND );
+        break;
+
+    default:
+        xaccQueryAddClearedMatch( q, cleared[g_rand_int_range( rand, 0, G_N_ELEMENTS(cleared) )],
+                                  QOF_QUERY_AND );
+        break;
+    }
+}
+
+/* Builds the same random split query for any book with the pushdown
+ * transactions: up to three terms, each possibly inverted, joined by AND
+ * or OR, and sometimes a limit on the number of results. */
+static QofQuery*
+make_pushdown_query( QofBook* book, guint32 seed )
+{
+    GRand* rand = g_rand_new_with_seed( seed );
+    QofQuery* query = NULL;
+    gint n_terms = g_rand_int_range( rand, 1, 4 );
+    gint i;
+
+    for ( i = 0; i < n_terms; i++ )
+    {
+        QofQuery* term = qof_query_create_for( GNC_ID_SPLIT );
+
+        add_pushdown_term( term, book, rand );
+        if ( g_rand_int_range( rand, 0, 4 ) == 0 )
+        {
+            QofQuery* inverted = qof_query_invert( term );
+            qof_query_destroy( term );
+            term = inverted;
+        }
+        if ( query == NULL )
+        {
+            query = term;
+        }
+        else
+        {
+            QofQuery* merged = qof_query_merge( query, term, g_rand_boolean( rand ) ?
+                                                QOF_QUERY_AND : QOF_QUERY_OR );
+            qof_query_destroy( query );
+            qof_query_destroy( term );
+            query = merged;
+        }
+    }
+    qof_query_set_book( query, book );
+    if ( g_rand_int_range( rand, 0, 4 ) == 0 )
+    {
+        qof_query_set_max_results( query, g_rand_int_range( rand, 1, 6 ) );
+    }
+    g_rand_free( rand );
+    return query;
+}
+
+/* Runs random split queries against a fully loaded book and against books
+ * which load their transactions as needed, which push the query terms down
+ * into SQL.  The transactions loaded must include every split the engine
+ * finds in the full book, and so the results must be the same. */
+void
+test_dbi_query_pushdown( const gchar* driver, const gchar* url )
+{
+    QofSession* full_session;
+    QofBook* full_book;
+    guint32 seed;
+
+    printf( "Testing query push-down %s\n", driver );
+
+    if ( !add_pushdown_transactions( url ) )
+    {
+        do_test( FALSE, "DB Session load failed" );
+        return;
+    }
+    full_session = open_session( url, FALSE );
+    if ( full_session == NULL )
+    {
+        do_test( FALSE, "DB Session Creation Failed" );
+        return;
+    }
+    full_book = qof_session_get_book( full_session );
+
+    for ( seed = 0; seed < PUSHDOWN_QUERIES; seed++ )
+    {
+        QofQuery* full_query = make_pushdown_query( full_book, seed );
+        GList* expected = qof_query_run( full_query );
+        QofSession* session = open_session( url, TRUE );
+        QofBook* book;
+        QofQuery* query;
+        GList* found;
+        GList* node;
+        gboolean ok;
+
+        if ( session == NULL )
+        {
+            do_test( FALSE, "DB Session Creation Failed" );
+            qof_query_destroy( full_query );
+            break;
+        }
+        book = qof_session_get_book( session );
+        query = make_pushdown_query( book, seed );
+        found = qof_query_run( query );
+
+        ok = g_list_length( found ) == g_list_length( expected );
+        for ( node = expected; ok && node != NULL; node = node->next )
+        {
+            const GncGUID* guid = qof_instance_get_guid( QOF_INSTANCE(node->data) );
+            Split* split = xaccSplitLookup( guid, book );
+
+            ok = split != NULL && g_list_find( found, split ) != NULL;
+        }
+        if ( !ok )
+        {
+            failure_args( "query push-down", __FILE__, __LINE__,
+                          "query %u found %d splits instead of %d", seed,
+                          g_list_length( found ), g_list_length( expected ) );
+        }
+
+        qof_query_destroy( query );
+        qof_query_destroy( full_query );
+        qof_session_end( session );
+        qof_session_destroy( session );
+        if ( !ok ) break;
+    }
+    if ( seed == PUSHDOWN_QUERIES )
+    {
+        success( "pushed down queries load every split they find" );
+    }
+
+    qof_session_end( full_session );
+    qof_session_destroy( full_session );
+}
+
+/* Commit through the background writer with GNC_DBI_WRITE_BEHIND set and
+ * check that everything committed is in the database once the session
+ * has ended. */
+void
+test_dbi_write_behind( const gchar* driver, const gchar* url )
+{
+    QofSession* session;
+    QofBook* book;
+    Account* bank;
+    Account* savings;
+    gint n_trans;
+
+    printf( "Testing write-behind %s\n", driver );
+
+    g_setenv( "GNC_DBI_WRITE_BEHIND", "1", TRUE );
+    bank = load_slots_account( &session, url );
+    g_unsetenv( "GNC_DBI_WRITE_BEHIND" );
+    if ( bank == NULL )
+    {
+        do_test( FALSE, "DB Session load failed" );
+        goto cleanup;
+    }
+    book = qof_session_get_book( session );
+
+    savings = xaccMallocAccount( book );
+    xaccAccountBeginEdit( savings );
+    xaccAccountSetType( savings, ACCT_TYPE_BANK );
+    xaccAccountSetName( savings, "Write-behind savings" );
+    xaccAccountSetCommodity( savings, xaccAccountGetCommodity( bank ) );
+    gnc_account_append_child( gnc_book_get_root_account( book ), savings );
+    xaccAccountCommitEdit( savings );
+
+    add_transfer( book, bank, savings, 10000, CREC );
+    add_transfer( book, bank, savings, 2550, NREC );
+    n_trans = count_instances( book, GNC_ID_TRANS );
+    do_test( qof_session_get_error( session ) == ERR_BACKEND_NO_ERR,
+             "Commits queued without error" );
+    qof_session_end( session );
+    qof_session_destroy( session );
+
+    bank = load_slots_account( &session, url );
+    if ( bank == NULL )
+    {
+        do_test( FALSE, "DB Session reload failed" );
+        goto cleanup;
+    }
+    book = qof_session_get_book( session );
+    do_test( gnc_account_lookup_by_name( gnc_book_get_root_account( book ),
+                                         "Write-behind savings" ) != NULL,
+             "Account written behind" );
+    do_test( count_instances( book, GNC_ID_TRANS ) == n_trans,
+             "Transactions written behind" );
+
+cleanup:
+    qof_session_end( session );
+    qof_session_destroy( session );
+}
+
+/* MySQL indexes are listed as "<index> <table>". */
+static gboolean
+has_index( QofBackend *qbe, const gchar* index_name )
+{
+    GncDbiBackend *be = (GncDbiBackend*)qbe;
+    GSList *index_list = ((GncDbiSqlConnection*)(be->sql_be.conn))->provider->get_index_list( be->conn );
+    GSList *iter;
+    gsize len = strlen( index_name );
+    gboolean found = FALSE;
+
+    for ( iter = index_list; iter != NULL; iter = iter->next )
+    {
+        const gchar* name = iter->data;
+        if ( strncmp( name, index_name, len ) == 0 &&
+                ( name[len] == '\0' || name[len] == ' ' ) )
+            found = TRUE;
+        g_free( iter->data );
+    }
+    g_slist_free( index_list );
+    return found;
+}
+
+/* Makes the transactions, splits and slots tables look as if they were
+ * written before their indexes were replaced by composite ones. */
+static void
+downgrade_indexed_tables( QofBackend *qbe )
+{
+    GncSqlBackend *be = (GncSqlBackend*)qbe;
+
+    gnc_sql_set_table_version( be, "transactions", 3 );
+    gnc_sql_set_table_version( be, "splits", 4 );
+    gnc_sql_set_table_version( be, "slots", 3 );
+    gnc_sql_execute_nonselect_sql( be, "CREATE INDEX tx_post_date_index ON transactions (post_date)" );
+    gnc_sql_execute_nonselect_sql( be, "CREATE INDEX splits_account_guid_index ON splits (account_guid)" );
+    gnc_sql_execute_nonselect_sql( be, "CREATE INDEX slots_guid_index ON slots (obj_guid)" );
+}
+
+static void
+check_upgraded_indexes( QofBackend *qbe )
+{
+    do_test( !has_index( qbe, "tx_post_date_index" ) &&
+             !has_index( qbe, "splits_account_guid_index" ) &&
+             !has_index( qbe, "slots_guid_index" ),
+             "Upgrade dropped the replaced indexes" );
+    do_test( has_index( qbe, "tx_post_date_guid_index" ) &&
+             has_index( qbe, "splits_account_tx_index" ) &&
+             has_index( qbe, "slots_guid_name_index" ),
+             "Upgrade kept the composite indexes" );
+}
+
 /* Test the gnc_dbi_load logic that forces a newer database to be
  * opened read-only and an older one to be safe-saved. Again, it would
  * be better to do this starting from a fresh file, but instead we're
@@ -311,6 +1089,7 @@ test_dbi_version_control( const gchar* driver,  const gchar* url )
     qof_book_begin_edit( book );
     gnc_sql_set_table_version( (GncSqlBackend*)qbe,
                                "Gnucash", GNUCASH_RESAVE_VERSION - 1 );
+    downgrade_indexed_tables( qbe );
     qof_book_commit_edit( book );
     qof_session_end( sess );
     qof_session_destroy( sess );
@@ -320,6 +1099,7 @@ test_dbi_version_control( const gchar* driver,  const gchar* url )
     err = qof_session_pop_error( sess );
     do_test( err == ERR_SQL_DB_TOO_OLD, "DB Failed to flag too old" );
     qbe = qof_session_get_backend( sess );
+    check_upgraded_indexes( qbe );
     book = qof_session_get_book( sess );
     qof_book_begin_edit( book );
     gnc_sql_set_table_version( (GncSqlBackend*)qbe,
@@ -53,6 +53,38 @@ void test_dbi_store_and_reload( const gchar* driver, QofSession* session_1, cons
  */
 void test_dbi_safe_save( const gchar* driver, const gchar* url );
 
+/** Test that editing the slots of an object in an existing db writes
+ * its changes correctly.
+ */
+void test_dbi_update_slots( const gchar* driver, const gchar* url );
+
+/** Test that saving an object doesn't query the db for commodities
+ * known to be in it.
+ */
+void test_dbi_persisted_commodities( const gchar* driver, const gchar* url );
+
+/** Test that transactions are only loaded when they are asked for when
+ * GNC_SQL_LOAD_TX_AS_NEEDED is set, and that balances stay right.
+ */
+void test_dbi_load_as_needed( const gchar* driver, const gchar* url );
+
+/** Test that a safe save of a db opened with GNC_SQL_LOAD_TX_AS_NEEDED
+ * set keeps the transactions that were never loaded.
+ */
+void test_dbi_safe_save_as_needed( const gchar* driver, const gchar* url );
+
+/** Test that split queries pushed down into SQL, when transactions are
+ * loaded as needed, load every split the engine would find.
+ */
+void test_dbi_query_pushdown( const gchar* driver, const gchar* url );
+
+/** Test that commits queued for the background writer when
+ * GNC_DBI_WRITE_BEHIND is set are all in the database after the session
+ * ends.  Only MySQL and PostgreSQL sessions have a writer; the writer
+ * itself is tested against sqlite3 by test-dbi-writer.
+ */
+void test_dbi_write_behind( const gchar* driver, const gchar* url );
+
 /** Test the version control mechanism.
  */
 void test_dbi_version_control( const gchar* driver,  const gchar* url );
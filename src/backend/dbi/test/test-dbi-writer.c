@@ -0,0 +1,199 @@
+/***************************************************************************
+ *            test-dbi-writer.c
+ *
+ *  Tests the write-behind writer thread against a dbi/sqlite3 db, so
+ *  that it is exercised without a database server.
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <dbi/dbi.h>
+#include "qof.h"
+#include "test-stuff.h"
+
+#include "../gnc-dbi-writer.h"
+
+#define N_UNITS 50
+#define UNIT_ROWS 10
+
+static dbi_conn
+open_conn( const gchar* dirname, const gchar* basename )
+{
+    dbi_conn conn = dbi_conn_new( "sqlite3" );
+
+    if ( conn == NULL ) return NULL;
+    if ( dbi_conn_set_option( conn, "dbname", basename ) < 0 ||
+            dbi_conn_set_option( conn, "sqlite3_dbdir", dirname ) < 0 ||
+            dbi_conn_connect( conn ) < 0 )
+    {
+        dbi_conn_close( conn );
+        return NULL;
+    }
+    return conn;
+}
+
+static gboolean
+run_sql( dbi_conn conn, const gchar* sql )
+{
+    dbi_result result = dbi_conn_query( conn, sql );
+
+    if ( result == NULL ) return FALSE;
+    (void)dbi_result_free( result );
+    return TRUE;
+}
+
+/* Counts the rows with ids in [first, last). */
+static gint
+count_rows( dbi_conn conn, gint first, gint last )
+{
+    dbi_result result;
+    gint n;
+
+    result = dbi_conn_queryf( conn, "SELECT id FROM writer_test WHERE id >= %d AND id < %d",
+                              first, last );
+    if ( result == NULL ) return -1;
+    n = (gint)dbi_result_get_numrows( result );
+    (void)dbi_result_free( result );
+    return n;
+}
+
+/* A unit inserting the ids [first, first + n), followed by 'extra' if
+ * it isn't NULL. */
+static GPtrArray*
+make_unit( gint first, gint n, const gchar* extra )
+{
+    GPtrArray* unit = g_ptr_array_new();
+    gint i;
+
+    for ( i = first; i < first + n; i++ )
+    {
+        g_ptr_array_add( unit, g_strdup_printf( "INSERT INTO writer_test VALUES (%d)", i ) );
+    }
+    if ( extra != NULL )
+    {
+        g_ptr_array_add( unit, g_strdup( extra ) );
+    }
+    return unit;
+}
+
+/* Every unit pushed is written, in push order, by the time flush
+ * returns; empty units are dropped. */
+static void
+test_push_and_flush( GncDbiWriter* writer, dbi_conn reader )
+{
+    gint i;
+
+    for ( i = 0; i < N_UNITS; i++ )
+    {
+        gnc_dbi_writer_push( writer, make_unit( i * UNIT_ROWS, UNIT_ROWS, NULL ) );
+    }
+    gnc_dbi_writer_push( writer, g_ptr_array_new() );
+    do_test( gnc_dbi_writer_flush( writer ) == ERR_BACKEND_NO_ERR,
+             "Units flushed without error" );
+    do_test( count_rows( reader, 0, N_UNITS * UNIT_ROWS ) == N_UNITS * UNIT_ROWS,
+             "Every pushed unit written" );
+
+    gnc_dbi_writer_push( writer, make_unit( 0, 0, "DELETE FROM writer_test" ) );
+    gnc_dbi_writer_push( writer, make_unit( 0, 1, NULL ) );
+    (void)gnc_dbi_writer_flush( writer );
+    do_test( count_rows( reader, 0, N_UNITS * UNIT_ROWS ) == 1,
+             "Units written in push order" );
+}
+
+/* A unit that fails is rolled back and reported once, and nothing is
+ * written after it until it has been reported. */
+static void
+test_error( GncDbiWriter* writer, dbi_conn reader )
+{
+    gnc_dbi_writer_push( writer, make_unit( 1000, UNIT_ROWS,
+                                            "INSERT INTO no_such_table VALUES (1)" ) );
+    gnc_dbi_writer_push( writer, make_unit( 2000, UNIT_ROWS, NULL ) );
+    do_test( gnc_dbi_writer_flush( writer ) == ERR_BACKEND_SERVER_ERR,
+             "Failed unit reported by flush" );
+    do_test( count_rows( reader, 1000, 1000 + UNIT_ROWS ) == 0,
+             "Failed unit rolled back" );
+    do_test( count_rows( reader, 2000, 2000 + UNIT_ROWS ) == 0,
+             "Nothing written after an unreported failure" );
+    do_test( gnc_dbi_writer_take_error( writer ) == ERR_BACKEND_NO_ERR,
+             "Failure reported only once" );
+
+    gnc_dbi_writer_push( writer, make_unit( 3000, UNIT_ROWS, NULL ) );
+    do_test( gnc_dbi_writer_flush( writer ) == ERR_BACKEND_NO_ERR,
+             "Units flushed without error after a reported failure" );
+    do_test( count_rows( reader, 3000, 3000 + UNIT_ROWS ) == UNIT_ROWS,
+             "Writing resumes once the failure is reported" );
+}
+
+int main (int argc, char ** argv)
+{
+    gchar* dirname = g_strdup( g_get_tmp_dir() );
+    gchar* basename = g_strdup_printf( "test-dbi-writer-%d", (int)getpid() );
+    gchar* filename = g_build_filename( dirname, basename, NULL );
+    GncDbiWriter* writer = NULL;
+    dbi_conn reader = NULL;
+    dbi_conn conn;
+
+#ifndef HAVE_GLIB_2_32
+    g_thread_init( NULL );
+#endif
+    qof_init();
+    if ( dbi_initialize( g_getenv( "GNC_DBD_DIR" ) ) <= 0 )
+    {
+        failure( "No DBD drivers found" );
+        goto cleanup;
+    }
+
+    reader = open_conn( dirname, basename );
+    if ( reader == NULL || !run_sql( reader, "CREATE TABLE writer_test ( id integer )" ) )
+    {
+        failure( "Unable to create the sqlite3 db" );
+        goto cleanup;
+    }
+    conn = open_conn( dirname, basename );
+    writer = conn != NULL ? gnc_dbi_writer_new( conn ) : NULL;
+    if ( writer == NULL )
+    {
+        if ( conn != NULL ) dbi_conn_close( conn );
+        failure( "Unable to start the writer" );
+        goto cleanup;
+    }
+
+    test_push_and_flush( writer, reader );
+    test_error( writer, reader );
+
+    /* Destroying the writer writes what is still queued. */
+    gnc_dbi_writer_push( writer, make_unit( 4000, UNIT_ROWS, NULL ) );
+    gnc_dbi_writer_destroy( writer );
+    do_test( count_rows( reader, 4000, 4000 + UNIT_ROWS ) == UNIT_ROWS,
+             "Queued units written on destroy" );
+
+cleanup:
+    if ( reader != NULL ) dbi_conn_close( reader );
+    dbi_shutdown();
+    (void)g_unlink( filename );
+    g_free( filename );
+    g_free( basename );
+    g_free( dirname );
+    print_test_results();
+    qof_close();
+    return get_rv();
+}
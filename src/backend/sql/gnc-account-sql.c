@@ -302,7 +302,8 @@ load_all_accounts( GncSqlBackend* be )
                           "start-cleared-balance", &balances->cleared_balance,
                           "start-reconciled-balance", &balances->reconciled_balance,
                           NULL);
-
+            xaccAccountRecomputeBalance( balances->acct );
+            g_free( balances );
         }
         if ( bal_slist != NULL )
         {
@@ -103,6 +103,14 @@ static GncSqlStatement* build_delete_statement( GncSqlBackend* be,
         const gchar* table_name,
         QofIdTypeConst obj_name, gpointer pObject,
         const GncSqlColumnTableEntry* table );
+static gboolean add_bulk_insert_row( GncSqlBackend* be,
+                                     const gchar* table_name,
+                                     QofIdTypeConst obj_name, gpointer pObject,
+                                     const GncSqlColumnTableEntry* table );
+static gboolean flush_bulk_inserts( GncSqlBackend* be );
+static void forget_bulk_inserts( GncSqlBackend* be );
+static void create_deferred_indexes( GncSqlBackend* be );
+static void forget_deferred_indexes( GncSqlBackend* be );
 
 #define TRANSACTION_NAME "trans"
 
@@ -130,6 +138,26 @@ typedef struct
     gnc_sql_query_info* pQueryInfo;
 } sql_backend;
 
+/* An index put off until a full save has written its rows */
+typedef struct
+{
+    gchar* index_name;
+    gchar* table_name;
+    /*@ dependent @*/
+    const GncSqlColumnTableEntry* col_table;
+} deferred_index_t;
+
+/* A multi-row INSERT being built for one table in a full save */
+typedef struct
+{
+    GString* sql;
+    guint rows;
+} bulk_insert_t;
+
+/* Keeps a multi-row INSERT well inside the smallest statement size the
+   servers accept by default (1MB for MySQL's max_allowed_packet). */
+#define MAX_BULK_INSERT_LEN (256 * 1024)
+
 static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define SQLITE_PROVIDER_NAME "SQLite"
@@ -137,7 +165,7 @@ static QofLogModule log_module = G_LOG_DOMAIN;
 /* ================================================================= */
 
 void
-gnc_sql_init( /*@ unused @*/ GncSqlBackend* be )
+gnc_sql_init( /*@ null @*/ GncSqlBackend* be )
 {
     static gboolean initialized = FALSE;
 
@@ -147,6 +175,12 @@ gnc_sql_init( /*@ unused @*/ GncSqlBackend* be )
         gnc_sql_init_object_handlers();
         initialized = TRUE;
     }
+
+    if ( be != NULL )
+    {
+        const gchar* as_needed = g_getenv( "GNC_SQL_LOAD_TX_AS_NEEDED" );
+        be->load_tx_as_needed = as_needed != NULL && g_strcmp0( as_needed, "0" ) != 0;
+    }
 }
 
 /* ================================================================= */
@@ -231,6 +265,7 @@ gnc_sql_load( GncSqlBackend* be, /*@ dependent @*/ QofBook *book, QofBackendLoad
     {
         g_assert( be->primary_book == NULL );
         be->primary_book = book;
+        gnc_sql_transaction_forget_loaded( be );
 
         /* Load any initial stuff. Some of this needs to happen in a certain order */
         for ( i = 0; fixed_load_order[i] != NULL; i++ )
@@ -348,11 +383,13 @@ write_account_tree( GncSqlBackend* be, Account* root )
     is_ok = gnc_sql_save_account( be, QOF_INSTANCE(root) );
     if ( is_ok )
     {
+        be->operations_done++;
         descendants = gnc_account_get_descendants( root );
         for ( node = descendants; node != NULL && is_ok; node = g_list_next(node) )
         {
             is_ok = gnc_sql_save_account( be, QOF_INSTANCE(GNC_ACCOUNT(node->data)) );
             if ( !is_ok ) break;
+            be->operations_done++;
         }
         g_list_free( descendants );
     }
@@ -388,6 +425,7 @@ write_tx( Transaction* tx, gpointer data )
     g_return_val_if_fail( data != NULL, 0 );
 
     s->is_ok = gnc_sql_save_transaction( s->be, QOF_INSTANCE(tx) );
+    s->be->operations_done++;
     update_progress( s->be );
 
     if ( s->is_ok )
@@ -472,10 +510,16 @@ write_cb( const gchar* type, gpointer data_p, gpointer be_p )
     }
 }
 
+/* A full save knows how many accounts and transactions it has to write,
+   so it reports how far it has got; anything else just pulses. */
 static void
 update_progress( GncSqlBackend* be )
 {
-    if ( be->be.percentage != NULL )
+    if ( be->be.percentage == NULL ) return;
+
+    if ( be->obj_total > 0 )
+        (be->be.percentage)( NULL, MIN( 100.0, ( 100.0 * be->operations_done ) / be->obj_total ) );
+    else
         (be->be.percentage)( NULL, 101.0 );
 }
 
@@ -486,6 +530,20 @@ finish_progress( GncSqlBackend* be )
         (be->be.percentage)( NULL, -1.0 );
 }
 
+gboolean
+gnc_sql_load_all_for_sync( GncSqlBackend* be, QofBook *book )
+{
+    g_return_val_if_fail( be != NULL, FALSE );
+    g_return_val_if_fail( book != NULL, FALSE );
+
+    if ( !be->load_tx_as_needed || be->primary_book != book ) return TRUE;
+    if ( gnc_sql_transaction_load_all_tx( be ) ) return TRUE;
+
+    PERR( "Unable to load all transactions before rewriting the db\n" );
+    qof_backend_set_error( &be->be, ERR_BACKEND_SERVER_ERR );
+    return FALSE;
+}
+
 void
 gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book )
 {
@@ -495,6 +553,11 @@ gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book )
     g_return_if_fail( book != NULL );
 
     ENTER( "book=%p, primary=%p", book, be->primary_book );
+    if ( !gnc_sql_load_all_for_sync( be, book ) )
+    {
+        LEAVE( "Failed to load all transactions" );
+        return;
+    }
     update_progress( be );
     (void)reset_version_info( be );
     gnc_sql_set_table_version( be, "Gnucash", gnc_get_long_version() );
@@ -502,14 +565,19 @@ gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book )
 
     /* Create new tables */
     be->is_pristine_db = TRUE;
+    gnc_sql_slots_forget_all( be );
+    gnc_sql_forget_persisted( be );
     qof_object_foreach_backend( GNC_SQL_BACKEND, create_tables_cb, be );
 
     /* Save all contents */
     be->primary_book = book;
     be->obj_total = 0;
     be->obj_total += 1 + gnc_account_n_descendants( gnc_book_get_root_account( book ) );
+    be->obj_total += 1 + gnc_account_n_descendants( gnc_book_get_template_root( book ) );
     be->obj_total += gnc_book_count_transactions( book );
     be->operations_done = 0;
+    be->bulk_statements = 0;
+    be->bulk_rows = 0;
 
     is_ok = gnc_sql_connection_begin_transaction( be->conn );
 
@@ -540,13 +608,25 @@ gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book )
         qof_object_foreach_backend( GNC_SQL_BACKEND, write_cb, be );
     }
     if ( is_ok )
+    {
+        is_ok = flush_bulk_inserts( be );
+        forget_bulk_inserts( be );
+    }
+    if ( is_ok )
     {
         is_ok = gnc_sql_connection_commit_transaction( be->conn );
     }
     if ( is_ok )
     {
+        /* Outside the transaction, because MySQL commits before DDL */
+        create_deferred_indexes( be );
         be->is_pristine_db = FALSE;
 
+        /* The db now holds exactly what is in the book, so there is
+           nothing left to load from it. */
+        gnc_sql_transaction_forget_loaded( be );
+        be->all_tx_loaded = TRUE;
+
         /* Mark the session as clean -- though it shouldn't ever get
 	 * marked dirty with this backend
 	 */
@@ -555,8 +635,14 @@ gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book )
     else
     {
         qof_backend_set_error( (QofBackend*)be, ERR_BACKEND_SERVER_ERR );
+        forget_bulk_inserts( be );
+        forget_deferred_indexes( be );
         is_ok = gnc_sql_connection_rollback_transaction( be->conn );
+        gnc_sql_slots_forget_all( be );
+        gnc_sql_forget_persisted( be );
+        be->is_pristine_db = FALSE;
     }
+    be->obj_total = 0;
     finish_progress( be );
     LEAVE( "book=%p", book );
 }
@@ -685,6 +771,8 @@ gnc_sql_commit_edit( GncSqlBackend *be, QofInstance *inst )
     {
         // Error - roll it back
         (void)gnc_sql_connection_rollback_transaction( be->conn );
+        gnc_sql_slots_forget_all( be );
+        gnc_sql_forget_persisted( be );
 
         // This *should* leave things marked dirty
         LEAVE( "Rolled back - database error" );
@@ -1000,12 +1088,13 @@ gnc_sql_free_query( QofBackend* pBEnd, gpointer pQuery )
     // Try various objects first
     be_data.is_ok = FALSE;
     be_data.be = be;
-    be_data.pCompiledQuery = pQuery;
+    be_data.pCompiledQuery = pQueryInfo->pCompiledQuery;
     be_data.pQueryInfo = pQueryInfo;
 
     qof_object_foreach_backend( GNC_SQL_BACKEND, free_query_cb, &be_data );
     if ( be_data.is_ok )
     {
+        g_free( pQueryInfo );
         LEAVE( "" );
         return;
     }
@@ -1081,6 +1170,30 @@ gnc_sql_run_query( QofBackend* pBEnd, gpointer pQuery )
     LEAVE( "" );
 }
 
+/**
+ * Loads the transactions of an account which haven't been loaded yet
+ * because transactions are only loaded as they are needed.
+ *
+ * @param pBEnd SQL backend
+ * @param inst Instance whose related objects are needed
+ */
+void
+gnc_sql_load_related( QofBackend* pBEnd, QofInstance* inst )
+{
+    GncSqlBackend *be = (GncSqlBackend*)pBEnd;
+
+    g_return_if_fail( pBEnd != NULL );
+    g_return_if_fail( inst != NULL );
+
+    if ( !be->load_tx_as_needed || be->loading || be->in_query ) return;
+    if ( qof_instance_get_book( inst ) != be->primary_book ) return;
+
+    if ( GNC_IS_ACCOUNT(inst) )
+    {
+        gnc_sql_transaction_load_tx_for_account( be, GNC_ACCOUNT(inst) );
+    }
+}
+
 /* ================================================================= */
 /* Order in which business objects need to be loaded */
 static const gchar* business_fixed_load_order[] =
@@ -1961,16 +2074,15 @@ load_timespec( const GncSqlBackend* be, GncSqlRow* row,
             const gchar* s = g_value_get_string( val );
             if ( s != NULL )
             {
-                gchar* buf;
-                buf = g_strdup_printf( "%c%c%c%c-%c%c-%c%c %c%c:%c%c:%c%c",
-                                       s[0], s[1], s[2], s[3],
-                                       s[4], s[5],
-                                       s[6], s[7],
-                                       s[8], s[9],
-                                       s[10], s[11],
-                                       s[12], s[13] );
+                gchar buf[20];
+                (void)g_snprintf( buf, sizeof(buf), "%c%c%c%c-%c%c-%c%c %c%c:%c%c:%c%c",
+                                  s[0], s[1], s[2], s[3],
+                                  s[4], s[5],
+                                  s[6], s[7],
+                                  s[8], s[9],
+                                  s[10], s[11],
+                                  s[12], s[13] );
                 ts = gnc_iso8601_to_timespec_gmt( buf );
-                g_free( buf );
                 isOK = TRUE;
             }
         }
@@ -2216,7 +2328,7 @@ load_numeric( const GncSqlBackend* be, GncSqlRow* row,
               const GncSqlColumnTableEntry* table_row )
 {
     const GValue* val;
-    gchar* buf;
+    gchar buf[64];
     gint64 num, denom;
     gnc_numeric n;
     gboolean isNull = FALSE;
@@ -2227,9 +2339,8 @@ load_numeric( const GncSqlBackend* be, GncSqlRow* row,
     g_return_if_fail( table_row != NULL );
     g_return_if_fail( table_row->gobj_param_name != NULL || setter != NULL );
 
-    buf = g_strdup_printf( "%s_num", table_row->col_name );
+    (void)g_snprintf( buf, sizeof(buf), "%s_num", table_row->col_name );
     val = gnc_sql_row_get_value_at_col_name( row, buf );
-    g_free( buf );
     if ( val == NULL )
     {
         isNull = TRUE;
@@ -2239,9 +2350,8 @@ load_numeric( const GncSqlBackend* be, GncSqlRow* row,
     {
         num = gnc_sql_get_integer_value( val );
     }
-    buf = g_strdup_printf( "%s_denom", table_row->col_name );
+    (void)g_snprintf( buf, sizeof(buf), "%s_denom", table_row->col_name );
     val = gnc_sql_row_get_value_at_col_name( row, buf );
-    g_free( buf );
     if ( val == NULL )
     {
         isNull = TRUE;
@@ -2464,39 +2574,98 @@ gnc_sql_load_tx_guid( const GncSqlBackend* be, GncSqlRow* row )
     return &guid;
 }
 
-void
-gnc_sql_load_object( const GncSqlBackend* be, GncSqlRow* row,
-                     /*@ null @*/ QofIdTypeConst obj_name, gpointer pObject,
-                     const GncSqlColumnTableEntry* table )
+/* The column handlers and setters used to load an object from a table, found
+ * once per table rather than for every row loaded. */
+typedef struct
+{
+    /*@ null @*/ QofIdTypeConst obj_name;
+    GncSqlColumnTypeHandler** handlers;
+    QofSetterFunc* setters;
+} GncSqlLoadPlan;
+
+static /*@ null @*//*@ only @*/ GHashTable* g_loadPlanHash = NULL;
+
+static void
+load_plan_free( GncSqlLoadPlan* plan )
+{
+    g_free( plan->handlers );
+    g_free( plan->setters );
+    g_free( plan );
+}
+
+static const GncSqlLoadPlan*
+get_load_plan( /*@ null @*/ QofIdTypeConst obj_name, const GncSqlColumnTableEntry* table )
 {
-    QofSetterFunc setter;
-    GncSqlColumnTypeHandler* pHandler;
     const GncSqlColumnTableEntry* table_row;
+    GncSqlLoadPlan* plan;
+    gint num_cols = 0;
+    gint i;
 
-    g_return_if_fail( be != NULL );
-    g_return_if_fail( row != NULL );
-    g_return_if_fail( pObject != NULL );
-    g_return_if_fail( table != NULL );
+    if ( g_loadPlanHash == NULL )
+    {
+        g_loadPlanHash = g_hash_table_new_full( g_direct_hash, g_direct_equal,
+                                                NULL, (GDestroyNotify)load_plan_free );
+    }
+    plan = g_hash_table_lookup( g_loadPlanHash, table );
+    if ( plan != NULL && safe_strcmp( plan->obj_name, obj_name ) == 0 )
+    {
+        return plan;
+    }
 
+    /* A table loaded for a different type of object than last time gets a
+       new plan. */
     for ( table_row = table; table_row->col_name != NULL; table_row++ )
+    {
+        num_cols++;
+    }
+    plan = g_new0( GncSqlLoadPlan, 1 );
+    g_assert( plan != NULL );
+    plan->obj_name = obj_name;
+    plan->handlers = g_new0( GncSqlColumnTypeHandler*, num_cols );
+    plan->setters = g_new0( QofSetterFunc, num_cols );
+
+    for ( table_row = table, i = 0; table_row->col_name != NULL; table_row++, i++ )
     {
         if ( (table_row->flags & COL_AUTOINC) != 0 )
         {
-            setter = set_autoinc_id;
+            plan->setters[i] = set_autoinc_id;
         }
         else if ( table_row->qof_param_name != NULL )
         {
             g_assert( obj_name != NULL );
-            setter = qof_class_get_parameter_setter( obj_name,
-                     table_row->qof_param_name );
+            plan->setters[i] = qof_class_get_parameter_setter( obj_name,
+                               table_row->qof_param_name );
         }
         else
         {
-            setter = table_row->setter;
+            plan->setters[i] = table_row->setter;
         }
-        pHandler = get_handler( table_row );
-        g_assert( pHandler != NULL );
-        pHandler->load_fn( be, row, setter, pObject, table_row );
+        plan->handlers[i] = get_handler( table_row );
+        g_assert( plan->handlers[i] != NULL );
+    }
+    g_hash_table_replace( g_loadPlanHash, (gpointer)table, plan );
+
+    return plan;
+}
+
+void
+gnc_sql_load_object( const GncSqlBackend* be, GncSqlRow* row,
+                     /*@ null @*/ QofIdTypeConst obj_name, gpointer pObject,
+                     const GncSqlColumnTableEntry* table )
+{
+    const GncSqlLoadPlan* plan;
+    const GncSqlColumnTableEntry* table_row;
+    gint i;
+
+    g_return_if_fail( be != NULL );
+    g_return_if_fail( row != NULL );
+    g_return_if_fail( pObject != NULL );
+    g_return_if_fail( table != NULL );
+
+    plan = get_load_plan( obj_name, table );
+    for ( table_row = table, i = 0; table_row->col_name != NULL; table_row++, i++ )
+    {
+        plan->handlers[i]->load_fn( be, row, plan->setters[i], pObject, table_row );
     }
 }
 
@@ -2544,6 +2713,10 @@ gnc_sql_execute_select_statement( GncSqlBackend* be, GncSqlStatement* stmt )
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( stmt != NULL, NULL );
 
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return NULL;
+    }
     result = gnc_sql_connection_execute_select_statement( be->conn, stmt );
     if ( result == NULL )
     {
@@ -2581,6 +2754,10 @@ gnc_sql_execute_select_sql( GncSqlBackend* be, const gchar* sql )
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( sql != NULL, NULL );
 
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return NULL;
+    }
     stmt = gnc_sql_create_statement_from_sql( be, sql );
     if ( stmt == NULL )
     {
@@ -2606,6 +2783,10 @@ gnc_sql_execute_nonselect_sql( GncSqlBackend* be, const gchar* sql )
     g_return_val_if_fail( be != NULL, 0 );
     g_return_val_if_fail( sql != NULL, 0 );
 
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return -1;
+    }
     stmt = gnc_sql_create_statement_from_sql( be, sql );
     if ( stmt == NULL )
     {
@@ -2665,6 +2846,105 @@ gnc_sql_append_guid_list_to_sql( GString* sql, GList* list, guint maxCount )
 }
 /* ================================================================= */
 
+/* ================================================================= */
+/* Persisted objects
+ *
+ * For each table whose contents are known in full, the backend keeps the
+ * set of guids of the objects in it.  The sets let existence checks be
+ * answered without a round trip to the db.  They only describe tables
+ * keyed by the object guid, and are kept current by
+ * gnc_sql_do_db_operation().
+ */
+
+static /*@ null @*/ GHashTable*
+get_persisted_set( const GncSqlBackend* be, const gchar* table_name )
+{
+    if ( be->persisted == NULL ) return NULL;
+    return g_hash_table_lookup( be->persisted, table_name );
+}
+
+void
+gnc_sql_track_persisted( GncSqlBackend* be, const gchar* table_name )
+{
+    g_return_if_fail( be != NULL );
+    g_return_if_fail( table_name != NULL );
+
+    if ( be->persisted == NULL )
+    {
+        be->persisted = g_hash_table_new_full( g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)g_hash_table_destroy );
+    }
+    g_hash_table_replace( be->persisted, g_strdup( table_name ),
+                          g_hash_table_new_full( guid_hash_to_guint,
+                                  guid_g_hash_table_equal,
+                                  (GDestroyNotify)guid_free, NULL ) );
+}
+
+void
+gnc_sql_mark_persisted( GncSqlBackend* be, const gchar* table_name,
+                        const GncGUID* guid )
+{
+    GHashTable* set;
+
+    g_return_if_fail( be != NULL );
+    g_return_if_fail( table_name != NULL );
+    g_return_if_fail( guid != NULL );
+
+    set = get_persisted_set( be, table_name );
+    if ( set != NULL && g_hash_table_lookup( set, guid ) == NULL )
+    {
+        GncGUID* key = guid_copy( guid );
+        g_hash_table_insert( set, key, key );
+    }
+}
+
+void
+gnc_sql_forget_persisted( GncSqlBackend* be )
+{
+    g_return_if_fail( be != NULL );
+
+    if ( be->persisted != NULL )
+    {
+        g_hash_table_destroy( be->persisted );
+        be->persisted = NULL;
+    }
+}
+
+guint
+gnc_sql_get_avoided_query_count( const GncSqlBackend* be )
+{
+    g_return_val_if_fail( be != NULL, 0 );
+
+    return be->avoided_queries;
+}
+
+/* Brings the set of a tracked table up to date after a successful write.
+   Writes through other column tables, such as deleting the splits of a
+   transaction by the transaction guid, are not about the object itself. */
+static void
+update_persisted( GncSqlBackend* be, E_DB_OPERATION op, const gchar* table_name,
+                  gpointer pObject, const GncSqlColumnTableEntry* table )
+{
+    GHashTable* set = get_persisted_set( be, table_name );
+
+    if ( set == NULL || !QOF_IS_INSTANCE(pObject)
+            || ( table[0].flags & COL_PKEY ) == 0
+            || g_ascii_strcasecmp( table[0].col_type, CT_GUID ) != 0 )
+    {
+        return;
+    }
+
+    if ( op == OP_DB_INSERT )
+    {
+        gnc_sql_mark_persisted( be, table_name,
+                                qof_instance_get_guid( QOF_INSTANCE(pObject) ) );
+    }
+    else if ( op == OP_DB_DELETE )
+    {
+        (void)g_hash_table_remove( set, qof_instance_get_guid( QOF_INSTANCE(pObject) ) );
+    }
+}
+
 gboolean
 gnc_sql_object_is_it_in_db( GncSqlBackend* be, const gchar* table_name,
                             QofIdTypeConst obj_name, gpointer pObject,
@@ -2674,6 +2954,7 @@ gnc_sql_object_is_it_in_db( GncSqlBackend* be, const gchar* table_name,
     guint count;
     GncSqlColumnTypeHandler* pHandler;
     GSList* list = NULL;
+    GHashTable* set;
 
     g_return_val_if_fail( be != NULL, FALSE );
     g_return_val_if_fail( table_name != NULL, FALSE );
@@ -2681,6 +2962,14 @@ gnc_sql_object_is_it_in_db( GncSqlBackend* be, const gchar* table_name,
     g_return_val_if_fail( pObject != NULL, FALSE );
     g_return_val_if_fail( table != NULL, FALSE );
 
+    set = get_persisted_set( be, table_name );
+    if ( set != NULL && QOF_IS_INSTANCE(pObject) )
+    {
+        be->avoided_queries++;
+        return g_hash_table_lookup( set,
+                                    qof_instance_get_guid( QOF_INSTANCE(pObject) ) ) != NULL;
+    }
+
     /* SELECT * FROM */
     sqlStmt = create_single_col_select_statement( be, table_name, table );
     g_assert( sqlStmt != NULL );
@@ -2720,6 +3009,20 @@ gnc_sql_do_db_operation( GncSqlBackend* be,
     g_return_val_if_fail( pObject != NULL, FALSE );
     g_return_val_if_fail( table != NULL, FALSE );
 
+    if ( op == OP_DB_INSERT && be->is_pristine_db && be->max_insert_rows > 1 )
+    {
+        ok = add_bulk_insert_row( be, table_name, obj_name, pObject, table );
+        if ( ok )
+        {
+            update_persisted( be, op, table_name, pObject, table );
+        }
+        return ok;
+    }
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return FALSE;
+    }
+
     if ( op == OP_DB_INSERT )
     {
         stmt = build_insert_statement( be, table_name, obj_name, pObject, table );
@@ -2749,6 +3052,7 @@ gnc_sql_do_db_operation( GncSqlBackend* be,
         else
         {
             ok = TRUE;
+            update_persisted( be, op, table_name, pObject, table );
         }
         gnc_sql_statement_dispose( stmt );
     }
@@ -2864,32 +3168,18 @@ free_gvalue_list( GSList* list )
     g_slist_free( list );
 }
 
-/*@ null @*/ static GncSqlStatement*
-build_insert_statement( GncSqlBackend* be,
-                        const gchar* table_name,
-                        QofIdTypeConst obj_name, gpointer pObject,
-                        const GncSqlColumnTableEntry* table )
+/* Appends "INSERT INTO table(col,...) VALUES" */
+static void
+append_insert_head( GString* sql, const gchar* table_name,
+                    const GncSqlColumnTableEntry* table )
 {
-    GncSqlStatement* stmt;
-    GString* sql;
-    GSList* values;
-    GSList* node;
-    gchar* sqlbuf;
     GList* colnames = NULL;
     GList* colname;
     const GncSqlColumnTableEntry* table_row;
 
-    g_return_val_if_fail( be != NULL, NULL );
-    g_return_val_if_fail( table_name != NULL, NULL );
-    g_return_val_if_fail( obj_name != NULL, NULL );
-    g_return_val_if_fail( pObject != NULL, NULL );
-    g_return_val_if_fail( table != NULL, NULL );
+    g_string_append_printf( sql, "INSERT INTO %s(", table_name );
 
-    sqlbuf = g_strdup_printf( "INSERT INTO %s(", table_name );
-    sql = g_string_new( sqlbuf );
-    g_free( sqlbuf );
-
-    // Get all col names and all values
+    // Get all col names
     for ( table_row = table; table_row->col_name != NULL; table_row++ )
     {
         if (( table_row->flags & COL_AUTOINC ) == 0 )
@@ -2915,7 +3205,19 @@ build_insert_statement( GncSqlBackend* be,
     }
     g_list_free( colnames );
 
-    g_string_append( sql, ") VALUES(" );
+    g_string_append( sql, ") VALUES" );
+}
+
+/* Appends "(value,...)" for one object */
+static void
+append_insert_row( GncSqlBackend* be, GString* sql,
+                   QofIdTypeConst obj_name, gpointer pObject,
+                   const GncSqlColumnTableEntry* table )
+{
+    GSList* values;
+    GSList* node;
+
+    (void)g_string_append( sql, "(" );
     values = create_gslist_from_values( be, obj_name, pObject, table );
     for ( node = values; node != NULL; node = node->next )
     {
@@ -2932,6 +3234,26 @@ build_insert_statement( GncSqlBackend* be,
     }
     free_gvalue_list( values );
     (void)g_string_append( sql, ")" );
+}
+
+/*@ null @*/ static GncSqlStatement*
+build_insert_statement( GncSqlBackend* be,
+                        const gchar* table_name,
+                        QofIdTypeConst obj_name, gpointer pObject,
+                        const GncSqlColumnTableEntry* table )
+{
+    GncSqlStatement* stmt;
+    GString* sql;
+
+    g_return_val_if_fail( be != NULL, NULL );
+    g_return_val_if_fail( table_name != NULL, NULL );
+    g_return_val_if_fail( obj_name != NULL, NULL );
+    g_return_val_if_fail( pObject != NULL, NULL );
+    g_return_val_if_fail( table != NULL, NULL );
+
+    sql = g_string_new( NULL );
+    append_insert_head( sql, table_name, table );
+    append_insert_row( be, sql, obj_name, pObject, table );
 
     stmt = gnc_sql_connection_create_statement_from_sql( be->conn, sql->str );
     (void)g_string_free( sql, TRUE );
@@ -2939,6 +3261,170 @@ build_insert_statement( GncSqlBackend* be,
     return stmt;
 }
 
+static void
+free_bulk_insert( gpointer data )
+{
+    bulk_insert_t* insert = data;
+
+    (void)g_string_free( insert->sql, TRUE );
+    g_free( insert );
+}
+
+/* Sends a multi-row INSERT, if it has any rows, and empties it. */
+static gboolean
+send_bulk_insert( GncSqlBackend* be, bulk_insert_t* insert )
+{
+    GncSqlStatement* stmt;
+    gint result;
+
+    if ( insert->rows == 0 )
+    {
+        return TRUE;
+    }
+
+    stmt = gnc_sql_connection_create_statement_from_sql( be->conn,
+            insert->sql->str );
+    be->bulk_statements++;
+    be->bulk_rows += insert->rows;
+    (void)g_string_truncate( insert->sql, 0 );
+    insert->rows = 0;
+    if ( stmt == NULL )
+    {
+        qof_backend_set_error( &be->be, ERR_BACKEND_SERVER_ERR );
+        return FALSE;
+    }
+
+    result = gnc_sql_connection_execute_nonselect_statement( be->conn, stmt );
+    if ( result == -1 )
+    {
+        PERR( "SQL error: %s\n", gnc_sql_statement_to_sql( stmt ) );
+        qof_backend_set_error( &be->be, ERR_BACKEND_SERVER_ERR );
+    }
+    gnc_sql_statement_dispose( stmt );
+
+    return result != -1;
+}
+
+/* Adds a row to the multi-row INSERT being built for its table, first
+   sending that INSERT if it is full.  Each table has its own INSERT, as
+   saving an object writes rows to several tables in turn. */
+static gboolean
+add_bulk_insert_row( GncSqlBackend* be, const gchar* table_name,
+                     QofIdTypeConst obj_name, gpointer pObject,
+                     const GncSqlColumnTableEntry* table )
+{
+    bulk_insert_t* insert;
+
+    if ( be->bulk_inserts == NULL )
+    {
+        be->bulk_inserts = g_hash_table_new_full( g_str_hash, g_str_equal,
+                           g_free, free_bulk_insert );
+    }
+    insert = g_hash_table_lookup( be->bulk_inserts, table_name );
+    if ( insert == NULL )
+    {
+        insert = g_new0( bulk_insert_t, 1 );
+        insert->sql = g_string_sized_new( MAX_BULK_INSERT_LEN / 4 );
+        g_hash_table_insert( be->bulk_inserts, g_strdup( table_name ), insert );
+    }
+    else if ( insert->rows >= be->max_insert_rows
+              || insert->sql->len >= MAX_BULK_INSERT_LEN )
+    {
+        if ( !send_bulk_insert( be, insert ) )
+        {
+            return FALSE;
+        }
+    }
+
+    if ( insert->rows == 0 )
+    {
+        append_insert_head( insert->sql, table_name, table );
+    }
+    else
+    {
+        (void)g_string_append( insert->sql, "," );
+    }
+    append_insert_row( be, insert->sql, obj_name, pObject, table );
+    insert->rows++;
+
+    return TRUE;
+}
+
+/* Sends the multi-row INSERTs being built for every table.  This must
+   be done before any other statement, so that it sees their rows. */
+static gboolean
+flush_bulk_inserts( GncSqlBackend* be )
+{
+    GHashTableIter iter;
+    gpointer insert;
+
+    if ( be->bulk_inserts == NULL )
+    {
+        return TRUE;
+    }
+
+    g_hash_table_iter_init( &iter, be->bulk_inserts );
+    while ( g_hash_table_iter_next( &iter, NULL, &insert ) )
+    {
+        if ( !send_bulk_insert( be, (bulk_insert_t*)insert ) )
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Drops the multi-row INSERTs being built, sent or not. */
+static void
+forget_bulk_inserts( GncSqlBackend* be )
+{
+    if ( be->bulk_inserts != NULL )
+    {
+        g_hash_table_destroy( be->bulk_inserts );
+        be->bulk_inserts = NULL;
+    }
+}
+
+static void
+free_deferred_index( gpointer data, gpointer user_data )
+{
+    deferred_index_t* index = data;
+
+    g_free( index->index_name );
+    g_free( index->table_name );
+    g_free( index );
+}
+
+static void
+forget_deferred_indexes( GncSqlBackend* be )
+{
+    g_slist_foreach( be->deferred_indexes, free_deferred_index, NULL );
+    g_slist_free( be->deferred_indexes );
+    be->deferred_indexes = NULL;
+}
+
+/* As when they are created with their tables, an index which can't be
+   created is logged but doesn't fail the save. */
+static void
+create_deferred_indexes( GncSqlBackend* be )
+{
+    GSList* node;
+
+    for ( node = be->deferred_indexes; node != NULL; node = node->next )
+    {
+        deferred_index_t* index = node->data;
+
+        if ( !gnc_sql_connection_create_index( be->conn, index->index_name,
+                                               index->table_name,
+                                               index->col_table ) )
+        {
+            PERR( "Unable to create index %s\n", index->index_name );
+        }
+        update_progress( be );
+    }
+    forget_deferred_indexes( be );
+}
+
 /*@ null @*/ static GncSqlStatement*
 build_update_statement( GncSqlBackend* be,
                         const gchar* table_name,
@@ -3129,6 +3615,10 @@ gnc_sql_create_table( GncSqlBackend* be, const gchar* table_name,
 
     DEBUG( "Creating %s table\n", table_name );
 
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return FALSE;
+    }
     ok = do_create_table( be, table_name, col_table );
     if ( ok )
     {
@@ -3149,7 +3639,7 @@ gnc_sql_create_temp_table( const GncSqlBackend* be, const gchar* table_name,
 }
 
 gboolean
-gnc_sql_create_index( const GncSqlBackend* be, const gchar* index_name,
+gnc_sql_create_index( GncSqlBackend* be, const gchar* index_name,
                       const gchar* table_name,
                       const GncSqlColumnTableEntry* col_table )
 {
@@ -3160,11 +3650,43 @@ gnc_sql_create_index( const GncSqlBackend* be, const gchar* index_name,
     g_return_val_if_fail( table_name != NULL, FALSE );
     g_return_val_if_fail( col_table != NULL, FALSE );
 
+    /* Indexes slow down the inserts of a full save more than building
+       them afterwards costs. */
+    if ( be->is_pristine_db && be->max_insert_rows > 1 )
+    {
+        deferred_index_t* index = g_new0( deferred_index_t, 1 );
+
+        index->index_name = g_strdup( index_name );
+        index->table_name = g_strdup( table_name );
+        index->col_table = col_table;
+        be->deferred_indexes = g_slist_append( be->deferred_indexes, index );
+        return TRUE;
+    }
+
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return FALSE;
+    }
     ok = gnc_sql_connection_create_index( be->conn, index_name, table_name,
                                           col_table );
     return ok;
 }
 
+gboolean
+gnc_sql_drop_index( GncSqlBackend* be, const gchar* index_name,
+                    const gchar* table_name )
+{
+    g_return_val_if_fail( be != NULL, FALSE );
+    g_return_val_if_fail( index_name != NULL, FALSE );
+    g_return_val_if_fail( table_name != NULL, FALSE );
+
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return FALSE;
+    }
+    return gnc_sql_connection_drop_index( be->conn, index_name, table_name );
+}
+
 gint
 gnc_sql_get_table_version( const GncSqlBackend* be, const gchar* table_name )
 {
@@ -3232,6 +3754,10 @@ gboolean gnc_sql_add_columns_to_table( GncSqlBackend* be, const gchar* table_nam
         pHandler->add_col_info_to_list_fn( be, new_col_table, &col_info_list );
     }
     g_assert( col_info_list != NULL );
+    if ( !flush_bulk_inserts( be ) )
+    {
+        return FALSE;
+    }
     ok = gnc_sql_connection_add_columns_to_table( be->conn, table_name, col_info_list );
     return ok;
 }
@@ -63,12 +63,28 @@ struct GncSqlBackend
     gint operations_done;			/**< Number of operations (save/load) done */
     GHashTable* versions;			/**< Version number for each table */
     const gchar* timespec_format;	/**< Format string for SQL for timespec values */
+    GHashTable* slot_snapshots;	/**< Slots of each object as last loaded or saved */
+    GHashTable* persisted;		/**< Guids in the db, for each table known in full */
+    guint avoided_queries;		/**< Queries answered from the persisted guids */
+    gboolean load_tx_as_needed;	/**< Only load transactions when they are asked for */
+    gboolean all_tx_loaded;		/**< Every transaction in the db has been loaded */
+    GHashTable* tx_loaded_accounts;	/**< Accounts whose transactions have all been loaded */
+    guint max_insert_rows;		/**< Most rows one INSERT may carry in a full save; 0 or 1 for one each */
+    GHashTable* bulk_inserts;		/**< Multi-row INSERT being built for each table in a full save */
+    guint bulk_statements;		/**< Multi-row INSERTs sent by the last full save */
+    guint bulk_rows;				/**< Rows sent in them */
+    GSList* deferred_indexes;		/**< Indexes to create once a full save has written its rows */
 };
 typedef struct GncSqlBackend GncSqlBackend;
 
 /**
  * Initialize the SQL backend.
  *
+ * Transactions are normally all loaded when the book is opened.  If the
+ * GNC_SQL_LOAD_TX_AS_NEEDED environment variable is set to anything but
+ * "0", only account balances are read at open and transactions are loaded
+ * when a query, or qof_session_ensure_all_data_loaded(), asks for them.
+ *
  * @param be SQL backend
  */
 void gnc_sql_init( GncSqlBackend* be );
@@ -84,11 +100,27 @@ void gnc_sql_load( GncSqlBackend* be, /*@ dependent @*/ QofBook *book, QofBacken
 /**
  * Save the contents of a book to an SQL database.
  *
+ * If max_insert_rows is more than 1, the rows of each table are written
+ * with INSERTs of up to that many rows each, and the indexes are created
+ * after the rows are committed.
+ *
  * @param be SQL backend
  * @param book Book to be saved
  */
 void gnc_sql_sync_all( GncSqlBackend* be, /*@ dependent @*/ QofBook *book );
 
+/**
+ * Make sure that book holds everything in the database before the
+ * database is rewritten from it.  If book was loaded from this backend
+ * and transactions are only loaded as they are needed, the remaining
+ * transactions are loaded now.  Sets the backend error if they can't be.
+ *
+ * @param be SQL backend
+ * @param book Book to be saved
+ * @return TRUE if the database can be rewritten from book
+ */
+gboolean gnc_sql_load_all_for_sync( GncSqlBackend* be, QofBook *book );
+
 /**
  * An object is about to be edited.
  *
@@ -158,6 +190,7 @@ struct GncSqlConnection
     gboolean (*commitTransaction)( GncSqlConnection* ); /**< Returns TRUE if successful, FALSE if error */
     gboolean (*createTable)( GncSqlConnection*, const gchar*, GList* ); /**< Returns TRUE if successful, FALSE if error */
     gboolean (*createIndex)( GncSqlConnection*, const gchar*, const gchar*, const GncSqlColumnTableEntry* ); /**< Returns TRUE if successful, FALSE if error */
+    gboolean (*dropIndex)( GncSqlConnection*, const gchar*, const gchar* ); /**< Returns TRUE if the index is gone, FALSE if error */
     gboolean (*addColumnsToTable)( GncSqlConnection*, const gchar* table, GList* ); /**< Returns TRUE if successful, FALSE if error */
     gchar* (*quoteString)( const GncSqlConnection*, gchar* );
 };
@@ -180,6 +213,8 @@ struct GncSqlConnection
 		(CONN)->createTable(CONN,NAME,COLLIST)
 #define gnc_sql_connection_create_index(CONN,INDEXNAME,TABLENAME,COLTABLE) \
 		(CONN)->createIndex(CONN,INDEXNAME,TABLENAME,COLTABLE)
+#define gnc_sql_connection_drop_index(CONN,INDEXNAME,TABLENAME) \
+		(CONN)->dropIndex(CONN,INDEXNAME,TABLENAME)
 #define gnc_sql_connection_add_columns_to_table(CONN,TABLENAME,COLLIST) \
 		(CONN)->addColumnsToTable(CONN,TABLENAME,COLLIST)
 #define gnc_sql_connection_quote_string(CONN,STR) \
@@ -513,6 +548,46 @@ gboolean gnc_sql_object_is_it_in_db( GncSqlBackend* be,
                                      QofIdTypeConst obj_name, const gpointer pObject,
                                      const GncSqlColumnTableEntry* table );
 
+/**
+ * Starts keeping track of the objects in a table, so that
+ * gnc_sql_object_is_it_in_db() can answer without querying the db.  Must
+ * only be called when the table is known in full, i.e. it has just been
+ * created or is about to be loaded completely.  Objects loaded from the
+ * table must be added with gnc_sql_mark_persisted(); objects written
+ * through gnc_sql_do_db_operation() are tracked automatically.
+ *
+ * @param be SQL backend struct
+ * @param table_name DB table name
+ */
+void gnc_sql_track_persisted( GncSqlBackend* be, const gchar* table_name );
+
+/**
+ * Records that an object is in a table which is being tracked.
+ *
+ * @param be SQL backend struct
+ * @param table_name DB table name
+ * @param guid Object guid
+ */
+void gnc_sql_mark_persisted( GncSqlBackend* be, const gchar* table_name,
+                             const GncGUID* guid );
+
+/**
+ * Stops tracking all tables.  Must be called whenever the db may no longer
+ * hold what was written to it, e.g. after a rollback.
+ *
+ * @param be SQL backend struct
+ */
+void gnc_sql_forget_persisted( GncSqlBackend* be );
+
+/**
+ * Returns the number of queries gnc_sql_object_is_it_in_db() has avoided
+ * by answering from the tracked tables.
+ *
+ * @param be SQL backend struct
+ * @return Number of avoided queries
+ */
+guint gnc_sql_get_avoided_query_count( const GncSqlBackend* be );
+
 /**
  * Returns the version number for a DB table.
  *
@@ -554,7 +629,8 @@ gboolean gnc_sql_create_temp_table( const GncSqlBackend* be,
                                     const GncSqlColumnTableEntry* col_table );
 
 /**
- * Creates an index in the database
+ * Creates an index in the database.  In a full save with multi-row
+ * INSERTs, the index is only created once the rows have been written.
  *
  * @param be SQL backend struct
  * @param index_name Index name
@@ -562,9 +638,21 @@ gboolean gnc_sql_create_temp_table( const GncSqlBackend* be,
  * @param col_table Columns that the index should index
  * @return TRUE if successful, FALSE if unsuccessful
  */
-gboolean gnc_sql_create_index( const GncSqlBackend* be, const gchar* index_name,
+gboolean gnc_sql_create_index( GncSqlBackend* be, const gchar* index_name,
                                const gchar* table_name, const GncSqlColumnTableEntry* col_table );
 
+/**
+ * Drops an index from the database, if it exists.  Used by table upgrades
+ * whose new index replaces an old one.
+ *
+ * @param be SQL backend struct
+ * @param index_name Index name
+ * @param table_name Table the index is on
+ * @return TRUE if the index is not (or no longer) there, FALSE if an error occurred
+ */
+gboolean gnc_sql_drop_index( GncSqlBackend* be, const gchar* index_name,
+                             const gchar* table_name );
+
 /**
  * Loads the object guid from a database row.  The table must have a column
  * named "guid" with type CT_GUID.
@@ -745,6 +833,7 @@ void _retrieve_guid_( gpointer pObject, /*@ null @*/ gpointer pValue );
 gpointer gnc_sql_compile_query( QofBackend* pBEnd, QofQuery* pQuery );
 void gnc_sql_free_query( QofBackend* pBEnd, gpointer pQuery );
 void gnc_sql_run_query( QofBackend* pBEnd, gpointer pQuery );
+void gnc_sql_load_related( QofBackend* pBEnd, QofInstance* inst );
 
 typedef struct
 {
@@ -144,6 +144,8 @@ load_all_commodities( GncSqlBackend* be )
         GncSqlRow* row = gnc_sql_result_get_first_row( result );
         gchar* sql;
 
+        // The whole table is loaded, so later checks can be answered locally
+        gnc_sql_track_persisted( be, COMMODITIES_TABLE );
         while ( row != NULL )
         {
             pCommodity = load_single_commodity( be, row );
@@ -155,6 +157,7 @@ load_all_commodities( GncSqlBackend* be )
                 guid = *qof_instance_get_guid( QOF_INSTANCE(pCommodity) );
                 pCommodity = gnc_commodity_table_insert( pTable, pCommodity );
                 qof_instance_set_guid( QOF_INSTANCE(pCommodity), &guid );
+                gnc_sql_mark_persisted( be, COMMODITIES_TABLE, &guid );
             }
             row = gnc_sql_result_get_next_row( result );
         }
@@ -177,7 +180,10 @@ create_commodities_tables( GncSqlBackend* be )
     version = gnc_sql_get_table_version( be, COMMODITIES_TABLE );
     if ( version == 0 )
     {
-        (void)gnc_sql_create_table( be, COMMODITIES_TABLE, TABLE_VERSION, col_table );
+        if ( gnc_sql_create_table( be, COMMODITIES_TABLE, TABLE_VERSION, col_table ) )
+        {
+            gnc_sql_track_persisted( be, COMMODITIES_TABLE );
+        }
     }
 }
 
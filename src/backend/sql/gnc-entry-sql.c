@@ -53,7 +53,7 @@
 static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define TABLE_NAME "entries"
-#define TABLE_VERSION 3
+#define TABLE_VERSION 4
 #define MAX_DESCRIPTION_LEN 2048
 #define MAX_ACTION_LEN 2048
 #define MAX_NOTES_LEN 2048
@@ -115,6 +115,18 @@ static GncSqlColumnTableEntry col_table[] =
     { NULL }
 };
 
+static GncSqlColumnTableEntry invoice_col_table[] =
+{
+    { "invoice",       CT_INVOICEREF,  0,                   0,                 NULL },
+    { NULL }
+};
+
+static GncSqlColumnTableEntry bill_col_table[] =
+{
+    { "bill",          CT_INVOICEREF,  0,                   0,                 NULL },
+    { NULL }
+};
+
 static void
 entry_set_invoice( gpointer pObject, gpointer val )
 {
@@ -210,6 +222,16 @@ load_all_entries( GncSqlBackend* be )
 }
 
 /* ================================================================= */
+static void
+create_entry_indexes( GncSqlBackend* be )
+{
+    if ( !gnc_sql_create_index( be, "entries_invoice_index", TABLE_NAME, invoice_col_table )
+            || !gnc_sql_create_index( be, "entries_bill_index", TABLE_NAME, bill_col_table ) )
+    {
+        PERR( "Unable to create index\n" );
+    }
+}
+
 static void
 create_entry_tables( GncSqlBackend* be )
 {
@@ -221,14 +243,20 @@ create_entry_tables( GncSqlBackend* be )
     if ( version == 0 )
     {
         gnc_sql_create_table( be, TABLE_NAME, TABLE_VERSION, col_table );
+        create_entry_indexes( be );
     }
     else if ( version < TABLE_VERSION )
     {
         /* Upgrade:
             1->2: 64 bit int handling
         	2->3: "entered" -> "date_entered", and it can be NULL
+            3->4: indexes on invoice and bill
         */
-        gnc_sql_upgrade_table( be, TABLE_NAME, col_table );
+        if ( version < 3 )
+        {
+            gnc_sql_upgrade_table( be, TABLE_NAME, col_table );
+        }
+        create_entry_indexes( be );
         gnc_sql_set_table_version( be, TABLE_NAME, TABLE_VERSION );
 
         PINFO("Entries table upgraded from version %d to version %d\n", version, TABLE_VERSION);
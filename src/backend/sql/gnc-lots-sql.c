@@ -46,7 +46,7 @@
 /*@ unused @*/ static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define TABLE_NAME "lots"
-#define TABLE_VERSION 2
+#define TABLE_VERSION 3
 
 static /*@ dependent @*//*@ null @*/ gpointer get_lot_account( gpointer pObject );
 static void set_lot_account( gpointer pObject, /*@ null @*/ gpointer pValue );
@@ -64,6 +64,14 @@ static const GncSqlColumnTableEntry col_table[] =
     /*@ +full_init_block @*/
 };
 
+static const GncSqlColumnTableEntry account_col_table[] =
+{
+    /*@ -full_init_block @*/
+    { "account_guid", CT_ACCOUNTREF, 0, 0, NULL },
+    { NULL }
+    /*@ +full_init_block @*/
+};
+
 /* ================================================================= */
 static /*@ dependent @*//*@ null @*/ gpointer
 get_lot_account( gpointer pObject )
@@ -151,6 +159,7 @@ static void
 create_lots_tables( GncSqlBackend* be )
 {
     gint version;
+    gboolean ok;
 
     g_return_if_fail( be != NULL );
 
@@ -159,19 +168,33 @@ create_lots_tables( GncSqlBackend* be )
     {
         /* The table doesn't exist, so create it */
         (void)gnc_sql_create_table( be, TABLE_NAME, TABLE_VERSION, col_table );
+        ok = gnc_sql_create_index( be, "lots_account_index", TABLE_NAME, account_col_table );
+        if ( !ok )
+        {
+            PERR( "Unable to create index\n" );
+        }
     }
-    else if ( version == 1 )
+    else if ( version < TABLE_VERSION )
     {
-        /* Version 1 -> 2 removes the 'NOT NULL' constraint on the account_guid
-        field.
+        if ( version == 1 )
+        {
+            /* Version 1 -> 2 removes the 'NOT NULL' constraint on the account_guid
+            field.
 
-        Create a temporary table, copy the data from the old table, delete the
-        old table, then rename the new one. */
+            Create a temporary table, copy the data from the old table, delete the
+            old table, then rename the new one. */
 
-        gnc_sql_upgrade_table( be, TABLE_NAME, col_table );
+            gnc_sql_upgrade_table( be, TABLE_NAME, col_table );
+        }
+        /* Version 2 -> 3 adds the account index */
+        ok = gnc_sql_create_index( be, "lots_account_index", TABLE_NAME, account_col_table );
+        if ( !ok )
+        {
+            PERR( "Unable to create index\n" );
+        }
         (void)gnc_sql_set_table_version( be, TABLE_NAME, TABLE_VERSION );
 
-        PINFO("Lots table upgraded from version 1 to version %d\n", TABLE_VERSION);
+        PINFO("Lots table upgraded from version %d to version %d\n", version, TABLE_VERSION);
     }
 }
 
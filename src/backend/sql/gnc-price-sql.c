@@ -46,7 +46,7 @@
 /*@ unused @*/ static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define TABLE_NAME "prices"
-#define TABLE_VERSION 2
+#define TABLE_VERSION 3
 
 #define PRICE_MAX_SOURCE_LEN 2048
 #define PRICE_MAX_TYPE_LEN 2048
@@ -65,6 +65,17 @@ static const GncSqlColumnTableEntry col_table[] =
     /*@ +full_init_block @*/
 };
 
+/* Index columns for finding the prices of a commodity in a currency by date */
+static const GncSqlColumnTableEntry pair_date_col_table[] =
+{
+    /*@ -full_init_block @*/
+    { "commodity_guid", CT_COMMODITYREF,   0,                    COL_NNUL,          "commodity" },
+    { "currency_guid",  CT_COMMODITYREF,   0,                    COL_NNUL,          "currency" },
+    { "date",           CT_TIMESPEC,       0,                    COL_NNUL,          "date" },
+    { NULL }
+    /*@ +full_init_block @*/
+};
+
 /* ================================================================= */
 
 static /*@ null @*//*@ dependent @*/ GNCPrice*
@@ -134,6 +145,7 @@ static void
 create_prices_tables( GncSqlBackend* be )
 {
     gint version;
+    gboolean ok;
 
     g_return_if_fail( be != NULL );
 
@@ -141,14 +153,30 @@ create_prices_tables( GncSqlBackend* be )
     if ( version == 0 )
     {
         (void)gnc_sql_create_table( be, TABLE_NAME, TABLE_VERSION, col_table );
+        ok = gnc_sql_create_index( be, "prices_pair_date_index", TABLE_NAME, pair_date_col_table );
+        if ( !ok )
+        {
+            PERR( "Unable to create index\n" );
+        }
     }
-    else if ( version == 1 )
+    else if ( version < TABLE_VERSION )
     {
-        /* Upgrade 64 bit int handling */
-        gnc_sql_upgrade_table( be, TABLE_NAME, col_table );
+        /* Upgrade:
+            1->2: 64 bit int handling
+            2->3: index on commodity, currency and date
+        */
+        if ( version == 1 )
+        {
+            gnc_sql_upgrade_table( be, TABLE_NAME, col_table );
+        }
+        ok = gnc_sql_create_index( be, "prices_pair_date_index", TABLE_NAME, pair_date_col_table );
+        if ( !ok )
+        {
+            PERR( "Unable to create index\n" );
+        }
         (void)gnc_sql_set_table_version( be, TABLE_NAME, TABLE_VERSION );
 
-        PINFO("Prices table upgraded from version 1 to version %d\n", TABLE_VERSION);
+        PINFO("Prices table upgraded from version %d to version %d\n", version, TABLE_VERSION);
     }
 }
 
@@ -44,7 +44,7 @@
 /*@ unused @*/ static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define TABLE_NAME "slots"
-#define TABLE_VERSION 3
+#define TABLE_VERSION 4
 
 typedef enum
 {
@@ -169,6 +169,16 @@ static const GncSqlColumnTableEntry obj_guid_col_table[] =
     /*@ +full_init_block @*/
 };
 
+/* Index columns for finding one slot of an object */
+static const GncSqlColumnTableEntry obj_guid_name_col_table[] =
+{
+    /*@ -full_init_block @*/
+    { "obj_guid", CT_GUID,   0,                     0,        NULL },
+    { "name",     CT_STRING, SLOT_MAX_PATHNAME_LEN, COL_NNUL, NULL },
+    { NULL }
+    /*@ +full_init_block @*/
+};
+
 static const GncSqlColumnTableEntry gdate_col_table[] =
 {
     /*@ -full_init_block @*/
@@ -706,25 +716,318 @@ save_slot( const gchar* key, KvpValue* value, gpointer data )
     (void)g_string_truncate( pSlot_info->path, curlen );
 }
 
+/* ================================================================= */
+/* Slot snapshots
+ *
+ * The backend keeps a copy of the slots of each object as they were last
+ * loaded from or saved to the db.  Saving an object compares its frame
+ * with that copy: an unchanged frame needs no db work at all, and a
+ * changed one only rewrites the rows of the keys which differ.  Frames
+ * nested in both copies are compared key by key in the same way.  The
+ * rows are only known by an autoincremented id, so a changed value is
+ * deleted and inserted again rather than updated in place.
+ */
+
+static /*@ null @*/ KvpFrame*
+slots_get_snapshot( const GncSqlBackend* be, const GncGUID* guid )
+{
+    if ( be->slot_snapshots == NULL ) return NULL;
+    return g_hash_table_lookup( be->slot_snapshots, guid );
+}
+
+static void
+slots_set_snapshot( GncSqlBackend* be, const GncGUID* guid, const KvpFrame* pFrame )
+{
+    if ( be->slot_snapshots == NULL )
+    {
+        be->slot_snapshots = g_hash_table_new_full( guid_hash_to_guint,
+                             guid_g_hash_table_equal,
+                             (GDestroyNotify)guid_free,
+                             (GDestroyNotify)kvp_frame_delete );
+    }
+    g_hash_table_replace( be->slot_snapshots, guid_copy( guid ),
+                          kvp_frame_copy( pFrame ) );
+}
+
+static void
+slots_forget_snapshot( GncSqlBackend* be, const GncGUID* guid )
+{
+    if ( be->slot_snapshots != NULL )
+    {
+        (void)g_hash_table_remove( be->slot_snapshots, guid );
+    }
+}
+
+void
+gnc_sql_slots_forget_all( GncSqlBackend* be )
+{
+    g_return_if_fail( be != NULL );
+
+    if ( be->slot_snapshots != NULL )
+    {
+        g_hash_table_destroy( be->slot_snapshots );
+        be->slot_snapshots = NULL;
+    }
+}
+
+/* Builds the condition selecting the rows of an object for the slot at
+   'path'.  Files written by old versions may hold a nested frame as
+   rows named "path/key" instead of a frame row, so those match too. */
+static gchar*
+slot_rows_condition( const GncSqlBackend* be, const GncGUID* guid, const gchar* path )
+{
+    gchar guid_buf[GUID_ENCODING_LENGTH + 1];
+    gchar* quoted_path;
+    gchar* prefix;
+    gchar* quoted_prefix;
+    gchar* cond;
+
+    (void)guid_to_string_buff( guid, guid_buf );
+    prefix = g_strconcat( path, "/", NULL );
+    quoted_path = gnc_sql_connection_quote_string( be->conn, (gchar*)path );
+    quoted_prefix = gnc_sql_connection_quote_string( be->conn, prefix );
+    cond = g_strdup_printf( "obj_guid='%s' AND (name=%s OR substr(name,1,%ld)=%s)",
+                            guid_buf, quoted_path,
+                            g_utf8_strlen( prefix, -1 ), quoted_prefix );
+    g_free( quoted_path );
+    g_free( quoted_prefix );
+    g_free( prefix );
+
+    return cond;
+}
+
+/* Looks up the guid under which the rows of the frame at 'path' are kept. */
+static gboolean
+slots_get_frame_guid( GncSqlBackend* be, const GncGUID* guid, const gchar* path,
+                      GncGUID* frame_guid )
+{
+    gchar guid_buf[GUID_ENCODING_LENGTH + 1];
+    gchar* quoted_path;
+    gchar* sql;
+    GncSqlResult* result;
+    gboolean found = FALSE;
+
+    (void)guid_to_string_buff( guid, guid_buf );
+    quoted_path = gnc_sql_connection_quote_string( be->conn, (gchar*)path );
+    sql = g_strdup_printf( "SELECT guid_val FROM %s WHERE obj_guid='%s' AND name=%s and slot_type='%d' and not guid_val is null",
+                           TABLE_NAME, guid_buf, quoted_path, KVP_TYPE_FRAME );
+    g_free( quoted_path );
+    result = gnc_sql_execute_select_sql( be, sql );
+    g_free( sql );
+    if ( result != NULL )
+    {
+        GncSqlRow* row = gnc_sql_result_get_first_row( result );
+
+        if ( row != NULL )
+        {
+            const GValue* val = gnc_sql_row_get_value_at_col_name( row,
+                                col_table[guid_val_col].col_name );
+            if ( val != NULL && G_VALUE_HOLDS_STRING( val ) )
+            {
+                found = string_to_guid( g_value_get_string( val ), frame_guid );
+            }
+        }
+        gnc_sql_result_dispose( result );
+    }
+
+    return found;
+}
+
+/* Deletes the rows of the slot at 'path', along with the rows of any
+   frames or lists it holds. */
+static gboolean
+slots_delete_path( GncSqlBackend* be, const GncGUID* guid, const gchar* path )
+{
+    gchar* cond = slot_rows_condition( be, guid, path );
+    gchar* sql;
+    GncSqlResult* result;
+    gboolean is_ok = TRUE;
+
+    sql = g_strdup_printf( "SELECT guid_val FROM %s WHERE %s and slot_type in ('%d', '%d') and not guid_val is null",
+                           TABLE_NAME, cond, KVP_TYPE_FRAME, KVP_TYPE_GLIST );
+    result = gnc_sql_execute_select_sql( be, sql );
+    g_free( sql );
+    if ( result != NULL )
+    {
+        GncSqlRow* row;
+
+        for ( row = gnc_sql_result_get_first_row( result );
+                row != NULL && is_ok;
+                row = gnc_sql_result_get_next_row( result ) )
+        {
+            GncGUID child_guid;
+            const GValue* val = gnc_sql_row_get_value_at_col_name( row,
+                                col_table[guid_val_col].col_name );
+            if ( val == NULL || !G_VALUE_HOLDS_STRING( val ) ) continue;
+
+            if ( string_to_guid( g_value_get_string( val ), &child_guid ) )
+            {
+                is_ok = gnc_sql_slots_delete( be, &child_guid );
+            }
+        }
+        gnc_sql_result_dispose( result );
+    }
+
+    if ( is_ok )
+    {
+        sql = g_strdup_printf( "DELETE FROM %s WHERE %s", TABLE_NAME, cond );
+        is_ok = gnc_sql_execute_nonselect_sql( be, sql ) != -1;
+        g_free( sql );
+    }
+    g_free( cond );
+
+    return is_ok;
+}
+
+typedef struct
+{
+    /*@ dependent @*/
+    GncSqlBackend* be;
+    /*@ dependent @*/
+    const GncGUID* guid;
+    /*@ dependent @*/
+    const gchar* path;
+    /*@ dependent @*/
+    KvpFrame* pOther;
+    gboolean is_ok;
+} slot_diff_t;
+
+static gboolean slots_save_changes( GncSqlBackend* be, const GncGUID* guid,
+                                    const gchar* path, KvpFrame* pOld,
+                                    KvpFrame* pNew );
+
+static gchar*
+slot_diff_path( const slot_diff_t* diff, const gchar* key )
+{
+    if ( *diff->path == '\0' ) return g_strdup( key );
+    return g_strconcat( diff->path, "/", key, NULL );
+}
+
+/* Called for each old slot, with the new frame in pOther */
+static void
+delete_removed_slot( const gchar* key, KvpValue* value, gpointer data )
+{
+    slot_diff_t* diff = (slot_diff_t*)data;
+    gchar* path;
+
+    if ( !diff->is_ok || kvp_frame_get_slot( diff->pOther, key ) != NULL ) return;
+
+    path = slot_diff_path( diff, key );
+    diff->is_ok = slots_delete_path( diff->be, diff->guid, path );
+    g_free( path );
+}
+
+/* Called for each new slot, with the old frame in pOther */
+static void
+save_changed_slot( const gchar* key, KvpValue* value, gpointer data )
+{
+    slot_diff_t* diff = (slot_diff_t*)data;
+    KvpValue* old_value;
+    slot_info_t slot_info = { NULL, NULL, TRUE, NULL, 0, NULL, FRAME, NULL, NULL };
+    gchar* path;
+
+    if ( !diff->is_ok ) return;
+
+    old_value = kvp_frame_get_slot( diff->pOther, key );
+    if ( old_value != NULL && kvp_value_compare( old_value, value ) == 0 ) return;
+
+    path = slot_diff_path( diff, key );
+    if ( old_value != NULL )
+    {
+        GncGUID frame_guid;
+
+        if ( kvp_value_get_type( old_value ) == KVP_TYPE_FRAME
+                && kvp_value_get_type( value ) == KVP_TYPE_FRAME
+                && slots_get_frame_guid( diff->be, diff->guid, path, &frame_guid ) )
+        {
+            diff->is_ok = slots_save_changes( diff->be, &frame_guid, path,
+                                              kvp_value_get_frame( old_value ),
+                                              kvp_value_get_frame( value ) );
+            g_free( path );
+            return;
+        }
+        diff->is_ok = slots_delete_path( diff->be, diff->guid, path );
+    }
+    g_free( path );
+    if ( !diff->is_ok ) return;
+
+    slot_info.be = diff->be;
+    slot_info.guid = diff->guid;
+    slot_info.path = g_string_new( diff->path );
+    save_slot( key, value, &slot_info );
+    (void)g_string_free( slot_info.path, TRUE );
+    diff->is_ok = slot_info.is_ok;
+}
+
+/* Writes the differences between the frame last saved under 'guid' and
+   its new contents.  'path' is the slot path of the frame itself, "" for
+   the top level of an object. */
+static gboolean
+slots_save_changes( GncSqlBackend* be, const GncGUID* guid, const gchar* path,
+                    KvpFrame* pOld, KvpFrame* pNew )
+{
+    slot_diff_t diff;
+
+    diff.be = be;
+    diff.guid = guid;
+    diff.path = path;
+    diff.is_ok = TRUE;
+
+    diff.pOther = pNew;
+    kvp_frame_for_each_slot( pOld, delete_removed_slot, &diff );
+    diff.pOther = pOld;
+    kvp_frame_for_each_slot( pNew, save_changed_slot, &diff );
+
+    return diff.is_ok;
+}
+
 gboolean
 gnc_sql_slots_save( GncSqlBackend* be, const GncGUID* guid, gboolean is_infant, KvpFrame* pFrame )
 {
-    slot_info_t slot_info = { NULL, NULL, TRUE, NULL, 0, NULL, FRAME, NULL, g_string_new('\0') };
+    slot_info_t slot_info = { NULL, NULL, TRUE, NULL, 0, NULL, FRAME, NULL, NULL };
+    KvpFrame* pSnapshot = NULL;
 
     g_return_val_if_fail( be != NULL, FALSE );
     g_return_val_if_fail( guid != NULL, FALSE );
     g_return_val_if_fail( pFrame != NULL, FALSE );
 
-    // If this is not saving into a new db, clear out the old saved slots first
     if ( !be->is_pristine_db && !is_infant )
     {
-        (void)gnc_sql_slots_delete( be, guid );
+        pSnapshot = slots_get_snapshot( be, guid );
     }
 
-    slot_info.be = be;
-    slot_info.guid = guid;
-    kvp_frame_for_each_slot( pFrame, save_slot, &slot_info );
-    (void)g_string_free( slot_info.path, TRUE );
+    if ( pSnapshot != NULL )
+    {
+        // Only write what changed since the slots were last loaded or saved
+        if ( kvp_frame_compare( pSnapshot, pFrame ) == 0 )
+        {
+            return TRUE;
+        }
+        slot_info.is_ok = slots_save_changes( be, guid, "", pSnapshot, pFrame );
+    }
+    else
+    {
+        // If this is not saving into a new db, clear out the old saved slots first
+        if ( !be->is_pristine_db && !is_infant )
+        {
+            (void)gnc_sql_slots_delete( be, guid );
+        }
+
+        slot_info.be = be;
+        slot_info.guid = guid;
+        slot_info.path = g_string_new( NULL );
+        kvp_frame_for_each_slot( pFrame, save_slot, &slot_info );
+        (void)g_string_free( slot_info.path, TRUE );
+    }
+
+    if ( slot_info.is_ok )
+    {
+        slots_set_snapshot( be, guid, pFrame );
+    }
+    else
+    {
+        slots_forget_snapshot( be, guid );
+    }
 
     return slot_info.is_ok;
 }
@@ -741,6 +1044,7 @@ gnc_sql_slots_delete( GncSqlBackend* be, const GncGUID* guid )
     g_return_val_if_fail( be != NULL, FALSE );
     g_return_val_if_fail( guid != NULL, FALSE );
 
+    slots_forget_snapshot( be, guid );
     (void)guid_to_string_buff( guid, guid_buf );
 
     buf = g_strdup_printf( "SELECT * FROM %s WHERE obj_guid='%s' and slot_type in ('%d', '%d') and not guid_val is null",
@@ -828,6 +1132,7 @@ gnc_sql_slots_load( GncSqlBackend* be, QofInstance* inst )
     info.context = NONE;
 
     slots_load_info( &info );
+    slots_set_snapshot( be, info.guid, info.pKvpFrame );
 }
 
 static void
@@ -963,24 +1268,31 @@ gnc_sql_slots_load_for_list( GncSqlBackend* be, GList* list )
             row = gnc_sql_result_get_next_row( result );
         }
         gnc_sql_result_dispose( result );
+
+        for ( ; list != NULL; list = list->next )
+        {
+            QofInstance* inst = QOF_INSTANCE(list->data);
+            slots_set_snapshot( be, qof_instance_get_guid( inst ),
+                                qof_instance_get_slots( inst ) );
+        }
     }
 }
 
-static void
+static /*@ null @*/ QofInstance*
 load_slot_for_book_object( GncSqlBackend* be, GncSqlRow* row, BookLookupFn lookup_fn )
 {
     slot_info_t slot_info = { NULL, NULL, TRUE, NULL, 0, NULL, FRAME, NULL, NULL };
     const GncGUID* guid;
     QofInstance* inst;
 
-    g_return_if_fail( be != NULL );
-    g_return_if_fail( row != NULL );
-    g_return_if_fail( lookup_fn != NULL );
+    g_return_val_if_fail( be != NULL, NULL );
+    g_return_val_if_fail( row != NULL, NULL );
+    g_return_val_if_fail( lookup_fn != NULL, NULL );
 
     guid = load_obj_guid( be, row );
-    g_return_if_fail( guid != NULL );
+    g_return_val_if_fail( guid != NULL, NULL );
     inst = lookup_fn( guid, be->primary_book );
-    g_return_if_fail( inst != NULL );
+    g_return_val_if_fail( inst != NULL, NULL );
 
     slot_info.be = be;
     slot_info.pKvpFrame = qof_instance_get_slots( inst );
@@ -992,6 +1304,17 @@ load_slot_for_book_object( GncSqlBackend* be, GncSqlRow* row, BookLookupFn looku
     {
         (void)g_string_free( slot_info.path, TRUE );
     }
+
+    return inst;
+}
+
+static void
+set_snapshot_cb( gpointer key, gpointer value, gpointer be )
+{
+    QofInstance* inst = QOF_INSTANCE(key);
+
+    slots_set_snapshot( (GncSqlBackend*)be, qof_instance_get_guid( inst ),
+                        qof_instance_get_slots( inst ) );
 }
 
 /**
@@ -1033,13 +1356,22 @@ void gnc_sql_slots_load_for_sql_subquery( GncSqlBackend* be, const gchar* subque
     if ( result != NULL )
     {
         GncSqlRow* row = gnc_sql_result_get_first_row( result );
+        GHashTable* loaded = g_hash_table_new( g_direct_hash, g_direct_equal );
 
         while ( row != NULL )
         {
-            load_slot_for_book_object( be, row, lookup_fn );
+            QofInstance* inst = load_slot_for_book_object( be, row, lookup_fn );
+            if ( inst != NULL )
+            {
+                g_hash_table_insert( loaded, inst, inst );
+            }
             row = gnc_sql_result_get_next_row( result );
         }
         gnc_sql_result_dispose( result );
+
+        // Objects without any slots get theirs on their first save
+        g_hash_table_foreach( loaded, set_snapshot_cb, be );
+        g_hash_table_destroy( loaded );
     }
 }
 
@@ -1057,7 +1389,8 @@ create_slots_tables( GncSqlBackend* be )
     {
         (void)gnc_sql_create_table( be, TABLE_NAME, TABLE_VERSION, col_table );
 
-        ok = gnc_sql_create_index( be, "slots_guid_index", TABLE_NAME, obj_guid_col_table );
+        /* Serves lookups by obj_guid alone as well */
+        ok = gnc_sql_create_index( be, "slots_guid_name_index", TABLE_NAME, obj_guid_name_col_table );
         if ( !ok )
         {
             PERR( "Unable to create index\n" );
@@ -1068,15 +1401,11 @@ create_slots_tables( GncSqlBackend* be )
         /* Upgrade:
             1->2: 64-bit int values to proper definition, add index
             2->3: Add gdate field
+            3->4: Index on obj_guid and name
         */
         if ( version == 1 )
         {
             gnc_sql_upgrade_table( be, TABLE_NAME, col_table );
-            ok = gnc_sql_create_index( be, "slots_guid_index", TABLE_NAME, obj_guid_col_table );
-            if ( !ok )
-            {
-                PERR( "Unable to create index\n" );
-            }
         }
         else if ( version == 2 )
         {
@@ -1086,6 +1415,16 @@ create_slots_tables( GncSqlBackend* be )
                 PERR( "Unable to add gdate column\n" );
             }
         }
+        ok = gnc_sql_create_index( be, "slots_guid_name_index", TABLE_NAME, obj_guid_name_col_table );
+        if ( !ok )
+        {
+            PERR( "Unable to create index\n" );
+        }
+        ok = gnc_sql_drop_index( be, "slots_guid_index", TABLE_NAME );
+        if ( !ok )
+        {
+            PERR( "Unable to drop index\n" );
+        }
         (void)gnc_sql_set_table_version( be, TABLE_NAME, TABLE_VERSION );
         PINFO("Slots table upgraded from version %d to version %d\n", version, TABLE_VERSION);
     }
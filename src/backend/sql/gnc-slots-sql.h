@@ -56,6 +56,16 @@ gboolean gnc_sql_slots_save( GncSqlBackend* be, const GncGUID* guid,
  */
 gboolean gnc_sql_slots_delete( GncSqlBackend* be, const GncGUID* guid );
 
+/**
+ * gnc_sql_slots_forget_all - Drops the copies of the slots last loaded or
+ * saved for each object.  Objects saved afterwards have all of their slots
+ * rewritten.  Must be called whenever the db may no longer hold what was
+ * last written, e.g. after a rollback.
+ *
+ * @param be SQL backend
+ */
+void gnc_sql_slots_forget_all( GncSqlBackend* be );
+
 /** Loads slots for an object from the db.
  *
  * @param be SQL backend
@@ -47,21 +47,17 @@
 
 #include "gnc-engine.h"
 
-#include "escape.h"
-
 #ifdef S_SPLINT_S
 #include "splint-defs.h"
 #endif
 
-#define SIMPLE_QUERY_COMPILATION 1
-#define LOAD_TRANSACTIONS_AS_NEEDED 0
 
 static QofLogModule log_module = G_LOG_DOMAIN;
 
 #define TRANSACTION_TABLE "transactions"
-#define TX_TABLE_VERSION 3
+#define TX_TABLE_VERSION 4
 #define SPLIT_TABLE "splits"
-#define SPLIT_TABLE_VERSION 4
+#define SPLIT_TABLE_VERSION 5
 
 typedef struct
 {
@@ -118,18 +114,23 @@ static const GncSqlColumnTableEntry split_col_table[] =
     /*@ +full_init_block @*/
 };
 
-static const GncSqlColumnTableEntry post_date_col_table[] =
+/* Index columns.  With the guid after the date and the transaction after
+   the account, the splits of an account in a date range are found from
+   the two indexes alone, whichever table the database starts from. */
+static const GncSqlColumnTableEntry post_date_guid_col_table[] =
 {
     /*@ -full_init_block @*/
     { "post_date", CT_TIMESPEC, 0, 0, "post-date" },
+    { "guid",      CT_GUID,     0, 0, "guid" },
     { NULL }
     /*@ +full_init_block @*/
 };
 
-static const GncSqlColumnTableEntry account_guid_col_table[] =
+static const GncSqlColumnTableEntry account_tx_col_table[] =
 {
     /*@ -full_init_block @*/
     { "account_guid", CT_ACCOUNTREF, 0, COL_NNUL, "account" },
+    { "tx_guid",      CT_GUID,       0, 0,        "guid" },
     { NULL }
     /*@ +full_init_block @*/
 };
@@ -341,6 +342,7 @@ save_account_balances( Account* acc, gpointer pData )
     g_assert( newbal != NULL );
 
     newbal->acc = acc;
+    xaccAccountRecomputeBalance( acc );
     g_object_get( acc,
                   "start-balance", &pstart,
                   "end-balance", &pend,
@@ -365,21 +367,57 @@ save_account_balances( Account* acc, gpointer pData )
     g_free( pend_r );
 }
 
+/**
+ * Saves the start/end balances of the accounts which the splits of newly
+ * loaded transactions belong to.  This must be done before the transactions
+ * are committed, which is when their splits are added to the accounts.
+ *
+ * @param tx_list List of loaded transactions, still open for editing
+ * @param pBal_list Pointer to balances info list
+ */
+static void
+save_touched_account_balances( GList* tx_list, GSList** pBal_list )
+{
+    GHashTable* saved;
+    GList* tx_node;
+
+    saved = g_hash_table_new( g_direct_hash, g_direct_equal );
+    for ( tx_node = tx_list; tx_node != NULL; tx_node = tx_node->next )
+    {
+        GList* split_node;
+
+        for ( split_node = xaccTransGetSplitList( GNC_TRANSACTION(tx_node->data) );
+                split_node != NULL; split_node = split_node->next )
+        {
+            Account* acc = xaccSplitGetAccount( GNC_SPLIT(split_node->data) );
+
+            if ( acc == NULL || g_hash_table_lookup( saved, acc ) != NULL ) continue;
+            g_hash_table_insert( saved, acc, acc );
+            save_account_balances( acc, pBal_list );
+        }
+    }
+    g_hash_table_destroy( saved );
+}
+
 /**
  * Executes a transaction query statement and loads the transactions and all
  * of the splits.
  *
  * @param be SQL backend
  * @param stmt SQL statement
+ * @return TRUE if the statement could be run
  */
-static void
+static gboolean
 query_transactions( GncSqlBackend* be, GncSqlStatement* stmt )
 {
     GncSqlResult* result;
+    gboolean was_loading;
 
-    g_return_if_fail( be != NULL );
-    g_return_if_fail( stmt != NULL );
+    g_return_val_if_fail( be != NULL, FALSE );
+    g_return_val_if_fail( stmt != NULL, FALSE );
 
+    was_loading = be->loading;
+    be->loading = TRUE;
     result = gnc_sql_execute_select_statement( be, stmt );
     if ( result != NULL )
     {
@@ -391,16 +429,11 @@ query_transactions( GncSqlBackend* be, GncSqlStatement* stmt )
         GSList* nextbal;
         Account* root = gnc_book_get_root_account( be->primary_book );
 
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        qof_event_suspend();
-        xaccAccountBeginEdit( root );
-
-        // Save the start/ending balances (balance, cleared and reconciled) for
-        // every account.
-        gnc_account_foreach_descendant( gnc_book_get_root_account( be->primary_book ),
-                                        save_account_balances,
-                                        &bal_list );
-#endif
+        if ( be->load_tx_as_needed )
+        {
+            qof_event_suspend();
+            xaccAccountBeginEdit( root );
+        }
 
         // Load the transactions
         row = gnc_sql_result_get_first_row( result );
@@ -422,6 +455,13 @@ query_transactions( GncSqlBackend* be, GncSqlStatement* stmt )
             load_splits_for_tx_list( be, tx_list );
         }
 
+        // Save the start/ending balances (balance, cleared and reconciled) of
+        // the accounts which the new splits are about to be added to.
+        if ( be->load_tx_as_needed )
+        {
+            save_touched_account_balances( tx_list, &bal_list );
+        }
+
         // Commit all of the transactions
         for ( node = tx_list; node != NULL; node = node->next )
         {
@@ -430,64 +470,68 @@ query_transactions( GncSqlBackend* be, GncSqlStatement* stmt )
         }
         g_list_free( tx_list );
 
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        // Update the account balances based on the loaded splits.  If the end
-        // balance has changed, update the start balance so that the end
-        // balance is the same as it was before the splits were loaded.
-        // Repeat for cleared and reconciled balances.
-        for ( nextbal = bal_list; nextbal != NULL; nextbal = nextbal->next )
+        if ( be->load_tx_as_needed )
         {
-            full_acct_balances_t* balns = (full_acct_balances_t*)nextbal->data;
-            gnc_numeric* pnew_end_bal;
-            gnc_numeric* pnew_end_c_bal;
-            gnc_numeric* pnew_end_r_bal;
-            gnc_numeric adj;
-
-            g_object_get( balns->acc,
-                          "end-balance", &pnew_end_bal,
-                          "end-cleared-balance", &pnew_end_c_bal,
-                          "end-reconciled-balance", &pnew_end_r_bal,
-                          NULL );
-
-            if ( !gnc_numeric_eq( *pnew_end_bal, balns->end_bal ) )
-            {
-                adj = gnc_numeric_sub( balns->end_bal, *pnew_end_bal,
-                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                balns->start_bal = gnc_numeric_add( balns->start_bal, adj,
-                                                    GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                g_object_set( balns->acc, "start-balance", &balns->start_bal, NULL );
-            }
-            if ( !gnc_numeric_eq( *pnew_end_c_bal, balns->end_cleared_bal ) )
+            // Update the account balances based on the loaded splits.  If the end
+            // balance has changed, update the start balance so that the end
+            // balance is the same as it was before the splits were loaded.
+            // Repeat for cleared and reconciled balances.
+            for ( nextbal = bal_list; nextbal != NULL; nextbal = nextbal->next )
             {
-                adj = gnc_numeric_sub( balns->end_cleared_bal, *pnew_end_c_bal,
-                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                balns->start_cleared_bal = gnc_numeric_add( balns->start_cleared_bal, adj,
+                full_acct_balances_t* balns = (full_acct_balances_t*)nextbal->data;
+                gnc_numeric* pnew_end_bal;
+                gnc_numeric* pnew_end_c_bal;
+                gnc_numeric* pnew_end_r_bal;
+                gnc_numeric adj;
+
+                xaccAccountRecomputeBalance( balns->acc );
+                g_object_get( balns->acc,
+                              "end-balance", &pnew_end_bal,
+                              "end-cleared-balance", &pnew_end_c_bal,
+                              "end-reconciled-balance", &pnew_end_r_bal,
+                              NULL );
+
+                if ( !gnc_numeric_eq( *pnew_end_bal, balns->end_bal ) )
+                {
+                    adj = gnc_numeric_sub( balns->end_bal, *pnew_end_bal,
+                                           GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+                    balns->start_bal = gnc_numeric_add( balns->start_bal, adj,
+                                                        GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+                    g_object_set( balns->acc, "start-balance", &balns->start_bal, NULL );
+                }
+                if ( !gnc_numeric_eq( *pnew_end_c_bal, balns->end_cleared_bal ) )
+                {
+                    adj = gnc_numeric_sub( balns->end_cleared_bal, *pnew_end_c_bal,
                                            GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                g_object_set( balns->acc, "start-cleared-balance", &balns->start_cleared_bal, NULL );
+                    balns->start_cleared_bal = gnc_numeric_add( balns->start_cleared_bal, adj,
+                                               GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+                    g_object_set( balns->acc, "start-cleared-balance", &balns->start_cleared_bal, NULL );
+                }
+                if ( !gnc_numeric_eq( *pnew_end_r_bal, balns->end_reconciled_bal ) )
+                {
+                    adj = gnc_numeric_sub( balns->end_reconciled_bal, *pnew_end_r_bal,
+                                           GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+                    balns->start_reconciled_bal = gnc_numeric_add( balns->start_reconciled_bal, adj,
+                                                  GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+                    g_object_set( balns->acc, "start-reconciled-balance", &balns->start_reconciled_bal, NULL );
+                }
+                xaccAccountRecomputeBalance( balns->acc );
+                g_free( pnew_end_bal );
+                g_free( pnew_end_c_bal );
+                g_free( pnew_end_r_bal );
+                g_free( balns );
             }
-            if ( !gnc_numeric_eq( *pnew_end_r_bal, balns->end_reconciled_bal ) )
+            if ( bal_list != NULL )
             {
-                adj = gnc_numeric_sub( balns->end_reconciled_bal, *pnew_end_r_bal,
-                                       GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                balns->start_reconciled_bal = gnc_numeric_add( balns->start_reconciled_bal, adj,
-                                              GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                g_object_set( balns->acc, "start-reconciled-balance", &balns->start_reconciled_bal, NULL );
+                g_slist_free( bal_list );
             }
-            xaccAccountRecomputeBalance( balns->acc );
-            g_free( pnew_end_bal );
-            g_free( pnew_end_c_bal );
-            g_free( pnew_end_r_bal );
-            g_free( balns );
-        }
-        if ( bal_list != NULL )
-        {
-            g_slist_free( bal_list );
-        }
 
-        xaccAccountCommitEdit( root );
-        qof_event_resume();
-#endif
+            xaccAccountCommitEdit( root );
+            qof_event_resume();
+        }
     }
+    be->loading = was_loading;
+    return result != NULL;
 }
 
 /* ================================================================= */
@@ -508,7 +552,7 @@ create_transaction_tables( GncSqlBackend* be )
     if ( version == 0 )
     {
         (void)gnc_sql_create_table( be, TRANSACTION_TABLE, TX_TABLE_VERSION, tx_col_table );
-        ok = gnc_sql_create_index( be, "tx_post_date_index", TRANSACTION_TABLE, post_date_col_table );
+        ok = gnc_sql_create_index( be, "tx_post_date_guid_index", TRANSACTION_TABLE, post_date_guid_col_table );
         if ( !ok )
         {
             PERR( "Unable to create index\n" );
@@ -519,8 +563,22 @@ create_transaction_tables( GncSqlBackend* be )
         /* Upgrade:
             1->2: 64 bit int handling
         	2->3: allow dates to be NULL
+            3->4: index on post date and guid
         */
-        gnc_sql_upgrade_table( be, TRANSACTION_TABLE, tx_col_table );
+        if ( version < 3 )
+        {
+            gnc_sql_upgrade_table( be, TRANSACTION_TABLE, tx_col_table );
+        }
+        ok = gnc_sql_create_index( be, "tx_post_date_guid_index", TRANSACTION_TABLE, post_date_guid_col_table );
+        if ( !ok )
+        {
+            PERR( "Unable to create index\n" );
+        }
+        ok = gnc_sql_drop_index( be, "tx_post_date_index", TRANSACTION_TABLE );
+        if ( !ok )
+        {
+            PERR( "Unable to drop index\n" );
+        }
         (void)gnc_sql_set_table_version( be, TRANSACTION_TABLE, TX_TABLE_VERSION );
         PINFO("Transactions table upgraded from version %d to version %d\n", version, TX_TABLE_VERSION);
     }
@@ -534,7 +592,7 @@ create_transaction_tables( GncSqlBackend* be )
         {
             PERR( "Unable to create index\n" );
         }
-        ok = gnc_sql_create_index( be, "splits_account_guid_index", SPLIT_TABLE, account_guid_col_table );
+        ok = gnc_sql_create_index( be, "splits_account_tx_index", SPLIT_TABLE, account_tx_col_table );
         if ( !ok )
         {
             PERR( "Unable to create index\n" );
@@ -545,17 +603,26 @@ create_transaction_tables( GncSqlBackend* be )
 
         /* Upgrade:
            1->2: 64 bit int handling
-           3->4: Split reconcile date can be NULL */
-        gnc_sql_upgrade_table( be, SPLIT_TABLE, split_col_table );
-        ok = gnc_sql_create_index( be, "splits_tx_guid_index", SPLIT_TABLE, tx_guid_col_table );
+           3->4: Split reconcile date can be NULL
+           4->5: index on account and transaction */
+        if ( version < 4 )
+        {
+            gnc_sql_upgrade_table( be, SPLIT_TABLE, split_col_table );
+            ok = gnc_sql_create_index( be, "splits_tx_guid_index", SPLIT_TABLE, tx_guid_col_table );
+            if ( !ok )
+            {
+                PERR( "Unable to create index\n" );
+            }
+        }
+        ok = gnc_sql_create_index( be, "splits_account_tx_index", SPLIT_TABLE, account_tx_col_table );
         if ( !ok )
         {
             PERR( "Unable to create index\n" );
         }
-        ok = gnc_sql_create_index( be, "splits_account_guid_index", SPLIT_TABLE, account_guid_col_table );
+        ok = gnc_sql_drop_index( be, "splits_account_guid_index", SPLIT_TABLE );
         if ( !ok )
         {
-            PERR( "Unable to create index\n" );
+            PERR( "Unable to drop index\n" );
         }
         (void)gnc_sql_set_table_version( be, SPLIT_TABLE, SPLIT_TABLE_VERSION );
         PINFO("Splits table upgraded from version %d to version %d\n", version, SPLIT_TABLE_VERSION);
@@ -850,6 +917,51 @@ get_guid_from_query( QofQuery* pQuery )
     }
 }
 
+/* ----------------------------------------------------------------- */
+/* When transactions are loaded as needed, the backend remembers which
+   accounts have had all of their transactions loaded so that they are not
+   queried again. */
+
+static gboolean
+account_is_loaded( const GncSqlBackend* be, const GncGUID* guid )
+{
+    if ( be->all_tx_loaded ) return TRUE;
+    if ( be->tx_loaded_accounts == NULL ) return FALSE;
+
+    return g_hash_table_lookup( be->tx_loaded_accounts, guid ) != NULL;
+}
+
+static void
+mark_account_loaded( GncSqlBackend* be, const GncGUID* guid )
+{
+    GncGUID* key;
+
+    if ( be->tx_loaded_accounts == NULL )
+    {
+        be->tx_loaded_accounts = g_hash_table_new_full( guid_hash_to_guint,
+                                 guid_g_hash_table_equal,
+                                 (GDestroyNotify)guid_free, NULL );
+    }
+    if ( g_hash_table_lookup( be->tx_loaded_accounts, guid ) != NULL ) return;
+
+    key = guid_malloc();
+    *key = *guid;
+    g_hash_table_insert( be->tx_loaded_accounts, key, key );
+}
+
+void
+gnc_sql_transaction_forget_loaded( GncSqlBackend* be )
+{
+    g_return_if_fail( be != NULL );
+
+    if ( be->tx_loaded_accounts != NULL )
+    {
+        g_hash_table_destroy( be->tx_loaded_accounts );
+        be->tx_loaded_accounts = NULL;
+    }
+    be->all_tx_loaded = FALSE;
+}
+
 /**
  * Loads all transactions for an account.
  *
@@ -867,6 +979,8 @@ void gnc_sql_transaction_load_tx_for_account( GncSqlBackend* be, Account* accoun
     g_return_if_fail( account != NULL );
 
     guid = qof_instance_get_guid( QOF_INSTANCE(account) );
+    if ( account_is_loaded( be, guid ) ) return;
+
     (void)guid_to_string_buff( guid, guid_buf );
     query_sql = g_strdup_printf(
                     "SELECT DISTINCT t.* FROM %s AS t, %s AS s WHERE s.tx_guid=t.guid AND s.account_guid ='%s'",
@@ -877,6 +991,7 @@ void gnc_sql_transaction_load_tx_for_account( GncSqlBackend* be, Account* accoun
     {
         query_transactions( be, stmt );
         gnc_sql_statement_dispose( stmt );
+        mark_account_loaded( be, guid );
     }
 }
 
@@ -885,435 +1000,901 @@ void gnc_sql_transaction_load_tx_for_account( GncSqlBackend* be, Account* accoun
  * all data is in memory and ready to be saved.
  *
  * @param be SQL backend
+ * @return TRUE if every transaction is now loaded
  */
-void gnc_sql_transaction_load_all_tx( GncSqlBackend* be )
+gboolean gnc_sql_transaction_load_all_tx( GncSqlBackend* be )
 {
     gchar* query_sql;
     GncSqlStatement* stmt;
 
-    g_return_if_fail( be != NULL );
+    g_return_val_if_fail( be != NULL, FALSE );
+
+    if ( be->all_tx_loaded ) return TRUE;
 
     query_sql = g_strdup_printf( "SELECT * FROM %s", TRANSACTION_TABLE );
     stmt = gnc_sql_create_statement_from_sql( be, query_sql );
     g_free( query_sql );
     if ( stmt != NULL )
     {
-        query_transactions( be, stmt );
+        be->all_tx_loaded = query_transactions( be, stmt );
         gnc_sql_statement_dispose( stmt );
     }
+    return be->all_tx_loaded;
 }
 
+/**
+ * Initial load of transactions: everything, unless transactions are only
+ * loaded as they are needed.
+ *
+ * @param be SQL backend
+ */
 static void
-convert_query_comparison_to_sql( QofQueryPredData* pPredData, gboolean isInverted, GString* sql )
+load_initial_tx( GncSqlBackend* be )
 {
-    if ( pPredData->how == QOF_COMPARE_LT
-            || ( isInverted && pPredData->how == QOF_COMPARE_GTE ) )
+    g_return_if_fail( be != NULL );
+
+    if ( !be->load_tx_as_needed )
     {
-        g_string_append( sql, "<" );
+        gnc_sql_transaction_load_all_tx( be );
     }
-    else if ( pPredData->how == QOF_COMPARE_LTE
-              || ( isInverted && pPredData->how == QOF_COMPARE_GT ) )
+}
+
+/* ----------------------------------------------------------------- */
+/* Split queries are translated into a condition on the transactions (t)
+   and splits (s) of a transaction so that only the transactions which the
+   query could match are loaded.  The engine runs the query again over the
+   loaded splits, so a term may be translated into a condition which
+   matches more splits than the term does, but never fewer.  A term which
+   can't be translated that way doesn't restrict the load at all. */
+
+/* Transactions are loaded a little more widely than the query asks for,
+   one day on each side, so that day-granular and timezone-shifted date
+   comparisons in the engine never miss a transaction. */
+#define DATE_RANGE_SLOP (60*60*24)
+
+/* The engine considers amounts equal if they match to four decimal places.
+   SQL compares them as floating point, so allow a little more. */
+#define AMOUNT_SLOP 0.0002
+
+/* Slots are stored by gnc-slots-sql.c */
+#define SLOT_TABLE "slots"
+
+typedef enum
+{
+    TERM_NOT_TRANSLATED,	/* Nothing was added to the condition */
+    TERM_WIDER,				/* The condition matches at least the term's splits */
+    TERM_EXACT				/* The condition matches exactly the term's splits */
+} term_translation_t;
+
+/**
+ * What the query needs in memory before the engine can run it.  A query
+ * which selects splits only by account keeps the accounts so that those
+ * which are already loaded can be skipped.  Queries which keep only the
+ * latest splits, and whose condition is exact, remember how many so that
+ * older transactions needn't be loaded.
+ */
+typedef struct
+{
+    /*@ owned @*/ GList* accounts;	/* GncGUID* */
+    /*@ null @*/ gchar* where;		/* NULL if every transaction could match */
+    gboolean is_exact;
+    gint max_results;				/* -1 unless only the latest splits are kept */
+    gboolean has_been_run;
+} split_query_info_t;
+
+static gboolean
+param_path_is( GSList* path, const gchar* first, /*@ null @*/ const gchar* second )
+{
+    if ( path == NULL || safe_strcmp( path->data, first ) != 0 ) return FALSE;
+    path = path->next;
+    if ( second == NULL ) return path == NULL;
+    return path != NULL && path->next == NULL && safe_strcmp( path->data, second ) == 0;
+}
+
+static /*@ null @*/ const gchar*
+comparison_to_sql( QofQueryCompare how )
+{
+    switch ( how )
     {
-        g_string_append( sql, "<=" );
+    case QOF_COMPARE_LT:
+        return "<";
+    case QOF_COMPARE_LTE:
+        return "<=";
+    case QOF_COMPARE_EQUAL:
+        return "=";
+    case QOF_COMPARE_GT:
+        return ">";
+    case QOF_COMPARE_GTE:
+        return ">=";
+    case QOF_COMPARE_NEQ:
+        return "<>";
+    default:
+        PERR( "Unknown comparison type %d\n", how );
+        return NULL;
     }
-    else if ( pPredData->how == QOF_COMPARE_EQUAL
-              || ( isInverted && pPredData->how == QOF_COMPARE_NEQ ) )
+}
+
+/* Only strings which need no quoting are put into the SQL, because the
+   backends quote differently. */
+static gboolean
+is_plain_sql_string( /*@ null @*/ const gchar* str )
+{
+    return str != NULL && strpbrk( str, "'\\" ) == NULL;
+}
+
+static gboolean
+is_ascii_string( const gchar* str )
+{
+    for ( ; *str != '\0'; str++ )
     {
-        g_string_append( sql, "=" );
+        if ( (guchar)*str >= 0x80 ) return FALSE;
     }
-    else if ( pPredData->how == QOF_COMPARE_GT
-              || ( isInverted && pPredData->how == QOF_COMPARE_LTE ) )
+    return TRUE;
+}
+
+static void
+append_guid_list( GString* sql, GList* guids )
+{
+    GList* node;
+
+    for ( node = guids; node != NULL; node = node->next )
     {
-        g_string_append( sql, ">" );
+        gchar guid_buf[GUID_ENCODING_LENGTH+1];
+
+        (void)guid_to_string_buff( node->data, guid_buf );
+        g_string_append_printf( sql, "%s'%s'", node == guids ? "" : ",", guid_buf );
     }
-    else if ( pPredData->how == QOF_COMPARE_GTE
-              || ( isInverted && pPredData->how == QOF_COMPARE_LT ) )
+}
+
+/* The [book, guid] term which qof_query_set_book() adds matches every
+   split in the database. */
+static gboolean
+is_own_book_term( const GncSqlBackend* be, QofQueryTerm* term )
+{
+    QofQueryPredData* pPredData = qof_query_term_get_pred_data( term );
+    query_guid_t guid_data = (query_guid_t)pPredData;
+    const GncGUID* book_guid = qof_instance_get_guid( QOF_INSTANCE(be->primary_book) );
+
+    if ( !param_path_is( qof_query_term_get_param_path( term ), QOF_PARAM_BOOK, QOF_PARAM_GUID ) )
+        return FALSE;
+    if ( safe_strcmp( pPredData->type_name, QOF_TYPE_GUID ) != 0 ) return FALSE;
+    if ( qof_query_term_is_inverted( term ) || guid_data->options != QOF_GUID_MATCH_ANY ) return FALSE;
+
+    return g_list_find_custom( guid_data->guids, book_guid, (GCompareFunc)guid_compare ) != NULL;
+}
+
+static term_translation_t
+translate_guid_term( const gchar* field, query_guid_t guid_data, gboolean isInverted, GString* sql )
+{
+    gboolean match;
+
+    switch ( guid_data->options )
     {
-        g_string_append( sql, ">=" );
+    case QOF_GUID_MATCH_ANY:
+    case QOF_GUID_MATCH_NONE:
+        if ( guid_data->guids == NULL ) return TERM_NOT_TRANSLATED;
+        match = ( guid_data->options == QOF_GUID_MATCH_ANY ) != isInverted;
+        if ( match )
+        {
+            g_string_append_printf( sql, "%s IN (", field );
+        }
+        else
+        {
+            /* A missing object (e.g. no lot) has the null guid, which
+               isn't in the list */
+            g_string_append_printf( sql, "(%s IS NULL OR %s NOT IN (", field, field );
+        }
+        append_guid_list( sql, guid_data->guids );
+        g_string_append( sql, match ? ")" : "))" );
+        return TERM_EXACT;
+
+    case QOF_GUID_MATCH_NULL:
+        g_string_append_printf( sql, "%s IS %sNULL", field, isInverted ? "NOT " : "" );
+        return TERM_EXACT;
+
+    default:
+        return TERM_NOT_TRANSLATED;
     }
-    else if ( pPredData->how == QOF_COMPARE_NEQ
-              || ( isInverted && pPredData->how == QOF_COMPARE_EQUAL ) )
+}
+
+static term_translation_t
+translate_char_term( const gchar* field, query_char_t char_data, gboolean isInverted, GString* sql )
+{
+    const gchar* c;
+    gboolean match;
+
+    if ( char_data->char_list == NULL || char_data->char_list[0] == '\0' )
+        return TERM_NOT_TRANSLATED;
+    for ( c = char_data->char_list; *c != '\0'; c++ )
     {
-        g_string_append( sql, "~=" );
+        if ( !g_ascii_isalnum( *c ) ) return TERM_NOT_TRANSLATED;
     }
-    else
+
+    match = ( char_data->options == QOF_CHAR_MATCH_ANY ) != isInverted;
+    g_string_append_printf( sql, "%s %sIN (", field, match ? "" : "NOT " );
+    for ( c = char_data->char_list; *c != '\0'; c++ )
     {
-        PERR( "Unknown comparison type\n" );
-        g_string_append( sql, "??" );
+        g_string_append_printf( sql, "%s'%c'", c == char_data->char_list ? "" : ",", *c );
     }
+    g_string_append( sql, ")" );
+    return TERM_EXACT;
 }
 
-static void
-convert_query_term_to_sql( const GncSqlBackend* be, const gchar* fieldName, QofQueryTerm* pTerm, GString* sql )
+static term_translation_t
+translate_date_term( const GncSqlBackend* be, const gchar* field, query_date_t date_data,
+                     gboolean isInverted, GString* sql )
 {
-    GSList* pParamPath;
-    QofQueryPredData* pPredData;
-    gboolean isInverted;
-    GSList* name;
+    QofQueryCompare how = date_data->pd.how;
+    gboolean has_start;
+    gboolean has_end;
+    Timespec ts;
+    gchar* datebuf;
 
-    g_return_if_fail( pTerm != NULL );
-    g_return_if_fail( sql != NULL );
+    if ( isInverted ) return TERM_NOT_TRANSLATED;
 
-    pParamPath = qof_query_term_get_param_path( pTerm );
-    pPredData = qof_query_term_get_pred_data( pTerm );
-    isInverted = qof_query_term_is_inverted( pTerm );
+    has_start = how == QOF_COMPARE_GT || how == QOF_COMPARE_GTE || how == QOF_COMPARE_EQUAL;
+    has_end = how == QOF_COMPARE_LT || how == QOF_COMPARE_LTE || how == QOF_COMPARE_EQUAL;
+    if ( !has_start && !has_end ) return TERM_NOT_TRANSLATED;
 
-    if ( safe_strcmp( pPredData->type_name, QOF_TYPE_GUID ) == 0 )
+    /* A missing date is the epoch to the engine */
+    if ( has_start )
     {
-        query_guid_t guid_data = (query_guid_t)pPredData;
-        GList* guid_entry;
-
-        g_string_append( sql, "(" );
-        g_string_append( sql, fieldName );
-
-        switch ( guid_data->options )
+        ts = date_data->date;
+        ts.tv_sec -= DATE_RANGE_SLOP;
+        datebuf = gnc_sql_convert_timespec_to_string( be, ts );
+        if ( ts.tv_sec <= 0 )
         {
-        case QOF_GUID_MATCH_ANY:
-            if ( isInverted ) g_string_append( sql, " NOT IN (" );
-            else g_string_append( sql, " IN (" );
-            break;
-
-        case QOF_GUID_MATCH_NONE:
-            if ( isInverted ) g_string_append( sql, " IN (" );
-            else g_string_append( sql, " NOT IN (" );
-            break;
-
-        default:
-            PERR( "Unexpected GncGUID match type: %d\n", guid_data->options );
+            g_string_append_printf( sql, "(%s IS NULL OR %s >= '%s')", field, field, datebuf );
         }
-
-        for ( guid_entry = guid_data->guids; guid_entry != NULL; guid_entry = guid_entry->next )
+        else
         {
-            gchar guid_buf[GUID_ENCODING_LENGTH+1];
-
-            if ( guid_entry != guid_data->guids ) g_string_append( sql, "," );
-            (void)guid_to_string_buff( guid_entry->data, guid_buf );
-            g_string_append_printf( sql, "'%s'", guid_buf );
+            g_string_append_printf( sql, "%s >= '%s'", field, datebuf );
         }
-        g_string_append( sql, "))" );
+        g_free( datebuf );
+    }
+    if ( has_end )
+    {
+        ts = date_data->date;
+        ts.tv_sec += DATE_RANGE_SLOP;
+        datebuf = gnc_sql_convert_timespec_to_string( be, ts );
+        g_string_append_printf( sql, "%s(%s IS NULL OR %s <= '%s')",
+                                has_start ? " AND " : "", field, field, datebuf );
+        g_free( datebuf );
+    }
+    return TERM_WIDER;
+}
 
+static term_translation_t
+translate_numeric_term( const gchar* num_field, const gchar* denom_field,
+                        query_numeric_t numeric_data, gboolean isInverted, GString* sql )
+{
+    QofQueryCompare how = numeric_data->pd.how;
+    gdouble amount = gnc_numeric_to_double( numeric_data->amount );
+    gchar low[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar high[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar* value;
+    const gchar* sep = "";
+
+    if ( isInverted ) return TERM_NOT_TRANSLATED;
+
+    /* Credits and debits are split values <= 0 and >= 0, while amounts are
+       compared with the absolute split value. */
+    value = g_strdup_printf( "(1.0*%s/NULLIF(%s,0))", num_field, denom_field );
+    if ( numeric_data->options == QOF_NUMERIC_MATCH_CREDIT )
+    {
+        g_string_append_printf( sql, "%s <= 0", value );
+        sep = " AND ";
     }
-    else if ( safe_strcmp( pPredData->type_name, QOF_TYPE_CHAR ) == 0 )
+    else if ( numeric_data->options == QOF_NUMERIC_MATCH_DEBIT )
     {
-        query_char_t char_data = (query_char_t)pPredData;
-        int i;
+        g_string_append_printf( sql, "%s >= 0", value );
+        sep = " AND ";
+    }
 
-        if ( isInverted )
-        {
-            g_string_append( sql, "NOT(" );
-        }
-        if ( char_data->options == QOF_CHAR_MATCH_NONE )
+    if ( how == QOF_COMPARE_EQUAL && amount < 0 ) amount = -amount;
+    (void)g_ascii_dtostr( low, sizeof(low), amount - AMOUNT_SLOP );
+    (void)g_ascii_dtostr( high, sizeof(high), amount + AMOUNT_SLOP );
+    switch ( how )
+    {
+    case QOF_COMPARE_LT:
+    case QOF_COMPARE_LTE:
+        g_string_append_printf( sql, "%sABS(%s) <= %s", sep, value, high );
+        sep = " AND ";
+        break;
+    case QOF_COMPARE_GT:
+    case QOF_COMPARE_GTE:
+        g_string_append_printf( sql, "%sABS(%s) >= %s", sep, value, low );
+        sep = " AND ";
+        break;
+    case QOF_COMPARE_EQUAL:
+        g_string_append_printf( sql, "%sABS(%s) >= %s AND ABS(%s) <= %s",
+                                sep, value, low, value, high );
+        sep = " AND ";
+        break;
+    default:
+        break;
+    }
+    g_free( value );
+
+    return *sep != '\0' ? TERM_WIDER : TERM_NOT_TRANSLATED;
+}
+
+/* Appends a character to a LIKE pattern which uses '!' as its escape. */
+static void
+append_like_char( GString* pattern, gchar c )
+{
+    if ( c == '%' || c == '_' || c == '!' )
+    {
+        g_string_append_c( pattern, '!' );
+    }
+    g_string_append_c( pattern, c );
+}
+
+/* Converts a regular expression which only matches a literal string,
+   optionally anchored and with '.' wildcards, into a LIKE pattern which
+   matches at least the same strings.  Returns NULL for anything else. */
+static /*@ null @*/ gchar*
+regex_to_like_pattern( const gchar* regex )
+{
+    GString* pattern = g_string_new( "" );
+    const gchar* p = regex;
+    gboolean has_literal = FALSE;
+
+    if ( *p == '^' )
+    {
+        p++;
+    }
+    else
+    {
+        g_string_append_c( pattern, '%' );
+    }
+    for ( ; *p != '\0' && !( *p == '$' && p[1] == '\0' ); p++ )
+    {
+        if ( *p == '.' )
         {
-            g_string_append( sql, "NOT " );
+            /* '.' may match a byte of a multibyte character, so don't
+               count characters */
+            g_string_append_c( pattern, '%' );
         }
-        g_string_append( sql, "(" );
-        for ( i = 0; char_data->char_list[i] != '\0'; i++ )
+        else if ( strchr( "^$[](){}*+?|\\", *p ) != NULL )
         {
-            if ( i != 0 )
-            {
-                g_string_append( sql, " OR " );
-            }
-            g_string_append( sql, fieldName );
-            g_string_append( sql, " = '" );
-            g_string_append_c( sql, char_data->char_list[i] );
-            g_string_append( sql, "'" );
+            (void)g_string_free( pattern, TRUE );
+            return NULL;
         }
-        g_string_append( sql, ") " );
-        if ( isInverted )
+        else
         {
-            g_string_append( sql, ") " );
+            append_like_char( pattern, *p );
+            has_literal = TRUE;
         }
+    }
+    if ( *p == '\0' )
+    {
+        g_string_append_c( pattern, '%' );
+    }
+
+    /* Otherwise an empty string, which is what the engine uses for a
+       missing one, could match */
+    if ( !has_literal )
+    {
+        (void)g_string_free( pattern, TRUE );
+        return NULL;
+    }
+    return g_string_free( pattern, FALSE );
+}
+
+static term_translation_t
+translate_string_term( const gchar* field, query_string_t string_data,
+                       gboolean isInverted, GString* sql )
+{
+    const gchar* str = string_data->matchstring;
+    gchar* pattern;
 
+    if ( isInverted || string_data->pd.how != QOF_COMPARE_EQUAL ) return TERM_NOT_TRANSLATED;
+    if ( !is_plain_sql_string( str ) || *str == '\0' ) return TERM_NOT_TRANSLATED;
+
+    if ( string_data->is_regex )
+    {
+        pattern = regex_to_like_pattern( str );
+        if ( pattern == NULL ) return TERM_NOT_TRANSLATED;
     }
-    else if ( safe_strcmp( pPredData->type_name, QOF_TYPE_STRING ) == 0 )
+    else
     {
-        query_string_t string_data = (query_string_t)pPredData;
-        sqlEscape* escape = sqlEscape_new();
+        GString* buf = g_string_new( "%" );
 
-        if ( isInverted )
+        for ( ; *str != '\0'; str++ )
         {
-            g_string_append( sql, "NOT(" );
+            append_like_char( buf, *str );
         }
-        if ( pPredData->how == QOF_COMPARE_NEQ )
-        {
-            g_string_append( sql, "NOT(" );
-        }
-        g_string_append( sql, fieldName );
-        if ( string_data->is_regex || string_data->options == QOF_STRING_MATCH_CASEINSENSITIVE )
+        g_string_append_c( buf, '%' );
+        pattern = g_string_free( buf, FALSE );
+    }
+
+    /* LIKE ignores case for some databases and not others, so a case
+       sensitive match is at worst wider.  For a case insensitive one both
+       sides are lowered, which only agrees with the engine's UTF-8 case
+       folding for ASCII. */
+    if ( string_data->options == QOF_STRING_MATCH_CASEINSENSITIVE )
+    {
+        gchar* lower;
+
+        if ( !is_ascii_string( pattern ) )
         {
-            PWARN( "String is_regex || option = QOF_STRING_MATCH_INSENSITIVE\n" );
+            g_free( pattern );
+            return TERM_NOT_TRANSLATED;
         }
-//			g_string_append( sql, " ~" );
-//		} else {
-        g_string_append( sql, " =" );
-//		}
-//		if( string_data->options == QOF_STRING_MATCH_CASEINSENSITIVE ) {
-//			g_string_append( sql, "*" );
-//		}
-        g_string_append( sql, "'" );
-        g_string_append( sql, sqlEscapeString( escape, string_data->matchstring ) );
-        g_string_append( sql, "'" );
-        if ( pPredData->how == QOF_COMPARE_NEQ )
+        lower = g_ascii_strdown( pattern, -1 );
+        g_string_append_printf( sql, "LOWER(%s) LIKE '%s' ESCAPE '!'", field, lower );
+        g_free( lower );
+    }
+    else
+    {
+        g_string_append_printf( sql, "%s LIKE '%s' ESCAPE '!'", field, pattern );
+    }
+    g_free( pattern );
+    return TERM_WIDER;
+}
+
+/* KVP terms become a lookup in the slots table.  Nested frames are stored
+   under guids of their own, so only top level slots are looked up. */
+static term_translation_t
+translate_kvp_term( const gchar* guid_field, query_kvp_t kvp_data,
+                    gboolean isInverted, GString* sql )
+{
+    QofQueryCompare how = kvp_data->pd.how;
+    const gchar* op = comparison_to_sql( how );
+    KvpValue* value = kvp_data->value;
+    term_translation_t translation = TERM_EXACT;
+    const gchar* name;
+    GString* cond;
+
+    if ( isInverted || op == NULL || value == NULL ) return TERM_NOT_TRANSLATED;
+    if ( kvp_data->path == NULL || kvp_data->path->next != NULL ) return TERM_NOT_TRANSLATED;
+    name = kvp_data->path->data;
+    if ( !is_plain_sql_string( name ) ) return TERM_NOT_TRANSLATED;
+
+    cond = g_string_new( "" );
+    switch ( kvp_value_get_type( value ) )
+    {
+    case KVP_TYPE_GINT64:
+        g_string_append_printf( cond, "sl.int64_val %s %" G_GINT64_FORMAT,
+                                op, kvp_value_get_gint64( value ) );
+        break;
+
+    case KVP_TYPE_GUID:
+        if ( how == QOF_COMPARE_EQUAL || how == QOF_COMPARE_NEQ )
         {
-            g_string_append( sql, ")" );
+            gchar guid_buf[GUID_ENCODING_LENGTH+1];
+
+            (void)guid_to_string_buff( kvp_value_get_guid( value ), guid_buf );
+            g_string_append_printf( cond, "sl.guid_val %s '%s'", op, guid_buf );
         }
-        if ( isInverted )
+        break;
+
+    case KVP_TYPE_STRING:
+        /* The column's collation may ignore case */
+        if ( how == QOF_COMPARE_EQUAL && is_plain_sql_string( kvp_value_get_string( value ) ) )
         {
-            g_string_append( sql, ")" );
+            g_string_append_printf( cond, "sl.string_val = '%s'", kvp_value_get_string( value ) );
+            translation = TERM_WIDER;
         }
-        sqlEscape_destroy( escape );
+        break;
 
+    default:
+        break;
     }
-    else
+
+    if ( cond->len == 0 )
     {
-        g_string_append( sql, "(" );
-        g_string_append( sql, fieldName );
-        convert_query_comparison_to_sql( pPredData, isInverted, sql );
+        (void)g_string_free( cond, TRUE );
+        return TERM_NOT_TRANSLATED;
+    }
+    g_string_append_printf( sql,
+                            "EXISTS (SELECT 1 FROM %s AS sl WHERE sl.obj_guid=%s AND sl.name='%s' AND sl.slot_type=%d AND %s)",
+                            SLOT_TABLE, guid_field, name, (gint)kvp_value_get_type( value ), cond->str );
+    (void)g_string_free( cond, TRUE );
+    return translation;
+}
 
-        if ( strcmp( pPredData->type_name, QOF_TYPE_NUMERIC ) == 0 )
-        {
-            query_numeric_t pData = (query_numeric_t)pPredData;
-            double d = gnc_numeric_to_double( pData->amount );
+/**
+ * Appends a condition on s and t for a split query term.
+ *
+ * @param be SQL backend
+ * @param term Query term
+ * @param sql String to append the condition to
+ * @return How well the condition matches the term
+ */
+static term_translation_t
+translate_term( const GncSqlBackend* be, QofQueryTerm* term, GString* sql )
+{
+    GSList* path = qof_query_term_get_param_path( term );
+    QofQueryPredData* pPredData = qof_query_term_get_pred_data( term );
+    gboolean isInverted = qof_query_term_is_inverted( term );
+    const gchar* type = pPredData->type_name;
 
-            g_string_append_printf( sql, "%f", d );
+    if ( is_own_book_term( be, term ) ) return TERM_EXACT;
 
-        }
-        else if ( safe_strcmp( pPredData->type_name, QOF_TYPE_DATE ) == 0 )
-        {
-            query_date_t date_data = (query_date_t)pPredData;
-            gchar* datebuf;
+    if ( safe_strcmp( type, QOF_TYPE_GUID ) == 0 )
+    {
+        const gchar* field;
 
-            datebuf = gnc_sql_convert_timespec_to_string( be, date_data->date );
-            g_string_append_printf( sql, "'%s'", datebuf );
+        if ( param_path_is( path, SPLIT_ACCOUNT, QOF_PARAM_GUID ) ) field = "s.account_guid";
+        else if ( param_path_is( path, QOF_PARAM_GUID, NULL ) ) field = "s.guid";
+        else if ( param_path_is( path, SPLIT_TRANS, QOF_PARAM_GUID ) ) field = "t.guid";
+        else if ( param_path_is( path, SPLIT_LOT, QOF_PARAM_GUID ) ) field = "s.lot_guid";
+        else return TERM_NOT_TRANSLATED;
 
-        }
-        else if ( strcmp( pPredData->type_name, QOF_TYPE_INT32 ) == 0 )
-        {
-            query_int32_t pData = (query_int32_t)pPredData;
+        return translate_guid_term( field, (query_guid_t)pPredData, isInverted, sql );
+    }
+    else if ( safe_strcmp( type, QOF_TYPE_CHAR ) == 0 )
+    {
+        if ( !param_path_is( path, SPLIT_RECONCILE, NULL ) ) return TERM_NOT_TRANSLATED;
 
-            g_string_append_printf( sql, "%d", pData->val );
+        return translate_char_term( "s.reconcile_state", (query_char_t)pPredData, isInverted, sql );
+    }
+    else if ( safe_strcmp( type, QOF_TYPE_DATE ) == 0 )
+    {
+        const gchar* field;
+
+        if ( param_path_is( path, SPLIT_TRANS, TRANS_DATE_POSTED ) ) field = "t.post_date";
+        else if ( param_path_is( path, SPLIT_TRANS, TRANS_DATE_ENTERED ) ) field = "t.enter_date";
+        else if ( param_path_is( path, SPLIT_DATE_RECONCILED, NULL ) ) field = "s.reconcile_date";
+        else return TERM_NOT_TRANSLATED;
 
+        return translate_date_term( be, field, (query_date_t)pPredData, isInverted, sql );
+    }
+    else if ( safe_strcmp( type, QOF_TYPE_NUMERIC ) == 0 )
+    {
+        if ( param_path_is( path, SPLIT_VALUE, NULL ) )
+        {
+            return translate_numeric_term( "s.value_num", "s.value_denom",
+                                           (query_numeric_t)pPredData, isInverted, sql );
         }
-        else if ( strcmp( pPredData->type_name, QOF_TYPE_INT64 ) == 0 )
+        if ( param_path_is( path, SPLIT_AMOUNT, NULL ) )
         {
-            query_int64_t pData = (query_int64_t)pPredData;
+            return translate_numeric_term( "s.quantity_num", "s.quantity_denom",
+                                           (query_numeric_t)pPredData, isInverted, sql );
+        }
+        return TERM_NOT_TRANSLATED;
+    }
+    else if ( safe_strcmp( type, QOF_TYPE_STRING ) == 0 )
+    {
+        const gchar* field;
 
-            g_string_append_printf( sql, "%" G_GINT64_FORMAT, pData->val );
+        if ( param_path_is( path, SPLIT_MEMO, NULL ) ) field = "s.memo";
+        else if ( param_path_is( path, SPLIT_ACTION, NULL ) ) field = "s.action";
+        else if ( param_path_is( path, SPLIT_TRANS, TRANS_DESCRIPTION ) ) field = "t.description";
+        else if ( param_path_is( path, SPLIT_TRANS, TRANS_NUM ) ) field = "t.num";
+        else return TERM_NOT_TRANSLATED;
 
-        }
-        else if ( strcmp( pPredData->type_name, QOF_TYPE_DOUBLE ) == 0 )
-        {
-            query_double_t pData = (query_double_t)pPredData;
+        return translate_string_term( field, (query_string_t)pPredData, isInverted, sql );
+    }
+    else if ( safe_strcmp( type, QOF_TYPE_KVP ) == 0 )
+    {
+        const gchar* field;
 
-            g_string_append_printf( sql, "%f", pData->val );
+        if ( param_path_is( path, SPLIT_KVP, NULL ) ) field = "s.guid";
+        else if ( param_path_is( path, SPLIT_TRANS, TRANS_KVP ) ) field = "t.guid";
+        else if ( param_path_is( path, SPLIT_ACCOUNT, ACCOUNT_KVP ) ) field = "s.account_guid";
+        else return TERM_NOT_TRANSLATED;
 
-        }
-        else if ( strcmp( pPredData->type_name, QOF_TYPE_BOOLEAN ) == 0 )
-        {
-            query_boolean_t pData = (query_boolean_t)pPredData;
+        return translate_kvp_term( field, (query_kvp_t)pPredData, isInverted, sql );
+    }
 
-            g_string_append_printf( sql, "%d", pData->val );
+    return TERM_NOT_TRANSLATED;
+}
 
-        }
-        else
+/* Returns the accounts of a query which selects splits only by account, or
+   NULL for any other query. */
+static /*@ null @*/ GList*
+get_query_accounts( const GncSqlBackend* be, GList* orterms )
+{
+    GList* accounts = NULL;
+    GList* orTerm;
+
+    for ( orTerm = orterms; orTerm != NULL; orTerm = orTerm->next )
+    {
+        GList* andTerm;
+        gboolean has_account_term = FALSE;
+
+        for ( andTerm = (GList*)orTerm->data; andTerm != NULL; andTerm = andTerm->next )
         {
-            PERR( "Unknown query predicate type: %s\n", pPredData->type_name );
+            QofQueryTerm* term = (QofQueryTerm*)andTerm->data;
+            QofQueryPredData* pPredData = qof_query_term_get_pred_data( term );
+            GList* node;
+
+            if ( is_own_book_term( be, term ) ) continue;
+            if ( !param_path_is( qof_query_term_get_param_path( term ), SPLIT_ACCOUNT, QOF_PARAM_GUID )
+                    || safe_strcmp( pPredData->type_name, QOF_TYPE_GUID ) != 0
+                    || qof_query_term_is_inverted( term )
+                    || ((query_guid_t)pPredData)->options != QOF_GUID_MATCH_ANY )
+            {
+                g_list_foreach( accounts, (GFunc)guid_free, NULL );
+                g_list_free( accounts );
+                return NULL;
+            }
+
+            for ( node = ((query_guid_t)pPredData)->guids; node != NULL; node = node->next )
+            {
+                accounts = g_list_prepend( accounts, guid_malloc() );
+                *(GncGUID*)accounts->data = *(GncGUID*)node->data;
+            }
+            has_account_term = TRUE;
         }
 
-        g_string_append( sql, ")" );
+        if ( !has_account_term )
+        {
+            g_list_foreach( accounts, (GFunc)guid_free, NULL );
+            g_list_free( accounts );
+            return NULL;
+        }
     }
+
+    return accounts;
 }
 
-typedef struct
+/* Returns TRUE if the engine sorts the query's splits by increasing date
+   posted before anything else, and so keeps the latest ones when it limits
+   the number of results. */
+static gboolean
+keeps_latest_splits( QofQuery* query )
 {
-    GncSqlStatement* stmt;
-    gboolean has_been_run;
-} split_query_info_t;
+    QofQuerySort* primary = NULL;
+    GSList* path;
+
+    qof_query_get_sorts( query, &primary, NULL, NULL );
+    if ( primary == NULL || !qof_query_sort_get_increasing( primary ) ) return FALSE;
+
+    /* The default split order starts with the transaction order, which
+       starts with the date posted */
+    path = qof_query_sort_get_param_path( primary );
+    return param_path_is( path, QUERY_DEFAULT_SORT, NULL )
+           || param_path_is( path, SPLIT_TRANS, TRANS_DATE_POSTED );
+}
 
 static /*@ null @*/ gpointer
 compile_split_query( GncSqlBackend* be, QofQuery* query )
 {
-    const GncGUID* acct_guid;
-    gchar guid_buf[GUID_ENCODING_LENGTH+1];
     split_query_info_t* query_info = NULL;
-    gchar* query_sql;
+    GList* orterms;
+    GList* orTerm;
+    GString* where;
+    gboolean is_restricted = TRUE;
+    gint max_results;
 
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( query != NULL, NULL );
 
-    query_info = g_malloc( (gsize)sizeof(split_query_info_t) );
+    query_info = g_new0( split_query_info_t, 1 );
     g_assert( query_info != NULL );
-    query_info->has_been_run = FALSE;
 
-    if ( qof_query_has_terms( query ) )
+    query_info->max_results = -1;
+    max_results = qof_query_get_max_results( query );
+    if ( max_results == 0 )
     {
-        GList* orterms = qof_query_get_terms( query );
-        GList* orTerm;
-        GString* sql = g_string_new( "" );
-        gboolean need_OR = FALSE;
-
-        for ( orTerm = orterms; orTerm != NULL; orTerm = orTerm->next )
-        {
-            GList* andterms = (GList*)orTerm->data;
-            GList* andTerm;
-            gboolean need_AND = FALSE;
-            gboolean has_tx_guid_check = FALSE;
-
-            if ( need_OR )
-            {
-                g_string_append( sql, " OR " );
-            }
-            g_string_append( sql, "(" );
-            for ( andTerm = andterms; andTerm != NULL; andTerm = andTerm->next )
-            {
-                QofQueryTerm* term;
-                GSList* paramPath;
-                gboolean unknownPath = FALSE;
-
-                term = (QofQueryTerm*)andTerm->data;
-                paramPath = qof_query_term_get_param_path( term );
-
-                if ( strcmp( paramPath->data, QOF_PARAM_BOOK ) == 0 ) continue;
-
-#if SIMPLE_QUERY_COMPILATION
-                if ( strcmp( paramPath->data, SPLIT_ACCOUNT ) != 0
-                        || strcmp( paramPath->next->data, QOF_PARAM_GUID ) != 0 ) continue;
-#endif
-
-                if ( need_AND ) g_string_append( sql, " AND " );
-
-                if ( strcmp( paramPath->data, SPLIT_ACCOUNT ) == 0
-                        && strcmp( paramPath->next->data, QOF_PARAM_GUID ) == 0 )
-                {
-                    convert_query_term_to_sql( be, "s.account_guid", term, sql );
-#if SIMPLE_QUERY_COMPILATION
-                    goto done_compiling_query;
-#endif
-
-                }
-                else if ( strcmp( paramPath->data, SPLIT_RECONCILE ) == 0 )
-                {
-                    convert_query_term_to_sql( be, "s.reconcile_state", term, sql );
+        /* The engine will discard everything anyway */
+        query_info->max_results = 0;
+        return query_info;
+    }
 
-                }
-                else if ( strcmp( paramPath->data, SPLIT_TRANS ) == 0 )
-                {
-#if 0
-                    if ( !has_tx_guid_check )
-                    {
-                        g_string_append( sql, "(splits.tx_guid = transactions.guid) AND " );
-                        has_tx_guid_check = TRUE;
-                    }
-#endif
-                    if ( strcmp( paramPath->next->data, TRANS_DATE_POSTED ) == 0 )
-                    {
-                        convert_query_term_to_sql( be, "t.post_date", term, sql );
-                    }
-                    else if ( strcmp( paramPath->next->data, TRANS_DESCRIPTION ) == 0 )
-                    {
-                        convert_query_term_to_sql( be, "t.description", term, sql );
-                    }
-                    else
-                    {
-                        unknownPath = TRUE;
-                    }
+    if ( safe_strcmp( qof_query_get_search_for( query ), GNC_ID_SPLIT ) != 0 )
+    {
+        return query_info;
+    }
 
-                }
-                else if ( strcmp( paramPath->data, SPLIT_VALUE ) == 0 )
-                {
-                    convert_query_term_to_sql( be, "s.value_num/s.value_denom", term, sql );
+    orterms = qof_query_get_terms( query );
+    query_info->accounts = get_query_accounts( be, orterms );
+    query_info->is_exact = TRUE;
 
-                }
-                else
-                {
-                    unknownPath = TRUE;
-                }
+    where = g_string_new( "" );
+    for ( orTerm = orterms; orTerm != NULL; orTerm = orTerm->next )
+    {
+        GString* clause = g_string_new( "" );
+        GList* andTerm;
 
-                if ( unknownPath )
-                {
-                    GString* name = g_string_new( (gchar*)paramPath->data );
-                    while ( paramPath->next != NULL )
-                    {
-                        g_string_append( name, "." );
-                        g_string_append( name, paramPath->next->data );
-                        paramPath = paramPath->next;
-                    }
-                    PERR( "Unknown SPLIT query field: %s\n", name->str );
-                    g_string_free( name, TRUE );
-                }
-                need_AND = TRUE;
-            }
+        for ( andTerm = (GList*)orTerm->data; andTerm != NULL; andTerm = andTerm->next )
+        {
+            GString* cond = g_string_new( "" );
 
-            /* If the last char in the string is a '(', then for some reason, there were
-               no terms added to the SQL.  If so, remove it and ignore the OR term. */
-            if ( sql->str[sql->len-1] == '(' )
+            if ( translate_term( be, (QofQueryTerm*)andTerm->data, cond ) != TERM_EXACT )
             {
-                g_string_truncate( sql, sql->len - 1 );
-                need_OR = FALSE;
+                query_info->is_exact = FALSE;
             }
-            else
+            if ( cond->len > 0 )
             {
-                g_string_append( sql, ")" );
-                need_OR = TRUE;
+                g_string_append_printf( clause, "%s(%s)", clause->len > 0 ? " AND " : "", cond->str );
             }
+            (void)g_string_free( cond, TRUE );
         }
 
-#if SIMPLE_QUERY_COMPILATION
-done_compiling_query:
-#endif
-        if ( sql->len != 0 )
+        /* A clause without a condition could match any split */
+        if ( clause->len == 0 )
         {
-#if SIMPLE_QUERY_COMPILATION
-            g_string_append( sql, ")" );
-#endif
-            query_sql = g_strdup_printf(
-                            "SELECT DISTINCT t.* FROM %s AS t, %s AS s WHERE s.tx_guid=t.guid AND %s",
-                            TRANSACTION_TABLE, SPLIT_TABLE, sql->str );
+            is_restricted = FALSE;
         }
         else
         {
-            query_sql = g_strdup_printf( "SELECT * FROM %s", TRANSACTION_TABLE );
+            g_string_append_printf( where, "%s(%s)", where->len > 0 ? " OR " : "", clause->str );
         }
-        query_info->stmt = gnc_sql_create_statement_from_sql( be, query_sql );
-
-        g_string_free( sql, TRUE );
-        g_free( query_sql );
-
+        (void)g_string_free( clause, TRUE );
+    }
+    if ( is_restricted && where->len > 0 )
+    {
+        query_info->where = g_string_free( where, FALSE );
     }
     else
     {
-        query_sql = g_strdup_printf( "SELECT * FROM %s", TRANSACTION_TABLE );
-        query_info->stmt = gnc_sql_create_statement_from_sql( be, query_sql );
-        g_free( query_sql );
+        (void)g_string_free( where, TRUE );
+    }
+
+    /* The latest splits can only be found in SQL if the condition matches
+       exactly the splits which the engine will count */
+    if ( max_results > 0 && query_info->is_exact && keeps_latest_splits( query ) )
+    {
+        query_info->max_results = max_results;
     }
 
     return query_info;
 }
 
+/* Loads the transactions of the accounts which haven't been loaded yet. */
+static void
+load_tx_for_accounts( GncSqlBackend* be, GList* account_guids )
+{
+    GList* accounts = NULL;
+    GList* node;
+    GString* sql;
+    GncSqlStatement* stmt;
+
+    for ( node = account_guids; node != NULL; node = node->next )
+    {
+        if ( !account_is_loaded( be, node->data ) )
+        {
+            accounts = g_list_prepend( accounts, node->data );
+        }
+    }
+    if ( accounts == NULL ) return;
+
+    sql = g_string_new( "" );
+    g_string_append_printf( sql,
+                            "SELECT DISTINCT t.* FROM %s AS t, %s AS s WHERE s.tx_guid=t.guid AND s.account_guid IN (",
+                            TRANSACTION_TABLE, SPLIT_TABLE );
+    append_guid_list( sql, accounts );
+    g_string_append( sql, ")" );
+
+    stmt = gnc_sql_create_statement_from_sql( be, sql->str );
+    (void)g_string_free( sql, TRUE );
+    if ( stmt != NULL )
+    {
+        query_transactions( be, stmt );
+        gnc_sql_statement_dispose( stmt );
+
+        for ( node = accounts; node != NULL; node = node->next )
+        {
+            mark_account_loaded( be, node->data );
+        }
+    }
+    g_list_free( accounts );
+}
+
+static void
+set_latest_date( gpointer pObject, Timespec ts )
+{
+    *(Timespec*)pObject = ts;
+}
+
+static const GncSqlColumnTableEntry latest_date_col_table[] =
+{
+    /*@ -full_init_block @*/
+    { "post_date", CT_TIMESPEC, 0, 0, NULL, NULL, NULL, (QofSetterFunc)set_latest_date },
+    { NULL }
+    /*@ +full_init_block @*/
+};
+
+/* Limits a load to the transactions posted no earlier than the
+   max_results'th latest matching split, less a day for the engine's own
+   date comparisons.  A split without a posted date is the earliest to the
+   engine, so it only matters if fewer splits match than are kept, and
+   then nothing is limited. */
+static void
+append_latest_date_bound( GncSqlBackend* be, const split_query_info_t* query_info, GString* sql )
+{
+    gchar* bound_sql;
+    GncSqlResult* result;
+    GncSqlRow* row;
+    Timespec bound = { 0, 0 };
+    gboolean has_bound = FALSE;
+    gchar* datebuf;
+
+    bound_sql = g_strdup_printf( "SELECT t.post_date FROM %s AS t, %s AS s WHERE s.tx_guid=t.guid AND t.post_date IS NOT NULL%s%s%s ORDER BY t.post_date DESC LIMIT 1 OFFSET %d",
+                                 TRANSACTION_TABLE, SPLIT_TABLE,
+                                 query_info->where != NULL ? " AND (" : "",
+                                 query_info->where != NULL ? query_info->where : "",
+                                 query_info->where != NULL ? ")" : "",
+                                 query_info->max_results - 1 );
+    result = gnc_sql_execute_select_sql( be, bound_sql );
+    g_free( bound_sql );
+    if ( result != NULL )
+    {
+        row = gnc_sql_result_get_first_row( result );
+        if ( row != NULL )
+        {
+            gnc_sql_load_object( be, row, NULL, &bound, latest_date_col_table );
+            has_bound = TRUE;
+        }
+        gnc_sql_result_dispose( result );
+    }
+    if ( !has_bound ) return;
+
+    bound.tv_sec -= DATE_RANGE_SLOP;
+    datebuf = gnc_sql_convert_timespec_to_string( be, bound );
+    g_string_append_printf( sql, " AND t.post_date >= '%s'", datebuf );
+    g_free( datebuf );
+}
+
 static void
 run_split_query( GncSqlBackend* be, gpointer pQuery )
 {
     split_query_info_t* query_info = (split_query_info_t*)pQuery;
+    GString* sql;
+    GncSqlStatement* stmt;
 
     g_return_if_fail( be != NULL );
     g_return_if_fail( pQuery != NULL );
 
-    if ( !query_info->has_been_run )
+    if ( !be->load_tx_as_needed || be->all_tx_loaded ) return;
+    if ( query_info->has_been_run ) return;
+    query_info->has_been_run = TRUE;
+
+    if ( query_info->max_results == 0 ) return;
+
+    if ( query_info->max_results < 0 )
     {
-        query_transactions( be, query_info->stmt );
-        query_info->has_been_run = TRUE;
-        gnc_sql_statement_dispose( query_info->stmt );
-        query_info->stmt = NULL;
+        if ( query_info->accounts != NULL )
+        {
+            load_tx_for_accounts( be, query_info->accounts );
+            return;
+        }
+        if ( query_info->where == NULL )
+        {
+            gnc_sql_transaction_load_all_tx( be );
+            return;
+        }
+    }
+
+    sql = g_string_new( "" );
+    g_string_append_printf( sql, "SELECT DISTINCT t.* FROM %s AS t, %s AS s WHERE s.tx_guid=t.guid",
+                            TRANSACTION_TABLE, SPLIT_TABLE );
+    if ( query_info->where != NULL )
+    {
+        g_string_append_printf( sql, " AND (%s)", query_info->where );
+    }
+    if ( query_info->max_results > 0 )
+    {
+        append_latest_date_bound( be, query_info, sql );
+    }
+
+    stmt = gnc_sql_create_statement_from_sql( be, sql->str );
+    (void)g_string_free( sql, TRUE );
+    if ( stmt != NULL )
+    {
+        query_transactions( be, stmt );
+        gnc_sql_statement_dispose( stmt );
     }
 }
 
 static void
-free_split_query( GncSqlBackend* be, gpointer pQuery )
+free_split_query( GncSqlBackend* be, /*@ null @*/ gpointer pQuery )
 {
+    split_query_info_t* query_info = (split_query_info_t*)pQuery;
+
     g_return_if_fail( be != NULL );
-    g_return_if_fail( pQuery != NULL );
 
-    g_free( pQuery );
+    if ( query_info == NULL ) return;
+
+    g_list_foreach( query_info->accounts, (GFunc)guid_free, NULL );
+    g_list_free( query_info->accounts );
+    g_free( query_info->where );
+    g_free( query_info );
 }
 
 /* ----------------------------------------------------------------- */
@@ -1378,7 +1959,7 @@ load_single_acct_balances( const GncSqlBackend* be, GncSqlRow* row )
     g_return_val_if_fail( be != NULL, NULL );
     g_return_val_if_fail( row != NULL, NULL );
 
-    bal = g_malloc( (gsize)sizeof(single_acct_balance_t) );
+    bal = g_new0( single_acct_balance_t, 1 );
     g_assert( bal != NULL );
 
     bal->be = be;
@@ -1390,7 +1971,6 @@ load_single_acct_balances( const GncSqlBackend* be, GncSqlRow* row )
 /*@ null @*/ GSList*
 gnc_sql_get_account_balances_slist( GncSqlBackend* be )
 {
-#if LOAD_TRANSACTIONS_AS_NEEDED
     GncSqlResult* result;
     GncSqlStatement* stmt;
     gchar* buf;
@@ -1398,6 +1978,8 @@ gnc_sql_get_account_balances_slist( GncSqlBackend* be )
 
     g_return_val_if_fail( be != NULL, NULL );
 
+    if ( !be->load_tx_as_needed ) return NULL;
+
     buf = g_strdup_printf( "SELECT account_guid, reconcile_state, sum(quantity_num) as quantity_num, quantity_denom FROM %s GROUP BY account_guid, reconcile_state, quantity_denom ORDER BY account_guid, reconcile_state",
                            SPLIT_TABLE );
     stmt = gnc_sql_create_statement_from_sql( be, buf );
@@ -1417,15 +1999,11 @@ gnc_sql_get_account_balances_slist( GncSqlBackend* be )
 
             // Get the next reconcile state balance and merge with other balances
             single_bal = load_single_acct_balances( be, row );
-            if ( single_bal != NULL )
+            if ( single_bal != NULL && single_bal->acct != NULL )
             {
                 if ( bal != NULL && bal->acct != single_bal->acct )
                 {
-                    bal->cleared_balance = gnc_numeric_add( bal->cleared_balance, bal->reconciled_balance,
-                                                            GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                    bal->balance = gnc_numeric_add( bal->balance, bal->cleared_balance,
-                                                    GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                    bal_slist = g_slist_append( bal_slist, bal );
+                    bal_slist = g_slist_prepend( bal_slist, bal );
                     bal = NULL;
                 }
                 if ( bal == NULL )
@@ -1438,42 +2016,34 @@ gnc_sql_get_account_balances_slist( GncSqlBackend* be )
                     bal->cleared_balance = gnc_numeric_zero();
                     bal->reconciled_balance = gnc_numeric_zero();
                 }
-                if ( single_bal->reconcile_state == 'n' )
-                {
-                    bal->balance = gnc_numeric_add( bal->balance, single_bal->balance,
-                                                    GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-                }
-                else if ( single_bal->reconcile_state == 'c' )
+
+                // Same rules as xaccAccountRecomputeBalance()
+                bal->balance = gnc_numeric_add( bal->balance, single_bal->balance,
+                                                GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
+                if ( single_bal->reconcile_state != NREC )
                 {
                     bal->cleared_balance = gnc_numeric_add( bal->cleared_balance, single_bal->balance,
                                                             GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
                 }
-                else if ( single_bal->reconcile_state == 'y' )
+                if ( single_bal->reconcile_state == YREC || single_bal->reconcile_state == FREC )
                 {
                     bal->reconciled_balance = gnc_numeric_add( bal->reconciled_balance, single_bal->balance,
                                               GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
                 }
-                g_free( single_bal );
             }
+            g_free( single_bal );
             row = gnc_sql_result_get_next_row( result );
         }
 
         // Add the final balance
         if ( bal != NULL )
         {
-            bal->cleared_balance = gnc_numeric_add( bal->cleared_balance, bal->reconciled_balance,
-                                                    GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-            bal->balance = gnc_numeric_add( bal->balance, bal->cleared_balance,
-                                            GNC_DENOM_AUTO, GNC_HOW_DENOM_LCD );
-            bal_slist = g_slist_append( bal_slist, bal );
+            bal_slist = g_slist_prepend( bal_slist, bal );
         }
         gnc_sql_result_dispose( result );
     }
 
     return bal_slist;
-#else
-    return NULL;
-#endif
 }
 
 /* ----------------------------------------------------------------- */
@@ -1544,15 +2114,11 @@ gnc_sql_init_transaction_handler( void )
         GNC_SQL_BACKEND_VERSION,
         GNC_ID_TRANS,
         commit_transaction,          /* commit */
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        NULL,                        /* initial load */
-#else
-        gnc_sql_transaction_load_all_tx,
-#endif
+        load_initial_tx,             /* initial load */
         create_transaction_tables,   /* create tables */
-        NULL,                        /* compile_query */
-        NULL,                        /* run_query */
-        NULL,                        /* free_query */
+        compile_split_query,         /* compile_query */
+        run_split_query,             /* run_query */
+        free_split_query,            /* free_query */
         NULL                         /* write */
     };
     static GncSqlObjectBackend be_data_split =
@@ -1562,15 +2128,9 @@ gnc_sql_init_transaction_handler( void )
         commit_split,                /* commit */
         NULL,                        /* initial_load */
         NULL,                        /* create tables */
-#if LOAD_TRANSACTIONS_AS_NEEDED
-        compile_split_query,
-        run_split_query,
-        free_split_query,
-#else
-        NULL,                        /* compile_query */
-        NULL,                        /* run_query */
-        NULL,                        /* free_query */
-#endif
+        compile_split_query,         /* compile_query */
+        run_split_query,             /* run_query */
+        free_split_query,            /* free_query */
         NULL                         /* write */
     };
 
@@ -54,7 +54,8 @@ void gnc_sql_transaction_commit_splits( GncSqlBackend* be, Transaction* pTx );
 gboolean gnc_sql_save_transaction( GncSqlBackend* be, QofInstance* inst );
 
 /**
- * Loads all transactions which have splits for a specific account.
+ * Loads all transactions which have splits for a specific account.  If the
+ * transactions for this account have already been loaded, nothing is done.
  *
  * @param be SQL backend
  * @param account Account
@@ -62,11 +63,21 @@ gboolean gnc_sql_save_transaction( GncSqlBackend* be, QofInstance* inst );
 void gnc_sql_transaction_load_tx_for_account( GncSqlBackend* be, Account* account );
 
 /**
- * Loads all transactions.
+ * Loads all transactions, unless they have all been loaded already.
  *
  * @param be SQL backend
+ * @return TRUE if every transaction is now loaded
  */
-void gnc_sql_transaction_load_all_tx( GncSqlBackend* be );
+gboolean gnc_sql_transaction_load_all_tx( GncSqlBackend* be );
+
+/**
+ * Forgets which accounts have had their transactions loaded, so that
+ * later queries read them from the db again.  Called when a book is
+ * opened or closed.
+ *
+ * @param be SQL backend
+ */
+void gnc_sql_transaction_forget_loaded( GncSqlBackend* be );
 
 typedef struct
 {
@@ -78,7 +89,9 @@ typedef struct
 
 /**
  * Returns a list of acct_balances_t structures, one for each account which
- * has splits.
+ * has splits.  Only used when transactions are loaded as needed, to give
+ * the accounts their balances before any of their splits are loaded;
+ * otherwise NULL is returned.
  *
  * @param be SQL backend
  * @return GSList of acct_balances_t structures
@@ -140,6 +140,156 @@ price_parse_xml_sub_node(GNCPrice *p, xmlNodePtr sub_node, QofBook *book)
     return TRUE;
 }
 
+/* Loading through the pipeline (see io-gncxml-pipeline.h): a loader
+ * thread decodes the price into a price_record, and the price is
+ * created from it on the main thread.  The commodities are looked up
+ * there too. */
+
+typedef struct
+{
+    GncGUID *id;
+    xmlNodePtr commodity;
+    xmlNodePtr currency;
+    Timespec time;
+    gboolean has_time;
+    gchar *source;
+    gchar *type;
+    gnc_numeric *value;
+    gboolean ok;
+} price_record;
+
+static void
+price_record_free(price_record *rec)
+{
+    g_free(rec->id);
+    g_free(rec->source);
+    g_free(rec->type);
+    g_free(rec->value);
+    g_slice_free(price_record, rec);
+}
+
+static gboolean
+price_record_sub_node(price_record *rec, xmlNodePtr sub_node)
+{
+    if (safe_strcmp("price:id", (char*)sub_node->name) == 0)
+    {
+        rec->id = dom_tree_to_guid(sub_node);
+        if (!rec->id) return FALSE;
+    }
+    else if (safe_strcmp("price:commodity", (char*)sub_node->name) == 0)
+    {
+        rec->commodity = sub_node;
+    }
+    else if (safe_strcmp("price:currency", (char*)sub_node->name) == 0)
+    {
+        rec->currency = sub_node;
+    }
+    else if (safe_strcmp("price:time", (char*)sub_node->name) == 0)
+    {
+        rec->time = dom_tree_to_timespec(sub_node);
+        if (!dom_tree_valid_timespec(&rec->time, sub_node->name)) return FALSE;
+        rec->has_time = TRUE;
+    }
+    else if (safe_strcmp("price:source", (char*)sub_node->name) == 0)
+    {
+        rec->source = dom_tree_to_text(sub_node);
+        if (!rec->source) return FALSE;
+    }
+    else if (safe_strcmp("price:type", (char*)sub_node->name) == 0)
+    {
+        rec->type = dom_tree_to_text(sub_node);
+        if (!rec->type) return FALSE;
+    }
+    else if (safe_strcmp("price:value", (char*)sub_node->name) == 0)
+    {
+        rec->value = dom_tree_to_gnc_numeric(sub_node);
+        if (!rec->value) return FALSE;
+    }
+    return TRUE;
+}
+
+/* Runs on a loader thread. */
+static gpointer
+dom_tree_to_price_record(gpointer data)
+{
+    xmlNodePtr price_xml = data;
+    price_record *rec = g_slice_new0(price_record);
+    xmlNodePtr child;
+
+    rec->ok = TRUE;
+    for (child = price_xml->xmlChildrenNode; child && rec->ok;
+            child = child->next)
+    {
+        switch (child->type)
+        {
+        case XML_COMMENT_NODE:
+        case XML_TEXT_NODE:
+            break;
+        case XML_ELEMENT_NODE:
+            rec->ok = price_record_sub_node(rec, child);
+            break;
+        default:
+            PERR("Unknown node type (%d) while parsing gnc-price xml.", child->type);
+            rec->ok = FALSE;
+            break;
+        }
+    }
+    return rec;
+}
+
+/* Runs on the main thread, in file order. */
+static gboolean
+price_record_insert(gpointer record, gpointer data, gpointer global_data)
+{
+    price_record *rec = record;
+    gxpf_data *gdata = global_data;
+    QofBook *book = gdata->bookdata;
+    gnc_commodity *commodity = NULL, *currency = NULL;
+    GNCPrice *p;
+    gboolean ok = rec->ok;
+
+    if (ok && rec->commodity)
+    {
+        commodity = dom_tree_to_commodity_ref(rec->commodity, book);
+        ok = (commodity != NULL);
+    }
+    if (ok && rec->currency)
+    {
+        currency = dom_tree_to_commodity_ref(rec->currency, book);
+        ok = (currency != NULL);
+    }
+    if (!ok)
+    {
+        price_record_free(rec);
+        xmlFreeNode(data);
+        return FALSE;
+    }
+
+    p = gnc_price_create(book);
+    if (!p)
+    {
+        price_record_free(rec);
+        xmlFreeNode(data);
+        return FALSE;
+    }
+
+    gnc_price_begin_edit (p);
+    if (rec->id) gnc_price_set_guid(p, rec->id);
+    if (commodity) gnc_price_set_commodity(p, commodity);
+    if (currency) gnc_price_set_currency(p, currency);
+    if (rec->has_time) gnc_price_set_time(p, rec->time);
+    if (rec->source) gnc_price_set_source(p, rec->source);
+    if (rec->type) gnc_price_set_typestr(p, rec->type);
+    if (rec->value) gnc_price_set_value(p, *rec->value);
+    gnc_price_commit_edit (p);
+
+    gnc_pricedb_add_price(gnc_pricedb_get_db(book), p);
+    gnc_price_unref(p);
+    price_record_free(rec);
+    xmlFreeNode(data);
+    return TRUE;
+}
+
 static gboolean
 price_parse_xml_end_handler(gpointer data_for_children,
                             GSList* data_from_children,
@@ -178,6 +328,14 @@ price_parse_xml_end_handler(gpointer data_for_children,
         goto cleanup_and_exit;
     }
 
+    if (gdata->pipeline)
+    {
+        /* The price is added to the db by price_record_insert. */
+        return gnc_xml_pipeline_push(gdata->pipeline, price_xml,
+                                     dom_tree_to_price_record,
+                                     price_record_insert, gdata);
+    }
+
     p = gnc_price_create(book);
     if (!p)
     {
@@ -293,6 +451,10 @@ pricedb_after_child_handler(gpointer data_for_children,
     if (strcmp(child_result->tag, "price") == 0)
     {
         GNCPrice *p = (GNCPrice *) child_result->data;
+        gxpf_data *gdata = global_data;
+
+        /* Prices loaded through the pipeline are added later on. */
+        if (!p && gdata->pipeline) return TRUE;
 
         g_return_val_if_fail(p, FALSE);
         gnc_pricedb_add_price(db, p);
@@ -328,6 +490,7 @@ pricedb_v2_end_handler(
 {
     GNCPriceDB *db = *result;
     gxpf_data *gdata = (gxpf_data*)global_data;
+    gboolean ok = TRUE;
 
     if (parent_data)
     {
@@ -339,12 +502,16 @@ pricedb_v2_end_handler(
         return TRUE;
     }
 
+    /* All of the prices must be in the db before it is handed on. */
+    if (gdata->pipeline)
+        ok = gnc_xml_pipeline_flush(gdata->pipeline);
+
     gdata->cb(tag, gdata->parsedata, db);
     *result = NULL;
 
     gnc_pricedb_set_bulk_update(db, FALSE);
 
-    return TRUE;
+    return ok;
 }
 
 static sixtp*
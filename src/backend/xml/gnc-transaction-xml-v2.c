@@ -47,6 +47,8 @@
 #include "gnc-lot.h"
 #include "gnc-lot-p.h"
 
+static QofLogModule log_module = GNC_MOD_IO;
+
 const gchar *transaction_version_string = "2.0.0";
 
 static void
@@ -193,6 +195,108 @@ gnc_transaction_dom_tree_create(Transaction *trn)
     return ret;
 }
 
+/* The streaming equivalents of the above; the output must stay
+ * identical to dumping the tree gnc_transaction_dom_tree_create
+ * builds. */
+
+static void
+write_timespec(GncXmlWriter *writer, const gchar *tag, Timespec tms,
+               gboolean always)
+{
+    if (always || !((tms.tv_sec == 0) && (tms.tv_nsec == 0)))
+    {
+        gnc_xml_writer_timespec(writer, tag, &tms);
+    }
+}
+
+static void
+write_split(GncXmlWriter *writer, const gchar *tag, Split *spl)
+{
+    const char *memo = xaccSplitGetMemo(spl);
+    const char *action = xaccSplitGetAction(spl);
+    GNCLot *lot = xaccSplitGetLot(spl);
+    char tmp[2];
+
+    gnc_xml_writer_start(writer, tag);
+
+    gnc_xml_writer_guid(writer, "split:id", xaccSplitGetGUID(spl));
+
+    if (memo && safe_strcmp(memo, "") != 0)
+    {
+        gnc_xml_writer_text_element(writer, "split:memo", memo);
+    }
+
+    if (action && safe_strcmp(action, "") != 0)
+    {
+        gnc_xml_writer_text_element(writer, "split:action", action);
+    }
+
+    tmp[0] = xaccSplitGetReconcile(spl);
+    tmp[1] = '\0';
+    gnc_xml_writer_text_element(writer, "split:reconciled-state", tmp);
+
+    write_timespec(writer, "split:reconcile-date",
+                   xaccSplitRetDateReconciledTS(spl), FALSE);
+
+    gnc_xml_writer_numeric(writer, "split:value", xaccSplitGetValue(spl));
+
+    gnc_xml_writer_numeric(writer, "split:quantity", xaccSplitGetAmount(spl));
+
+    gnc_xml_writer_guid(writer, "split:account",
+                        xaccAccountGetGUID(xaccSplitGetAccount(spl)));
+
+    if (lot)
+    {
+        gnc_xml_writer_guid(writer, "split:lot", gnc_lot_get_guid(lot));
+    }
+
+    gnc_xml_writer_kvp_frame(writer, "split:slots", xaccSplitGetSlots(spl));
+
+    gnc_xml_writer_end(writer, tag);
+}
+
+void
+gnc_transaction_write(GncXmlWriter *writer, Transaction *trn)
+{
+    GList *n;
+
+    gnc_xml_writer_start(writer, "gnc:transaction");
+    gnc_xml_writer_attribute(writer, "version", transaction_version_string);
+
+    gnc_xml_writer_guid(writer, "trn:id", xaccTransGetGUID(trn));
+
+    gnc_xml_writer_commodity_ref(writer, "trn:currency",
+                                 xaccTransGetCurrency(trn));
+
+    if (xaccTransGetNum(trn) && (safe_strcmp(xaccTransGetNum(trn), "") != 0))
+    {
+        gnc_xml_writer_text_element(writer, "trn:num", xaccTransGetNum(trn));
+    }
+
+    write_timespec(writer, "trn:date-posted", xaccTransRetDatePostedTS(trn),
+                   TRUE);
+
+    write_timespec(writer, "trn:date-entered",
+                   xaccTransRetDateEnteredTS(trn), TRUE);
+
+    if (xaccTransGetDescription(trn))
+    {
+        gnc_xml_writer_text_element(writer, "trn:description",
+                                    xaccTransGetDescription(trn));
+    }
+
+    gnc_xml_writer_kvp_frame(writer, "trn:slots", xaccTransGetSlots(trn));
+
+    gnc_xml_writer_start(writer, "trn:splits");
+    for (n = xaccTransGetSplitList(trn); n; n = n->next)
+    {
+        write_split(writer, "trn:split", n->data);
+    }
+    gnc_xml_writer_end(writer, "trn:splits");
+
+    gnc_xml_writer_end(writer, "gnc:transaction");
+}
+
 /***********************************************************************/
 
 struct split_pdata
@@ -572,6 +676,406 @@ struct dom_tree_handler trn_dom_handlers[] =
     { NULL, NULL, 0, 0 },
 };
 
+/***********************************************************************/
+/* Loading through the pipeline (see io-gncxml-pipeline.h).  A loader
+ * thread decodes the transaction into the records below, and the
+ * transaction and its splits are created from them on the main
+ * thread.  Commodity references and slots are left as DOM trees:
+ * both go through tables that only the main thread may touch. */
+
+typedef struct
+{
+    GncGUID *id;
+    gchar *memo;
+    gchar *action;
+    gchar *reconciled_state;
+    Timespec reconcile_date;
+    gboolean has_reconcile_date;
+    gnc_numeric *value;
+    gnc_numeric *quantity;
+    GncGUID *account;
+    GncGUID *lot;
+    xmlNodePtr slots;
+} split_record;
+
+typedef struct
+{
+    GncGUID *id;
+    xmlNodePtr currency;
+    gchar *num;
+    Timespec date_posted;
+    gboolean has_date_posted;
+    Timespec date_entered;
+    gboolean has_date_entered;
+    gchar *description;
+    xmlNodePtr slots;
+    GPtrArray *splits;          /* split_record* */
+    gboolean ok;
+} trans_record;
+
+static void
+split_record_free(split_record *rec)
+{
+    g_free(rec->id);
+    g_free(rec->memo);
+    g_free(rec->action);
+    g_free(rec->reconciled_state);
+    g_free(rec->value);
+    g_free(rec->quantity);
+    g_free(rec->account);
+    g_free(rec->lot);
+    g_slice_free(split_record, rec);
+}
+
+static void
+trans_record_free(trans_record *rec)
+{
+    guint i;
+
+    for (i = 0; i < rec->splits->len; i++)
+        split_record_free(g_ptr_array_index(rec->splits, i));
+    g_ptr_array_free(rec->splits, TRUE);
+    g_free(rec->id);
+    g_free(rec->num);
+    g_free(rec->description);
+    g_slice_free(trans_record, rec);
+}
+
+static gboolean
+spl_rec_id_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->id = dom_tree_to_guid(node);
+    return rec->id != NULL;
+}
+
+static gboolean
+spl_rec_memo_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->memo = dom_tree_to_text(node);
+    return rec->memo != NULL;
+}
+
+static gboolean
+spl_rec_action_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->action = dom_tree_to_text(node);
+    return rec->action != NULL;
+}
+
+static gboolean
+spl_rec_reconciled_state_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->reconciled_state = dom_tree_to_text(node);
+    return rec->reconciled_state != NULL;
+}
+
+static gboolean
+spl_rec_reconcile_date_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+
+    rec->reconcile_date = dom_tree_to_timespec(node);
+    rec->has_reconcile_date =
+        dom_tree_valid_timespec(&rec->reconcile_date, node->name);
+    return rec->has_reconcile_date;
+}
+
+static gboolean
+spl_rec_value_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->value = dom_tree_to_gnc_numeric(node);
+    return rec->value != NULL;
+}
+
+static gboolean
+spl_rec_quantity_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->quantity = dom_tree_to_gnc_numeric(node);
+    return rec->quantity != NULL;
+}
+
+static gboolean
+spl_rec_account_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->account = dom_tree_to_guid(node);
+    return rec->account != NULL;
+}
+
+static gboolean
+spl_rec_lot_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->lot = dom_tree_to_guid(node);
+    return rec->lot != NULL;
+}
+
+static gboolean
+spl_rec_slots_handler(xmlNodePtr node, gpointer data)
+{
+    split_record *rec = data;
+    rec->slots = node;
+    return TRUE;
+}
+
+/* Same tags as spl_dom_handlers.  Never pass these tables to
+ * dom_tree_generic_parse directly: it writes to them, so each loader
+ * thread parses with its own copy. */
+static const struct dom_tree_handler spl_rec_dom_handlers[] =
+{
+    { "split:id", spl_rec_id_handler, 1, 0 },
+    { "split:memo", spl_rec_memo_handler, 0, 0 },
+    { "split:action", spl_rec_action_handler, 0, 0 },
+    { "split:reconciled-state", spl_rec_reconciled_state_handler, 1, 0 },
+    { "split:reconcile-date", spl_rec_reconcile_date_handler, 0, 0 },
+    { "split:value", spl_rec_value_handler, 1, 0 },
+    { "split:quantity", spl_rec_quantity_handler, 1, 0 },
+    { "split:account", spl_rec_account_handler, 1, 0 },
+    { "split:lot", spl_rec_lot_handler, 0, 0 },
+    { "split:slots", spl_rec_slots_handler, 0, 0 },
+    { NULL, NULL, 0, 0 },
+};
+
+static gboolean
+trn_rec_id_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+    rec->id = dom_tree_to_guid(node);
+    return rec->id != NULL;
+}
+
+static gboolean
+trn_rec_currency_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+    rec->currency = node;
+    return TRUE;
+}
+
+static gboolean
+trn_rec_num_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+    rec->num = dom_tree_to_text(node);
+    return rec->num != NULL;
+}
+
+static gboolean
+trn_rec_date_posted_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+
+    rec->date_posted = dom_tree_to_timespec(node);
+    rec->has_date_posted =
+        dom_tree_valid_timespec(&rec->date_posted, node->name);
+    return rec->has_date_posted;
+}
+
+static gboolean
+trn_rec_date_entered_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+
+    rec->date_entered = dom_tree_to_timespec(node);
+    rec->has_date_entered =
+        dom_tree_valid_timespec(&rec->date_entered, node->name);
+    return rec->has_date_entered;
+}
+
+static gboolean
+trn_rec_description_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+    rec->description = dom_tree_to_text(node);
+    return rec->description != NULL;
+}
+
+static gboolean
+trn_rec_slots_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+    rec->slots = node;
+    return TRUE;
+}
+
+static gboolean
+trn_rec_splits_handler(xmlNodePtr node, gpointer data)
+{
+    trans_record *rec = data;
+    xmlNodePtr mark;
+
+    g_return_val_if_fail(node, FALSE);
+    g_return_val_if_fail(node->xmlChildrenNode, FALSE);
+
+    for (mark = node->xmlChildrenNode; mark; mark = mark->next)
+    {
+        struct dom_tree_handler handlers[G_N_ELEMENTS(spl_rec_dom_handlers)];
+        split_record *spl;
+
+        if (safe_strcmp("text", (char*)mark->name) == 0)
+            continue;
+
+        if (safe_strcmp("trn:split", (char*)mark->name))
+        {
+            return FALSE;
+        }
+
+        spl = g_slice_new0(split_record);
+        memcpy(handlers, spl_rec_dom_handlers, sizeof(handlers));
+        if (!dom_tree_generic_parse(mark, handlers, spl))
+        {
+            split_record_free(spl);
+            return FALSE;
+        }
+        g_ptr_array_add(rec->splits, spl);
+    }
+    return TRUE;
+}
+
+/* Same tags as trn_dom_handlers. */
+static const struct dom_tree_handler trn_rec_dom_handlers[] =
+{
+    { "trn:id", trn_rec_id_handler, 1, 0 },
+    { "trn:currency", trn_rec_currency_handler, 0, 0},
+    { "trn:num", trn_rec_num_handler, 0, 0 },
+    { "trn:date-posted", trn_rec_date_posted_handler, 1, 0 },
+    { "trn:date-entered", trn_rec_date_entered_handler, 1, 0 },
+    { "trn:description", trn_rec_description_handler, 0, 0 },
+    { "trn:slots", trn_rec_slots_handler, 0, 0 },
+    { "trn:splits", trn_rec_splits_handler, 1, 0 },
+    { NULL, NULL, 0, 0 },
+};
+
+/* Runs on a loader thread. */
+static gpointer
+dom_tree_to_trans_record(gpointer data)
+{
+    xmlNodePtr node = data;
+    struct dom_tree_handler handlers[G_N_ELEMENTS(trn_rec_dom_handlers)];
+    trans_record *rec = g_slice_new0(trans_record);
+
+    rec->splits = g_ptr_array_new();
+    memcpy(handlers, trn_rec_dom_handlers, sizeof(handlers));
+    rec->ok = dom_tree_generic_parse(node, handlers, rec);
+    return rec;
+}
+
+/* The main thread half of dom_tree_to_split. */
+static Split *
+split_record_to_split(split_record *rec, QofBook *book)
+{
+    Split *split = xaccMallocSplit(book);
+
+    g_return_val_if_fail(split, NULL);
+
+    if (rec->id)
+        xaccSplitSetGUID(split, rec->id);
+    if (rec->memo)
+        xaccSplitSetMemo(split, rec->memo);
+    if (rec->action)
+        xaccSplitSetAction(split, rec->action);
+    if (rec->reconciled_state)
+        xaccSplitSetReconcile(split, rec->reconciled_state[0]);
+    if (rec->has_reconcile_date)
+        xaccSplitSetDateReconciledTS(split, &rec->reconcile_date);
+    if (rec->value)
+        xaccSplitSetValue(split, *rec->value);
+    if (rec->quantity)
+        xaccSplitSetAmount(split, *rec->quantity);
+    if (rec->account)
+    {
+        Account *account = xaccAccountLookup(rec->account, book);
+        if (!account && gnc_transaction_xml_v2_testing &&
+                !guid_equal(rec->account, guid_null()))
+        {
+            account = xaccMallocAccount(book);
+            xaccAccountSetGUID(account, rec->account);
+            xaccAccountSetCommoditySCU(account,
+                                       xaccSplitGetAmount(split).denom);
+        }
+        xaccAccountInsertSplit(account, split);
+    }
+    if (rec->lot)
+    {
+        GNCLot *lot = gnc_lot_lookup(rec->lot, book);
+        if (!lot && gnc_transaction_xml_v2_testing &&
+                !guid_equal(rec->lot, guid_null()))
+        {
+            lot = gnc_lot_new(book);
+            gnc_lot_set_guid(lot, *rec->lot);
+        }
+        gnc_lot_add_split(lot, split);
+    }
+    if (rec->slots &&
+            !dom_tree_to_kvp_frame_given(rec->slots, xaccSplitGetSlots(split)))
+        PERR("could not read the slots of a split");
+
+    return split;
+}
+
+/* The main thread half of dom_tree_to_transaction. */
+static gboolean
+trans_record_insert(gpointer record, gpointer data, gpointer global_data)
+{
+    trans_record *rec = record;
+    xmlNodePtr node = data;
+    gxpf_data *gdata = global_data;
+    QofBook *book = gdata->bookdata;
+    Transaction *trn;
+    guint i;
+
+    trn = xaccMallocTransaction(book);
+    xaccTransBeginEdit(trn);
+
+    if (rec->id)
+        xaccTransSetGUID(trn, rec->id);
+    if (rec->currency)
+        xaccTransSetCurrency(trn,
+                             dom_tree_to_commodity_ref(rec->currency, book));
+    if (rec->num)
+        xaccTransSetNum(trn, rec->num);
+    if (rec->has_date_posted)
+        xaccTransSetDatePostedTS(trn, &rec->date_posted);
+    if (rec->has_date_entered)
+        xaccTransSetDateEnteredTS(trn, &rec->date_entered);
+    if (rec->description)
+        xaccTransSetDescription(trn, rec->description);
+    if (rec->slots &&
+            !dom_tree_to_kvp_frame_given(rec->slots, xaccTransGetSlots(trn)))
+        PERR("could not read the slots of a transaction");
+    for (i = 0; i < rec->splits->len; i++)
+    {
+        Split *spl = split_record_to_split(g_ptr_array_index(rec->splits, i),
+                                           book);
+        if (spl)
+            xaccTransAppendSplit(trn, spl);
+    }
+
+    xaccTransCommitEdit(trn);
+
+    if (!rec->ok)
+    {
+        xmlElemDump(stdout, NULL, node);
+        xaccTransBeginEdit(trn);
+        xaccTransDestroy(trn);
+        xaccTransCommitEdit(trn);
+        trans_record_free(rec);
+        xmlFreeNode(node);
+        return FALSE;
+    }
+
+    gdata->cb((const char *)node->name, gdata->parsedata, trn);
+    trans_record_free(rec);
+    xmlFreeNode(node);
+    return TRUE;
+}
+
 static gboolean
 gnc_transaction_end_handler(gpointer data_for_children,
                             GSList* data_from_children, GSList* sibling_data,
@@ -597,6 +1101,13 @@ gnc_transaction_end_handler(gpointer data_for_children,
 
     g_return_val_if_fail(tree, FALSE);
 
+    if (gdata->pipeline)
+    {
+        return gnc_xml_pipeline_push(gdata->pipeline, tree,
+                                     dom_tree_to_trans_record,
+                                     trans_record_insert, gdata);
+    }
+
     trn = dom_tree_to_transaction(tree, gdata->bookdata);
     if (trn != NULL)
     {
@@ -27,6 +27,7 @@
 
 #include <glib.h>
 #include "sixtp.h"
+#include "io-gncxml-pipeline.h"
 
 typedef gboolean (*gxpf_callback)(const char *tag, gpointer parsedata,
                                   gpointer data);
@@ -36,6 +37,7 @@ struct gxpf_data_struct
     gxpf_callback cb;
     gpointer parsedata;
     gpointer bookdata;
+    GncXmlPipeline *pipeline;  /* NULL to convert subtrees in place */
 };
 
 typedef struct gxpf_data_struct gxpf_data;
@@ -0,0 +1,206 @@
+/********************************************************************\
+ * io-gncxml-pipeline.c -- run xml work on worker threads, in order *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "io-gncxml-pipeline.h"
+#include "qof.h"
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+typedef struct
+{
+    gpointer data;
+    GncXmlDecodeFunc decode;
+    GncXmlInsertFunc insert;
+    gpointer global_data;
+    gpointer record;
+    gboolean done;              /* protected by the pipeline's mutex */
+} GncXmlPipelineItem;
+
+struct _GncXmlPipeline
+{
+    GThreadPool *pool;
+    GMutex *mutex;
+    GCond *cond;
+    GQueue *items;              /* GncXmlPipelineItem*, in push order */
+    guint max_pending;
+    gboolean ok;
+};
+
+static gint
+gnc_xml_pipeline_num_workers(const gchar *threads_env)
+{
+    const gchar *env = g_getenv(threads_env);
+
+    if (env)
+        return atoi(env);
+#ifdef HAVE_GLIB_2_36
+    /* The pushing thread is busy too. */
+    return g_get_num_processors() - 1;
+#else
+    return 1;
+#endif
+}
+
+static void
+gnc_xml_pipeline_decode(gpointer data, gpointer user_data)
+{
+    GncXmlPipelineItem *item = data;
+    GncXmlPipeline *pipeline = user_data;
+    gpointer record;
+
+    record = item->decode(item->data);
+
+    g_mutex_lock(pipeline->mutex);
+    item->record = record;
+    item->done = TRUE;
+    g_cond_broadcast(pipeline->cond);
+    g_mutex_unlock(pipeline->mutex);
+}
+
+GncXmlPipeline *
+gnc_xml_pipeline_new(const gchar *threads_env, guint max_pending)
+{
+    GncXmlPipeline *pipeline;
+    GError *error = NULL;
+    gint workers = gnc_xml_pipeline_num_workers(threads_env);
+
+    if (workers < 1)
+        return NULL;
+
+#ifndef HAVE_GLIB_2_32
+    if (!g_thread_supported())
+        return NULL;
+#endif
+
+    pipeline = g_new0(GncXmlPipeline, 1);
+    pipeline->pool = g_thread_pool_new(gnc_xml_pipeline_decode, pipeline,
+                                       workers, FALSE, &error);
+    if (!pipeline->pool)
+    {
+        PWARN("Could not start xml worker threads: %s", error->message);
+        g_error_free(error);
+        g_free(pipeline);
+        return NULL;
+    }
+#ifdef HAVE_GLIB_2_32
+    pipeline->mutex = g_new(GMutex, 1);
+    g_mutex_init(pipeline->mutex);
+    pipeline->cond = g_new(GCond, 1);
+    g_cond_init(pipeline->cond);
+#else
+    pipeline->mutex = g_mutex_new();
+    pipeline->cond = g_cond_new();
+#endif
+    pipeline->items = g_queue_new();
+    pipeline->max_pending = MAX(max_pending, 1);
+    pipeline->ok = TRUE;
+
+    DEBUG("%d xml worker threads for %s", workers, threads_env);
+    return pipeline;
+}
+
+/* Insert the decoded items at the head of the queue until the
+ * queue is no longer than max_pending, waiting for the workers if
+ * need be.  With max_pending 0 this drains the queue. */
+static void
+gnc_xml_pipeline_insert(GncXmlPipeline *pipeline, guint max_pending)
+{
+    GncXmlPipelineItem *item;
+
+    g_mutex_lock(pipeline->mutex);
+    while ((item = g_queue_peek_head(pipeline->items)) != NULL)
+    {
+        if (!item->done)
+        {
+            if (g_queue_get_length(pipeline->items) <= max_pending)
+                break;
+            g_cond_wait(pipeline->cond, pipeline->mutex);
+            continue;
+        }
+        g_queue_pop_head(pipeline->items);
+        g_mutex_unlock(pipeline->mutex);
+
+        if (!item->insert(item->record, item->data, item->global_data))
+            pipeline->ok = FALSE;
+        g_slice_free(GncXmlPipelineItem, item);
+
+        g_mutex_lock(pipeline->mutex);
+    }
+    g_mutex_unlock(pipeline->mutex);
+}
+
+gboolean
+gnc_xml_pipeline_push(GncXmlPipeline *pipeline, gpointer data,
+                      GncXmlDecodeFunc decode, GncXmlInsertFunc insert,
+                      gpointer global_data)
+{
+    GncXmlPipelineItem *item;
+
+    g_return_val_if_fail(pipeline && decode && insert, FALSE);
+
+    item = g_slice_new0(GncXmlPipelineItem);
+    item->data = data;
+    item->decode = decode;
+    item->insert = insert;
+    item->global_data = global_data;
+
+    g_mutex_lock(pipeline->mutex);
+    g_queue_push_tail(pipeline->items, item);
+    g_mutex_unlock(pipeline->mutex);
+    g_thread_pool_push(pipeline->pool, item, NULL);
+
+    gnc_xml_pipeline_insert(pipeline, pipeline->max_pending);
+    return pipeline->ok;
+}
+
+gboolean
+gnc_xml_pipeline_flush(GncXmlPipeline *pipeline)
+{
+    g_return_val_if_fail(pipeline, FALSE);
+
+    gnc_xml_pipeline_insert(pipeline, 0);
+    return pipeline->ok;
+}
+
+void
+gnc_xml_pipeline_destroy(GncXmlPipeline *pipeline)
+{
+    if (!pipeline) return;
+
+    gnc_xml_pipeline_insert(pipeline, 0);
+    g_thread_pool_free(pipeline->pool, FALSE, TRUE);
+    g_queue_free(pipeline->items);
+#ifdef HAVE_GLIB_2_32
+    g_mutex_clear(pipeline->mutex);
+    g_free(pipeline->mutex);
+    g_cond_clear(pipeline->cond);
+    g_free(pipeline->cond);
+#else
+    g_mutex_free(pipeline->mutex);
+    g_cond_free(pipeline->cond);
+#endif
+    g_free(pipeline);
+}
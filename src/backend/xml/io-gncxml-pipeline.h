@@ -0,0 +1,74 @@
+/********************************************************************\
+ * io-gncxml-pipeline.h -- run xml work on worker threads, in order *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+
+/* The pipeline splits the handling of a piece of work in two.  The
+ * decode function does the expensive, self-contained part on a worker
+ * thread; when loading it turns a completed DOM subtree into a plain
+ * record (guids, numerics, timespecs, strings), when saving it turns
+ * engine objects into text.  It must not change the engine.  The
+ * insert function finishes the work (creates the engine objects,
+ * writes the text) on the thread that pushed it, strictly in the order
+ * the work was pushed.
+ *
+ * The number of worker threads is read from an environment variable
+ * named by the caller, GNC_XML_LOAD_THREADS or GNC_XML_SAVE_THREADS;
+ * 0 turns the pipeline off.
+ */
+
+#ifndef IO_GNCXML_PIPELINE_H
+#define IO_GNCXML_PIPELINE_H
+
+#include <glib.h>
+
+typedef struct _GncXmlPipeline GncXmlPipeline;
+
+/* Called on a worker thread with the pushed data.  Returns the
+ * record, or NULL if the data could not be decoded. */
+typedef gpointer (*GncXmlDecodeFunc)(gpointer data);
+
+/* Called on the pushing thread with the record returned by the decode
+ * function and the pushed data, both of which it must free. */
+typedef gboolean (*GncXmlInsertFunc)(gpointer record, gpointer data,
+                                     gpointer global_data);
+
+/* Returns NULL if only one thread should be used.  At most
+ * max_pending pieces of work are kept waiting before a push blocks,
+ * which bounds the memory they take. */
+GncXmlPipeline *gnc_xml_pipeline_new(const gchar *threads_env,
+                                     guint max_pending);
+
+/* Waits for and inserts all pending work, then frees the pipeline. */
+void gnc_xml_pipeline_destroy(GncXmlPipeline *pipeline);
+
+/* Hands data to the workers.  Inserts whatever is ready, and blocks
+ * if too much work is waiting.  Returns FALSE once an insert has
+ * failed. */
+gboolean gnc_xml_pipeline_push(GncXmlPipeline *pipeline, gpointer data,
+                               GncXmlDecodeFunc decode,
+                               GncXmlInsertFunc insert,
+                               gpointer global_data);
+
+/* Waits for and inserts all pending work.  Returns FALSE if any
+ * insert has failed. */
+gboolean gnc_xml_pipeline_flush(GncXmlPipeline *pipeline);
+
+#endif /* IO_GNCXML_PIPELINE_H */
@@ -92,6 +92,9 @@ struct file_backend
     sixtp         * parser;
     FILE          * out;
     QofBook       * book;
+    GncXmlWriter  * writer;
+    GncXmlPipeline * pipeline;
+    GPtrArray     * chunk;      /* Transaction*, waiting to be pushed */
 };
 
 #define GNC_V2_STRING "gnc-v2"
@@ -99,6 +102,19 @@ struct file_backend
 const gchar *gnc_v2_xml_version_string = GNC_V2_STRING;
 extern const gchar *gnc_v2_book_version_string;        /* see gnc-book-xml-v2 */
 
+/* How many DOM subtrees may wait for the loader threads, and how many
+ * chunks of transactions or blocks of the file for the saver threads.
+ * These bound the memory taken by pending work. */
+#define GNC_XML_LOAD_MAX_PENDING 1024
+#define GNC_XML_SAVE_MAX_PENDING 64
+#define GZ_MAX_PENDING_BLOCKS 16
+
+/* Transactions serialised by one piece of saver work. */
+#define GNC_XML_SAVE_CHUNK 256
+
+/* Bytes of the file compressed into each gzip member. */
+#define GZ_BLOCK_LEN (1 << 20)
+
 /* Forward declarations */
 static FILE *try_gz_open (const char *filename, const char *perms, gboolean use_gzip,
                           gboolean compress);
@@ -619,6 +635,26 @@ generic_callback(const char *tag, gpointer globaldata, gpointer data)
     return TRUE;
 }
 
+/* Transactions and prices may still be in the loader pipeline.  Get
+ * them into the book before anything else is read, because it may
+ * refer to them. */
+static gboolean
+flush_pipeline_before_child(gpointer data_for_children,
+                            GSList* data_from_children,
+                            GSList* sibling_data,
+                            gpointer parent_data,
+                            gpointer global_data,
+                            gpointer *result,
+                            const gchar *tag,
+                            const gchar *child_tag)
+{
+    gxpf_data *gdata = (gxpf_data*)global_data;
+
+    if (gdata->pipeline && safe_strcmp(child_tag, TRANSACTION_TAG) != 0)
+        return gnc_xml_pipeline_flush(gdata->pipeline);
+    return TRUE;
+}
+
 static void
 add_parser_cb (const char *type, gpointer data_p, gpointer be_data_p)
 {
@@ -699,12 +735,16 @@ qof_session_load_from_xml_file_v2_full(
     struct file_backend be_data;
     gboolean retval;
     char *v2type = NULL;
+    gpointer parse_result = NULL;
+    gxpf_data gpdata;
 
     gd = gnc_sixtp_gdv2_new(book, FALSE, file_rw_feedback, be->percentage);
 
     top_parser = sixtp_new();
     main_parser = sixtp_new();
     book_parser = sixtp_new();
+    sixtp_set_before_child(main_parser, flush_pipeline_before_child);
+    sixtp_set_before_child(book_parser, flush_pipeline_before_child);
 
     if (type == GNC_BOOK_XML2_FILE)
         v2type = g_strdup(GNC_V2_STRING);
@@ -766,15 +806,14 @@ qof_session_load_from_xml_file_v2_full(
     xaccLogDisable ();
     xaccDisableDataScrubbing();
 
+    gpdata.cb = generic_callback;
+    gpdata.parsedata = gd;
+    gpdata.bookdata = book;
+    gpdata.pipeline = gnc_xml_pipeline_new("GNC_XML_LOAD_THREADS",
+                                           GNC_XML_LOAD_MAX_PENDING);
+
     if (push_handler)
     {
-        gpointer parse_result = NULL;
-        gxpf_data gpdata;
-
-        gpdata.cb = generic_callback;
-        gpdata.parsedata = gd;
-        gpdata.bookdata = book;
-
         retval = sixtp_parse_push(top_parser, push_handler, push_user_data,
                                   NULL, &gpdata, &parse_result);
     }
@@ -800,8 +839,8 @@ qof_session_load_from_xml_file_v2_full(
             }
             else
             {
-                retval = gnc_xml_parse_fd(top_parser, file,
-                                          generic_callback, gd, book);
+                retval = sixtp_parse_fd(top_parser, file,
+                                        NULL, &gpdata, &parse_result);
                 fclose(file);
                 if (is_compressed)
                     wait_for_gzip(file);
@@ -814,6 +853,13 @@ qof_session_load_from_xml_file_v2_full(
 #endif
     }
 
+    if (gpdata.pipeline)
+    {
+        if (!gnc_xml_pipeline_flush(gpdata.pipeline))
+            retval = FALSE;
+        gnc_xml_pipeline_destroy(gpdata.pipeline);
+    }
+
     if (!retval)
     {
         sixtp_destroy(top_parser);
@@ -1136,18 +1182,68 @@ write_pricedb(FILE *out, QofBook *book, sixtp_gdv2 *gd)
     return TRUE;
 }
 
+/* Runs on a saver thread. */
+static gpointer
+write_trn_chunk(gpointer data)
+{
+    GPtrArray *chunk = data;
+    GncXmlWriter *writer = gnc_xml_writer_new(NULL);
+    guint i;
+
+    for (i = 0; i < chunk->len; i++)
+        gnc_transaction_write(writer, g_ptr_array_index(chunk, i));
+
+    return gnc_xml_writer_free_to_string(writer);
+}
+
+/* Runs on the saving thread, in the order the chunks were pushed. */
+static gboolean
+insert_trn_chunk(gpointer record, gpointer data, gpointer global_data)
+{
+    GString *text = record;
+    GPtrArray *chunk = data;
+    struct file_backend *be_data = global_data;
+    gboolean ok;
+    guint i;
+
+    ok = fwrite(text->str, 1, text->len, be_data->out) == text->len
+         && !ferror(be_data->out);
+    for (i = 0; ok && i < chunk->len; i++)
+    {
+        be_data->gd->counter.transactions_loaded++;
+        run_callback(be_data->gd, "transaction");
+    }
+
+    g_string_free(text, TRUE);
+    g_ptr_array_free(chunk, TRUE);
+    return ok;
+}
+
+static gboolean
+push_trn_chunk(struct file_backend *be_data)
+{
+    GPtrArray *chunk = be_data->chunk;
+
+    be_data->chunk = g_ptr_array_sized_new(GNC_XML_SAVE_CHUNK);
+    return gnc_xml_pipeline_push(be_data->pipeline, chunk, write_trn_chunk,
+                                 insert_trn_chunk, be_data);
+}
+
 static int
 xml_add_trn_data(Transaction *t, gpointer data)
 {
     struct file_backend *be_data = data;
-    xmlNodePtr node;
 
-    node = gnc_transaction_dom_tree_create(t);
-
-    xmlElemDump(be_data->out, NULL, node);
-    xmlFreeNode(node);
+    if (be_data->pipeline)
+    {
+        g_ptr_array_add(be_data->chunk, t);
+        if (be_data->chunk->len < GNC_XML_SAVE_CHUNK)
+            return 0;
+        return push_trn_chunk(be_data) ? 0 : -1;
+    }
 
-    if (ferror(be_data->out) || fprintf(be_data->out, "\n") < 0)
+    gnc_transaction_write(be_data->writer, t);
+    if (ferror(be_data->out))
         return -1;
 
     be_data->gd->counter.transactions_loaded++;
@@ -1159,13 +1255,36 @@ static gboolean
 write_transactions(FILE *out, QofBook *book, sixtp_gdv2 *gd)
 {
     struct file_backend be_data;
+    gboolean ok;
 
+    /* The transactions are serialised in chunks on the saver threads
+     * if there are any, and written out in their usual order. */
     be_data.out = out;
     be_data.gd = gd;
-    return 0 ==
-           xaccAccountTreeForEachTransaction(gnc_book_get_root_account(book),
-                   xml_add_trn_data,
-                   (gpointer) &be_data);
+    be_data.writer = NULL;
+    be_data.chunk = NULL;
+    be_data.pipeline = gnc_xml_pipeline_new("GNC_XML_SAVE_THREADS",
+                                            GNC_XML_SAVE_MAX_PENDING);
+    if (be_data.pipeline)
+        be_data.chunk = g_ptr_array_sized_new(GNC_XML_SAVE_CHUNK);
+    else
+        be_data.writer = gnc_xml_writer_new(out);
+
+    ok = 0 ==
+         xaccAccountTreeForEachTransaction(gnc_book_get_root_account(book),
+                 xml_add_trn_data,
+                 (gpointer) &be_data);
+
+    if (!be_data.pipeline)
+        return gnc_xml_writer_destroy(be_data.writer) && ok;
+
+    if (ok && be_data.chunk->len > 0)
+        ok = push_trn_chunk(&be_data);
+    if (!gnc_xml_pipeline_flush(be_data.pipeline))
+        ok = FALSE;
+    gnc_xml_pipeline_destroy(be_data.pipeline);
+    g_ptr_array_free(be_data.chunk, TRUE);
+    return ok;
 }
 
 static gboolean
@@ -1176,15 +1295,22 @@ write_template_transaction_data( FILE *out, QofBook *book, sixtp_gdv2 *gd )
 
     be_data.out = out;
     be_data.gd = gd;
+    be_data.pipeline = NULL;
 
     ra = gnc_book_get_template_root(book);
     if ( gnc_account_n_descendants(ra) > 0 )
     {
+        gboolean ok;
+
         if (fprintf(out, "<%s>\n", TEMPLATE_TRANSACTION_TAG) < 0
-                || !write_account_tree(out, ra, gd)
-                || xaccAccountTreeForEachTransaction(ra, xml_add_trn_data, (gpointer)&be_data)
-                || fprintf(out, "</%s>\n", TEMPLATE_TRANSACTION_TAG) < 0)
+                || !write_account_tree(out, ra, gd))
+            return FALSE;
 
+        be_data.writer = gnc_xml_writer_new(out);
+        ok = 0 == xaccAccountTreeForEachTransaction(ra, xml_add_trn_data,
+                (gpointer)&be_data);
+        if (!gnc_xml_writer_destroy(be_data.writer) || !ok
+                || fprintf(out, "</%s>\n", TEMPLATE_TRANSACTION_TAG) < 0)
             return FALSE;
     }
 
@@ -1366,6 +1492,150 @@ gnc_book_write_accounts_to_xml_filehandle_v2(QofBackend *be, QofBook *book, FILE
 
 #define BUFLEN 4096
 
+/* With saver threads, the file is compressed in blocks of GZ_BLOCK_LEN
+ * bytes on the worker threads.  Each block becomes a complete gzip
+ * member, and the members are written one after the other, which gzip
+ * and zlib's gzread read as a single stream. */
+
+typedef struct
+{
+    gchar *data;
+    gsize len;
+} gz_block_t;
+
+static void
+gz_block_free(gz_block_t *block)
+{
+    if (!block) return;
+    g_free(block->data);
+    g_free(block);
+}
+
+/* Runs on a saver thread. */
+static gpointer
+gz_deflate_block(gpointer data)
+{
+    gz_block_t *in = data;
+    gz_block_t *out;
+    z_stream strm;
+    uLong bound;
+
+    memset(&strm, 0, sizeof(strm));
+    /* 16 more window bits ask for a gzip header and trailer. */
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    /* Older zlibs leave the gzip header out of the bound. */
+    bound = deflateBound(&strm, in->len) + 32;
+    out = g_new(gz_block_t, 1);
+    out->data = g_malloc(bound);
+
+    strm.next_in = (Bytef *) in->data;
+    strm.avail_in = in->len;
+    strm.next_out = (Bytef *) out->data;
+    strm.avail_out = bound;
+    if (deflate(&strm, Z_FINISH) != Z_STREAM_END)
+    {
+        deflateEnd(&strm);
+        gz_block_free(out);
+        return NULL;
+    }
+    out->len = strm.total_out;
+    deflateEnd(&strm);
+    return out;
+}
+
+/* Runs on the compressing thread, in file order. */
+static gboolean
+gz_write_block(gpointer record, gpointer data, gpointer global_data)
+{
+    gz_block_t *out = record;
+    FILE *file = global_data;
+    gboolean ok = FALSE;
+
+    if (!out)
+        g_warning("Could not compress a block of the file");
+    else if (fwrite(out->data, 1, out->len, file) != out->len)
+        g_warning("Could not write the compressed file. The error is '%s' (errno %d)",
+                  g_strerror(errno) ? g_strerror(errno) : "", errno);
+    else
+        ok = TRUE;
+
+    gz_block_free(out);
+    gz_block_free(data);
+    return ok;
+}
+
+static gboolean
+gz_compress_in_blocks(gz_thread_params_t *params, GncXmlPipeline *pipeline)
+{
+    FILE *file;
+    gboolean success = TRUE;
+    gboolean at_eof = FALSE;
+    gboolean pushed = FALSE;
+
+    file = g_fopen(params->filename, "wb");
+    if (file == NULL)
+    {
+        g_warning("Could not open the compressed file '%s'. The error is '%s' (errno %d)",
+                  params->filename,
+                  g_strerror(errno) ? g_strerror(errno) : "", errno);
+        return FALSE;
+    }
+
+    while (success && !at_eof)
+    {
+        gz_block_t *block = g_new(gz_block_t, 1);
+
+        block->data = g_malloc(GZ_BLOCK_LEN);
+        block->len = 0;
+        while (block->len < GZ_BLOCK_LEN)
+        {
+            gssize bytes = read(params->fd, block->data + block->len,
+                                GZ_BLOCK_LEN - block->len);
+            if (bytes > 0)
+            {
+                block->len += bytes;
+            }
+            else if (bytes == 0)
+            {
+                at_eof = TRUE;
+                break;
+            }
+            else
+            {
+                g_warning("Could not read from pipe. The error is '%s' (errno %d)",
+                          g_strerror(errno) ? g_strerror(errno) : "", errno);
+                success = FALSE;
+                break;
+            }
+        }
+
+        /* An empty file still gets one (empty) member. */
+        if (!success || (block->len == 0 && pushed))
+        {
+            gz_block_free(block);
+            break;
+        }
+        pushed = TRUE;
+        success = gnc_xml_pipeline_push(pipeline, block, gz_deflate_block,
+                                        gz_write_block, file);
+    }
+
+    if (!gnc_xml_pipeline_flush(pipeline))
+        success = FALSE;
+
+    if (fclose(file) != 0)
+    {
+        g_warning("Could not close the compressed file '%s'. The error is '%s' (errno %d)",
+                  params->filename,
+                  g_strerror(errno) ? g_strerror(errno) : "", errno);
+        success = FALSE;
+    }
+    return success;
+}
+
 /* Compress or decompress function that is to be run in a separate thread.
  * Returns 1 on success or 0 otherwise, stuffed into a pointer type. */
 static gpointer
@@ -1377,6 +1647,19 @@ gz_thread_func(gz_thread_params_t *params)
     gzFile file;
     gint success = 1;
 
+    if (params->compress)
+    {
+        GncXmlPipeline *pipeline =
+            gnc_xml_pipeline_new("GNC_XML_SAVE_THREADS",
+                                 GZ_MAX_PENDING_BLOCKS);
+        if (pipeline)
+        {
+            success = gz_compress_in_blocks(params, pipeline);
+            gnc_xml_pipeline_destroy(pipeline);
+            goto cleanup_gz_thread_func;
+        }
+    }
+
 #ifdef G_OS_WIN32
     {
         gchar *conv_name = g_win32_locale_filename_from_utf8(params->filename);
@@ -0,0 +1,509 @@
+/********************************************************************\
+ * io-gncxml-writer.c -- stream xml straight from engine objects    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "io-gncxml-writer.h"
+#include "sixtp-dom-generators.h"
+#include "sixtp-utils.h"
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+/* The buffer is written out once it holds this many bytes. */
+#define GNC_XML_WRITER_BLOCK (1 << 20)
+
+/* The initial size of the buffer of a writer without a file. */
+#define GNC_XML_WRITER_STRING_SIZE (1 << 16)
+
+/* libxml2 stops indenting deeper than this many levels. */
+#define GNC_XML_WRITER_MAX_INDENT 30
+
+static const char indent_spaces[] =
+    "                                                            ";
+
+struct _GncXmlWriter
+{
+    FILE *out;
+    GString *buf;
+    gint level;         /* depth of the next element to start */
+    gboolean open;      /* the last start tag still lacks its '>' */
+    gboolean text;      /* the current element holds text */
+    gboolean ok;
+};
+
+GncXmlWriter *
+gnc_xml_writer_new(FILE *out)
+{
+    GncXmlWriter *writer;
+
+    writer = g_new0(GncXmlWriter, 1);
+    writer->out = out;
+    writer->buf = g_string_sized_new(out ? GNC_XML_WRITER_BLOCK + 4096
+                                     : GNC_XML_WRITER_STRING_SIZE);
+    writer->ok = TRUE;
+    return writer;
+}
+
+gboolean
+gnc_xml_writer_flush(GncXmlWriter *writer)
+{
+    g_return_val_if_fail(writer, FALSE);
+
+    if (!writer->out)
+        return writer->ok;
+
+    if (writer->buf->len > 0 && writer->ok)
+    {
+        if (fwrite(writer->buf->str, 1, writer->buf->len, writer->out)
+                != writer->buf->len)
+        {
+            PERR("Could not write %" G_GSIZE_FORMAT " bytes",
+                 writer->buf->len);
+            writer->ok = FALSE;
+        }
+    }
+    g_string_truncate(writer->buf, 0);
+    return writer->ok && !ferror(writer->out);
+}
+
+gboolean
+gnc_xml_writer_destroy(GncXmlWriter *writer)
+{
+    gboolean ok;
+
+    if (!writer) return FALSE;
+
+    ok = gnc_xml_writer_flush(writer);
+    g_string_free(writer->buf, TRUE);
+    g_free(writer);
+    return ok;
+}
+
+GString *
+gnc_xml_writer_free_to_string(GncXmlWriter *writer)
+{
+    GString *buf;
+
+    g_return_val_if_fail(writer && !writer->out, NULL);
+
+    buf = writer->buf;
+    g_free(writer);
+    return buf;
+}
+
+static inline void
+writer_indent(GncXmlWriter *writer, gint level)
+{
+    g_string_append_len(writer->buf, indent_spaces,
+                        2 * MIN(level, GNC_XML_WRITER_MAX_INDENT));
+}
+
+/* What xmlEscapeContent does to text. */
+static void
+writer_escape_text(GncXmlWriter *writer, const char *text)
+{
+    const char *run = text;
+    const char *p;
+
+    for (p = text; *p; p++)
+    {
+        const char *entity;
+
+        switch (*p)
+        {
+        case '<':
+            entity = "&lt;";
+            break;
+        case '>':
+            entity = "&gt;";
+            break;
+        case '&':
+            entity = "&amp;";
+            break;
+        case '\r':
+            entity = "&#13;";
+            break;
+        default:
+            continue;
+        }
+        g_string_append_len(writer->buf, run, p - run);
+        g_string_append(writer->buf, entity);
+        run = p + 1;
+    }
+    g_string_append_len(writer->buf, run, p - run);
+}
+
+/* What xmlAttrSerializeTxtContent does to ASCII attribute values. */
+static void
+writer_escape_attribute(GncXmlWriter *writer, const char *value)
+{
+    const char *p;
+
+    for (p = value; *p; p++)
+    {
+        switch (*p)
+        {
+        case '<':
+            g_string_append(writer->buf, "&lt;");
+            break;
+        case '>':
+            g_string_append(writer->buf, "&gt;");
+            break;
+        case '&':
+            g_string_append(writer->buf, "&amp;");
+            break;
+        case '"':
+            g_string_append(writer->buf, "&quot;");
+            break;
+        case '\n':
+            g_string_append(writer->buf, "&#10;");
+            break;
+        case '\r':
+            g_string_append(writer->buf, "&#13;");
+            break;
+        case '\t':
+            g_string_append(writer->buf, "&#9;");
+            break;
+        default:
+            g_string_append_c(writer->buf, *p);
+        }
+    }
+}
+
+void
+gnc_xml_writer_start(GncXmlWriter *writer, const char *tag)
+{
+    g_return_if_fail(writer && tag);
+    g_return_if_fail(!writer->text);
+
+    if (writer->open)
+        g_string_append_len(writer->buf, ">\n", 2);
+    writer_indent(writer, writer->level);
+    g_string_append_c(writer->buf, '<');
+    g_string_append(writer->buf, tag);
+    writer->level++;
+    writer->open = TRUE;
+}
+
+void
+gnc_xml_writer_attribute(GncXmlWriter *writer, const char *name,
+                         const char *value)
+{
+    g_return_if_fail(writer && name && value);
+    g_return_if_fail(writer->open);
+
+    g_string_append_c(writer->buf, ' ');
+    g_string_append(writer->buf, name);
+    g_string_append_len(writer->buf, "=\"", 2);
+    writer_escape_attribute(writer, value);
+    g_string_append_c(writer->buf, '"');
+}
+
+void
+gnc_xml_writer_text(GncXmlWriter *writer, const char *text)
+{
+    g_return_if_fail(writer && text);
+    g_return_if_fail(writer->open || writer->text);
+
+    if (writer->open)
+    {
+        g_string_append_c(writer->buf, '>');
+        writer->open = FALSE;
+    }
+    writer->text = TRUE;
+    writer_escape_text(writer, text);
+}
+
+void
+gnc_xml_writer_end(GncXmlWriter *writer, const char *tag)
+{
+    g_return_if_fail(writer && tag);
+    g_return_if_fail(writer->level > 0);
+
+    writer->level--;
+    if (writer->open)
+    {
+        g_string_append_len(writer->buf, "/>\n", 3);
+    }
+    else
+    {
+        if (!writer->text)
+            writer_indent(writer, writer->level);
+        g_string_append_len(writer->buf, "</", 2);
+        g_string_append(writer->buf, tag);
+        g_string_append_len(writer->buf, ">\n", 2);
+    }
+    writer->open = FALSE;
+    writer->text = FALSE;
+
+    if (writer->level == 0 && writer->out
+            && writer->buf->len >= GNC_XML_WRITER_BLOCK)
+        gnc_xml_writer_flush(writer);
+}
+
+void
+gnc_xml_writer_text_element(GncXmlWriter *writer, const char *tag,
+                            const char *text)
+{
+    gnc_xml_writer_start(writer, tag);
+    if (text)
+        gnc_xml_writer_text(writer, text);
+    gnc_xml_writer_end(writer, tag);
+}
+
+/* Mirrors xmlNodeAddContent and xmlNodeSetContent, which add nothing
+ * for an empty string. */
+static void
+writer_content_element(GncXmlWriter *writer, const char *tag,
+                       const char *type, const char *text)
+{
+    gnc_xml_writer_start(writer, tag);
+    if (type)
+        gnc_xml_writer_attribute(writer, "type", type);
+    if (text && *text)
+        gnc_xml_writer_text(writer, text);
+    gnc_xml_writer_end(writer, tag);
+}
+
+/* Formats val in decimal, as "%" G_GINT64_FORMAT does, so that its
+ * terminating nul lands just before end.  Up to 21 bytes are used.
+ * Returns the start of the string. */
+static char *
+format_int64(char *end, gint64 val)
+{
+    guint64 u = val < 0 ? -(guint64) val : (guint64) val;
+    char *p = end;
+
+    *--p = '\0';
+    do
+    {
+        *--p = '0' + (char)(u % 10);
+        u /= 10;
+    }
+    while (u);
+    if (val < 0)
+        *--p = '-';
+    return p;
+}
+
+void
+gnc_xml_writer_guid(GncXmlWriter *writer, const char *tag,
+                    const GncGUID *guid)
+{
+    char guid_str[GUID_ENCODING_LENGTH + 1];
+
+    if (!guid_to_string_buff(guid, guid_str))
+    {
+        PERR("guid_to_string_buff failed\n");
+        return;
+    }
+    writer_content_element(writer, tag, "guid", guid_str);
+}
+
+void
+gnc_xml_writer_commodity_ref(GncXmlWriter *writer, const char *tag,
+                             const gnc_commodity *c)
+{
+    g_return_if_fail(c);
+
+    if (!gnc_commodity_get_namespace(c) || !gnc_commodity_get_mnemonic(c))
+        return;
+
+    gnc_xml_writer_start(writer, tag);
+    gnc_xml_writer_text_element(writer, "cmdty:space",
+                                gnc_commodity_get_namespace_compat(c));
+    gnc_xml_writer_text_element(writer, "cmdty:id",
+                                gnc_commodity_get_mnemonic(c));
+    gnc_xml_writer_end(writer, tag);
+}
+
+static void
+writer_timespec(GncXmlWriter *writer, const char *tag, const char *type,
+                const Timespec *ts)
+{
+    gchar date_str[TIMESPEC_SEC_FORMAT_MAX];
+
+    g_return_if_fail(ts);
+
+    if (!timespec_secs_to_given_string(ts, date_str))
+        return;
+
+    gnc_xml_writer_start(writer, tag);
+    if (type)
+        gnc_xml_writer_attribute(writer, "type", type);
+    gnc_xml_writer_text_element(writer, "ts:date", date_str);
+    if (ts->tv_nsec > 0)
+    {
+        char buf[24];
+        gnc_xml_writer_text_element(writer, "ts:ns",
+                                    format_int64(buf + sizeof(buf),
+                                                 ts->tv_nsec));
+    }
+    gnc_xml_writer_end(writer, tag);
+}
+
+void
+gnc_xml_writer_timespec(GncXmlWriter *writer, const char *tag,
+                        const Timespec *ts)
+{
+    writer_timespec(writer, tag, NULL, ts);
+}
+
+void
+gnc_xml_writer_numeric(GncXmlWriter *writer, const char *tag,
+                       gnc_numeric num)
+{
+    char buf[48];
+    char *denom, *str;
+
+    denom = format_int64(buf + sizeof(buf), num.denom);
+    str = format_int64(denom, num.num);
+    /* The numerator was terminated where the '/' goes. */
+    denom[-1] = '/';
+    writer_content_element(writer, tag, NULL, str);
+}
+
+static void writer_kvp_slot(gpointer key, gpointer value, gpointer data);
+
+static void
+writer_kvp_value(GncXmlWriter *writer, const char *tag, kvp_value *val)
+{
+    gchar *str = NULL;
+
+    switch (kvp_value_get_type(val))
+    {
+    case KVP_TYPE_GINT64:
+    {
+        char buf[24];
+        writer_content_element(writer, tag, "integer",
+                               format_int64(buf + sizeof(buf),
+                                            kvp_value_get_gint64(val)));
+    }
+    break;
+    case KVP_TYPE_DOUBLE:
+        str = double_to_string(kvp_value_get_double(val));
+        writer_content_element(writer, tag, "double", str);
+        break;
+    case KVP_TYPE_NUMERIC:
+        str = gnc_numeric_to_string(kvp_value_get_numeric(val));
+        writer_content_element(writer, tag, "numeric", str);
+        break;
+    case KVP_TYPE_STRING:
+        gnc_xml_writer_start(writer, tag);
+        gnc_xml_writer_attribute(writer, "type", "string");
+        if (kvp_value_get_string(val))
+            gnc_xml_writer_text(writer, kvp_value_get_string(val));
+        gnc_xml_writer_end(writer, tag);
+        break;
+    case KVP_TYPE_GUID:
+    {
+        char guid_str[GUID_ENCODING_LENGTH + 1];
+        writer_content_element(writer, tag, "guid",
+                               guid_to_string_buff(kvp_value_get_guid(val),
+                                                   guid_str));
+    }
+    break;
+    case KVP_TYPE_TIMESPEC:
+    {
+        Timespec ts = kvp_value_get_timespec(val);
+        writer_timespec(writer, tag, "timespec", &ts);
+    }
+    break;
+    case KVP_TYPE_GDATE:
+    {
+        GDate d = kvp_value_get_gdate(val);
+        gchar date_str[512];
+
+        g_date_strftime(date_str, sizeof(date_str), "%Y-%m-%d", &d);
+        gnc_xml_writer_start(writer, tag);
+        gnc_xml_writer_attribute(writer, "type", "gdate");
+        gnc_xml_writer_text_element(writer, "gdate", date_str);
+        gnc_xml_writer_end(writer, tag);
+    }
+    break;
+    case KVP_TYPE_BINARY:
+    {
+        guint64 size;
+        void *binary_data = kvp_value_get_binary(val, &size);
+
+        if (binary_data)
+            str = binary_to_string(binary_data, size);
+        writer_content_element(writer, tag, "binary", str);
+    }
+    break;
+    case KVP_TYPE_GLIST:
+    {
+        GList *cursor;
+
+        gnc_xml_writer_start(writer, tag);
+        gnc_xml_writer_attribute(writer, "type", "list");
+        for (cursor = kvp_value_get_glist(val); cursor; cursor = cursor->next)
+            writer_kvp_value(writer, "slot:value", (kvp_value*)cursor->data);
+        gnc_xml_writer_end(writer, tag);
+    }
+    break;
+    case KVP_TYPE_FRAME:
+    {
+        kvp_frame *frame = kvp_value_get_frame(val);
+
+        gnc_xml_writer_start(writer, tag);
+        gnc_xml_writer_attribute(writer, "type", "frame");
+        if (frame && kvp_frame_get_hash(frame))
+            g_hash_table_foreach_sorted(kvp_frame_get_hash(frame),
+                                        writer_kvp_slot, writer,
+                                        (GCompareFunc)strcmp);
+        gnc_xml_writer_end(writer, tag);
+    }
+    break;
+    default:
+        writer_content_element(writer, tag, NULL, NULL);
+        break;
+    }
+    g_free(str);
+}
+
+static void
+writer_kvp_slot(gpointer key, gpointer value, gpointer data)
+{
+    GncXmlWriter *writer = data;
+
+    gnc_xml_writer_start(writer, "slot");
+    gnc_xml_writer_text_element(writer, "slot:key", key);
+    writer_kvp_value(writer, "slot:value", value);
+    gnc_xml_writer_end(writer, "slot");
+}
+
+void
+gnc_xml_writer_kvp_frame(GncXmlWriter *writer, const char *tag,
+                         const kvp_frame *frame)
+{
+    if (!frame || !kvp_frame_get_hash(frame)
+            || g_hash_table_size(kvp_frame_get_hash(frame)) == 0)
+        return;
+
+    gnc_xml_writer_start(writer, tag);
+    g_hash_table_foreach_sorted(kvp_frame_get_hash(frame), writer_kvp_slot,
+                                writer, (GCompareFunc)strcmp);
+    gnc_xml_writer_end(writer, tag);
+}
@@ -0,0 +1,85 @@
+/********************************************************************\
+ * io-gncxml-writer.h -- stream xml straight from engine objects    *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+
+/* The writer produces exactly the bytes that xmlElemDump, followed by
+ * a newline, produces for the DOM tree built by the matching
+ * *_dom_tree_create function, without building the tree.  Elements
+ * hold either text or other elements, never both, and are indented by
+ * two spaces per level as libxml2 does.  Output is collected in a
+ * large buffer and written out in big blocks, or kept in memory by
+ * a writer without a file.
+ *
+ * The typed helpers mirror the generators in sixtp-dom-generators.c;
+ * keep the two in step.
+ */
+
+#ifndef IO_GNCXML_WRITER_H
+#define IO_GNCXML_WRITER_H
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "gnc-commodity.h"
+#include "qof.h"
+
+typedef struct _GncXmlWriter GncXmlWriter;
+
+/* With a NULL out, the output is kept in memory until it is taken
+ * with gnc_xml_writer_free_to_string. */
+GncXmlWriter *gnc_xml_writer_new(FILE *out);
+
+/* Writes out what is buffered.  Returns FALSE if any write has
+ * failed. */
+gboolean gnc_xml_writer_flush(GncXmlWriter *writer);
+
+/* Flushes and frees the writer.  Returns FALSE if any write has
+ * failed. */
+gboolean gnc_xml_writer_destroy(GncXmlWriter *writer);
+
+/* Frees a writer without a file and returns what it wrote. */
+GString *gnc_xml_writer_free_to_string(GncXmlWriter *writer);
+
+/* Element primitives.  Attributes must follow the start of their
+ * element; the value is expected to be plain ASCII. */
+void gnc_xml_writer_start(GncXmlWriter *writer, const char *tag);
+void gnc_xml_writer_attribute(GncXmlWriter *writer, const char *name,
+                              const char *value);
+void gnc_xml_writer_text(GncXmlWriter *writer, const char *text);
+void gnc_xml_writer_end(GncXmlWriter *writer, const char *tag);
+
+/* Like xmlNewTextChild: a NULL text gives an empty element, "" gives
+ * an element with an empty text. */
+void gnc_xml_writer_text_element(GncXmlWriter *writer, const char *tag,
+                                 const char *text);
+
+void gnc_xml_writer_guid(GncXmlWriter *writer, const char *tag,
+                         const GncGUID *guid);
+void gnc_xml_writer_commodity_ref(GncXmlWriter *writer, const char *tag,
+                                  const gnc_commodity *c);
+void gnc_xml_writer_timespec(GncXmlWriter *writer, const char *tag,
+                             const Timespec *ts);
+void gnc_xml_writer_numeric(GncXmlWriter *writer, const char *tag,
+                            gnc_numeric num);
+void gnc_xml_writer_kvp_frame(GncXmlWriter *writer, const char *tag,
+                              const kvp_frame *frame);
+
+#endif /* IO_GNCXML_WRITER_H */
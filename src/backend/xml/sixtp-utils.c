@@ -393,39 +393,6 @@ simple_chars_only_parser_new(sixtp_end_handler end_handler)
 }
 
 
-#ifdef HAVE_TIMEGM
-#  define gnc_timegm timegm
-#else /* !HAVE_TIMEGM */
-
-/* This code originates from GLib 2.12, gtimer.c and works until the year 2100
- * or the system-dependent maximal date that can be represented by a time_t,
- * whatever comes first.  The old implementation called mktime after setting
- * the environment variable TZ to UTC.  It did not work on Windows, at least.
- */
-static const gint days_before[] =
-{
-    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
-};
-
-static time_t
-gnc_timegm (struct tm *tm)
-{
-    time_t retval;
-    if (tm->tm_mon < 0 || tm->tm_mon > 11)
-        return (time_t) - 1;
-
-    retval = (tm->tm_year - 70) * 365;
-    retval += (tm->tm_year - 68) / 4;
-    retval += days_before[tm->tm_mon] + tm->tm_mday - 1;
-
-    if (tm->tm_year % 4 == 0 && tm->tm_mon < 2)
-        retval -= 1;
-
-    retval = ((((retval * 24) + tm->tm_hour) * 60) + tm->tm_min) * 60 + tm->tm_sec;
-
-    return retval;
-}
-#endif /* HAVE_TIMEGM */
 
 
 /****************************************************************************/
@@ -451,7 +418,7 @@ string_to_timespec_secs(const gchar *str, Timespec *ts)
 
     struct tm parsed_time;
     const gchar *strpos;
-    time_t parsed_secs;
+    gint64 parsed_secs;
     long int gmtoff;
 
     if (!str || !ts) return FALSE;
@@ -495,9 +462,12 @@ string_to_timespec_secs(const gchar *str, Timespec *ts)
         parsed_time.tm_isdst = -1;
     }
 
-    parsed_secs = gnc_timegm(&parsed_time);
-
-    if (parsed_secs == (time_t) - 1) return(FALSE);
+    parsed_secs = gnc_date_civil_to_secs(parsed_time.tm_year + 1900,
+                                         parsed_time.tm_mon + 1,
+                                         parsed_time.tm_mday,
+                                         parsed_time.tm_hour,
+                                         parsed_time.tm_min,
+                                         parsed_time.tm_sec);
 
     parsed_secs -= gmtoff;
 
@@ -534,7 +504,6 @@ timespec_secs_to_given_string (const Timespec *ts, gchar *str)
 {
     struct tm parsed_time;
     size_t num_chars;
-    time_t tmp_time;
     long int tz;
     int minutes;
     int hours;
@@ -543,20 +512,21 @@ timespec_secs_to_given_string (const Timespec *ts, gchar *str)
     if (!ts || !str)
         return FALSE;
 
-    tmp_time = ts->tv_sec;
+    /* This runs for every date written, so rather than localtime and
+     * strftime, use the cached time zone offsets and print
+     * TIMESPEC_TIME_FORMAT by hand.  %Y is not zero padded. */
+    tz = gnc_timezone_at (ts->tv_sec);
+    gnc_date_secs_to_civil (ts->tv_sec - tz, &parsed_time);
 
-    if (!localtime_r(&tmp_time, &parsed_time))
-        return FALSE;
-
-    num_chars = qof_strftime(str, TIMESPEC_SEC_FORMAT_MAX,
-                             TIMESPEC_TIME_FORMAT, &parsed_time);
-    if (num_chars == 0)
-        return FALSE;
+    num_chars = g_snprintf (str, TIMESPEC_SEC_FORMAT_MAX,
+                            "%d-%02d-%02d %02d:%02d:%02d",
+                            parsed_time.tm_year + 1900,
+                            parsed_time.tm_mon + 1, parsed_time.tm_mday,
+                            parsed_time.tm_hour, parsed_time.tm_min,
+                            parsed_time.tm_sec);
 
     str += num_chars;
 
-    tz = gnc_timezone (&parsed_time);
-
     /* gnc_timezone is seconds west of UTC */
     sign = (tz > 0) ? -1 : 1;
 
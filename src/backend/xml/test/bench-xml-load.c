@@ -0,0 +1,154 @@
+/*
+ * bench-xml-load.c -- Time loading a large XML v2 book.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Usage: bench-xml-load [transactions] [threads]
+ *
+ * Saves a random book with 'transactions' transactions (100000 by
+ * default) to a temporary file, then loads it once on a single thread
+ * (GNC_XML_LOAD_THREADS=0) and once through the loader pipeline, with
+ * 'threads' worker threads if given.  The time taken by each load is
+ * printed, and the two books are checked to hold the same number of
+ * transactions.  This is not run as part of "make check". */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "cashobjects.h"
+#include "TransLog.h"
+#include "gnc-engine.h"
+#include "test-engine-stuff.h"
+
+#define GNC_LIB_NAME "gncmod-backend-xml"
+
+static int
+count_trans (Transaction *trans, gpointer data)
+{
+    int *count = data;
+    (*count)++;
+    return 0;
+}
+
+static int
+load_book (const char *url, const char *threads)
+{
+    QofSession *session;
+    GTimer *timer;
+    int count = 0;
+
+    if (threads)
+        g_setenv ("GNC_XML_LOAD_THREADS", threads, TRUE);
+    else
+        g_unsetenv ("GNC_XML_LOAD_THREADS");
+
+    session = qof_session_new ();
+    qof_session_begin (session, url, TRUE, FALSE, FALSE);
+
+    timer = g_timer_new ();
+    qof_session_load (session, NULL);
+    g_timer_stop (timer);
+
+    if (qof_session_get_error (session) != ERR_BACKEND_NO_ERR)
+    {
+        g_printerr ("Loading failed with error %d\n",
+                    qof_session_get_error (session));
+        exit (1);
+    }
+    xaccAccountTreeForEachTransaction (
+        gnc_book_get_root_account (qof_session_get_book (session)),
+        count_trans, &count);
+
+    printf ("%-12s %8.3f s  %8d transactions\n",
+            threads ? threads : "default", g_timer_elapsed (timer, NULL),
+            count);
+
+    g_timer_destroy (timer);
+    qof_session_end (session);
+    qof_session_destroy (session);
+    return count;
+}
+
+int
+main (int argc, char **argv)
+{
+    QofSession *session;
+    gchar *filename, *url, *name;
+    const char *threads = NULL;
+    int n_trans = 100000;
+    int serial, pipelined;
+
+    if (argc > 1)
+        n_trans = atoi (argv[1]);
+    if (argc > 2)
+        threads = argv[2];
+
+#ifndef HAVE_GLIB_2_36
+    g_type_init ();
+#endif
+#ifndef HAVE_GLIB_2_32
+    g_thread_init (NULL);
+#endif
+    qof_init ();
+    cashobjects_register ();
+    if (!qof_load_backend_library ("../.libs/", GNC_LIB_NAME))
+    {
+        g_printerr ("Cannot load the xml backend\n");
+        return 1;
+    }
+    xaccLogDisable ();
+    srand (0);
+
+    name = g_strdup_printf ("bench-xml-load-%d.gnucash", (int) getpid ());
+    filename = g_build_filename (g_get_tmp_dir (), name, NULL);
+    g_free (name);
+    url = g_strdup_printf ("xml://%s", filename);
+
+    session = get_random_session ();
+    add_random_transactions_to_book (qof_session_get_book (session), n_trans);
+    qof_session_begin (session, url, TRUE, TRUE, TRUE);
+    qof_session_save (session, NULL);
+    if (qof_session_get_error (session) != ERR_BACKEND_NO_ERR)
+    {
+        g_printerr ("Saving %s failed with error %d\n", filename,
+                    qof_session_get_error (session));
+        return 1;
+    }
+    qof_session_end (session);
+    qof_session_destroy (session);
+
+    serial = load_book (url, "0");
+    pipelined = load_book (url, threads);
+
+    g_unlink (filename);
+    g_free (filename);
+    g_free (url);
+    qof_close ();
+
+    if (serial != pipelined)
+    {
+        g_printerr ("The loads disagree\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * bench-xml-save.c -- Time writing the transactions of a large book.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Usage: bench-xml-save [transactions] [threads]
+ *
+ * Builds a random book with 'transactions' transactions (100000 by
+ * default) and writes them all to temporary files twice: once by
+ * building and dumping a DOM tree for each, as the file backend used
+ * to, and once through the streaming writer.  Prints the time and
+ * throughput of each and checks that the two files are identical.
+ *
+ * Then saves the whole book, plain and compressed, once on a single
+ * thread (GNC_XML_SAVE_THREADS=0) and once with the saver threads,
+ * 'threads' of them if given, and checks that the files hold the same
+ * text.  This is not run as part of "make check". */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include "cashobjects.h"
+#include "TransLog.h"
+#include "gnc-engine.h"
+#include "gnc-xml.h"
+#include "io-gncxml-v2.h"
+#include "qofbackend-p.h"
+#include "test-engine-stuff.h"
+
+static int
+dump_trans (Transaction *trans, gpointer data)
+{
+    FILE *out = data;
+    xmlNodePtr node = gnc_transaction_dom_tree_create (trans);
+
+    xmlElemDump (out, NULL, node);
+    xmlFreeNode (node);
+    fprintf (out, "\n");
+    return 0;
+}
+
+static int
+stream_trans (Transaction *trans, gpointer data)
+{
+    gnc_transaction_write (data, trans);
+    return 0;
+}
+
+static gchar *
+contents (FILE *f, long *len)
+{
+    gchar *buf;
+
+    fflush (f);
+    *len = ftell (f);
+    rewind (f);
+    buf = g_malloc (*len);
+    *len = fread (buf, 1, *len, f);
+    return buf;
+}
+
+/* Reads a file, compressed or not. */
+static GString *
+file_text (const char *filename)
+{
+    GString *text = g_string_new (NULL);
+    gzFile file = gzopen (filename, "rb");
+    char buf[65536];
+    int len;
+
+    while ((len = gzread (file, buf, sizeof (buf))) > 0)
+        g_string_append_len (text, buf, len);
+    gzclose (file);
+    return text;
+}
+
+static GString *
+save_book (QofBook *book, const char *filename, gboolean compress,
+           const char *threads)
+{
+    GTimer *timer;
+    gchar *what;
+
+    if (threads)
+        g_setenv ("GNC_XML_SAVE_THREADS", threads, TRUE);
+    else
+        g_unsetenv ("GNC_XML_SAVE_THREADS");
+
+    timer = g_timer_new ();
+    if (!gnc_book_write_to_xml_file_v2 (book, filename, compress))
+    {
+        g_printerr ("Saving %s failed\n", filename);
+        exit (1);
+    }
+    g_timer_stop (timer);
+
+    what = g_strdup_printf ("%s, %s", compress ? "gzip" : "plain",
+                            threads ? threads : "default");
+    printf ("%-20s %8.3f s\n", what, g_timer_elapsed (timer, NULL));
+    g_free (what);
+    g_timer_destroy (timer);
+    return file_text (filename);
+}
+
+static gboolean
+compare_saves (QofBook *book, gboolean compress, const char *threads)
+{
+    gchar *name, *filename;
+    GString *serial, *parallel;
+    gboolean same;
+
+    name = g_strdup_printf ("bench-xml-save-%d.gnucash", (int) getpid ());
+    filename = g_build_filename (g_get_tmp_dir (), name, NULL);
+    g_free (name);
+
+    serial = save_book (book, filename, compress, "0");
+    parallel = save_book (book, filename, compress, threads);
+    same = g_string_equal (serial, parallel);
+    if (!same)
+        g_printerr ("The saves differ\n");
+
+    g_unlink (filename);
+    g_free (filename);
+    g_string_free (serial, TRUE);
+    g_string_free (parallel, TRUE);
+    return same;
+}
+
+static void
+report (const char *what, GTimer *timer, long bytes)
+{
+    gdouble secs = g_timer_elapsed (timer, NULL);
+
+    printf ("%-10s %8.3f s  %8.1f MB/s\n", what, secs,
+            secs > 0 ? bytes / secs / 1e6 : 0.0);
+}
+
+int
+main (int argc, char **argv)
+{
+    QofSession *session;
+    QofBackend be;
+    Account *root;
+    GncXmlWriter *writer;
+    GTimer *timer;
+    FILE *dumped, *streamed;
+    gchar *dumped_str, *streamed_str;
+    long dumped_len, streamed_len;
+    const char *threads = NULL;
+    int n_trans = 100000;
+    gboolean same;
+
+    if (argc > 1)
+        n_trans = atoi (argv[1]);
+    if (argc > 2)
+        threads = argv[2];
+
+#ifndef HAVE_GLIB_2_36
+    g_type_init ();
+#endif
+#ifndef HAVE_GLIB_2_32
+    g_thread_init (NULL);
+#endif
+
+    qof_init ();
+    cashobjects_register ();
+    xaccLogDisable ();
+    srand (0);
+
+    session = get_random_session ();
+    add_random_transactions_to_book (qof_session_get_book (session), n_trans);
+    root = gnc_book_get_root_account (qof_session_get_book (session));
+
+    dumped = tmpfile ();
+    streamed = tmpfile ();
+    timer = g_timer_new ();
+
+    xaccAccountTreeForEachTransaction (root, dump_trans, dumped);
+    fflush (dumped);
+    g_timer_stop (timer);
+    report ("dom", timer, ftell (dumped));
+
+    g_timer_start (timer);
+    writer = gnc_xml_writer_new (streamed);
+    xaccAccountTreeForEachTransaction (root, stream_trans, writer);
+    gnc_xml_writer_destroy (writer);
+    fflush (streamed);
+    g_timer_stop (timer);
+    report ("streaming", timer, ftell (streamed));
+
+    dumped_str = contents (dumped, &dumped_len);
+    streamed_str = contents (streamed, &streamed_len);
+    same = dumped_len == streamed_len
+           && memcmp (dumped_str, streamed_str, dumped_len) == 0;
+    printf ("%ld bytes, %s\n", dumped_len,
+            same ? "identical" : "THE OUTPUTS DIFFER");
+
+    g_free (dumped_str);
+    g_free (streamed_str);
+    fclose (dumped);
+    fclose (streamed);
+    g_timer_destroy (timer);
+
+    /* Writing a book wants a backend to report progress to. */
+    memset (&be, 0, sizeof (be));
+    qof_backend_init (&be);
+    qof_book_set_backend (qof_session_get_book (session), &be);
+    if (!compare_saves (qof_session_get_book (session), FALSE, threads)
+            || !compare_saves (qof_session_get_book (session), TRUE, threads))
+        same = FALSE;
+    qof_book_set_backend (qof_session_get_book (session), NULL);
+    qof_session_end (session);
+    qof_session_destroy (session);
+    qof_close ();
+    return same ? 0 : 1;
+}
@@ -27,6 +27,7 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/types.h>
@@ -366,6 +367,53 @@ test_add_transaction(const char *tag, gpointer globaldata, gpointer data)
     return retval;
 }
 
+static gchar *
+read_back_file(FILE *f, long *len)
+{
+    gchar *buf;
+
+    fflush(f);
+    *len = ftell(f);
+    rewind(f);
+    buf = g_malloc(*len + 1);
+    *len = fread(buf, 1, *len, f);
+    buf[*len] = '\0';
+    return buf;
+}
+
+/* The streaming writer must produce exactly what dumping the DOM tree
+ * does. */
+static gboolean
+streamed_same_as_dumped(xmlNodePtr node, Transaction *trn)
+{
+    FILE *dumped = tmpfile();
+    FILE *streamed = tmpfile();
+    GncXmlWriter *writer;
+    gchar *dumped_str, *streamed_str;
+    long dumped_len, streamed_len;
+    gboolean same;
+
+    xmlElemDump(dumped, NULL, node);
+    fprintf(dumped, "\n");
+
+    writer = gnc_xml_writer_new(streamed);
+    gnc_transaction_write(writer, trn);
+    gnc_xml_writer_destroy(writer);
+
+    dumped_str = read_back_file(dumped, &dumped_len);
+    streamed_str = read_back_file(streamed, &streamed_len);
+    same = dumped_len == streamed_len
+           && memcmp(dumped_str, streamed_str, dumped_len) == 0;
+    if (!same)
+        printf("dumped:\n%s\nstreamed:\n%s\n", dumped_str, streamed_str);
+
+    g_free(dumped_str);
+    g_free(streamed_str);
+    fclose(dumped);
+    fclose(streamed);
+    return same;
+}
+
 static void
 test_transaction(void)
 {
@@ -440,6 +488,9 @@ test_transaction(void)
             success_args("transaction_xml", __FILE__, __LINE__, "%d", i );
         }
 
+        do_test_args(streamed_same_as_dumped(test_node, ran_trn),
+                     "transaction_xml streamed", __FILE__, __LINE__, "%d", i);
+
         filename1 = g_strdup_printf("test_file_XXXXXX");
 
         fd = g_mkstemp(filename1);
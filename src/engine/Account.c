@@ -47,6 +47,10 @@ static QofLogModule log_module = GNC_MOD_ACCOUNT;
 static gchar account_separator[8] = ".";
 gunichar account_uc_separator = ':';
 
+/* Bumped whenever the separator changes, so that cached full names and
+ * full name indexes built with the old one are thrown away. */
+static guint account_separator_serial = 0;
+
 enum
 {
     LAST_SIGNAL
@@ -154,6 +158,21 @@ typedef struct AccountPrivate
      * in any way desired.  Handy for specialty traversals of the
      * account tree. */
     short mark;
+
+    /* The account's full name, built the first time it is asked for
+     * and thrown away whenever the account or one of its ancestors is
+     * renamed or moved, or the separator changes. */
+    gchar *full_name;
+    guint full_name_serial;
+
+    /* Only used on the root of a tree: its accounts indexed by full
+     * name, name and code.  Each maps the string to a list of the
+     * accounts that have it.  They are built by the first lookup and
+     * kept up to date from then on. */
+    GHashTable *full_name_index;
+    GHashTable *name_index;
+    GHashTable *code_index;
+    guint index_serial;
 } AccountPrivate;
 
 #define GET_PRIVATE(o)  \
@@ -197,11 +216,15 @@ gnc_set_account_separator (const gchar *separator)
     uc = g_utf8_get_char_validated(separator, -1);
     if ((uc == (gunichar) - 2) || (uc == (gunichar) - 1) || g_unichar_isalnum(uc))
     {
+        if (account_uc_separator != ':')
+            account_separator_serial++;
         account_uc_separator = ':';
         strcpy(account_separator, ":");
         return;
     }
 
+    if (uc != account_uc_separator)
+        account_separator_serial++;
     account_uc_separator = uc;
     count = g_unichar_to_utf8(uc, account_separator);
     account_separator[count] = '\0';
@@ -284,6 +307,196 @@ mark_account (Account *acc)
     qof_instance_set_dirty(&acc->inst);
 }
 
+/********************************************************************\
+ * Full names and the name indexes                                  *
+\********************************************************************/
+
+/* Returns the account's cached full name, building it from the
+ * parent's if it is missing or stale.  The root has no name. */
+static const gchar *
+account_full_name (const Account *acc)
+{
+    AccountPrivate *priv, *ppriv;
+
+    priv = GET_PRIVATE(acc);
+    if (!priv->parent)
+        return "";
+    if (priv->full_name && priv->full_name_serial == account_separator_serial)
+        return priv->full_name;
+
+    g_free(priv->full_name);
+    ppriv = GET_PRIVATE(priv->parent);
+    if (!ppriv->parent)
+        priv->full_name = g_strdup(priv->accountName);
+    else
+        priv->full_name = g_strconcat(account_full_name(priv->parent),
+                                      account_separator,
+                                      priv->accountName, NULL);
+    priv->full_name_serial = account_separator_serial;
+    return priv->full_name;
+}
+
+static void
+account_forget_full_names (Account *acc)
+{
+    AccountPrivate *priv;
+    GList *node;
+
+    priv = GET_PRIVATE(acc);
+    g_free(priv->full_name);
+    priv->full_name = NULL;
+    for (node = priv->children; node; node = node->next)
+        account_forget_full_names(node->data);
+}
+
+static void
+account_index_add (GHashTable *index, const gchar *key, Account *acc)
+{
+    GList *accounts;
+
+    /* Most accounts have no code; those stay out of the index. */
+    if (!key || !*key)
+        return;
+    accounts = g_hash_table_lookup(index, key);
+    g_hash_table_insert(index, g_strdup(key), g_list_prepend(accounts, acc));
+}
+
+static void
+account_index_remove (GHashTable *index, const gchar *key, Account *acc)
+{
+    GList *accounts;
+
+    if (!key || !*key)
+        return;
+    accounts = g_list_remove(g_hash_table_lookup(index, key), acc);
+    if (accounts)
+        g_hash_table_insert(index, g_strdup(key), accounts);
+    else
+        g_hash_table_remove(index, key);
+}
+
+static void
+account_index_free_list (gpointer key, gpointer value, gpointer user_data)
+{
+    g_list_free(value);
+}
+
+static void
+account_free_index (GHashTable *index)
+{
+    if (!index)
+        return;
+    g_hash_table_foreach(index, account_index_free_list, NULL);
+    g_hash_table_destroy(index);
+}
+
+static void
+account_free_indexes (AccountPrivate *rpriv)
+{
+    account_free_index(rpriv->full_name_index);
+    account_free_index(rpriv->name_index);
+    account_free_index(rpriv->code_index);
+    rpriv->full_name_index = NULL;
+    rpriv->name_index = NULL;
+    rpriv->code_index = NULL;
+}
+
+/* Returns TRUE if the root's indexes exist and are current.  Indexes
+ * built with an old separator are thrown away. */
+static gboolean
+account_tree_is_indexed (AccountPrivate *rpriv)
+{
+    if (!rpriv->full_name_index)
+        return FALSE;
+    if (rpriv->index_serial == account_separator_serial)
+        return TRUE;
+    account_free_indexes(rpriv);
+    return FALSE;
+}
+
+/* Adds or removes an account and all its descendants to or from the
+ * indexes of the tree's root, if it has any. */
+static void
+account_index_tree_helper (AccountPrivate *rpriv, Account *acc, gboolean add)
+{
+    AccountPrivate *priv;
+    GList *node;
+
+    priv = GET_PRIVATE(acc);
+    if (add)
+    {
+        account_index_add(rpriv->full_name_index, account_full_name(acc), acc);
+        account_index_add(rpriv->name_index, priv->accountName, acc);
+        account_index_add(rpriv->code_index, priv->accountCode, acc);
+    }
+    else
+    {
+        account_index_remove(rpriv->full_name_index, account_full_name(acc), acc);
+        account_index_remove(rpriv->name_index, priv->accountName, acc);
+        account_index_remove(rpriv->code_index, priv->accountCode, acc);
+    }
+    for (node = priv->children; node; node = node->next)
+        account_index_tree_helper(rpriv, node->data, add);
+}
+
+static void
+account_index_tree (Account *acc, gboolean add)
+{
+    AccountPrivate *rpriv;
+
+    rpriv = GET_PRIVATE(gnc_account_get_root(acc));
+    if (GET_PRIVATE(acc)->parent && account_tree_is_indexed(rpriv))
+        account_index_tree_helper(rpriv, acc, add);
+}
+
+/* Returns the root's private data with its indexes built. */
+static AccountPrivate *
+account_tree_indexes (const Account *any_acc)
+{
+    AccountPrivate *rpriv;
+    GList *node;
+
+    rpriv = GET_PRIVATE(gnc_account_get_root((Account *)any_acc));
+    if (account_tree_is_indexed(rpriv))
+        return rpriv;
+
+    rpriv->full_name_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                             g_free, NULL);
+    rpriv->name_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                        g_free, NULL);
+    rpriv->code_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                        g_free, NULL);
+    rpriv->index_serial = account_separator_serial;
+    for (node = rpriv->children; node; node = node->next)
+        account_index_tree_helper(rpriv, node->data, TRUE);
+    return rpriv;
+}
+
+/* Looks a key up in an index and returns the one account below
+ * 'parent' that has it.  Sets 'ambiguous' if there is more than one,
+ * leaving the caller to choose between them. */
+static Account *
+account_index_lookup (GHashTable *index, const Account *parent,
+                      const gchar *key, gboolean *ambiguous)
+{
+    Account *found = NULL;
+    GList *node;
+
+    *ambiguous = FALSE;
+    for (node = g_hash_table_lookup(index, key); node; node = node->next)
+    {
+        if (node->data == parent || !xaccAccountHasAncestor(node->data, parent))
+            continue;
+        if (found)
+        {
+            *ambiguous = TRUE;
+            return NULL;
+        }
+        found = node->data;
+    }
+    return found;
+}
+
 /********************************************************************\
 \********************************************************************/
 
@@ -324,6 +537,11 @@ gnc_account_init(Account* acc)
 
     priv->splits = NULL;
     priv->sort_dirty = FALSE;
+
+    priv->full_name = NULL;
+    priv->full_name_index = NULL;
+    priv->name_index = NULL;
+    priv->code_index = NULL;
 }
 
 static void
@@ -1149,6 +1367,10 @@ xaccFreeAccount (Account *acc)
     CACHE_REPLACE(priv->accountCode, NULL);
     CACHE_REPLACE(priv->description, NULL);
 
+    g_free(priv->full_name);
+    priv->full_name = NULL;
+    account_free_indexes(priv);
+
     /* zero out values, just in case stray
      * pointers are pointing here. */
 
@@ -2158,7 +2380,10 @@ xaccAccountSetName (Account *acc, const char *str)
         return;
 
     xaccAccountBeginEdit(acc);
+    account_index_tree(acc, FALSE);
     CACHE_REPLACE(priv->accountName, str);
+    account_forget_full_names(acc);
+    account_index_tree(acc, TRUE);
     mark_account (acc);
     xaccAccountCommitEdit(acc);
 }
@@ -2166,7 +2391,7 @@ xaccAccountSetName (Account *acc, const char *str)
 void
 xaccAccountSetCode (Account *acc, const char *str)
 {
-    AccountPrivate *priv;
+    AccountPrivate *priv, *rpriv;
 
     /* errors */
     g_return_if_fail(GNC_IS_ACCOUNT(acc));
@@ -2177,7 +2402,12 @@ xaccAccountSetCode (Account *acc, const char *str)
         return;
 
     xaccAccountBeginEdit(acc);
+    rpriv = GET_PRIVATE(gnc_account_get_root(acc));
+    if (priv->parent && account_tree_is_indexed(rpriv))
+        account_index_remove(rpriv->code_index, priv->accountCode, acc);
     CACHE_REPLACE(priv->accountCode, str ? str : "");
+    if (priv->parent && account_tree_is_indexed(rpriv))
+        account_index_add(rpriv->code_index, priv->accountCode, acc);
     mark_account (acc);
     xaccAccountCommitEdit(acc);
 }
@@ -2445,6 +2675,12 @@ gnc_account_append_child (Account *new_parent, Account *child)
     }
     cpriv->parent = new_parent;
     ppriv->children = g_list_append(ppriv->children, child);
+
+    /* The child's tree is now part of the new parent's. */
+    account_free_indexes(cpriv);
+    account_forget_full_names(child);
+    account_index_tree(child, TRUE);
+
     qof_instance_set_dirty(&new_parent->inst);
     qof_instance_set_dirty(&child->inst);
 
@@ -2480,6 +2716,8 @@ gnc_account_remove_child (Account *parent, Account *child)
         return;
     }
 
+    account_index_tree(child, FALSE);
+
     /* Gather event data */
     ed.node = parent;
     ed.idx = g_list_index(ppriv->children, child);
@@ -2491,6 +2729,7 @@ gnc_account_remove_child (Account *parent, Account *child)
 
     /* clear the account's parent pointer after REMOVE event generation. */
     cpriv->parent = NULL;
+    account_forget_full_names(child);
 
     qof_event_gen (&parent->inst, QOF_EVENT_MODIFY, NULL);
 }
@@ -2675,16 +2914,15 @@ gnc_account_get_descendants_sorted (const Account *account)
     return descendants;
 }
 
-Account *
-gnc_account_lookup_by_name (const Account *parent, const char * name)
+/* Walks the tree the way the lookups are documented to, to choose
+ * between several accounts with the same name. */
+static Account *
+account_lookup_by_name_scan (const Account *parent, const char * name)
 {
     AccountPrivate *cpriv, *ppriv;
     Account *child, *result;
     GList *node;
 
-    g_return_val_if_fail(GNC_IS_ACCOUNT(parent), NULL);
-    g_return_val_if_fail(name, NULL);
-
     /* first, look for accounts hanging off the current node */
     ppriv = GET_PRIVATE(parent);
     for (node = ppriv->children; node; node = node->next)
@@ -2700,7 +2938,7 @@ gnc_account_lookup_by_name (const Account *parent, const char * name)
     for (node = ppriv->children; node; node = node->next)
     {
         child = node->data;
-        result = gnc_account_lookup_by_name (child, name);
+        result = account_lookup_by_name_scan (child, name);
         if (result)
             return result;
     }
@@ -2708,16 +2946,13 @@ gnc_account_lookup_by_name (const Account *parent, const char * name)
     return NULL;
 }
 
-Account *
-gnc_account_lookup_by_code (const Account *parent, const char * code)
+static Account *
+account_lookup_by_code_scan (const Account *parent, const char * code)
 {
     AccountPrivate *cpriv, *ppriv;
     Account *child, *result;
     GList *node;
 
-    g_return_val_if_fail(GNC_IS_ACCOUNT(parent), NULL);
-    g_return_val_if_fail(code, NULL);
-
     /* first, look for accounts hanging off the current node */
     ppriv = GET_PRIVATE(parent);
     for (node = ppriv->children; node; node = node->next)
@@ -2733,7 +2968,7 @@ gnc_account_lookup_by_code (const Account *parent, const char * code)
     for (node = ppriv->children; node; node = node->next)
     {
         child = node->data;
-        result = gnc_account_lookup_by_code (child, code);
+        result = account_lookup_by_code_scan (child, code);
         if (result)
             return result;
     }
@@ -2741,6 +2976,46 @@ gnc_account_lookup_by_code (const Account *parent, const char * code)
     return NULL;
 }
 
+Account *
+gnc_account_lookup_by_name (const Account *parent, const char * name)
+{
+    AccountPrivate *rpriv;
+    Account *found;
+    gboolean ambiguous;
+
+    g_return_val_if_fail(GNC_IS_ACCOUNT(parent), NULL);
+    g_return_val_if_fail(name, NULL);
+
+    /* Empty names aren't indexed. */
+    if (!*name)
+        return account_lookup_by_name_scan(parent, name);
+    rpriv = account_tree_indexes(parent);
+    found = account_index_lookup(rpriv->name_index, parent, name, &ambiguous);
+    if (ambiguous)
+        return account_lookup_by_name_scan(parent, name);
+    return found;
+}
+
+Account *
+gnc_account_lookup_by_code (const Account *parent, const char * code)
+{
+    AccountPrivate *rpriv;
+    Account *found;
+    gboolean ambiguous;
+
+    g_return_val_if_fail(GNC_IS_ACCOUNT(parent), NULL);
+    g_return_val_if_fail(code, NULL);
+
+    /* Empty codes aren't indexed. */
+    if (!*code)
+        return account_lookup_by_code_scan(parent, code);
+    rpriv = account_tree_indexes(parent);
+    found = account_index_lookup(rpriv->code_index, parent, code, &ambiguous);
+    if (ambiguous)
+        return account_lookup_by_code_scan(parent, code);
+    return found;
+}
+
 /********************************************************************\
  * Fetch an account, given its full name                            *
 \********************************************************************/
@@ -2791,21 +3066,27 @@ Account *
 gnc_account_lookup_by_full_name (const Account *any_acc,
                                  const gchar *name)
 {
-    const AccountPrivate *rpriv;
+    AccountPrivate *rpriv;
     const Account *root;
     Account *found;
+    GList *accounts;
     gchar **names;
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(any_acc), NULL);
     g_return_val_if_fail(name, NULL);
 
-    root = any_acc;
-    rpriv = GET_PRIVATE(root);
-    while (rpriv->parent)
+    /* Empty names aren't indexed. */
+    if (*name)
     {
-        root = rpriv->parent;
-        rpriv = GET_PRIVATE(root);
+        rpriv = account_tree_indexes(any_acc);
+        accounts = g_hash_table_lookup(rpriv->full_name_index, name);
+        if (!accounts || !accounts->next)
+            return accounts ? accounts->data : NULL;
     }
+
+    /* Several accounts share the name, or it is empty; pick the one
+     * the search by components finds first. */
+    root = gnc_account_get_root((Account *)any_acc);
     names = g_strsplit(name, gnc_get_account_separator_string(), -1);
     found = gnc_account_lookup_by_full_name_helper(root, names);
     g_strfreev(names);
@@ -2936,12 +3217,6 @@ xaccAccountGetName (const Account *acc)
 gchar *
 gnc_account_get_full_name(const Account *account)
 {
-    AccountPrivate *priv;
-    const Account *a;
-    char *fullname;
-    gchar **names;
-    int level;
-
     /* So much for hardening the API. Too many callers to this function don't
      * bother to check if they have a non-NULL pointer before calling. */
     if (NULL == account)
@@ -2950,35 +3225,7 @@ gnc_account_get_full_name(const Account *account)
     /* errors */
     g_return_val_if_fail(GNC_IS_ACCOUNT(account), g_strdup(""));
 
-    /* optimizations */
-    priv = GET_PRIVATE(account);
-    if (!priv->parent)
-        return g_strdup("");
-
-    /* Figure out how much space is needed by counting the nodes up to
-     * the root. */
-    level = 0;
-    for (a = account; a; a = priv->parent)
-    {
-        priv = GET_PRIVATE(a);
-        level++;
-    }
-
-    /* Get all the pointers in the right order. The root node "entry"
-     * becomes the terminating NULL pointer for the array of strings. */
-    names = g_malloc(level * sizeof(gchar *));
-    names[--level] = NULL;
-    for (a = account; level > 0; a = priv->parent)
-    {
-        priv = GET_PRIVATE(a);
-        names[--level] = priv->accountName;
-    }
-
-    /* Build the full name */
-    fullname =  g_strjoinv(account_separator, names);
-    g_free(names);
-
-    return fullname;
+    return g_strdup(account_full_name(account));
 }
 
 const char *
@@ -3178,6 +3425,10 @@ xaccAccountGetBalanceAsOfDate (Account *acc, time_t date)
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
 
+    /* The walk below needs all of the account's splits, which a
+     * backend loading transactions as needed may not have read yet. */
+    qof_backend_run_load_related (qof_book_get_backend (qof_instance_get_book (acc)),
+                                  QOF_INSTANCE (acc));
     xaccAccountSortSplits (acc, TRUE); /* just in case, normally a noop */
     xaccAccountRecomputeBalance (acc); /* just in case, normally a noop */
 
@@ -3233,6 +3484,55 @@ xaccAccountGetBalanceAsOfDate (Account *acc, time_t date)
     return( balance );
 }
 
+void
+xaccAccountGetBalancesAsOfDates (Account *acc, const time_t *dates,
+                                 guint n_dates, gnc_numeric *balances)
+{
+    AccountPrivate *priv;
+    GList   *lp;
+    Timespec ts, trans_ts;
+    guint i;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+    g_return_if_fail(dates || n_dates == 0);
+    g_return_if_fail(balances || n_dates == 0);
+
+    qof_backend_run_load_related (qof_book_get_backend (qof_instance_get_book (acc)),
+                                  QOF_INSTANCE (acc));
+    xaccAccountSortSplits (acc, TRUE); /* just in case, normally a noop */
+    xaccAccountRecomputeBalance (acc); /* just in case, normally a noop */
+
+    priv = GET_PRIVATE(acc);
+    lp = priv->splits;
+    ts.tv_nsec = 0;
+
+    for (i = 0; i < n_dates; i++)
+    {
+        /* Start over if the dates go backwards. */
+        if (i > 0 && dates[i] < dates[i - 1])
+            lp = priv->splits;
+
+        /* Find the first split at or past the date, as
+         * xaccAccountGetBalanceAsOfDate does. */
+        ts.tv_sec = dates[i];
+        while (lp)
+        {
+            xaccTransGetDatePostedTS( xaccSplitGetParent( (Split *)lp->data ),
+                                      &trans_ts );
+            if ( timespec_cmp( &trans_ts, &ts ) >= 0 )
+                break;
+            lp = lp->next;
+        }
+
+        if (!lp)
+            balances[i] = priv->balance;
+        else if (lp->prev)
+            balances[i] = xaccSplitGetBalance( (Split *)lp->prev->data );
+        else
+            balances[i] = gnc_numeric_zero();
+    }
+}
+
 /*
  * Originally gsr_account_present_balance in gnc-split-reg.c
  *
@@ -4559,6 +4859,7 @@ gnc_account_copy_children (Account *to, Account *from)
         to_priv->children = g_list_append(to_priv->children, to_acc);
 
         GET_PRIVATE(to_acc)->parent = to;
+        account_index_tree(to_acc, TRUE);
         qof_instance_set_dirty(&to_acc->inst);
 
         /* Copy child accounts too. */
@@ -554,6 +554,12 @@ gnc_numeric xaccAccountGetProjectedMinimumBalance (const Account *account);
 /** Get the balance of the account as of the date specified */
 gnc_numeric xaccAccountGetBalanceAsOfDate (Account *account,
         time_t date);
+/** Get the balance of the account as of each of the dates, as
+    xaccAccountGetBalanceAsOfDate would, in one walk over the splits
+    if the dates are in increasing order. */
+void xaccAccountGetBalancesAsOfDates (Account *account,
+                                      const time_t *dates, guint n_dates,
+                                      gnc_numeric *balances);
 
 /* These two functions convert a given balance from one commodity to
    another.  The account argument is only used to get the Book, and
@@ -93,140 +93,196 @@ xaccQueryGetSplitsUniqueTrans(QofQuery *q)
  * we require some or all splits to match
  ********************************************************************/
 
-static void
-query_match_all_filter_func(gpointer key, gpointer value, gpointer user_data)
+/* How to find the splits of a transaction or lot */
+typedef struct
+{
+    QofIdTypeConst type;
+    SplitList * (*get_splits) (gpointer owner);
+    /* Optional; FALSE for the splits on the list which do not count */
+    gboolean (*has_split) (gpointer owner, Split *split);
+    /* The owner of a split, or NULL */
+    gpointer (*get_owner) (Split *split);
+} SplitOwnerType;
+
+typedef struct
+{
+    const QofQuery *q;
+    query_txn_match_t runtype;
+    const SplitOwnerType *owner_type;
+    GList *matches;
+} OwnerMatchData;
+
+/* Returns TRUE if any (QUERY_TXN_MATCH_ANY) or all (QUERY_TXN_MATCH_ALL)
+ * of the splits of owner match the query, stopping at the first split
+ * which decides it.  A transaction or lot without splits never matches. */
+static gboolean
+query_match_splits (const OwnerMatchData *data, gpointer owner)
 {
-    Transaction * t = key;
-    int         num_matches = GPOINTER_TO_INT(value);
-    GList       ** matches = user_data;
+    const SplitOwnerType *ot = data->owner_type;
+    SplitList *node;
+    gboolean any_split = FALSE;
 
-    if (num_matches == xaccTransCountSplits(t))
+    for (node = ot->get_splits (owner); node; node = node->next)
     {
-        *matches = g_list_prepend(*matches, t);
+        Split *split = node->data;
+        gboolean match;
+
+        if (ot->has_split && !ot->has_split (owner, split))
+            continue;
+        any_split = TRUE;
+
+        match = qof_query_object_matches (data->q, split);
+        if (data->runtype == QUERY_TXN_MATCH_ALL)
+        {
+            if (!match) return FALSE;
+        }
+        else if (match)
+            return TRUE;
     }
+    return any_split && data->runtype == QUERY_TXN_MATCH_ALL;
 }
 
 static void
-query_match_any_filter_func(gpointer key, gpointer value, gpointer user_data)
+query_match_owner (QofInstance *owner, gpointer user_data)
 {
-    Transaction * t = key;
-    GList       ** matches = user_data;
-    *matches = g_list_prepend(*matches, t);
+    OwnerMatchData *data = user_data;
+
+    if (query_match_splits (data, owner))
+        data->matches = g_list_prepend (data->matches, owner);
 }
 
-TransList *
-xaccQueryGetTransactions (QofQuery * q, query_txn_match_t runtype)
+static SplitList *
+trans_get_splits (gpointer trans)
 {
-    GList       * splits = qof_query_run(q);
-    GList       * current = NULL;
-    GList       * retval = NULL;
-    GHashTable  * trans_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
-    Transaction * trans = NULL;
-    gpointer    val = NULL;
-    int         count = 0;
-
-    /* iterate over matching splits, incrementing a match-count in
-     * the hash table */
-    for (current = splits; current; current = current->next)
-    {
-        trans = xaccSplitGetParent((Split *)(current->data));
+    return xaccTransGetSplitList (trans);
+}
 
-        /* don't waste time looking up unless we need the count
-         * information */
-        if (runtype == QUERY_TXN_MATCH_ALL)
-        {
-            val   = g_hash_table_lookup(trans_hash, trans);
-            count = GPOINTER_TO_INT(val);
-        }
-        g_hash_table_insert(trans_hash, trans, GINT_TO_POINTER(count + 1));
-    }
+static gboolean
+trans_has_split (gpointer trans, Split *split)
+{
+    return xaccTransStillHasSplit (trans, split);
+}
 
-    /* now pick out the transactions that match */
-    if (runtype == QUERY_TXN_MATCH_ALL)
-    {
-        g_hash_table_foreach(trans_hash, query_match_all_filter_func,
-                             &retval);
-    }
-    else
-    {
-        g_hash_table_foreach(trans_hash, query_match_any_filter_func,
-                             &retval);
-    }
+static SplitList *
+lot_get_splits (gpointer lot)
+{
+    return gnc_lot_get_split_list (lot);
+}
 
-    g_hash_table_destroy(trans_hash);
+static gpointer
+split_get_trans (Split *split)
+{
+    return xaccSplitGetParent (split);
+}
 
-    return retval;
+static gpointer
+split_get_lot (Split *split)
+{
+    return xaccSplitGetLot (split);
 }
 
-/********************************************************************
- * xaccQueryGetLots
- * Get lots matching the query terms, specifying whether
- * we require some or all splits to match
- ********************************************************************/
+static const SplitOwnerType trans_owner_type =
+{
+    GNC_ID_TRANS, trans_get_splits, trans_has_split, split_get_trans
+};
+
+static const SplitOwnerType lot_owner_type =
+{
+    GNC_ID_LOT, lot_get_splits, NULL, split_get_lot
+};
 
+/* Checks the owners of the candidate splits of 'book', each once.  An
+ * owner without a candidate split has no split that can match, so it
+ * can't match either way. */
 static void
-query_match_all_lot_filter_func(gpointer key, gpointer value, gpointer user_data)
+query_match_candidate_owners (OwnerMatchData *data, GList *candidates)
 {
-    GNCLot *	l = key;
-    int		num_matches = GPOINTER_TO_INT(value);
-    GList **	matches = user_data;
+    GHashTable *seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GList *node;
 
-    if (num_matches == gnc_lot_count_splits(l))
+    for (node = candidates; node; node = node->next)
     {
-        *matches = g_list_prepend(*matches, l);
+        gpointer owner = data->owner_type->get_owner (node->data);
+
+        if (!owner || g_hash_table_lookup (seen, owner))
+            continue;
+        g_hash_table_insert (seen, owner, owner);
+        query_match_owner (owner, data);
     }
+    g_hash_table_destroy (seen);
 }
 
-static void
-query_match_any_lot_filter_func(gpointer key, gpointer value, gpointer user_data)
+/* Checks the splits of each transaction or lot in the books of the
+ * split query 'q' and returns those that match, sorted by 'compare' if
+ * it is not NULL.  When an index can narrow the query's splits, only
+ * the owners of those splits are checked. */
+static GList *
+query_get_split_owners (QofQuery *q, query_txn_match_t runtype,
+                        const SplitOwnerType *owner_type, GCompareFunc compare)
 {
-    GNCLot *	t = key;
-    GList **	matches = user_data;
-    *matches = g_list_prepend(*matches, t);
-}
+    OwnerMatchData data;
+    GList *node;
 
-LotList *
-xaccQueryGetLots (QofQuery * q, query_txn_match_t runtype)
-{
-    GList       * splits = qof_query_run(q);
-    GList       * current = NULL;
-    GList       * retval = NULL;
-    GHashTable  * lot_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
-    GNCLot      * lot = NULL;
-    gpointer    val = NULL;
-    int         count = 0;
-
-    /* iterate over matching splits, incrementing a match-count in
-     * the hash table */
-    for (current = splits; current; current = current->next)
+    g_return_val_if_fail (q, NULL);
+    g_return_val_if_fail (!safe_strcmp (qof_query_get_search_for (q),
+                                        GNC_ID_SPLIT), NULL);
+
+    qof_query_prepare (q);
+
+    data.q = q;
+    data.runtype = runtype;
+    data.owner_type = owner_type;
+    data.matches = NULL;
+    for (node = qof_query_get_books (q); node; node = node->next)
     {
-        lot = xaccSplitGetLot((Split *)(current->data));
+        GList *candidates = NULL;
 
-        /* don't waste time looking up unless we need the count
-         * information */
-        if (runtype == QUERY_TXN_MATCH_ALL)
+        if (qof_query_get_candidates (q, node->data, &candidates))
         {
-            val   = g_hash_table_lookup(lot_hash, lot);
-            count = GPOINTER_TO_INT(val);
+            query_match_candidate_owners (&data, candidates);
+            g_list_free (candidates);
         }
-        g_hash_table_insert(lot_hash, lot, GINT_TO_POINTER(count + 1));
+        else
+            qof_collection_foreach (qof_book_get_collection (node->data,
+                                    owner_type->type),
+                                    query_match_owner, &data);
     }
 
-    /* now pick out the transactions that match */
-    if (runtype == QUERY_TXN_MATCH_ALL)
-    {
-        g_hash_table_foreach(lot_hash, query_match_all_lot_filter_func,
-                             &retval);
-    }
-    else
-    {
-        g_hash_table_foreach(lot_hash, query_match_any_lot_filter_func,
-                             &retval);
-    }
+    if (compare)
+        data.matches = g_list_sort (data.matches, compare);
+    return data.matches;
+}
 
-    g_hash_table_destroy(lot_hash);
+TransList *
+xaccQueryGetTransactions (QofQuery * q, query_txn_match_t runtype)
+{
+    return query_get_split_owners (q, runtype, &trans_owner_type, NULL);
+}
+
+TransList *
+xaccQueryGetTransactionsSorted (QofQuery * q, query_txn_match_t runtype,
+                                GCompareFunc compare)
+{
+    return query_get_split_owners (q, runtype, &trans_owner_type, compare);
+}
 
-    return retval;
+/********************************************************************
+ * xaccQueryGetLots
+ * Get lots matching the query terms, specifying whether
+ * we require some or all splits to match
+ ********************************************************************/
+
+LotList *
+xaccQueryGetLots (QofQuery * q, query_txn_match_t runtype)
+{
+    return query_get_split_owners (q, runtype, &lot_owner_type, NULL);
+}
+
+LotList *
+xaccQueryGetLotsSorted (QofQuery * q, query_txn_match_t runtype,
+                        GCompareFunc compare)
+{
+    return query_get_split_owners (q, runtype, &lot_owner_type, compare);
 }
 
 /*******************************************************************
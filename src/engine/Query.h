@@ -87,6 +87,19 @@ SplitList   * xaccQueryGetSplitsUniqueTrans(QofQuery *q);
  */
 TransList   * xaccQueryGetTransactions(QofQuery * q, query_txn_match_t type);
 
+/**
+ * The xaccQueryGetTransactionsSorted() routine is just like
+ *    GetTransactions() except that the list is sorted with compare,
+ *    e.g. xaccTransOrder.  Both check the splits of each transaction
+ *    in the query's books, stopping at the first split which matches
+ *    (ANY) or does not (ALL), rather than running the split query and
+ *    collecting the transactions of its results.  The sort order and
+ *    maximum number of results of the query itself are not used.
+ */
+TransList   * xaccQueryGetTransactionsSorted(QofQuery * q,
+        query_txn_match_t type,
+        GCompareFunc compare);
+
 /**
  * The xaccQueryGetLots() routine is just like GetTransactions() except
  *    it returns a list of Lots.
@@ -94,6 +107,13 @@ TransList   * xaccQueryGetTransactions(QofQuery * q, query_txn_match_t type);
  */
 LotList     * xaccQueryGetLots(QofQuery * q, query_txn_match_t type);
 
+/**
+ * The xaccQueryGetLotsSorted() routine is just like GetLots() except
+ *    that the list is sorted with compare.
+ */
+LotList     * xaccQueryGetLotsSorted(QofQuery * q, query_txn_match_t type,
+                                     GCompareFunc compare);
+
 /*******************************************************************
  *  match-adding API
  *******************************************************************/
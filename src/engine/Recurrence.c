@@ -388,6 +388,114 @@ recurrenceGetAccountPeriodValue(const Recurrence *r, Account *acc, guint n)
     return xaccAccountGetBalanceChangeForPeriod (acc, t1, t2, TRUE);
 }
 
+/* For recurrenceGetAccountPeriodValues: the balances of each account at
+ * the start and end of each period, found once per account, and the
+ * sums being rolled up for one account. */
+typedef struct
+{
+    const time_t *dates;
+    guint n_dates;
+    GHashTable *balances;       /* Account -> gnc_numeric[n_dates] */
+    const gnc_commodity *report_commodity;
+    gnc_numeric *sums;
+} PeriodValuesData;
+
+static const gnc_numeric *
+period_values_balances(PeriodValuesData *data, Account *acc)
+{
+    gnc_numeric *balances = g_hash_table_lookup(data->balances, acc);
+
+    if (!balances)
+    {
+        balances = g_new(gnc_numeric, data->n_dates);
+        xaccAccountGetBalancesAsOfDates(acc, data->dates, data->n_dates,
+                                        balances);
+        g_hash_table_insert(data->balances, acc, balances);
+    }
+    return balances;
+}
+
+/* Sums as xaccAccountGetBalanceAsOfDateInCurrency does for children. */
+static void
+period_values_add_child(Account *acc, gpointer user_data)
+{
+    PeriodValuesData *data = user_data;
+    const gnc_numeric *balances = period_values_balances(data, acc);
+    const gnc_commodity *commodity = xaccAccountGetCommodity(acc);
+    guint i;
+
+    for (i = 0; i < data->n_dates; i++)
+        data->sums[i] = gnc_numeric_add(
+                            data->sums[i],
+                            xaccAccountConvertBalanceToCurrency(
+                                acc, balances[i], commodity,
+                                data->report_commodity),
+                            gnc_commodity_get_fraction(data->report_commodity),
+                            GNC_HOW_RND_ROUND_HALF_UP);
+}
+
+gnc_numeric *
+recurrenceGetAccountPeriodValues(const Recurrence *r, GList *accounts,
+                                 guint num_periods, gboolean include_children)
+{
+    PeriodValuesData data;
+    time_t *dates;
+    gnc_numeric *values, *row;
+    GList *node;
+    guint i;
+
+    g_return_val_if_fail(r, NULL);
+
+    values = g_new(gnc_numeric, g_list_length(accounts) * num_periods);
+
+    /* The start and end of each period, as
+     * recurrenceGetAccountPeriodValue takes them. */
+    dates = g_new(time_t, 2 * num_periods);
+    for (i = 0; i < num_periods; i++)
+    {
+        dates[2 * i] = recurrenceGetPeriodTime(r, i, FALSE);
+        dates[2 * i + 1] = recurrenceGetPeriodTime(r, i, TRUE);
+    }
+
+    data.dates = dates;
+    data.n_dates = 2 * num_periods;
+    data.balances = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                          NULL, g_free);
+    data.sums = g_new(gnc_numeric, data.n_dates);
+
+    for (node = accounts, row = values; node;
+            node = node->next, row += num_periods)
+    {
+        Account *acc = node->data;
+        const gnc_numeric *balances;
+
+        data.report_commodity = xaccAccountGetCommodity(acc);
+        if (!data.report_commodity)
+        {
+            for (i = 0; i < num_periods; i++)
+                row[i] = gnc_numeric_zero();
+            continue;
+        }
+
+        balances = period_values_balances(&data, acc);
+        for (i = 0; i < data.n_dates; i++)
+            data.sums[i] = balances[i];
+        if (include_children)
+            gnc_account_foreach_descendant(acc, period_values_add_child,
+                                           &data);
+
+        /* As xaccAccountGetBalanceChangeForPeriod subtracts them. */
+        for (i = 0; i < num_periods; i++)
+            row[i] = gnc_numeric_sub(data.sums[2 * i + 1], data.sums[2 * i],
+                                     GNC_DENOM_AUTO, GNC_HOW_DENOM_FIXED);
+    }
+
+    g_free(data.sums);
+    g_hash_table_destroy(data.balances);
+    g_free(dates);
+    return values;
+}
+
 void
 recurrenceListNextInstance(const GList *rlist, const GDate *ref, GDate *next)
 {
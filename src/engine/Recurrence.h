@@ -144,6 +144,16 @@ time_t recurrenceGetPeriodTime(const Recurrence *r, guint n, gboolean end);
 gnc_numeric recurrenceGetAccountPeriodValue(const Recurrence *r,
         Account *acct, guint n);
 
+/** @return the values recurrenceGetAccountPeriodValue would give for
+ * the first num_periods instances of the Recurrence, for each of the
+ * accounts in turn, with sub-accounts included only if
+ * include_children is set.  The splits of each account are walked
+ * once.  The g_list_length(accounts) * num_periods values are to be
+ * freed with g_free.
+ **/
+gnc_numeric *recurrenceGetAccountPeriodValues(const Recurrence *r,
+        GList *accounts, guint num_periods, gboolean include_children);
+
 /** @return the earliest of the next occurances -- a "composite" recurrence **/
 void recurrenceListNextInstance(const GList *r, const GDate *refDate,
                                 GDate *nextDate);
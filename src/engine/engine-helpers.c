@@ -31,6 +31,7 @@
 #include "Account.h"
 #include "engine-helpers.h"
 #include "glib-helpers.h"
+#include "gnc-budget.h"
 #include "gnc-date.h"
 #include "gnc-engine.h"
 #include "guile-mappings.h"
@@ -2413,3 +2414,49 @@ qof_session_to_scm (const QofSession *session)
 {
     return gnc_generic_to_scm(session, "_p_QofSession");
 }
+
+SCM
+gnc_budget_account_values_to_scm (const GncBudget *budget,
+                                  const Account *account)
+{
+    guint i, num_periods = gnc_budget_get_num_periods (budget);
+    gnc_numeric *values = g_new (gnc_numeric, num_periods);
+    gboolean *is_set = g_new (gboolean, num_periods);
+    SCM list = SCM_EOL;
+
+    gnc_budget_get_account_period_values (budget, account, num_periods,
+                                          values, is_set);
+    for (i = num_periods; i > 0; i--)
+        list = scm_cons (is_set[i - 1] ? gnc_numeric_to_scm (values[i - 1])
+                         : SCM_BOOL_F, list);
+
+    g_free (values);
+    g_free (is_set);
+    return list;
+}
+
+SCM
+gnc_budget_accounts_actuals_to_scm (const GncBudget *budget,
+                                    AccountList *accounts,
+                                    gboolean include_children)
+{
+    guint i, num_periods = gnc_budget_get_num_periods (budget);
+    gnc_numeric *actuals, *row;
+    AccountList *node;
+    SCM rows = SCM_EOL;
+
+    actuals = gnc_budget_get_period_actual_values (budget, accounts,
+              include_children);
+    for (node = accounts, row = actuals; node;
+            node = node->next, row += num_periods)
+    {
+        SCM periods = SCM_EOL;
+
+        for (i = num_periods; i > 0; i--)
+            periods = scm_cons (gnc_numeric_to_scm (row[i - 1]), periods);
+        rows = scm_cons (periods, rows);
+    }
+
+    g_free (actuals);
+    return scm_reverse (rows);
+}
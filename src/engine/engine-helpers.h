@@ -30,6 +30,7 @@
 
 #include "gnc-engine.h"
 #include "Account.h"
+#include "gnc-budget.h"
 #include "Query.h"
 #include "Transaction.h"
 
@@ -75,4 +76,15 @@ SCM gnc_commodity_to_scm (const gnc_commodity *commodity);
 SCM gnc_book_to_scm (const QofBook *book);
 SCM qof_session_to_scm (const QofSession *session);
 
+/* A list of the account's budget values, one per period, with #f for
+ * the periods that are not set. */
+SCM gnc_budget_account_values_to_scm (const GncBudget *budget,
+                                      const Account *account);
+
+/* For each account, a list of its actual values in each budget period,
+ * as gnc_budget_get_period_actual_values finds them. */
+SCM gnc_budget_accounts_actuals_to_scm (const GncBudget *budget,
+                                        AccountList *accounts,
+                                        gboolean include_children);
+
 #endif
@@ -8,6 +8,7 @@
 #include <guile-mappings.h>
 #include <gnc-budget.h>
 #include <gnc-commodity.h>
+#include <gnc-duplicate-finder.h>
 #include <gnc-engine.h>
 #include <gnc-filepath-utils.h>
 #include <gnc-pricedb.h>
@@ -65,7 +66,10 @@ functions. */
 
 %newobject xaccQueryGetSplitsUniqueTrans;
 %newobject xaccQueryGetTransactions;
+%newobject xaccQueryGetTransactionsSorted;
 %newobject xaccQueryGetLots;
+%newobject xaccQueryGetLotsSorted;
+%newobject gnc_duplicate_finder_find;
 
 %newobject xaccSplitGetCorrAccountFullName;
 %newobject gnc_numeric_to_string;
@@ -107,6 +111,7 @@ SplitList * qof_query_run_subquery (QofQuery *q, const QofQuery *q);
 %typemap(in) QofQueryParamList * "$1 = gnc_query_scm2path($input);"
 
 %include <Query.h>
+%include <gnc-duplicate-finder.h>
 %ignore qof_query_run;
 %ignore qof_query_last_run;
 %ignore qof_query_run_subquery;
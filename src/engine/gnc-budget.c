@@ -26,6 +26,7 @@
 #include <glib.h>
 #include <glib/gprintf.h>
 #include <glib/gi18n.h>
+#include <string.h>
 #include <time.h>
 #include "qof.h"
 #include "qofbookslots.h"
@@ -52,6 +53,23 @@ struct budget_s
     QofInstance inst;
 };
 
+/* A dense copy of the account period values kept in the budget's
+ * slots, so that reading one needs neither a path to be formatted
+ * nor frames to be walked.  It is built from the slots when first
+ * needed and dropped whenever they may have changed: by the setters,
+ * and when an edit is committed or fails to commit.  The slots remain
+ * what is saved.  The backends fill the slots in while loading,
+ * before the budget is read. */
+typedef struct
+{
+    guint width;            /* periods per row */
+    guint n_rows;
+    guint capacity;         /* rows allocated */
+    GHashTable *rows;       /* account GncGUID -> row number + 1 */
+    gnc_numeric *values;    /* capacity * width values, row by row */
+    guint32 *is_set;        /* one bit per value */
+} BudgetValues;
+
 typedef struct
 {
     QofInstanceClass parent_class;
@@ -70,6 +88,9 @@ typedef struct BudgetPrivate
 
     /* Number of periods */
     guint  num_periods;
+
+    /* The values of the slots, or NULL until they are read. */
+    BudgetValues *values;
 } BudgetPrivate;
 
 #define GET_PRIVATE(o) \
@@ -105,9 +126,15 @@ gnc_budget_dispose (GObject *budgetp)
     G_OBJECT_CLASS(gnc_budget_parent_class)->dispose(budgetp);
 }
 
+static void budget_values_free(BudgetValues *bv);
+
 static void
 gnc_budget_finalize(GObject* budgetp)
 {
+    BudgetPrivate* priv = GET_PRIVATE(budgetp);
+
+    budget_values_free(priv->values);
+    priv->values = NULL;
     G_OBJECT_CLASS(gnc_budget_parent_class)->finalize(budgetp);
 }
 
@@ -233,8 +260,19 @@ gnc_budget_class_init(GncBudgetClass* klass)
                               G_PARAM_READWRITE));
 }
 
+/* Drops the values, to be built again from the slots when next read. */
+static void
+gnc_budget_invalidate_values(GncBudget *budget)
+{
+    BudgetPrivate* priv = GET_PRIVATE(budget);
+
+    budget_values_free(priv->values);
+    priv->values = NULL;
+}
+
 static void commit_err (QofInstance *inst, QofBackendError errcode)
 {
+    gnc_budget_invalidate_values(GNC_BUDGET(inst));
     PERR ("Failed to commit: %d", errcode);
     gnc_engine_signal_commit_error( errcode );
 }
@@ -272,14 +310,24 @@ gnc_budget_begin_edit(GncBudget *bgt)
     qof_begin_edit(QOF_INSTANCE(bgt));
 }
 
-void
-gnc_budget_commit_edit(GncBudget *bgt)
+/* Commits an edit made by one of the setters below, which keep the
+ * values up to date themselves. */
+static void
+gnc_budget_commit_own_edit(GncBudget *bgt)
 {
     if (!qof_commit_edit(QOF_INSTANCE(bgt))) return;
     qof_commit_edit_part2(QOF_INSTANCE(bgt), commit_err,
                           noop, gnc_budget_free);
 }
 
+void
+gnc_budget_commit_edit(GncBudget *bgt)
+{
+    /* The caller may have changed the slots directly. */
+    gnc_budget_invalidate_values(bgt);
+    gnc_budget_commit_own_edit(bgt);
+}
+
 GncBudget*
 gnc_budget_new(QofBook *book)
 {
@@ -375,7 +423,7 @@ gnc_budget_set_name(GncBudget* budget, const gchar* name)
     gnc_budget_begin_edit(budget);
     CACHE_REPLACE(priv->name, name);
     qof_instance_set_dirty(&budget->inst);
-    gnc_budget_commit_edit(budget);
+    gnc_budget_commit_own_edit(budget);
 
     qof_event_gen( &budget->inst, QOF_EVENT_MODIFY, NULL);
 }
@@ -400,7 +448,7 @@ gnc_budget_set_description(GncBudget* budget, const gchar* description)
     gnc_budget_begin_edit(budget);
     CACHE_REPLACE(priv->description, description);
     qof_instance_set_dirty(&budget->inst);
-    gnc_budget_commit_edit(budget);
+    gnc_budget_commit_own_edit(budget);
 
     qof_event_gen( &budget->inst, QOF_EVENT_MODIFY, NULL);
 }
@@ -423,7 +471,7 @@ gnc_budget_set_recurrence(GncBudget *budget, const Recurrence *r)
     gnc_budget_begin_edit(budget);
     priv->recurrence = *r;
     qof_instance_set_dirty(&budget->inst);
-    gnc_budget_commit_edit(budget);
+    gnc_budget_commit_own_edit(budget);
 
     qof_event_gen(&budget->inst, QOF_EVENT_MODIFY, NULL);
 }
@@ -456,7 +504,7 @@ gnc_budget_set_num_periods(GncBudget* budget, guint num_periods)
     gnc_budget_begin_edit(budget);
     priv->num_periods = num_periods;
     qof_instance_set_dirty(&budget->inst);
-    gnc_budget_commit_edit(budget);
+    gnc_budget_commit_own_edit(budget);
 
     qof_event_gen( &budget->inst, QOF_EVENT_MODIFY, NULL);
 }
@@ -471,6 +519,235 @@ gnc_budget_get_num_periods(const GncBudget* budget)
 #define BUF_SIZE (10 + GUID_ENCODING_LENGTH + \
    GNC_BUDGET_MAX_NUM_PERIODS_DIGITS)
 
+#define VALUE_IS_SET(bv, cell) \
+   (((bv)->is_set[(cell) / 32] >> ((cell) % 32)) & 1)
+
+/* Values of periods past this, which no budget has, stay in the slots
+ * alone and are looked up there. */
+#define MAX_VALUES_WIDTH 1000
+
+static void
+budget_values_free(BudgetValues *bv)
+{
+    if (!bv) return;
+    g_hash_table_destroy(bv->rows);
+    g_free(bv->values);
+    g_free(bv->is_set);
+    g_free(bv);
+}
+
+/* Returns the row of the account, adding one if asked to, or -1. */
+static gint
+budget_values_row(BudgetValues *bv, const GncGUID *guid, gboolean create)
+{
+    gpointer row = g_hash_table_lookup(bv->rows, guid);
+    guint old_words, new_words;
+
+    if (row)
+        return GPOINTER_TO_INT(row) - 1;
+    if (!create)
+        return -1;
+
+    if (bv->n_rows == bv->capacity)
+    {
+        old_words = (bv->capacity * bv->width + 31) / 32;
+        bv->capacity = MAX(16, 2 * bv->capacity);
+        new_words = (bv->capacity * bv->width + 31) / 32;
+        bv->values = g_renew(gnc_numeric, bv->values,
+                             bv->capacity * bv->width);
+        bv->is_set = g_renew(guint32, bv->is_set, new_words);
+        memset(bv->is_set + old_words, 0,
+               (new_words - old_words) * sizeof(guint32));
+    }
+    g_hash_table_insert(bv->rows, g_memdup(guid, sizeof(GncGUID)),
+                        GINT_TO_POINTER(bv->n_rows + 1));
+    return bv->n_rows++;
+}
+
+static void
+budget_values_store(BudgetValues *bv, guint row, guint period_num,
+                    gboolean is_set, gnc_numeric val)
+{
+    guint cell = row * bv->width + period_num;
+
+    if (is_set)
+    {
+        bv->values[cell] = val;
+        bv->is_set[cell / 32] |= 1u << (cell % 32);
+    }
+    else
+        bv->is_set[cell / 32] &= ~(1u << (cell % 32));
+}
+
+/* Only the keys that the setters format can be found by path. */
+static gboolean
+period_from_key(const gchar *key, guint *period_num)
+{
+    gchar *end;
+    guint64 num;
+
+    if (!g_ascii_isdigit(key[0]) || (key[0] == '0' && key[1] != '\0'))
+        return FALSE;
+    num = g_ascii_strtoull(key, &end, 10);
+    if (*end != '\0' || num > G_MAXINT)
+        return FALSE;
+    *period_num = num;
+    return TRUE;
+}
+
+static gboolean
+account_from_key(const gchar *key, KvpValue *value, GncGUID *guid)
+{
+    gchar buf[GUID_ENCODING_LENGTH + 1];
+
+    if (kvp_value_get_type(value) != KVP_TYPE_FRAME
+            || !string_to_guid(key, guid))
+        return FALSE;
+    guid_to_string_buff(guid, buf);
+    return strcmp(buf, key) == 0;
+}
+
+typedef struct
+{
+    BudgetValues *bv;
+    gint row;
+} BuildValuesData;
+
+static void
+measure_period_cb(const gchar *key, KvpValue *value, gpointer user_data)
+{
+    BuildValuesData *data = user_data;
+    guint period_num;
+
+    if (period_from_key(key, &period_num) && period_num >= data->bv->width
+            && period_num < MAX_VALUES_WIDTH)
+        data->bv->width = period_num + 1;
+}
+
+static void
+measure_account_cb(const gchar *key, KvpValue *value, gpointer user_data)
+{
+    GncGUID guid;
+
+    if (account_from_key(key, value, &guid))
+        kvp_frame_for_each_slot(kvp_value_get_frame(value),
+                                measure_period_cb, user_data);
+}
+
+static void
+fill_period_cb(const gchar *key, KvpValue *value, gpointer user_data)
+{
+    BuildValuesData *data = user_data;
+    guint period_num;
+
+    /* kvp_frame_get_numeric gives zero for values of other types. */
+    if (period_from_key(key, &period_num) && period_num < data->bv->width)
+        budget_values_store(data->bv, data->row, period_num, TRUE,
+                            kvp_value_get_type(value) == KVP_TYPE_NUMERIC ?
+                            kvp_value_get_numeric(value) :
+                            gnc_numeric_zero());
+}
+
+static void
+fill_account_cb(const gchar *key, KvpValue *value, gpointer user_data)
+{
+    BuildValuesData *data = user_data;
+    GncGUID guid;
+
+    if (!account_from_key(key, value, &guid))
+        return;
+    data->row = budget_values_row(data->bv, &guid, TRUE);
+    kvp_frame_for_each_slot(kvp_value_get_frame(value),
+                            fill_period_cb, data);
+}
+
+static BudgetValues *
+budget_values_new(KvpFrame *frame, guint num_periods)
+{
+    BuildValuesData data;
+
+    data.bv = g_new0(BudgetValues, 1);
+    data.bv->width = MAX(num_periods, 1);
+    data.bv->rows = g_hash_table_new_full(guid_hash_to_guint,
+                                          guid_g_hash_table_equal,
+                                          g_free, NULL);
+
+    /* Values past the budget's periods are kept as well. */
+    kvp_frame_for_each_slot(frame, measure_account_cb, &data);
+    kvp_frame_for_each_slot(frame, fill_account_cb, &data);
+    return data.bv;
+}
+
+/* Returns the budget's values, building them if need be. */
+static BudgetValues *
+gnc_budget_get_values(const GncBudget *budget)
+{
+    BudgetPrivate* priv = GET_PRIVATE(budget);
+
+    if (!priv->values)
+        priv->values = budget_values_new(qof_instance_get_slots(QOF_INSTANCE(budget)),
+                                         priv->num_periods);
+    return priv->values;
+}
+
+/* Returns TRUE and the value if it is set. */
+static gboolean
+gnc_budget_lookup_value(const GncBudget *budget, const Account *account,
+                        guint period_num, gnc_numeric *val)
+{
+    BudgetValues *bv = gnc_budget_get_values(budget);
+    gint row;
+    guint cell;
+
+    if (period_num >= MAX_VALUES_WIDTH)
+    {
+        KvpFrame *frame = qof_instance_get_slots(QOF_INSTANCE(budget));
+        gchar path[BUF_SIZE];
+        gchar *bufend;
+
+        bufend = guid_to_string_buff(xaccAccountGetGUID(account), path);
+        g_sprintf(bufend, "/%d", period_num);
+        if (!kvp_frame_get_value(frame, path))
+            return FALSE;
+        *val = kvp_frame_get_numeric(frame, path);
+        return TRUE;
+    }
+    if (period_num >= bv->width)
+        return FALSE;
+    row = budget_values_row(bv, xaccAccountGetGUID(account), FALSE);
+    if (row < 0)
+        return FALSE;
+    cell = row * bv->width + period_num;
+    if (!VALUE_IS_SET(bv, cell))
+        return FALSE;
+    *val = bv->values[cell];
+    return TRUE;
+}
+
+/* Updates the values, if they have been built, after a setter changed
+ * the slot of a single cell. */
+static void
+gnc_budget_store_value(GncBudget *budget, const Account *account,
+                       guint period_num, gboolean is_set, gnc_numeric val)
+{
+    BudgetPrivate* priv = GET_PRIVATE(budget);
+    gint row;
+
+    /* Values that far out are always read from the slots. */
+    if (!priv->values || period_num >= MAX_VALUES_WIDTH)
+        return;
+    if (period_num >= priv->values->width)
+    {
+        /* The rows would have to be widened; build them again instead. */
+        if (is_set)
+            gnc_budget_invalidate_values(budget);
+        return;
+    }
+    row = budget_values_row(priv->values, xaccAccountGetGUID(account), is_set);
+    if (row >= 0)
+        budget_values_store(priv->values, row, period_num, is_set, val);
+}
+
 /* period_num is zero-based */
 /* What happens when account is deleted, after we have an entry for it? */
 void
@@ -489,8 +766,10 @@ gnc_budget_unset_account_period_value(GncBudget *budget, const Account *account,
     g_sprintf(bufend, "/%d", period_num);
 
     kvp_frame_set_value(frame, path, NULL);
+    gnc_budget_store_value(budget, account, period_num, FALSE,
+                           gnc_numeric_zero());
     qof_instance_set_dirty(&budget->inst);
-    gnc_budget_commit_edit(budget);
+    gnc_budget_commit_own_edit(budget);
 
     qof_event_gen( &budget->inst, QOF_EVENT_MODIFY, NULL);
 
@@ -514,11 +793,17 @@ gnc_budget_set_account_period_value(GncBudget *budget, const Account *account,
     g_sprintf(bufend, "/%d", period_num);
 
     if (gnc_numeric_check(val))
+    {
         kvp_frame_set_value(frame, path, NULL);
+        gnc_budget_store_value(budget, account, period_num, FALSE, val);
+    }
     else
+    {
         kvp_frame_set_numeric(frame, path, val);
+        gnc_budget_store_value(budget, account, period_num, TRUE, val);
+    }
     qof_instance_set_dirty(&budget->inst);
-    gnc_budget_commit_edit(budget);
+    gnc_budget_commit_own_edit(budget);
 
     qof_event_gen( &budget->inst, QOF_EVENT_MODIFY, NULL);
 
@@ -559,17 +844,12 @@ gboolean
 gnc_budget_is_account_period_value_set(const GncBudget *budget, const Account *account,
                                        guint period_num)
 {
-    gchar path[BUF_SIZE];
-    gchar *bufend;
-    KvpFrame *frame;
+    gnc_numeric numeric;
 
     g_return_val_if_fail(GNC_IS_BUDGET(budget), FALSE);
     g_return_val_if_fail(account, FALSE);
 
-    frame = qof_instance_get_slots(QOF_INSTANCE(budget));
-    bufend = guid_to_string_buff(xaccAccountGetGUID(account), path);
-    g_sprintf(bufend, "/%d", period_num);
-    return (kvp_frame_get_value(frame, path) != NULL);
+    return gnc_budget_lookup_value(budget, account, period_num, &numeric);
 }
 
 gnc_numeric
@@ -577,23 +857,51 @@ gnc_budget_get_account_period_value(const GncBudget *budget, const Account *acco
                                     guint period_num)
 {
     gnc_numeric numeric;
-    gchar path[BUF_SIZE];
-    gchar *bufend;
-    KvpFrame *frame;
 
     numeric = gnc_numeric_zero();
     g_return_val_if_fail(GNC_IS_BUDGET(budget), numeric);
     g_return_val_if_fail(account, numeric);
 
-    frame = qof_instance_get_slots(QOF_INSTANCE(budget));
-    bufend = guid_to_string_buff(xaccAccountGetGUID(account), path);
-    g_sprintf(bufend, "/%d", period_num);
-
-    numeric = kvp_frame_get_numeric(frame, path);
     /* This still returns zero if unset, but callers can check for that. */
+    if (!gnc_budget_lookup_value(budget, account, period_num, &numeric))
+        numeric = gnc_numeric_zero();
     return numeric;
 }
 
+void
+gnc_budget_get_account_period_values(const GncBudget *budget,
+                                     const Account *account,
+                                     guint num_periods,
+                                     gnc_numeric *values, gboolean *is_set)
+{
+    BudgetValues *bv;
+    gint row;
+    guint i, cell;
+
+    g_return_if_fail(GNC_IS_BUDGET(budget));
+    g_return_if_fail(account);
+
+    bv = gnc_budget_get_values(budget);
+    row = budget_values_row(bv, xaccAccountGetGUID(account), FALSE);
+    for (i = 0; i < num_periods; i++)
+    {
+        gnc_numeric val = gnc_numeric_zero();
+        gboolean set = FALSE;
+
+        if (i >= MAX_VALUES_WIDTH)
+            set = gnc_budget_lookup_value(budget, account, i, &val);
+        else if (row >= 0 && i < bv->width)
+        {
+            cell = row * bv->width + i;
+            set = VALUE_IS_SET(bv, cell);
+            if (set)
+                val = bv->values[cell];
+        }
+        if (values) values[i] = val;
+        if (is_set) is_set[i] = set;
+    }
+}
+
 
 Timespec
 gnc_budget_get_period_start_date(const GncBudget *budget, guint period_num)
@@ -623,6 +931,19 @@ gnc_budget_get_account_period_actual_value(
                                            acc, period_num);
 }
 
+gnc_numeric *
+gnc_budget_get_period_actual_values(const GncBudget *budget, GList *accounts,
+                                    gboolean include_children)
+{
+    BudgetPrivate* priv;
+
+    g_return_val_if_fail(GNC_IS_BUDGET(budget), NULL);
+    priv = GET_PRIVATE(budget);
+    return recurrenceGetAccountPeriodValues(&priv->recurrence, accounts,
+                                            priv->num_periods,
+                                            include_children);
+}
+
 QofBook*
 gnc_budget_get_book(const GncBudget* budget)
 {
@@ -147,9 +147,25 @@ gboolean gnc_budget_is_account_period_value_set(
 
 gnc_numeric gnc_budget_get_account_period_value(
     const GncBudget *budget, const Account *account, guint period_num);
+
+/** Get the values of periods 0 to num_periods - 1 at once.  Either
+ * array may be NULL; unset periods get a zero value. */
+void gnc_budget_get_account_period_values(
+    const GncBudget *budget, const Account *account, guint num_periods,
+    gnc_numeric *values, gboolean *is_set);
+
 gnc_numeric gnc_budget_get_account_period_actual_value(
     const GncBudget *budget, Account *account, guint period_num);
 
+/** Get the actual values of every period for each of the accounts at
+ * once, with those of sub-accounts rolled up if include_children is
+ * set, as gnc_budget_get_account_period_actual_value does.  The splits
+ * of each account are walked once.  Returns the values account by
+ * account, g_list_length(accounts) * num_periods of them, to be
+ * freed with g_free. */
+gnc_numeric *gnc_budget_get_period_actual_values(
+    const GncBudget *budget, GList *accounts, gboolean include_children);
+
 /** Get the book that this budget is associated with. */
 QofBook* gnc_budget_get_book(const GncBudget* budget);
 
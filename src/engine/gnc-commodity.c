@@ -82,6 +82,10 @@ typedef struct CommodityPrivate
     /* the number of accounts using this commodity - this field is not
      * persisted */
     int       usage_count;
+
+    /* the table this commodity has been inserted in, whose indexes
+     * must follow changes to it */
+    gnc_commodity_table * table;
 } CommodityPrivate;
 
 #define GET_PRIVATE(o) \
@@ -113,6 +117,15 @@ struct gnc_commodity_table_s
 {
     GHashTable * ns_table;
     GList      * ns_list;
+
+    /* Secondary indexes over the commodities of every namespace.  Each
+     * maps a string to a list of the commodities that have it; the
+     * quote index is keyed by the internal name of the quote source
+     * and only holds commodities that want quotes. */
+    GHashTable * printname_index;
+    GHashTable * fullname_index;
+    GHashTable * cusip_index;
+    GHashTable * quote_index;
 };
 
 struct gnc_new_iso_code
@@ -604,6 +617,77 @@ reset_unique_name(CommodityPrivate *priv)
                                         priv->mnemonic ? priv->mnemonic : "");
 }
 
+/********************************************************************
+ * secondary indexes of the commodity table
+ ********************************************************************/
+
+static void
+commodity_index_add(GHashTable *index, const char *key, gnc_commodity *cm)
+{
+    GList *list;
+
+    if (!key || !*key) return;
+    list = g_hash_table_lookup(index, key);
+    g_hash_table_insert(index, g_strdup(key), g_list_prepend(list, cm));
+}
+
+static void
+commodity_index_remove(GHashTable *index, const char *key, gnc_commodity *cm)
+{
+    GList *list;
+
+    if (!key || !*key) return;
+    list = g_list_remove(g_hash_table_lookup(index, key), cm);
+    if (list)
+        g_hash_table_insert(index, g_strdup(key), list);
+    else
+        g_hash_table_remove(index, key);
+}
+
+static void
+commodity_index_free_list(gpointer key, gpointer value, gpointer user_data)
+{
+    g_list_free(value);
+}
+
+static void
+commodity_index_destroy(GHashTable *index)
+{
+    g_hash_table_foreach(index, commodity_index_free_list, NULL);
+    g_hash_table_destroy(index);
+}
+
+/* Adds the commodity to, or removes it from, the indexes of the table
+ * it is in.  Setters remove it before changing an indexed field and
+ * add it back afterwards. */
+static void
+commodity_table_index(gnc_commodity *cm, gboolean add)
+{
+    CommodityPrivate *priv = GET_PRIVATE(cm);
+    gnc_commodity_table *table = priv->table;
+    void (*update)(GHashTable *, const char *, gnc_commodity *);
+
+    if (!table) return;
+    update = add ? commodity_index_add : commodity_index_remove;
+
+    update(table->printname_index, priv->printname, cm);
+    update(table->fullname_index, priv->fullname, cm);
+    update(table->cusip_index, priv->cusip, cm);
+    if (priv->quote_flag && priv->quote_source)
+        update(table->quote_index,
+               gnc_quote_source_get_internal_name(priv->quote_source), cm);
+}
+
+/* Takes the commodity out of its table's indexes for good. */
+static void
+commodity_table_forget(gnc_commodity *cm)
+{
+    CommodityPrivate *priv = GET_PRIVATE(cm);
+
+    commodity_table_index(cm, FALSE);
+    priv->table = NULL;
+}
+
 /* GObject Initialization */
 G_DEFINE_TYPE(gnc_commodity, gnc_commodity, QOF_TYPE_INSTANCE);
 
@@ -877,6 +961,7 @@ commodity_free(gnc_commodity * cm)
     book = qof_instance_get_book(&cm->inst);
     table = gnc_commodity_table_get_table(book);
     gnc_commodity_table_remove(table, cm);
+    commodity_table_forget(cm);
     priv = GET_PRIVATE(cm);
 
     qof_event_gen (&cm->inst, QOF_EVENT_DESTROY, NULL);
@@ -1153,12 +1238,14 @@ gnc_commodity_set_mnemonic(gnc_commodity * cm, const char * mnemonic)
     if (priv->mnemonic == mnemonic) return;
 
     gnc_commodity_begin_edit(cm);
+    commodity_table_index(cm, FALSE);
     CACHE_REMOVE (priv->mnemonic);
     priv->mnemonic = CACHE_INSERT(mnemonic);
 
     mark_commodity_dirty (cm);
     reset_printname(priv);
     reset_unique_name(priv);
+    commodity_table_index(cm, TRUE);
     gnc_commodity_commit_edit(cm);
 }
 
@@ -1183,12 +1270,14 @@ gnc_commodity_set_namespace(gnc_commodity * cm, const char * namespace)
         return;
 
     gnc_commodity_begin_edit(cm);
+    commodity_table_index(cm, FALSE);
     priv->namespace = nsp;
     if (nsp->iso4217)
         priv->quote_source = gnc_quote_source_lookup_by_internal("currency");
     mark_commodity_dirty(cm);
     reset_printname(priv);
     reset_unique_name(priv);
+    commodity_table_index(cm, TRUE);
     gnc_commodity_commit_edit(cm);
 }
 
@@ -1205,12 +1294,14 @@ gnc_commodity_set_fullname(gnc_commodity * cm, const char * fullname)
     priv = GET_PRIVATE(cm);
     if (priv->fullname == fullname) return;
 
+    commodity_table_index(cm, FALSE);
     CACHE_REMOVE (priv->fullname);
     priv->fullname = CACHE_INSERT (fullname);
 
     gnc_commodity_begin_edit(cm);
     mark_commodity_dirty(cm);
     reset_printname(priv);
+    commodity_table_index(cm, TRUE);
     gnc_commodity_commit_edit(cm);
 }
 
@@ -1230,8 +1321,10 @@ gnc_commodity_set_cusip(gnc_commodity * cm,
     if (priv->cusip == cusip) return;
 
     gnc_commodity_begin_edit(cm);
+    commodity_table_index(cm, FALSE);
     CACHE_REMOVE (priv->cusip);
     priv->cusip = CACHE_INSERT (cusip);
+    commodity_table_index(cm, TRUE);
     mark_commodity_dirty(cm);
     gnc_commodity_commit_edit(cm);
 }
@@ -1321,7 +1414,9 @@ gnc_commodity_set_quote_flag(gnc_commodity *cm, const gboolean flag)
 
     if (!cm) return;
     gnc_commodity_begin_edit(cm);
+    commodity_table_index(cm, FALSE);
     GET_PRIVATE(cm)->quote_flag = flag;
+    commodity_table_index(cm, TRUE);
     mark_commodity_dirty(cm);
     gnc_commodity_commit_edit(cm);
     LEAVE(" ");
@@ -1338,7 +1433,9 @@ gnc_commodity_set_quote_source(gnc_commodity *cm, gnc_quote_source *src)
 
     if (!cm) return;
     gnc_commodity_begin_edit(cm);
+    commodity_table_index(cm, FALSE);
     GET_PRIVATE(cm)->quote_source = src;
+    commodity_table_index(cm, TRUE);
     mark_commodity_dirty(cm);
     gnc_commodity_commit_edit(cm);
     LEAVE(" ");
@@ -1590,6 +1687,14 @@ gnc_commodity_table_new(void)
     gnc_commodity_table * retval = g_new0(gnc_commodity_table, 1);
     retval->ns_table = g_hash_table_new(&g_str_hash, &g_str_equal);
     retval->ns_list = NULL;
+    retval->printname_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                              g_free, NULL);
+    retval->fullname_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                             g_free, NULL);
+    retval->cusip_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                          g_free, NULL);
+    retval->quote_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                          g_free, NULL);
     return retval;
 }
 
@@ -1751,28 +1856,52 @@ gnc_commodity_table_find_full(const gnc_commodity_table * table,
                               const char * namespace,
                               const char * fullname)
 {
-    gnc_commodity * retval = NULL;
-    GList         * all;
+    gnc_commodity_namespace * nsp;
     GList         * iterator;
 
-    if (!fullname || (fullname[0] == '\0'))
+    if (!table || !fullname || (fullname[0] == '\0'))
         return NULL;
 
-    all = gnc_commodity_table_get_commodities(table, namespace);
+    nsp = gnc_commodity_table_find_namespace(table, namespace);
+    if (!nsp)
+        return NULL;
 
-    for (iterator = all; iterator; iterator = iterator->next)
+    iterator = g_hash_table_lookup(table->printname_index, fullname);
+    for ( ; iterator; iterator = iterator->next)
     {
-        if (!strcmp(fullname,
-                    gnc_commodity_get_printname(iterator->data)))
-        {
-            retval = iterator->data;
-            break;
-        }
+        CommodityPrivate *priv = GET_PRIVATE(iterator->data);
+        if (g_hash_table_lookup(nsp->cm_table, priv->mnemonic) == iterator->data)
+            return iterator->data;
     }
+    return NULL;
+}
 
-    g_list_free (all);
+/********************************************************************
+ * gnc_commodity_table_find_by_fullname
+ * gnc_commodity_table_find_by_cusip
+ * locate a commodity in any namespace by full name or exchange code
+ ********************************************************************/
 
-    return retval;
+gnc_commodity *
+gnc_commodity_table_find_by_fullname(const gnc_commodity_table * table,
+                                     const char * fullname)
+{
+    GList *list;
+
+    if (!table || !fullname) return NULL;
+    list = g_hash_table_lookup(table->fullname_index, fullname);
+    return list ? list->data : NULL;
+}
+
+gnc_commodity *
+gnc_commodity_table_find_by_cusip(const gnc_commodity_table * table,
+                                  const char * cusip)
+{
+    GList *list;
+
+    if (!table || !cusip) return NULL;
+    list = g_hash_table_lookup(table->cusip_index, cusip);
+    return list ? list->data : NULL;
 }
 
 
@@ -1842,6 +1971,9 @@ gnc_commodity_table_insert(gnc_commodity_table * table,
                         (gpointer)comm);
     nsp->cm_list = g_list_append(nsp->cm_list, comm);
 
+    priv->table = table;
+    commodity_table_index(comm, TRUE);
+
     qof_event_gen (&comm->inst, QOF_EVENT_ADD, NULL);
     LEAVE ("(table=%p, comm=%p)", table, comm);
     return comm;
@@ -1877,6 +2009,9 @@ gnc_commodity_table_remove(gnc_commodity_table * table,
     nsp->cm_list = g_list_remove(nsp->cm_list, comm);
     g_hash_table_remove (nsp->cm_table, priv->mnemonic);
     /* XXX minor mem leak, should remove the key as well */
+
+    if (priv->table == table)
+        commodity_table_forget(comm);
 }
 
 /********************************************************************
@@ -2014,39 +2149,54 @@ gnc_commodity_table_get_commodities(const gnc_commodity_table * table,
  * list commodities in a given namespace that get price quotes
  ********************************************************************/
 
-static void
-get_quotables_helper1(gpointer key, gpointer value, gpointer data)
+typedef struct
 {
-    gnc_commodity *comm = value;
-    CommodityPrivate* priv = GET_PRIVATE(comm);
-    GList ** l = data;
-
-    if (!priv->quote_flag ||
-            !priv->quote_source || !priv->quote_source->supported)
-        return;
-    *l = g_list_prepend(*l, value);
-}
+    regex_t *pattern;
+    GHashTable *ns_matches;
+    GList *list;
+} QuotablesData;
 
+/* Decides once per namespace whether its name matches the pattern. */
 static gboolean
-get_quotables_helper2 (gnc_commodity *comm, gpointer data)
+get_quotables_ns_matches(QuotablesData *data, gnc_commodity_namespace *ns)
 {
-    GList ** l = data;
-    CommodityPrivate* priv = GET_PRIVATE(comm);
+    gpointer match;
 
-    if (!priv->quote_flag ||
-            !priv->quote_source || !priv->quote_source->supported)
+    if (!data->pattern)
         return TRUE;
-    *l = g_list_prepend(*l, comm);
-    return TRUE;
+    if (!g_hash_table_lookup_extended(data->ns_matches, ns, NULL, &match))
+    {
+        match = GINT_TO_POINTER(ns && regexec(data->pattern, ns->name,
+                                              0, NULL, 0) == 0);
+        g_hash_table_insert(data->ns_matches, ns, match);
+    }
+    return GPOINTER_TO_INT(match);
+}
+
+static void
+get_quotables_helper(gpointer key, gpointer value, gpointer user_data)
+{
+    QuotablesData *data = user_data;
+    GList *node = value;
+    CommodityPrivate* priv;
+
+    /* All the commodities in the list share the quote source. */
+    priv = GET_PRIVATE(node->data);
+    if (!priv->quote_source->supported)
+        return;
+
+    for ( ; node; node = node->next)
+    {
+        priv = GET_PRIVATE(node->data);
+        if (get_quotables_ns_matches(data, priv->namespace))
+            data->list = g_list_prepend(data->list, node->data);
+    }
 }
 
 CommodityList *
 gnc_commodity_table_get_quotable_commodities(const gnc_commodity_table * table)
 {
-    gnc_commodity_namespace * ns = NULL;
-    const char *namespace;
-    GList * nslist, * tmp;
-    GList * l = NULL;
+    QuotablesData data;
     regex_t pattern;
     const char *expression = gnc_main_get_namespace_regexp();
 
@@ -2054,6 +2204,9 @@ gnc_commodity_table_get_quotable_commodities(const gnc_commodity_table * table)
     if (!table)
         return NULL;
 
+    data.pattern = NULL;
+    data.ns_matches = NULL;
+    data.list = NULL;
     if (expression && *expression)
     {
         if (regcomp(&pattern, expression, REG_EXTENDED | REG_ICASE) != 0)
@@ -2061,31 +2214,19 @@ gnc_commodity_table_get_quotable_commodities(const gnc_commodity_table * table)
             LEAVE("Cannot compile regex");
             return NULL;
         }
-
-        nslist = gnc_commodity_table_get_namespaces(table);
-        for (tmp = nslist; tmp; tmp = tmp->next)
-        {
-            namespace = tmp->data;
-            if (regexec(&pattern, namespace, 0, NULL, 0) == 0)
-            {
-                DEBUG("Running list of %s commodities", namespace);
-                ns = gnc_commodity_table_find_namespace(table, namespace);
-                if (ns)
-                {
-                    g_hash_table_foreach(ns->cm_table, &get_quotables_helper1, (gpointer) &l);
-                }
-            }
-        }
-        g_list_free(nslist);
-        regfree(&pattern);
+        data.pattern = &pattern;
+        data.ns_matches = g_hash_table_new(g_direct_hash, g_direct_equal);
     }
-    else
+
+    g_hash_table_foreach(table->quote_index, get_quotables_helper, &data);
+
+    if (data.pattern)
     {
-        gnc_commodity_table_foreach_commodity(table, get_quotables_helper2,
-                                              (gpointer) &l);
+        g_hash_table_destroy(data.ns_matches);
+        regfree(&pattern);
     }
-    LEAVE("list head %p", l);
-    return l;
+    LEAVE("list head %p", data.list);
+    return data.list;
 }
 
 /********************************************************************
@@ -2182,6 +2323,7 @@ static int
 ns_helper(gpointer key, gpointer value, gpointer user_data)
 {
     gnc_commodity * c = value;
+    commodity_table_forget(c);
     gnc_commodity_destroy(c);
     CACHE_REMOVE(key);  /* key is commodity mnemonic */
     return TRUE;
@@ -2290,6 +2432,10 @@ gnc_commodity_table_destroy(gnc_commodity_table * t)
     t->ns_list = NULL;
     g_hash_table_destroy(t->ns_table);
     t->ns_table = NULL;
+    commodity_index_destroy(t->printname_index);
+    commodity_index_destroy(t->fullname_index);
+    commodity_index_destroy(t->cusip_index);
+    commodity_index_destroy(t->quote_index);
     g_free(t);
     LEAVE ("table=%p", t);
 }
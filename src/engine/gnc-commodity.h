@@ -719,6 +719,17 @@ gnc_commodity * gnc_commodity_table_find_full(const gnc_commodity_table * t,
         const char * commodity_namespace,
         const char * fullname);
 
+/** Find a commodity in any namespace of the table by its full name.
+ *  If several commodities share the name, one of them is returned. */
+gnc_commodity * gnc_commodity_table_find_by_fullname(
+    const gnc_commodity_table * t, const char * fullname);
+
+/** Find a commodity in any namespace of the table by its exchange
+ *  code (CUSIP, ISIN...).  If several commodities share the code, one
+ *  of them is returned. */
+gnc_commodity * gnc_commodity_table_find_by_cusip(
+    const gnc_commodity_table * t, const char * cusip);
+
 /*@ dependent @*/
 gnc_commodity * gnc_commodity_find_commodity_by_guid(const GncGUID *guid, QofBook *book);
 gnc_commodity_namespace * gnc_commodity_find_namespace_by_guid(const GncGUID *guid, QofBook *book);
@@ -0,0 +1,291 @@
+/********************************************************************\
+ * gnc-duplicate-finder.c -- find possibly duplicated transactions  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <time.h>
+#ifndef HAVE_LOCALTIME_R
+#include "localtime_r.h"
+#endif
+
+#include "gnc-duplicate-finder.h"
+#include "gnc-engine.h"
+
+static QofLogModule log_module = GNC_MOD_ENGINE;
+
+#define SECS_PER_WEEK (7 * 24 * 60 * 60)
+
+/* The values of matching splits may differ by less than this many
+ * units of 1/AMOUNT_DENOM. */
+#define AMOUNT_DENOM 10000
+
+/* Splits are indexed by account, by posting week and by their
+ * absolute value in units of 1/AMOUNT_DENOM.  A split of the new
+ * transaction can only match splits in the three weeks and three
+ * amount buckets around its own. */
+typedef struct
+{
+    const Account *account;
+    gint64 week;
+    gint64 amount;
+} DupKey;
+
+struct _GncDuplicateFinder
+{
+    Account *old_root;
+    GHashTable *accounts;       /* full name -> Account* in the old tree */
+    GHashTable *splits;         /* DupKey* -> GSList of Split* */
+};
+
+static guint
+dup_key_hash (gconstpointer key)
+{
+    const DupKey *k = key;
+    return g_direct_hash (k->account) ^ (guint)(k->week * 31) ^
+           (guint)(k->amount ^ (k->amount >> 32));
+}
+
+static gboolean
+dup_key_equal (gconstpointer a, gconstpointer b)
+{
+    const DupKey *ka = a, *kb = b;
+    return ka->account == kb->account && ka->week == kb->week &&
+           ka->amount == kb->amount;
+}
+
+static gint64
+dup_week (time_t secs)
+{
+    /* Round towards minus infinity, also for dates before 1970. */
+    if (secs < 0)
+        return -((-(gint64)secs + SECS_PER_WEEK - 1) / SECS_PER_WEEK);
+    return (gint64)secs / SECS_PER_WEEK;
+}
+
+static gint64
+dup_amount (gnc_numeric value)
+{
+    return (gint64) floor (fabs (gnc_numeric_to_double (value)) * AMOUNT_DENOM);
+}
+
+/* The test the query's QOF_COMPARE_EQUAL/QOF_NUMERIC_MATCH_ANY value
+ * predicate applies. */
+static gboolean
+dup_values_match (gnc_numeric a, gnc_numeric b)
+{
+    gnc_numeric diff = gnc_numeric_sub (gnc_numeric_abs (a),
+                                        gnc_numeric_abs (b),
+                                        100000, GNC_HOW_RND_ROUND_HALF_UP);
+    return gnc_numeric_compare (gnc_numeric_abs (diff),
+                                gnc_numeric_create (1, AMOUNT_DENOM)) < 0;
+}
+
+/* Move date by the given number of days in local time, the way the
+ * importer's date arithmetic does. */
+static Timespec
+dup_shift_days (Timespec date, int days)
+{
+    struct tm tm;
+    time_t secs = date.tv_sec;
+    Timespec result;
+
+    localtime_r (&secs, &tm);
+    tm.tm_mday += days;
+    result.tv_sec = mktime (&tm);
+    result.tv_nsec = 0;
+    return result;
+}
+
+static void
+dup_index_split (GncDuplicateFinder *finder, Split *split)
+{
+    DupKey key, *new_key;
+    GSList *list;
+
+    key.account = xaccSplitGetAccount (split);
+    key.week = dup_week (xaccTransGetDate (xaccSplitGetParent (split)));
+    key.amount = dup_amount (xaccSplitGetValue (split));
+
+    list = g_hash_table_lookup (finder->splits, &key);
+    if (list)
+    {
+        /* Insert after the head, so that the key need not change. */
+        list->next = g_slist_prepend (list->next, split);
+        return;
+    }
+    new_key = g_new (DupKey, 1);
+    *new_key = key;
+    g_hash_table_insert (finder->splits, new_key, g_slist_prepend (NULL, split));
+}
+
+static void
+dup_free_splits (gpointer value)
+{
+    g_slist_free (value);
+}
+
+GncDuplicateFinder *
+gnc_duplicate_finder_new (Account *old_root)
+{
+    GncDuplicateFinder *finder;
+    GList *accounts, *node;
+
+    g_return_val_if_fail (old_root != NULL, NULL);
+
+    ENTER ("root %p", old_root);
+    finder = g_new0 (GncDuplicateFinder, 1);
+    finder->old_root = old_root;
+    finder->accounts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                       g_free, NULL);
+    finder->splits = g_hash_table_new_full (dup_key_hash, dup_key_equal,
+                                            g_free, dup_free_splits);
+
+    accounts = gnc_account_get_descendants (old_root);
+    for (node = accounts; node; node = node->next)
+    {
+        Account *account = node->data;
+        gchar *full_name = gnc_account_get_full_name (account);
+        GList *splits;
+
+        /* The first account of a given name wins, as with
+         * gnc_account_lookup_by_full_name. */
+        if (!g_hash_table_lookup (finder->accounts, full_name))
+            g_hash_table_insert (finder->accounts, full_name, account);
+        else
+            g_free (full_name);
+
+        for (splits = xaccAccountGetSplitList (account); splits;
+                splits = splits->next)
+            dup_index_split (finder, splits->data);
+    }
+    g_list_free (accounts);
+
+    LEAVE ("%u accounts, %u buckets", g_hash_table_size (finder->accounts),
+           g_hash_table_size (finder->splits));
+    return finder;
+}
+
+void
+gnc_duplicate_finder_destroy (GncDuplicateFinder *finder)
+{
+    if (!finder) return;
+    g_hash_table_destroy (finder->accounts);
+    g_hash_table_destroy (finder->splits);
+    g_free (finder);
+}
+
+static void
+dup_match_all_filter (gpointer key, gpointer value, gpointer user_data)
+{
+    Transaction *trans = key;
+    TransList **matches = user_data;
+
+    if (GPOINTER_TO_INT (value) == xaccTransCountSplits (trans))
+        *matches = g_list_prepend (*matches, trans);
+}
+
+static void
+dup_match_any_filter (gpointer key, gpointer value, gpointer user_data)
+{
+    TransList **matches = user_data;
+    *matches = g_list_prepend (*matches, key);
+}
+
+TransList *
+gnc_duplicate_finder_find (GncDuplicateFinder *finder, Transaction *trans,
+                           query_txn_match_t type)
+{
+    GHashTable *matched_splits, *trans_counts;
+    TransList *matches = NULL;
+    Timespec date, earliest, latest;
+    gint64 first_week, last_week;
+    GList *node;
+
+    g_return_val_if_fail (finder != NULL, NULL);
+    g_return_val_if_fail (trans != NULL, NULL);
+
+    date = xaccTransRetDatePostedTS (trans);
+    earliest = dup_shift_days (date, -7);
+    latest = dup_shift_days (date, 7);
+    first_week = dup_week (earliest.tv_sec);
+    last_week = dup_week (latest.tv_sec);
+
+    /* Each old split counts once, even if it matches several splits
+     * of trans. */
+    matched_splits = g_hash_table_new (g_direct_hash, g_direct_equal);
+    trans_counts = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (node = xaccTransGetSplitList (trans); node; node = node->next)
+    {
+        Split *split = node->data;
+        gnc_numeric value = xaccSplitGetValue (split);
+        gchar *full_name;
+        DupKey key;
+
+        full_name = gnc_account_get_full_name (xaccSplitGetAccount (split));
+        key.account = full_name ?
+                      g_hash_table_lookup (finder->accounts, full_name) : NULL;
+        g_free (full_name);
+        /* An account that isn't in the old tree can't match anything. */
+        if (!key.account)
+            continue;
+
+        for (key.week = first_week; key.week <= last_week; key.week++)
+        {
+            gint64 amount = dup_amount (value);
+            for (key.amount = amount - 1; key.amount <= amount + 1; key.amount++)
+            {
+                GSList *old_splits = g_hash_table_lookup (finder->splits, &key);
+                for (; old_splits; old_splits = old_splits->next)
+                {
+                    Split *old_split = old_splits->data;
+                    Transaction *old_trans = xaccSplitGetParent (old_split);
+                    Timespec old_date;
+
+                    if (g_hash_table_lookup (matched_splits, old_split))
+                        continue;
+                    old_date = xaccTransRetDatePostedTS (old_trans);
+                    if (timespec_cmp (&old_date, &earliest) < 0 ||
+                            timespec_cmp (&old_date, &latest) > 0)
+                        continue;
+                    if (!dup_values_match (xaccSplitGetValue (old_split), value))
+                        continue;
+
+                    g_hash_table_insert (matched_splits, old_split, old_split);
+                    g_hash_table_insert (trans_counts, old_trans,
+                                         GINT_TO_POINTER (GPOINTER_TO_INT (
+                                                 g_hash_table_lookup (trans_counts, old_trans)) + 1));
+                }
+            }
+        }
+    }
+
+    g_hash_table_foreach (trans_counts,
+                          type == QUERY_TXN_MATCH_ALL ?
+                          dup_match_all_filter : dup_match_any_filter,
+                          &matches);
+
+    g_hash_table_destroy (matched_splits);
+    g_hash_table_destroy (trans_counts);
+    return matches;
+}
@@ -0,0 +1,72 @@
+/********************************************************************\
+ * gnc-duplicate-finder.h -- find possibly duplicated transactions  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+/** @addtogroup Engine
+    @{ */
+/** @file gnc-duplicate-finder.h
+ * @brief Find transactions in an account tree that a new transaction
+ * may duplicate.
+ *
+ * Importers need to know, for each imported transaction, which
+ * existing transactions it might be a copy of.  Running a split query
+ * per imported transaction gets slow for large imports, so the
+ * duplicate finder indexes the splits of the existing account tree
+ * once, by account, value and posting week, and then answers each
+ * question with a few hash table lookups.
+ *
+ * An existing split matches a split of the new transaction when
+ * - its account has the same full name (looked up in the existing
+ *   tree) as the account of the new split,
+ * - its value equals the value of the new split to four decimal
+ *   places, ignoring the sign, and
+ * - its transaction was posted no more than a week before or after
+ *   the new transaction.
+ *
+ * These are the same rules the QIF importer used to express as a
+ * query, so the results are the same.
+ */
+
+#ifndef GNC_DUPLICATE_FINDER_H
+#define GNC_DUPLICATE_FINDER_H
+
+#include "Account.h"
+#include "Query.h"
+#include "Transaction.h"
+
+typedef struct _GncDuplicateFinder GncDuplicateFinder;
+
+/** Index the splits of all of the descendants of old_root.  The tree
+ * must not be changed while the finder is in use. */
+GncDuplicateFinder * gnc_duplicate_finder_new (Account *old_root);
+
+void gnc_duplicate_finder_destroy (GncDuplicateFinder *finder);
+
+/** Return the transactions in the indexed tree that trans may
+ * duplicate.  With QUERY_TXN_MATCH_ANY a transaction is returned if
+ * any of its splits matches a split of trans; with
+ * QUERY_TXN_MATCH_ALL all of its splits must match, just as with
+ * xaccQueryGetTransactions.  The caller must free the list (but not
+ * the transactions). */
+TransList * gnc_duplicate_finder_find (GncDuplicateFinder *finder,
+                                       Transaction *trans,
+                                       query_txn_match_t type);
+
+#endif /* GNC_DUPLICATE_FINDER_H */
+/** @} */
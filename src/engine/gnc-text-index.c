@@ -0,0 +1,620 @@
+/********************************************************************\
+ * gnc-text-index.c -- trigram index of transaction and split text  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include "gnc-text-index.h"
+#include "gnc-engine.h"
+#include "Split.h"
+#include "Transaction.h"
+
+static QofLogModule log_module = GNC_MOD_ENGINE;
+
+#define TEXT_INDEX_KEY "gnc-text-index"
+
+/* The number of characters in an indexed sequence.  Literals shorter
+ * than this cannot be looked up. */
+#define TRIGRAM_LEN 3
+
+typedef enum
+{
+    KIND_TRANS,
+    KIND_SPLIT,
+    N_KINDS
+} TextKind;
+
+typedef enum
+{
+    FIELD_DESCRIPTION,
+    FIELD_NUM,
+    FIELD_NOTES,
+    FIELD_MEMO,
+    FIELD_ACTION,
+    N_FIELDS
+} TextField;
+
+#define MAX_SLOTS 3
+
+/* The indexed texts: the kind of object they belong to, their slot in
+ * its TextEntry and the query parameter which gets them. */
+static const struct
+{
+    TextKind kind;
+    guint slot;
+    const char *param;
+} fields[N_FIELDS] =
+{
+    { KIND_TRANS, 0, TRANS_DESCRIPTION },
+    { KIND_TRANS, 1, TRANS_NUM },
+    { KIND_TRANS, 2, TRANS_NOTES },
+    { KIND_SPLIT, 0, SPLIT_MEMO },
+    { KIND_SPLIT, 1, SPLIT_ACTION },
+};
+
+static const char *kind_ids[N_KINDS] = { GNC_ID_TRANS, GNC_ID_SPLIT };
+
+/* One indexed object.  It is identified by GUID rather than pointer, so
+ * that an entry outliving its object can do no harm: the object is
+ * looked up when the entry turns up as a candidate. */
+typedef struct
+{
+    GncGUID guid;
+    /* The texts the entry is indexed by, from the string cache, or NULL
+     * for empty ones */
+    const char *text[MAX_SLOTS];
+} TextEntry;
+
+typedef struct
+{
+    QofBook *book;
+    gboolean built;
+    guint64 suppressed_serial;  /* qof_event_get_suppressed_serial when synced */
+    GHashTable *entries[N_KINDS];       /* GncGUID* -> TextEntry* */
+    GHashTable *postings[N_FIELDS];     /* trigram -> set of TextEntry* */
+    GHashTable *unindexed[N_FIELDS];    /* set of TextEntry* not valid utf8 */
+} GncTextIndex;
+
+static gint event_handler_id = 0;
+
+/* ================================================================ */
+
+static gpointer
+trigram_key (gunichar c1, gunichar c2, gunichar c3)
+{
+    /* Different trigrams may share a key; that only adds candidates. */
+    return GUINT_TO_POINTER ((c1 * 65599u + c2) * 65599u + c3);
+}
+
+/* Calls func with the key of each trigram of folded. */
+static void
+foreach_trigram (const char *folded, void (*func) (gpointer key, gpointer data),
+                 gpointer data)
+{
+    gunichar c[TRIGRAM_LEN] = { 0, 0, 0 };
+    guint n = 0;
+    const char *p;
+
+    for (p = folded; *p; p = g_utf8_next_char (p))
+    {
+        c[0] = c[1];
+        c[1] = c[2];
+        c[2] = g_utf8_get_char (p);
+        if (++n >= TRIGRAM_LEN)
+            func (trigram_key (c[0], c[1], c[2]), data);
+    }
+}
+
+typedef struct
+{
+    GHashTable *postings;
+    TextEntry *entry;
+} PostingUpdate;
+
+static void
+posting_add (gpointer key, gpointer data)
+{
+    PostingUpdate *pu = data;
+    GHashTable *set = g_hash_table_lookup (pu->postings, key);
+
+    if (!set)
+    {
+        set = g_hash_table_new (g_direct_hash, g_direct_equal);
+        g_hash_table_insert (pu->postings, key, set);
+    }
+    g_hash_table_insert (set, pu->entry, pu->entry);
+}
+
+static void
+posting_remove (gpointer key, gpointer data)
+{
+    PostingUpdate *pu = data;
+    GHashTable *set = g_hash_table_lookup (pu->postings, key);
+
+    if (!set) return;
+    g_hash_table_remove (set, pu->entry);
+    if (g_hash_table_size (set) == 0)
+        g_hash_table_remove (pu->postings, key);
+}
+
+/* Adds entry to, or removes it from, the postings of the trigrams of
+ * text in field. */
+static void
+index_text (GncTextIndex *index, TextField field, TextEntry *entry,
+            const char *text, gboolean add)
+{
+    PostingUpdate pu;
+    gchar *folded = NULL;
+
+    if (!text) return;
+
+    if (g_utf8_validate (text, -1, NULL))
+        folded = qof_utf8_fold (text);
+    if (!folded)
+    {
+        /* It can only be found by checking it */
+        if (add)
+            g_hash_table_insert (index->unindexed[field], entry, entry);
+        else
+            g_hash_table_remove (index->unindexed[field], entry);
+        return;
+    }
+
+    pu.postings = index->postings[field];
+    pu.entry = entry;
+    foreach_trigram (folded, add ? posting_add : posting_remove, &pu);
+    g_free (folded);
+}
+
+static const char *
+get_text (QofInstance *inst, TextField field)
+{
+    switch (field)
+    {
+    case FIELD_DESCRIPTION:
+        return xaccTransGetDescription (GNC_TRANSACTION (inst));
+    case FIELD_NUM:
+        return xaccTransGetNum (GNC_TRANSACTION (inst));
+    case FIELD_NOTES:
+        return xaccTransGetNotes (GNC_TRANSACTION (inst));
+    case FIELD_MEMO:
+        return xaccSplitGetMemo (GNC_SPLIT (inst));
+    case FIELD_ACTION:
+        return xaccSplitGetAction (GNC_SPLIT (inst));
+    default:
+        return NULL;
+    }
+}
+
+static void
+remove_entry (GncTextIndex *index, TextKind kind, const GncGUID *guid)
+{
+    TextEntry *entry = g_hash_table_lookup (index->entries[kind], guid);
+    TextField field;
+
+    if (!entry) return;
+
+    for (field = 0; field < N_FIELDS; field++)
+    {
+        const char *text;
+
+        if (fields[field].kind != kind) continue;
+        text = entry->text[fields[field].slot];
+        if (!text) continue;
+        index_text (index, field, entry, text, FALSE);
+        qof_util_string_cache_remove (text);
+    }
+    g_hash_table_remove (index->entries[kind], &entry->guid);
+    g_free (entry);
+}
+
+/* Reindexes the texts of inst which differ from those it was indexed
+ * by, adding an entry for it if it has none. */
+static void
+update_entry (GncTextIndex *index, TextKind kind, QofInstance *inst)
+{
+    TextEntry *entry;
+    TextField field;
+
+    entry = g_hash_table_lookup (index->entries[kind],
+                                 qof_instance_get_guid (inst));
+    if (!entry)
+    {
+        entry = g_new0 (TextEntry, 1);
+        entry->guid = *qof_instance_get_guid (inst);
+        g_hash_table_insert (index->entries[kind], &entry->guid, entry);
+    }
+
+    for (field = 0; field < N_FIELDS; field++)
+    {
+        const char **slot;
+        const char *text;
+
+        if (fields[field].kind != kind) continue;
+        slot = &entry->text[fields[field].slot];
+        text = get_text (inst, field);
+        if (text && !*text) text = NULL;
+        if (!safe_strcmp (*slot, text)) continue;
+
+        if (*slot)
+        {
+            index_text (index, field, entry, *slot, FALSE);
+            qof_util_string_cache_remove (*slot);
+        }
+        *slot = text ? qof_util_string_cache_insert (text) : NULL;
+        index_text (index, field, entry, *slot, TRUE);
+    }
+}
+
+static void
+sync_instance (QofInstance *inst, gpointer data)
+{
+    GncTextIndex *index = data;
+    TextKind kind = GNC_IS_SPLIT (inst) ? KIND_SPLIT : KIND_TRANS;
+
+    update_entry (index, kind, inst);
+}
+
+typedef struct
+{
+    GncTextIndex *index;
+    TextKind kind;
+    QofCollection *col;
+    GSList *gone;
+} SweepData;
+
+static void
+find_gone_entry (gpointer key, gpointer value, gpointer data)
+{
+    SweepData *sd = data;
+
+    if (!qof_collection_lookup_entity (sd->col, key))
+        sd->gone = g_slist_prepend (sd->gone, key);
+}
+
+/* Brings the index up to date with every transaction and split of the
+ * book, after it missed events or before its first use. */
+static void
+text_index_sync (GncTextIndex *index)
+{
+    TextKind kind;
+
+    ENTER ("book=%p built=%d", index->book, index->built);
+    for (kind = 0; kind < N_KINDS; kind++)
+    {
+        SweepData sd;
+        GSList *node;
+
+        sd.index = index;
+        sd.kind = kind;
+        sd.col = qof_book_get_collection (index->book, kind_ids[kind]);
+        sd.gone = NULL;
+
+        qof_collection_foreach (sd.col, sync_instance, index);
+        g_hash_table_foreach (index->entries[kind], find_gone_entry, &sd);
+        for (node = sd.gone; node; node = node->next)
+            remove_entry (index, kind, node->data);
+        g_slist_free (sd.gone);
+    }
+    index->built = TRUE;
+    index->suppressed_serial = qof_event_get_suppressed_serial ();
+    LEAVE ("%u transactions, %u splits",
+           g_hash_table_size (index->entries[KIND_TRANS]),
+           g_hash_table_size (index->entries[KIND_SPLIT]));
+}
+
+/* ================================================================ */
+
+static void
+text_index_event_handler (QofInstance *ent, QofEventId event_type,
+                          gpointer handler_data, gpointer event_data)
+{
+    GncTextIndex *index;
+    TextKind kind;
+
+    if (GNC_IS_TRANSACTION (ent))
+        kind = KIND_TRANS;
+    else if (GNC_IS_SPLIT (ent))
+        kind = KIND_SPLIT;
+    else
+        return;
+
+    index = qof_book_get_data (qof_instance_get_book (ent), TEXT_INDEX_KEY);
+    /* Until it is built, the first query will find everything anyway */
+    if (!index || !index->built)
+        return;
+
+    switch (event_type)
+    {
+    case QOF_EVENT_CREATE:
+    case QOF_EVENT_MODIFY:
+    case QOF_EVENT_ADD:
+        if (!qof_instance_get_destroying (ent))
+        {
+            update_entry (index, kind, ent);
+            break;
+        }
+        /* fall through */
+    case QOF_EVENT_DESTROY:
+        if (kind == KIND_TRANS)
+        {
+            /* The splits of a destroyed transaction may not report it */
+            GList *node;
+            for (node = xaccTransGetSplitList (GNC_TRANSACTION (ent));
+                    node; node = node->next)
+                remove_entry (index, KIND_SPLIT,
+                              qof_instance_get_guid (node->data));
+        }
+        remove_entry (index, kind, qof_instance_get_guid (ent));
+        break;
+    default:
+        break;
+    }
+}
+
+/* ================================================================ */
+
+/* The field which param_list gets from search_for objects, and whether
+ * it belongs to their transaction rather than to them; -1 if the index
+ * does not hold it. */
+static gint
+find_field (QofIdTypeConst search_for, const QofQueryParamList *param_list,
+            gboolean *of_trans)
+{
+    TextKind kind;
+    TextField field;
+
+    if (!param_list) return -1;
+    *of_trans = FALSE;
+
+    if (!safe_strcmp (search_for, GNC_ID_TRANS))
+        kind = KIND_TRANS;
+    else if (!safe_strcmp (search_for, GNC_ID_SPLIT))
+    {
+        kind = KIND_SPLIT;
+        if (!safe_strcmp (param_list->data, SPLIT_TRANS) && param_list->next)
+        {
+            kind = KIND_TRANS;
+            *of_trans = TRUE;
+            param_list = param_list->next;
+        }
+    }
+    else
+        return -1;
+
+    if (param_list->next) return -1;
+    for (field = 0; field < N_FIELDS; field++)
+        if (fields[field].kind == kind &&
+                !safe_strcmp (param_list->data, fields[field].param))
+            return field;
+    return -1;
+}
+
+static void
+collect_posting (gpointer key, gpointer data)
+{
+    GPtrArray *keys = data;
+    g_ptr_array_add (keys, key);
+}
+
+static gint
+compare_set_size (gconstpointer a, gconstpointer b)
+{
+    guint sa = g_hash_table_size (*(GHashTable * const *) a);
+    guint sb = g_hash_table_size (*(GHashTable * const *) b);
+    return sa < sb ? -1 : sa > sb;
+}
+
+/* Adds the object of entry, if it still exists, or of a transaction
+ * entry its splits, to candidates. */
+static void
+add_candidate (GncTextIndex *index, TextEntry *entry, TextKind kind,
+               gboolean of_trans, GList **candidates)
+{
+    QofCollection *col = qof_book_get_collection (index->book, kind_ids[kind]);
+    QofInstance *inst = qof_collection_lookup_entity (col, &entry->guid);
+    GList *node;
+
+    if (!inst) return;
+    if (!of_trans)
+    {
+        *candidates = g_list_prepend (*candidates, inst);
+        return;
+    }
+    for (node = xaccTransGetSplitList (GNC_TRANSACTION (inst)); node;
+            node = node->next)
+        *candidates = g_list_prepend (*candidates, node->data);
+}
+
+static gboolean
+text_index_candidates (QofBook *book, QofIdTypeConst search_for,
+                       const QofQueryParamList *param_list,
+                       const gchar * const *literals, GList **candidates)
+{
+    GncTextIndex *index = qof_book_get_data (book, TEXT_INDEX_KEY);
+    GPtrArray *keys, *sets;
+    gboolean of_trans;
+    gint field;
+    TextKind kind;
+    guint i;
+
+    if (!index) return FALSE;
+    field = find_field (search_for, param_list, &of_trans);
+    if (field < 0) return FALSE;
+    kind = fields[field].kind;
+
+    keys = g_ptr_array_new ();
+    for (i = 0; literals[i]; i++)
+        foreach_trigram (literals[i], collect_posting, keys);
+    if (keys->len == 0)
+    {
+        /* Too short to look up */
+        g_ptr_array_free (keys, TRUE);
+        return FALSE;
+    }
+
+    if (!index->built ||
+            index->suppressed_serial != qof_event_get_suppressed_serial ())
+        text_index_sync (index);
+
+    *candidates = NULL;
+    sets = g_ptr_array_new ();
+    for (i = 0; i < keys->len; i++)
+    {
+        GHashTable *set = g_hash_table_lookup (index->postings[field],
+                                               keys->pdata[i]);
+        if (!set)
+        {
+            /* No indexed text has this trigram */
+            g_ptr_array_set_size (sets, 0);
+            break;
+        }
+        g_ptr_array_add (sets, set);
+    }
+    g_ptr_array_free (keys, TRUE);
+
+    /* Walk the smallest set, keeping the entries all others contain */
+    if (sets->len > 0)
+    {
+        GHashTableIter iter;
+        gpointer entry;
+
+        g_ptr_array_sort (sets, compare_set_size);
+        g_hash_table_iter_init (&iter, sets->pdata[0]);
+        while (g_hash_table_iter_next (&iter, &entry, NULL))
+        {
+            for (i = 1; i < sets->len; i++)
+                if (!g_hash_table_lookup (sets->pdata[i], entry))
+                    break;
+            if (i == sets->len)
+                add_candidate (index, entry, kind, of_trans, candidates);
+        }
+    }
+    g_ptr_array_free (sets, TRUE);
+
+    {
+        GHashTableIter iter;
+        gpointer entry;
+
+        g_hash_table_iter_init (&iter, index->unindexed[field]);
+        while (g_hash_table_iter_next (&iter, &entry, NULL))
+            add_candidate (index, entry, kind, of_trans, candidates);
+    }
+
+    PINFO ("%d candidates for field %d", g_list_length (*candidates), field);
+    return TRUE;
+}
+
+/* ================================================================ */
+
+static void
+free_entry (gpointer key, gpointer value, gpointer data)
+{
+    TextEntry *entry = value;
+    guint slot;
+
+    for (slot = 0; slot < MAX_SLOTS; slot++)
+        if (entry->text[slot])
+            qof_util_string_cache_remove (entry->text[slot]);
+    g_free (entry);
+}
+
+static void
+text_index_free (GncTextIndex *index)
+{
+    guint i;
+
+    for (i = 0; i < N_KINDS; i++)
+    {
+        g_hash_table_foreach (index->entries[i], free_entry, NULL);
+        g_hash_table_destroy (index->entries[i]);
+    }
+    for (i = 0; i < N_FIELDS; i++)
+    {
+        g_hash_table_destroy (index->postings[i]);
+        g_hash_table_destroy (index->unindexed[i]);
+    }
+    g_free (index);
+}
+
+static void
+text_index_book_end (QofBook *book, gpointer key, gpointer user_data)
+{
+    gnc_text_index_disable (book);
+}
+
+void
+gnc_text_index_enable (QofBook *book)
+{
+    GncTextIndex *index;
+    guint i;
+
+    g_return_if_fail (book);
+    if (qof_book_get_data (book, TEXT_INDEX_KEY))
+        return;
+
+    if (!event_handler_id)
+    {
+        /* Ahead of the handlers that may run queries in response */
+        event_handler_id =
+            qof_event_register_handler_with_priority (text_index_event_handler,
+                    NULL, QOF_EVENT_PRIORITY_DEFAULT + 100);
+        qof_query_register_candidates (GNC_ID_TRANS, text_index_candidates);
+        qof_query_register_candidates (GNC_ID_SPLIT, text_index_candidates);
+    }
+
+    index = g_new0 (GncTextIndex, 1);
+    index->book = book;
+    for (i = 0; i < N_KINDS; i++)
+        index->entries[i] = g_hash_table_new (guid_hash_to_guint,
+                                              guid_g_hash_table_equal);
+    for (i = 0; i < N_FIELDS; i++)
+    {
+        index->postings[i] =
+            g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                   (GDestroyNotify) g_hash_table_destroy);
+        index->unindexed[i] = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+    qof_book_set_data_fin (book, TEXT_INDEX_KEY, index, text_index_book_end);
+}
+
+void
+gnc_text_index_disable (QofBook *book)
+{
+    GncTextIndex *index;
+
+    g_return_if_fail (book);
+    index = qof_book_get_data (book, TEXT_INDEX_KEY);
+    if (!index) return;
+
+    qof_book_set_data (book, TEXT_INDEX_KEY, NULL);
+    text_index_free (index);
+}
+
+gboolean
+gnc_text_index_is_enabled (const QofBook *book)
+{
+    return qof_book_get_data (book, TEXT_INDEX_KEY) != NULL;
+}
+
+/* ========================== END OF FILE ========================= */
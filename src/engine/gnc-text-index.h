@@ -0,0 +1,60 @@
+/********************************************************************\
+ * gnc-text-index.h -- trigram index of transaction and split text  *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+/** @addtogroup Engine
+    @{ */
+/** @file gnc-text-index.h
+ * @brief Narrow text searches of transactions and splits with a
+ * trigram index.
+ *
+ * A string match in a query is evaluated by calling the object's
+ * getter and searching the result, for every split in the book.  When
+ * the text index is enabled for a book, it keeps, for the description,
+ * number and notes of every transaction and the memo and action of
+ * every split, the set of objects whose case folded text contains each
+ * three character sequence.  Queries for splits or transactions then
+ * only check the objects whose text contains every trigram of the
+ * string searched for, or of the literal parts of a regular expression
+ * without alternation.  The query still checks them against all of its
+ * terms, so the results are the same as without the index.
+ *
+ * The index is built by the first query that uses it and kept up to
+ * date from the events generated when transactions and splits are
+ * committed.  If events were suspended in the meantime, for instance
+ * while loading, the next query brings it up to date first.
+ */
+
+#ifndef GNC_TEXT_INDEX_H
+#define GNC_TEXT_INDEX_H
+
+#include "qof.h"
+
+/** Keep a text index for book until it is destroyed or the index is
+ * disabled.  Does nothing if the book already has one. */
+void gnc_text_index_enable (QofBook *book);
+
+/** Drop the text index of book, if it has one. */
+void gnc_text_index_disable (QofBook *book);
+
+/** Return TRUE if book has a text index. */
+gboolean gnc_text_index_is_enabled (const QofBook *book);
+
+#endif /* GNC_TEXT_INDEX_H */
+/** @} */
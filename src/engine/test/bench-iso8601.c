@@ -0,0 +1,99 @@
+/*
+ * bench-iso8601.c -- Time the ISO-8601 timestamp conversions.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Usage: bench-iso8601 [conversions]
+ *
+ * Converts 'conversions' timestamps (1000000 by default), spread over
+ * thirty years, to ISO-8601 strings and back, and prints how many
+ * conversions per second each direction manages.  For comparison it
+ * also times localtime_r and mktime on the same timestamps, which is
+ * what the conversions used to cost.  Set TZ to try other zones.
+ * This is not run as part of "make check". */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <glib.h>
+
+#include "gnc-date.h"
+
+#define START (G_GINT64_CONSTANT(946684800))    /* 2000-01-01 */
+#define SPREAD (30 * 365 * 24 * 3600)
+
+static void
+report (const char *what, GTimer *timer, int n)
+{
+    gdouble secs = g_timer_elapsed (timer, NULL);
+
+    printf ("%-24s %8.3f s  %12.0f conversions/s\n", what, secs,
+            secs > 0 ? n / secs : 0.0);
+    g_timer_start (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+    GTimer *timer;
+    gchar (*strings)[40];
+    Timespec ts;
+    gint64 check = 0;
+    int n = 1000000;
+    int i;
+
+    if (argc > 1)
+        n = atoi (argv[1]);
+
+    strings = g_new (gchar[40], n);
+    timer = g_timer_new ();
+
+    for (i = 0; i < n; i++)
+    {
+        ts.tv_sec = START + (gint64) i * (SPREAD / n);
+        ts.tv_nsec = 0;
+        gnc_timespec_to_iso8601_buff (ts, strings[i]);
+    }
+    report ("timespec to iso8601", timer, n);
+
+    for (i = 0; i < n; i++)
+    {
+        ts = gnc_iso8601_to_timespec_gmt (strings[i]);
+        check += ts.tv_sec - (START + (gint64) i * (SPREAD / n));
+    }
+    report ("iso8601 to timespec", timer, n);
+
+    for (i = 0; i < n; i++)
+    {
+        struct tm tm;
+        time_t t = START + (gint64) i * (SPREAD / n);
+        localtime_r (&t, &tm);
+        tm.tm_isdst = -1;
+        t = mktime (&tm);
+    }
+    report ("localtime_r + mktime", timer, n);
+
+    printf ("%s %s\n", strings[n - 1], check == 0 ? "round trips" :
+            "DOES NOT ROUND TRIP");
+
+    g_timer_destroy (timer);
+    g_free (strings);
+    return check == 0 ? 0 : 1;
+}
@@ -26,6 +26,7 @@
  */
 
 #include "config.h"
+#include <string.h>
 #include <unistd.h>
 #include <glib.h>
 #include "qof.h"
@@ -77,6 +78,124 @@ run_test (void)
 
 }
 
+static Account *
+make_account (QofBook *book, Account *parent, const char *name,
+              const char *code)
+{
+    Account *acc = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetName (acc, name);
+    xaccAccountSetCode (acc, code);
+    gnc_account_append_child (parent, acc);
+    xaccAccountCommitEdit (acc);
+    return acc;
+}
+
+static void
+check_full_name (Account *acc, const char *expected)
+{
+    gchar *name = gnc_account_get_full_name (acc);
+
+    do_test_args (strcmp (name, expected) == 0, "full name",
+                  __FILE__, __LINE__, "got %s, expected %s", name, expected);
+    g_free (name);
+}
+
+static void
+run_lookup_test (void)
+{
+    QofSession *sess;
+    QofBook *book;
+    Account *top, *assets, *bank, *bank2, *cash, *expenses, *food;
+
+    sess = qof_session_new ();
+    book = qof_session_get_book (sess);
+    gnc_set_account_separator (":");
+
+    top = xaccMallocAccount (book);
+    assets = make_account (book, top, "Assets", "1000");
+    bank = make_account (book, assets, "Bank", "1100");
+    cash = make_account (book, assets, "Cash", "1200");
+    expenses = make_account (book, top, "Expenses", "5000");
+    food = make_account (book, expenses, "Food", "5100");
+
+    check_full_name (top, "");
+    check_full_name (bank, "Assets:Bank");
+    do_test (gnc_account_lookup_by_full_name (food, "Assets:Bank") == bank,
+             "lookup by full name");
+    do_test (gnc_account_lookup_by_full_name (top, "Bank") == NULL,
+             "lookup by partial full name");
+    do_test (gnc_account_lookup_by_name (top, "Food") == food,
+             "lookup by name");
+    do_test (gnc_account_lookup_by_name (assets, "Food") == NULL,
+             "lookup by name outside parent");
+    do_test (gnc_account_lookup_by_name (top, "Top") == NULL,
+             "lookup by missing name");
+    do_test (gnc_account_lookup_by_code (top, "1200") == cash,
+             "lookup by code");
+
+    /* Renaming changes the full names of the descendants. */
+    xaccAccountSetName (assets, "Property");
+    check_full_name (cash, "Property:Cash");
+    do_test (gnc_account_lookup_by_full_name (top, "Assets:Bank") == NULL,
+             "old full name after rename");
+    do_test (gnc_account_lookup_by_full_name (top, "Property:Bank") == bank,
+             "new full name after rename");
+    do_test (gnc_account_lookup_by_name (top, "Assets") == NULL,
+             "old name after rename");
+    do_test (gnc_account_lookup_by_name (top, "Property") == assets,
+             "new name after rename");
+
+    xaccAccountSetCode (cash, "1300");
+    do_test (gnc_account_lookup_by_code (top, "1200") == NULL,
+             "old code");
+    do_test (gnc_account_lookup_by_code (top, "1300") == cash,
+             "new code");
+
+    /* Moving an account moves its names. */
+    gnc_account_append_child (expenses, bank);
+    check_full_name (bank, "Expenses:Bank");
+    do_test (gnc_account_lookup_by_full_name (top, "Property:Bank") == NULL,
+             "old full name after move");
+    do_test (gnc_account_lookup_by_full_name (top, "Expenses:Bank") == bank,
+             "new full name after move");
+    do_test (gnc_account_lookup_by_name (assets, "Bank") == NULL,
+             "name under old parent after move");
+    do_test (gnc_account_lookup_by_name (expenses, "Bank") == bank,
+             "name under new parent after move");
+
+    /* With two accounts of the same name, the depth-first search
+     * decides: Property comes before Expenses. */
+    bank2 = make_account (book, assets, "Bank", "1100");
+    do_test (gnc_account_lookup_by_name (top, "Bank") == bank2,
+             "lookup of a duplicated name");
+    do_test (gnc_account_lookup_by_code (top, "1100") == bank2,
+             "lookup of a duplicated code");
+
+    gnc_set_account_separator ("/");
+    check_full_name (food, "Expenses/Food");
+    do_test (gnc_account_lookup_by_full_name (top, "Expenses/Bank") == bank,
+             "lookup with a new separator");
+    do_test (gnc_account_lookup_by_full_name (top, "Expenses:Bank") == NULL,
+             "lookup with the old separator");
+
+    gnc_account_remove_child (expenses, bank);
+    check_full_name (bank, "");
+    do_test (gnc_account_lookup_by_full_name (top, "Expenses/Bank") == NULL,
+             "lookup of a removed account");
+    do_test (gnc_account_lookup_by_name (top, "Bank") == bank2,
+             "lookup by name after removal");
+
+    gnc_set_account_separator (":");
+    xaccAccountBeginEdit (bank);
+    xaccAccountDestroy (bank);
+    xaccAccountBeginEdit (top);
+    xaccAccountDestroy (top);
+    qof_session_end (sess);
+    qof_session_destroy (sess);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -94,6 +213,7 @@ main (int argc, char **argv)
 
     /* Run the tests */
     run_test ();
+    run_lookup_test ();
 
     print_test_results();
 
@@ -0,0 +1,254 @@
+/***************************************************************************
+ *            test-budget.c
+ *
+ *  Copyright  2011 GnuCash team
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+/* Check that the budget's account period values agree with the slots
+ * they are saved in, while values are set, unset, changed in the slots
+ * and cloned, and that the actual values found all at once agree with
+ * those found one at a time. */
+
+#include "config.h"
+#include <stdio.h>
+#include <glib.h>
+#include "qof.h"
+#include "cashobjects.h"
+#include "TransLog.h"
+#include "gnc-budget.h"
+#include "gnc-engine.h"
+#include "test-engine-stuff.h"
+#include "test-stuff.h"
+
+#define NUM_PERIODS 12
+/* Periods past the budget's end may hold values too. */
+#define MAX_PERIOD  20
+
+static gboolean
+check_values (GncBudget *budget, GList *accounts, const char *when)
+{
+    KvpFrame *frame = qof_instance_get_slots (QOF_INSTANCE (budget));
+    gnc_numeric values[MAX_PERIOD];
+    gboolean is_set[MAX_PERIOD];
+    GList *node;
+    guint i;
+
+    for (node = accounts; node; node = node->next)
+    {
+        Account *account = node->data;
+        gchar guid_str[GUID_ENCODING_LENGTH + 1];
+
+        guid_to_string_buff (xaccAccountGetGUID (account), guid_str);
+        gnc_budget_get_account_period_values (budget, account, MAX_PERIOD,
+                                              values, is_set);
+        for (i = 0; i < MAX_PERIOD; i++)
+        {
+            gchar *path = g_strdup_printf ("%s/%d", guid_str, i);
+            gboolean set = kvp_frame_get_value (frame, path) != NULL;
+            gnc_numeric val = kvp_frame_get_numeric (frame, path);
+
+            g_free (path);
+            if (set != gnc_budget_is_account_period_value_set (budget, account, i)
+                    || set != is_set[i]
+                    || !gnc_numeric_equal (val,
+                                           gnc_budget_get_account_period_value (budget, account, i))
+                    || !gnc_numeric_equal (val, values[i]))
+            {
+                failure_args ("budget values", __FILE__, __LINE__,
+                              "%s: period %d of %s differs from the slots",
+                              when, i, guid_str);
+                return FALSE;
+            }
+        }
+    }
+    success (when);
+    return TRUE;
+}
+
+static gboolean
+check_actuals (GncBudget *budget, GList *accounts, gboolean include_children)
+{
+    gnc_numeric *actuals, *row;
+    GList *node;
+    guint i, num_periods = gnc_budget_get_num_periods (budget);
+    gboolean ok = TRUE;
+
+    actuals = gnc_budget_get_period_actual_values (budget, accounts,
+              include_children);
+    for (node = accounts, row = actuals; node && ok;
+            node = node->next, row += num_periods)
+    {
+        Account *account = node->data;
+
+        for (i = 0; i < num_periods && ok; i++)
+        {
+            const Recurrence *r = gnc_budget_get_recurrence (budget);
+            gnc_numeric expected = include_children ?
+                                   gnc_budget_get_account_period_actual_value (budget, account, i) :
+                                   xaccAccountGetBalanceChangeForPeriod (
+                                       account,
+                                       recurrenceGetPeriodTime (r, i, FALSE),
+                                       recurrenceGetPeriodTime (r, i, TRUE),
+                                       FALSE);
+
+            if (!gnc_numeric_equal (expected, row[i]))
+            {
+                failure_args ("budget actuals", __FILE__, __LINE__,
+                              "period %d of %s differs", i,
+                              xaccAccountGetName (account));
+                ok = FALSE;
+            }
+        }
+    }
+    g_free (actuals);
+    if (ok)
+        success (include_children ? "rolled up actuals" : "actuals");
+    return ok;
+}
+
+static void
+change_values (GncBudget *budget, GList *accounts, int count)
+{
+    guint n_accounts = g_list_length (accounts);
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        Account *account = g_list_nth_data (accounts,
+                                            get_random_int_in_range (0, n_accounts - 1));
+        guint period = get_random_int_in_range (0, MAX_PERIOD - 1);
+
+        if (get_random_int_in_range (0, 3) == 0)
+            gnc_budget_unset_account_period_value (budget, account, period);
+        else
+            gnc_budget_set_account_period_value (budget, account, period,
+                                                 get_random_gnc_numeric ());
+    }
+}
+
+static void
+change_slot (GncBudget *budget, Account *account, guint period)
+{
+    KvpFrame *frame = qof_instance_get_slots (QOF_INSTANCE (budget));
+    gchar guid_str[GUID_ENCODING_LENGTH + 1];
+    gchar *path;
+
+    guid_to_string_buff (xaccAccountGetGUID (account), guid_str);
+    path = g_strdup_printf ("%s/%d", guid_str, period);
+    kvp_frame_set_numeric (frame, path, gnc_numeric_create (period + 7, 1));
+    qof_instance_set_dirty (QOF_INSTANCE (budget));
+    g_free (path);
+}
+
+static void
+run_test (void)
+{
+    QofSession *session;
+    QofBook *book;
+    GncBudget *budget, *clone;
+    GList *accounts;
+    Recurrence r;
+    GDate date;
+
+    session = get_random_session ();
+    book = qof_session_get_book (session);
+    accounts = gnc_account_get_descendants (gnc_book_get_root_account (book));
+    if (!accounts)
+    {
+        qof_session_end (session);
+        return;
+    }
+
+    budget = gnc_budget_new (book);
+    gnc_budget_set_num_periods (budget, NUM_PERIODS);
+
+    /* Random transactions are spread over 1970 to 2038. */
+    add_random_transactions_to_book (book, 50);
+    g_date_clear (&date, 1);
+    g_date_set_dmy (&date, 1, G_DATE_JANUARY, 1970);
+    recurrenceSet (&r, 3, PERIOD_YEAR, &date, WEEKEND_ADJ_NONE);
+    gnc_budget_set_recurrence (budget, &r);
+    if (!check_actuals (budget, accounts, TRUE)
+            || !check_actuals (budget, accounts, FALSE))
+        goto done;
+
+    /* Some values are set before the budget is first read. */
+    change_values (budget, accounts, 50);
+    if (!check_values (budget, accounts, "values set before reading"))
+        goto done;
+
+    change_values (budget, accounts, 200);
+    if (!check_values (budget, accounts, "values set after reading"))
+        goto done;
+
+    gnc_budget_set_num_periods (budget, NUM_PERIODS / 2);
+    if (!check_values (budget, accounts, "after dropping periods"))
+        goto done;
+
+    /* A change made to the slots directly shows once it is committed. */
+    gnc_budget_begin_edit (budget);
+    change_slot (budget, accounts->data, 1);
+    gnc_budget_commit_edit (budget);
+    if (!check_values (budget, accounts, "slots changed in an edit"))
+        goto done;
+
+    /* Setters used inside that edit don't hide the direct change. */
+    gnc_budget_begin_edit (budget);
+    change_slot (budget, accounts->data, 2);
+    change_values (budget, accounts, 20);
+    gnc_budget_commit_edit (budget);
+    if (!check_values (budget, accounts, "slots and setters in one edit"))
+        goto done;
+
+    clone = gnc_budget_clone (budget);
+    check_values (clone, accounts, "values of the clone");
+
+done:
+    g_list_free (accounts);
+    qof_session_end (session);
+}
+
+int
+main (int argc, char **argv)
+{
+    int i;
+
+    qof_init();
+    g_log_set_always_fatal( G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING );
+
+    xaccLogDisable ();
+
+    /* Always start from the same random seed so we fail consistently */
+    srand(0);
+    if (!cashobjects_register())
+    {
+        failure("can't register cashbojects");
+        goto cleanup;
+    }
+
+    for (i = 0; i < 10; i++)
+    {
+        run_test ();
+    }
+    success("budget values seem to work");
+
+cleanup:
+    qof_close();
+    return get_rv();
+}
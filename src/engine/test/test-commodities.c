@@ -179,6 +179,64 @@ test_commodity(void)
         }
     }
 
+    {
+        gnc_commodity_table *tbl;
+        gnc_commodity *acme, *beta;
+        GList *quotables;
+        QofBook *book;
+
+        book = qof_book_new ();
+        tbl = gnc_commodity_table_new ();
+        acme = gnc_commodity_new(book, "Acme Corp", "NYSE", "ACME",
+                                 "US0001", 100);
+        beta = gnc_commodity_new(book, "Beta Fund", "FUND", "BETA",
+                                 "US0002", 1000);
+        gnc_commodity_table_insert(tbl, acme);
+        gnc_commodity_table_insert(tbl, beta);
+
+        do_test(gnc_commodity_table_find_full(tbl, "NYSE", "ACME (Acme Corp)")
+                == acme, "find full");
+        do_test(gnc_commodity_table_find_full(tbl, "FUND", "ACME (Acme Corp)")
+                == NULL, "find full in the wrong namespace");
+        do_test(gnc_commodity_table_find_by_fullname(tbl, "Beta Fund") == beta,
+                "find by full name");
+        do_test(gnc_commodity_table_find_by_cusip(tbl, "US0001") == acme,
+                "find by cusip");
+
+        gnc_commodity_set_fullname(acme, "Acme Inc");
+        gnc_commodity_set_cusip(acme, "US0003");
+        do_test(gnc_commodity_table_find_full(tbl, "NYSE", "ACME (Acme Corp)")
+                == NULL, "find old printname");
+        do_test(gnc_commodity_table_find_full(tbl, "NYSE", "ACME (Acme Inc)")
+                == acme, "find new printname");
+        do_test(gnc_commodity_table_find_by_fullname(tbl, "Acme Corp") == NULL,
+                "find old full name");
+        do_test(gnc_commodity_table_find_by_cusip(tbl, "US0001") == NULL,
+                "find old cusip");
+        do_test(gnc_commodity_table_find_by_cusip(tbl, "US0003") == acme,
+                "find new cusip");
+
+        quotables = gnc_commodity_table_get_quotable_commodities(tbl);
+        do_test(quotables == NULL, "no quotables");
+        gnc_commodity_set_quote_source(beta,
+                                       gnc_quote_source_lookup_by_internal("currency"));
+        gnc_commodity_set_quote_flag(beta, TRUE);
+        quotables = gnc_commodity_table_get_quotable_commodities(tbl);
+        do_test(g_list_length(quotables) == 1 && quotables->data == beta,
+                "one quotable");
+        g_list_free(quotables);
+
+        gnc_commodity_table_remove(tbl, beta);
+        do_test(gnc_commodity_table_find_by_cusip(tbl, "US0002") == NULL,
+                "find removed commodity");
+        quotables = gnc_commodity_table_get_quotable_commodities(tbl);
+        do_test(quotables == NULL, "removed commodity isn't quotable");
+
+        gnc_commodity_destroy(beta);
+        gnc_commodity_table_destroy(tbl);
+        qof_book_destroy (book);
+    }
+
 }
 
 int
@@ -109,6 +109,51 @@ check_conversion (const char * str, Timespec expected_ts)
     return TRUE;
 }
 
+/* The arithmetic conversions must agree with the C library's. */
+static gboolean
+check_civil (time_t secs)
+{
+    struct tm expected, got;
+
+    localtime_r (&secs, &expected);
+    gnc_date_secs_to_local_civil (secs, &got);
+    if (expected.tm_year != got.tm_year || expected.tm_mon != got.tm_mon ||
+            expected.tm_mday != got.tm_mday ||
+            expected.tm_hour != got.tm_hour ||
+            expected.tm_min != got.tm_min || expected.tm_sec != got.tm_sec ||
+            gnc_timezone (&expected) != gnc_timezone_at (secs))
+    {
+        failure_args ("local civil", __FILE__, __LINE__,
+                      "%ld differs from localtime", (long) secs);
+        return FALSE;
+    }
+
+    gmtime_r (&secs, &expected);
+    gnc_date_secs_to_civil (secs, &got);
+    if (expected.tm_year != got.tm_year || expected.tm_mon != got.tm_mon ||
+            expected.tm_mday != got.tm_mday ||
+            expected.tm_hour != got.tm_hour ||
+            expected.tm_min != got.tm_min || expected.tm_sec != got.tm_sec ||
+            expected.tm_wday != got.tm_wday || expected.tm_yday != got.tm_yday)
+    {
+        failure_args ("utc civil", __FILE__, __LINE__,
+                      "%ld differs from gmtime", (long) secs);
+        return FALSE;
+    }
+
+    if (gnc_date_civil_to_secs (got.tm_year + 1900, got.tm_mon + 1,
+                                got.tm_mday, got.tm_hour, got.tm_min,
+                                got.tm_sec) != secs)
+    {
+        failure_args ("civil to secs", __FILE__, __LINE__,
+                      "%ld does not round trip", (long) secs);
+        return FALSE;
+    }
+
+    success ("civil conversion");
+    return TRUE;
+}
+
 static void
 run_test (void)
 {
@@ -384,6 +429,14 @@ run_test (void)
             return;
     }
 
+    /* Just under every hour for three years or so either side of the
+     * epoch, which takes in a few daylight saving transitions. */
+    for (i = -30000; i < 30000; i++)
+    {
+        if (!check_civil ((time_t) i * 3599))
+            return;
+    }
+
     for (i = 0; i < 5000; i++)
     {
         ts = *get_random_timespec ();
@@ -0,0 +1,215 @@
+/***************************************************************************
+ *            test-duplicate-finder.c
+ *
+ *  Copyright  2011 GnuCash team
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+/* Check that the duplicate finder returns the same transactions as
+ * the split query the QIF importer used to build for each new
+ * transaction. */
+
+#include "config.h"
+#include <time.h>
+#include <glib.h>
+#include "qof.h"
+#include "cashobjects.h"
+#include "Transaction.h"
+#include "TransLog.h"
+#include "gnc-duplicate-finder.h"
+#include "gnc-engine.h"
+#include "test-engine-stuff.h"
+#include "test-stuff.h"
+
+typedef struct
+{
+    Account *root;
+    GncDuplicateFinder *finder;
+} TestData;
+
+static Timespec
+shift_days (Timespec date, int days)
+{
+    struct tm tm;
+    time_t secs = date.tv_sec;
+    Timespec result;
+
+    localtime_r (&secs, &tm);
+    tm.tm_mday += days;
+    result.tv_sec = mktime (&tm);
+    result.tv_nsec = 0;
+    return result;
+}
+
+static TransList *
+query_duplicates (Account *root, Transaction *trans, query_txn_match_t type)
+{
+    QofQuery *query, *q_splits = NULL, *q_new;
+    QofBook *book = gnc_account_get_book (root);
+    Timespec date = xaccTransRetDatePostedTS (trans);
+    GList *accounts, *node;
+    TransList *result;
+
+    query = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (query, book);
+    accounts = gnc_account_get_descendants_sorted (root);
+    xaccQueryAddAccountMatch (query, accounts, QOF_GUID_MATCH_ANY, QOF_QUERY_AND);
+    g_list_free (accounts);
+    xaccQueryAddDateMatchTS (query, TRUE, shift_days (date, -7),
+                             TRUE, shift_days (date, 7), QOF_QUERY_AND);
+
+    for (node = xaccTransGetSplitList (trans); node; node = node->next)
+    {
+        Split *split = node->data;
+        QofQuery *sq = qof_query_create_for (GNC_ID_SPLIT);
+        gchar *name = gnc_account_get_full_name (xaccSplitGetAccount (split));
+
+        qof_query_set_book (sq, book);
+        xaccQueryAddSingleAccountMatch (sq,
+                                        gnc_account_lookup_by_full_name (root, name),
+                                        QOF_QUERY_AND);
+        g_free (name);
+        xaccQueryAddValueMatch (sq, xaccSplitGetValue (split),
+                                QOF_NUMERIC_MATCH_ANY, QOF_COMPARE_EQUAL,
+                                QOF_QUERY_AND);
+        if (q_splits)
+        {
+            q_new = qof_query_merge (q_splits, sq, QOF_QUERY_OR);
+            qof_query_destroy (q_splits);
+            qof_query_destroy (sq);
+            q_splits = q_new;
+        }
+        else
+            q_splits = sq;
+    }
+
+    if (q_splits)
+    {
+        q_new = qof_query_merge (query, q_splits, QOF_QUERY_AND);
+        qof_query_destroy (query);
+        qof_query_destroy (q_splits);
+        query = q_new;
+    }
+
+    result = xaccQueryGetTransactions (query, type);
+    qof_query_destroy (query);
+    return result;
+}
+
+static gint
+compare_pointers (gconstpointer a, gconstpointer b)
+{
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static gboolean
+same_transactions (TransList *a, TransList *b)
+{
+    for (; a && b; a = a->next, b = b->next)
+        if (a->data != b->data)
+            return FALSE;
+    return a == NULL && b == NULL;
+}
+
+static int
+test_trans_duplicates (Transaction *trans, gpointer data)
+{
+    TestData *td = data;
+    query_txn_match_t type;
+
+    for (type = QUERY_TXN_MATCH_ALL; type <= QUERY_TXN_MATCH_ANY; type++)
+    {
+        TransList *expected = query_duplicates (td->root, trans, type);
+        TransList *found = gnc_duplicate_finder_find (td->finder, trans, type);
+
+        /* Neither returns the transactions in any particular order. */
+        expected = g_list_sort (expected, compare_pointers);
+        found = g_list_sort (found, compare_pointers);
+
+        if (!same_transactions (expected, found))
+        {
+            failure_args ("duplicates", __FILE__, __LINE__,
+                          "finder found %d transactions, query %d",
+                          g_list_length (found), g_list_length (expected));
+            g_list_free (expected);
+            g_list_free (found);
+            return 13;
+        }
+        if (type == QUERY_TXN_MATCH_ANY && !g_list_find (found, trans))
+        {
+            failure ("transaction is not a duplicate of itself");
+            g_list_free (expected);
+            g_list_free (found);
+            return 13;
+        }
+        g_list_free (expected);
+        g_list_free (found);
+    }
+
+    success ("finder matches query");
+    return 0;
+}
+
+static void
+run_test (void)
+{
+    QofSession *session;
+    QofBook *book;
+    TestData td;
+
+    session = get_random_session ();
+    book = qof_session_get_book (session);
+    td.root = gnc_book_get_root_account (book);
+
+    add_random_transactions_to_book (book, 20);
+
+    td.finder = gnc_duplicate_finder_new (td.root);
+    xaccAccountTreeForEachTransaction (td.root, test_trans_duplicates, &td);
+    gnc_duplicate_finder_destroy (td.finder);
+
+    qof_session_end (session);
+}
+
+int
+main (int argc, char **argv)
+{
+    int i;
+
+    qof_init();
+    g_log_set_always_fatal( G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING );
+
+    xaccLogDisable ();
+
+    /* Always start from the same random seed so we fail consistently */
+    srand(0);
+    if (!cashobjects_register())
+    {
+        failure("can't register cashbojects");
+        goto cleanup;
+    }
+
+    for (i = 0; i < 10; i++)
+    {
+        run_test ();
+    }
+    success("duplicate finder seems to work");
+
+cleanup:
+    qof_close();
+    return get_rv();
+}
@@ -27,6 +27,7 @@
 #include "cashobjects.h"
 #include "Transaction.h"
 #include "TransLog.h"
+#include "gnc-lot.h"
 #include "gnc-engine.h"
 #include "test-engine-stuff.h"
 #include "test-stuff.h"
@@ -65,20 +66,341 @@ test_trans_query (Transaction *trans, gpointer data)
     return 0;
 }
 
+static gint
+compare_pointers (gconstpointer a, gconstpointer b)
+{
+    return a < b ? -1 : a > b;
+}
+
+/* The transactions of the splits the query finds, picked the way
+ * xaccQueryGetTransactions used to: for QUERY_TXN_MATCH_ALL, those all
+ * of whose splits were found. */
+static GList *
+reference_transactions (QofQuery *q, query_txn_match_t runtype)
+{
+    GHashTable *counts = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GList *node, *result = NULL, *trans_list;
+
+    for (node = qof_query_run (q); node; node = node->next)
+    {
+        Transaction *trans = xaccSplitGetParent (node->data);
+        gint count = GPOINTER_TO_INT (g_hash_table_lookup (counts, trans));
+        g_hash_table_insert (counts, trans, GINT_TO_POINTER (count + 1));
+    }
+
+    trans_list = g_hash_table_get_keys (counts);
+    for (node = trans_list; node; node = node->next)
+    {
+        gint count = GPOINTER_TO_INT (g_hash_table_lookup (counts, node->data));
+        if (runtype == QUERY_TXN_MATCH_ANY ||
+                count == xaccTransCountSplits (node->data))
+            result = g_list_prepend (result, node->data);
+    }
+    g_list_free (trans_list);
+    g_hash_table_destroy (counts);
+    return g_list_sort (result, compare_pointers);
+}
+
+/* The same for lots, whose splits may be found one by one; splits
+ * that are not in a lot are skipped. */
+static GList *
+reference_lots (QofQuery *q, query_txn_match_t runtype)
+{
+    GHashTable *counts = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GList *node, *result = NULL, *lot_list;
+
+    for (node = qof_query_run (q); node; node = node->next)
+    {
+        GNCLot *lot = xaccSplitGetLot (node->data);
+        gint count;
+
+        if (!lot)
+            continue;
+        count = GPOINTER_TO_INT (g_hash_table_lookup (counts, lot));
+        g_hash_table_insert (counts, lot, GINT_TO_POINTER (count + 1));
+    }
+
+    lot_list = g_hash_table_get_keys (counts);
+    for (node = lot_list; node; node = node->next)
+    {
+        gint count = GPOINTER_TO_INT (g_hash_table_lookup (counts, node->data));
+        if (runtype == QUERY_TXN_MATCH_ANY ||
+                count == (gint) g_list_length (gnc_lot_get_split_list (node->data)))
+            result = g_list_prepend (result, node->data);
+    }
+    g_list_free (lot_list);
+    g_hash_table_destroy (counts);
+    return g_list_sort (result, compare_pointers);
+}
+
+static gint
+compare_lot_titles (gconstpointer a, gconstpointer b)
+{
+    return safe_strcmp (gnc_lot_get_title ((GNCLot *) a),
+                        gnc_lot_get_title ((GNCLot *) b));
+}
+
+static gboolean
+same_list (GList *a, GList *b)
+{
+    for (; a && b; a = a->next, b = b->next)
+        if (a->data != b->data)
+            return FALSE;
+    return a == b;
+}
+
+/* Checks that xaccQueryGetTransactions(Sorted) find the reference
+ * transactions for both match types. */
+static gboolean
+check_runtypes (QofQuery *q)
+{
+    query_txn_match_t runtype;
+
+    for (runtype = QUERY_TXN_MATCH_ALL; runtype <= QUERY_TXN_MATCH_ANY;
+            runtype++)
+    {
+        GList *expected = reference_transactions (q, runtype);
+        GList *list = xaccQueryGetTransactions (q, runtype);
+        GList *sorted = xaccQueryGetTransactionsSorted (q, runtype,
+                        (GCompareFunc) xaccTransOrder);
+        GList *node;
+        gboolean ordered = TRUE;
+        gboolean ok;
+
+        for (node = sorted; node && node->next; node = node->next)
+            if (xaccTransOrder (node->data, node->next->data) > 0)
+                ordered = FALSE;
+
+        list = g_list_sort (list, compare_pointers);
+        ok = same_list (list, expected) && ordered &&
+             g_list_length (sorted) == g_list_length (expected);
+        if (!ok)
+            failure_args ("transaction query", __FILE__, __LINE__,
+                          "match type %d found %d transactions, expected %d%s",
+                          runtype, g_list_length (list),
+                          g_list_length (expected),
+                          ordered ? "" : ", out of order");
+        g_list_free (expected);
+        g_list_free (list);
+        g_list_free (sorted);
+        if (!ok)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Checks that xaccQueryGetLots(Sorted) find the reference lots for
+ * both match types, and nothing for the splits without a lot. */
+static gboolean
+check_lot_runtypes (QofQuery *q)
+{
+    query_txn_match_t runtype;
+
+    for (runtype = QUERY_TXN_MATCH_ALL; runtype <= QUERY_TXN_MATCH_ANY;
+            runtype++)
+    {
+        GList *expected = reference_lots (q, runtype);
+        GList *list = xaccQueryGetLots (q, runtype);
+        GList *sorted = xaccQueryGetLotsSorted (q, runtype, compare_lot_titles);
+        GList *node;
+        gboolean ordered = TRUE;
+        gboolean ok;
+
+        for (node = sorted; node && node->next; node = node->next)
+            if (compare_lot_titles (node->data, node->next->data) > 0)
+                ordered = FALSE;
+
+        list = g_list_sort (list, compare_pointers);
+        ok = same_list (list, expected) && ordered &&
+             g_list_length (sorted) == g_list_length (expected) &&
+             !g_list_find (list, NULL) && !g_list_find (sorted, NULL);
+        if (!ok)
+            failure_args ("lot query", __FILE__, __LINE__,
+                          "match type %d found %d lots, expected %d%s",
+                          runtype, g_list_length (list),
+                          g_list_length (expected),
+                          ordered ? "" : ", out of order");
+        g_list_free (expected);
+        g_list_free (list);
+        g_list_free (sorted);
+        if (!ok)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static int
+test_trans_query_runtypes (Transaction *trans, gpointer data)
+{
+    QofBook *book = data;
+    QofQuery *q;
+    gboolean ok;
+
+    /* Some splits of some transactions */
+    q = make_trans_query (trans, ACCOUNT_QT);
+    qof_query_set_book (q, book);
+    ok = check_runtypes (q) && check_lot_runtypes (q);
+    qof_query_destroy (q);
+
+    /* All splits of one transaction */
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddGUIDMatch (q, xaccTransGetGUID (trans), GNC_ID_TRANS,
+                           QOF_QUERY_AND);
+    ok = ok && check_runtypes (q) && check_lot_runtypes (q);
+    qof_query_destroy (q);
+
+    if (!ok)
+        return 13;
+    success ("transaction and lot queries agree with split query");
+    return 0;
+}
+
+static void
+collect_instance (QofInstance *inst, gpointer user_data)
+{
+    GList **list = user_data;
+
+    *list = g_list_prepend (*list, inst);
+}
+
+#define CANDIDATE_DESCRIPTION "Candidate check"
+
+static GList *candidate_splits = NULL;
+static gint candidate_calls = 0;
+
+/* Stands in for an index which says that only candidate_splits can
+ * match. */
+static gboolean
+test_candidates (QofBook *book, QofIdTypeConst search_for,
+                 const QofQueryParamList *param_list,
+                 const gchar * const *literals, GList **candidates)
+{
+    candidate_calls++;
+    *candidates = g_list_copy (candidate_splits);
+    return TRUE;
+}
+
+/* TRUE if every lot on the list has a split of trans. */
+static gboolean
+lots_of_trans (GList *lots, Transaction *trans)
+{
+    for (; lots; lots = lots->next)
+    {
+        GList *node;
+
+        for (node = xaccTransGetSplitList (trans); node; node = node->next)
+            if (xaccSplitGetLot (node->data) == lots->data)
+                break;
+        if (!node)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Gives two transactions the same description, but lets the registered
+ * candidates function offer only the splits of the first. Transaction
+ * and lot queries must then look no further than those splits. */
+static void
+test_candidate_owners (QofBook *book, Transaction *first, Transaction *second)
+{
+    QofQuery *q;
+    GList *list, *lots;
+
+    xaccTransBeginEdit (first);
+    xaccTransSetDescription (first, CANDIDATE_DESCRIPTION);
+    xaccTransCommitEdit (first);
+    xaccTransBeginEdit (second);
+    xaccTransSetDescription (second, CANDIDATE_DESCRIPTION);
+    xaccTransCommitEdit (second);
+
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddDescriptionMatch (q, CANDIDATE_DESCRIPTION, TRUE, FALSE,
+                                  QOF_QUERY_AND);
+
+    candidate_splits = xaccTransGetSplitList (first);
+    candidate_calls = 0;
+    qof_query_register_candidates (GNC_ID_SPLIT, test_candidates);
+    list = xaccQueryGetTransactions (q, QUERY_TXN_MATCH_ANY);
+    lots = xaccQueryGetLots (q, QUERY_TXN_MATCH_ANY);
+    qof_query_register_candidates (GNC_ID_SPLIT, NULL);
+    do_test (candidate_calls >= 2, "candidates asked for by owner queries");
+    do_test (g_list_length (list) == 1 && list->data == first,
+             "transaction query checked only the candidates");
+    do_test (lots_of_trans (lots, first), "lot query checked only the candidates");
+    g_list_free (list);
+    g_list_free (lots);
+
+    list = xaccQueryGetTransactions (q, QUERY_TXN_MATCH_ANY);
+    do_test (g_list_length (list) == 2,
+             "transaction query checks every transaction without candidates");
+    g_list_free (list);
+    qof_query_destroy (q);
+    candidate_splits = NULL;
+}
+
+/* Puts the splits of each account in two lots, leaving every third
+ * split out of them, so that some lots have all their splits found by
+ * a query and some splits have no lot. */
+static void
+add_lots (Account *root)
+{
+    GList *accounts = gnc_account_get_descendants (root);
+    GList *node;
+
+    for (node = accounts; node; node = node->next)
+    {
+        Account *account = node->data;
+        GList *splits = g_list_copy (xaccAccountGetSplitList (account));
+        GNCLot *lots[2] = { NULL, NULL };
+        GList *split_node;
+        gint i = 0;
+
+        for (split_node = splits; split_node; split_node = split_node->next, i++)
+        {
+            if (i % 3 == 2)
+                continue;
+            if (!lots[i % 3])
+            {
+                gchar *title = g_strdup_printf ("%s lot %d",
+                                                xaccAccountGetName (account),
+                                                i % 3);
+                lots[i % 3] = gnc_lot_new (gnc_account_get_book (account));
+                gnc_lot_set_title (lots[i % 3], title);
+                g_free (title);
+            }
+            gnc_lot_add_split (lots[i % 3], split_node->data);
+        }
+        g_list_free (splits);
+    }
+    g_list_free (accounts);
+}
+
 static void
 run_test (void)
 {
     QofSession *session;
     Account *root;
     QofBook *book;
+    GList *transactions = NULL;
 
     session = get_random_session ();
     book = qof_session_get_book (session);
     root = gnc_book_get_root_account (book);
 
     add_random_transactions_to_book (book, 20);
+    add_lots (root);
 
     xaccAccountTreeForEachTransaction (root, test_trans_query, book);
+    xaccAccountTreeForEachTransaction (root, test_trans_query_runtypes, book);
+
+    qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                            collect_instance, &transactions);
+    if (g_list_length (transactions) >= 2)
+        test_candidate_owners (book, transactions->data,
+                               transactions->next->data);
+    g_list_free (transactions);
 
     qof_session_end (session);
 }
@@ -0,0 +1,281 @@
+/***************************************************************************
+ *            test-text-index.c
+ *
+ *  Tests that queries narrowed by the text index find what a scan finds.
+ ****************************************************************************/
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+#include "qof.h"
+#include "cashobjects.h"
+#include "Query.h"
+#include "Split.h"
+#include "Transaction.h"
+#include "TransLog.h"
+#include "gnc-engine.h"
+#include "gnc-text-index.h"
+#include "test-engine-stuff.h"
+#include "test-stuff.h"
+
+typedef void (*AddMatch) (QofQuery *q, const char *m, gboolean c, gboolean r,
+                          QofQueryOp o);
+
+static gint
+compare_pointers (gconstpointer a, gconstpointer b)
+{
+    return a < b ? -1 : a > b;
+}
+
+/* Runs a split query for 'match' and returns the splits found, sorted.
+ * For a scan, the query is ORed with a term no split matches: the text
+ * index can only narrow a query whose every OR-term has a string match,
+ * so no candidates are asked for and every split is checked. */
+static GList *
+run_query (QofBook *book, AddMatch add, const char *match, gboolean case_sens,
+           gboolean regex, gboolean scan)
+{
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    GList *result;
+
+    qof_query_set_book (q, book);
+    add (q, match, case_sens, regex, QOF_QUERY_AND);
+    if (scan)
+    {
+        QofQuery *none = qof_query_create_for (GNC_ID_SPLIT);
+        QofQuery *merged;
+
+        qof_query_set_book (none, book);
+        xaccQueryAddGUIDMatch (none, guid_null (), GNC_ID_SPLIT, QOF_QUERY_AND);
+        merged = qof_query_merge (q, none, QOF_QUERY_OR);
+        qof_query_destroy (none);
+        qof_query_destroy (q);
+        q = merged;
+    }
+
+    result = g_list_sort (g_list_copy (qof_query_run (q)), compare_pointers);
+    qof_query_destroy (q);
+    return result;
+}
+
+/* Runs a split query for 'match' through the index of book and as a
+ * scan, and returns the number of splits found, or -1 if the results
+ * differ.  If 'indexed' is not NULL, it is set to the splits found. */
+static gint
+run_both (QofBook *book, AddMatch add, const char *match, gboolean case_sens,
+          gboolean regex, GList **indexed)
+{
+    GList *scanned, *found, *a, *b;
+    gint count = 0;
+
+    found = run_query (book, add, match, case_sens, regex, FALSE);
+    scanned = run_query (book, add, match, case_sens, regex, TRUE);
+
+    for (a = scanned, b = found; a && b; a = a->next, b = b->next, count++)
+        if (a->data != b->data)
+            break;
+    if (a || b)
+        count = -1;
+
+    g_list_free (scanned);
+    if (indexed)
+        *indexed = found;
+    else
+        g_list_free (found);
+    return count;
+}
+
+/* Returns TRUE if none of the splits of trans is in 'splits'. */
+static gboolean
+trans_absent (GList *splits, Transaction *trans)
+{
+    GList *node;
+
+    for (node = splits; node; node = node->next)
+        if (xaccSplitGetParent (node->data) == trans)
+            return FALSE;
+    return TRUE;
+}
+
+static gboolean
+check_substrings (QofBook *book, const char *text, AddMatch add)
+{
+    gchar *sub, *upper;
+    gint len;
+
+    if (!text || strlen (text) < 4)
+        return TRUE;
+
+    len = strlen (text);
+    sub = g_strndup (text + len / 4, MAX (3, len / 2));
+    upper = g_ascii_strup (sub, -1);
+
+    if (run_both (book, add, sub, TRUE, FALSE, NULL) < 1 ||
+            run_both (book, add, upper, FALSE, FALSE, NULL) < 1)
+    {
+        failure_args ("substring", __FILE__, __LINE__,
+                      "searching for \"%s\" in \"%s\"", sub, text);
+        g_free (sub);
+        g_free (upper);
+        return FALSE;
+    }
+    g_free (sub);
+    g_free (upper);
+    return TRUE;
+}
+
+static void
+test_random_text (QofBook *book)
+{
+    GList *splits;
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    GList *node;
+    gint checked = 0;
+
+    qof_query_set_book (q, book);
+    splits = g_list_copy (qof_query_run (q));
+    qof_query_destroy (q);
+
+    for (node = splits; node && checked < 50; node = node->next, checked++)
+    {
+        Split *split = node->data;
+        Transaction *trans = xaccSplitGetParent (split);
+
+        if (!check_substrings (book, xaccTransGetDescription (trans),
+                               xaccQueryAddDescriptionMatch) ||
+                !check_substrings (book, xaccSplitGetMemo (split),
+                                   xaccQueryAddMemoMatch) ||
+                !check_substrings (book, xaccSplitGetAction (split),
+                                   xaccQueryAddActionMatch) ||
+                !check_substrings (book, xaccTransGetNum (trans),
+                                   xaccQueryAddNumberMatch))
+            break;
+    }
+    g_list_free (splits);
+    if (!node || checked == 50)
+        success ("indexed substring queries match scans");
+}
+
+/* The index stays enabled across the edits, so the results come from
+ * the updates made by the commit events and not from a rebuild. */
+static void
+test_updates (QofBook *book)
+{
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    Transaction *trans;
+    Split *split;
+    GList *found;
+    gint n_splits;
+
+    qof_query_set_book (q, book);
+    split = qof_query_run (q)->data;
+    qof_query_destroy (q);
+    trans = xaccSplitGetParent (split);
+    n_splits = xaccTransCountSplits (trans);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetDescription (trans, "Grocery Store 42");
+    xaccSplitSetMemo (split, "Weekly \xc3\x89picerie");
+    xaccTransCommitEdit (trans);
+
+    do_test (run_both (book, xaccQueryAddDescriptionMatch,
+                       "grocery store", FALSE, FALSE, NULL) >= n_splits,
+             "new description found");
+    do_test (run_both (book, xaccQueryAddDescriptionMatch,
+                       "Groc.*Store [0-9]+", TRUE, TRUE, NULL) >= n_splits,
+             "regular expression with literals");
+    do_test (run_both (book, xaccQueryAddDescriptionMatch,
+                       "Supermarket|Grocery", TRUE, TRUE, NULL) >= n_splits,
+             "regular expression with alternation");
+    do_test (run_both (book, xaccQueryAddMemoMatch, "\xc3\xa9PICERIE",
+                       FALSE, FALSE, NULL) >= 1,
+             "case folded memo found");
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetDescription (trans, "Zebra crossing");
+    xaccSplitSetMemo (split, "Monthly rent");
+    xaccTransCommitEdit (trans);
+
+    do_test (run_both (book, xaccQueryAddDescriptionMatch,
+                       "ebra cross", FALSE, FALSE, NULL) >= n_splits,
+             "changed description found");
+    do_test (run_both (book, xaccQueryAddDescriptionMatch,
+                       "Grocery Store 42", TRUE, FALSE, &found) >= 0
+             && trans_absent (found, trans),
+             "old description no longer found");
+    g_list_free (found);
+    do_test (run_both (book, xaccQueryAddMemoMatch, "picerie",
+                       FALSE, FALSE, &found) >= 0
+             && !g_list_find (found, split),
+             "old memo no longer found");
+    g_list_free (found);
+
+    xaccTransBeginEdit (trans);
+    xaccTransDestroy (trans);
+    xaccTransCommitEdit (trans);
+
+    do_test (run_both (book, xaccQueryAddDescriptionMatch,
+                       "Zebra crossing", TRUE, FALSE, NULL) == 0,
+             "destroyed transaction not found");
+}
+
+static void
+run_test (void)
+{
+    QofSession *session;
+    QofBook *book;
+
+    session = get_random_session ();
+    book = qof_session_get_book (session);
+    add_random_transactions_to_book (book, 20);
+    gnc_text_index_enable (book);
+
+    test_random_text (book);
+    test_updates (book);
+
+    qof_session_end (session);
+}
+
+int
+main (int argc, char **argv)
+{
+    int i;
+
+    qof_init();
+    g_log_set_always_fatal( G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING );
+
+    xaccLogDisable ();
+
+    /* Always start from the same random seed so we fail consistently */
+    srand(0);
+    if (!cashobjects_register())
+    {
+        failure("can't register cashbojects");
+        goto cleanup;
+    }
+
+    for (i = 0; i < 5; i++)
+    {
+        run_test ();
+    }
+
+cleanup:
+    qof_close();
+    return get_rv();
+}
@@ -0,0 +1,27 @@
+/*************************************************************
+ * gnc-module-manifest.c -- write the gnc_module manifests
+ *
+ * Usage: gnc-module-manifest [dir ...]
+ *
+ * Writes a manifest into each of the given directories, or into
+ * those of GNC_MODULE_PATH if none are given.  Run at install time.
+ *************************************************************/
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gnc-module.h"
+
+int
+main(int argc, char ** argv)
+{
+    if (argc > 1)
+    {
+        gchar * path = g_strjoinv(G_SEARCHPATH_SEPARATOR_S, argv + 1);
+        g_setenv("GNC_MODULE_PATH", path, TRUE);
+        g_free(path);
+    }
+
+    return gnc_module_system_write_manifests() ? 0 : 1;
+}
@@ -9,7 +9,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <gmodule.h>
+#include <glib/gstdio.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #ifdef HAVE_DIRENT_H
 # include <dirent.h>
 #endif
@@ -42,7 +44,11 @@ typedef struct
     int           (* init_func)(int refcount);
 } GNCLoadedModule;
 
-static GNCModuleInfo * gnc_module_get_info(const char * lib_path);
+static GNCModuleInfo * gnc_module_get_info(const char * lib_path,
+        gboolean * inspected);
+
+/* The name of the manifest file in each module directory. */
+#define GNC_MODULE_MANIFEST "gnc-module-manifest"
 
 /*************************************************************
  * gnc_module_system_search_dirs
@@ -120,6 +126,241 @@ gnc_module_system_search_dirs(void)
     return list;
 }
 
+/*************************************************************
+ * gnc_module_is_candidate
+ * is the file name that of a library that may be a gnc_module?
+ *************************************************************/
+
+static gboolean
+gnc_module_is_candidate(const gchar * dent)
+{
+    /* Gotcha: On MacOS, G_MODULE_SUFFIX is defined as "so", but if we do
+     * not build clean libtool modules with "-module", we get dynamic
+     * libraries ending on .dylib
+     * On Windows, all modules will move to bin/, so they will be mixed with
+     * other libraries, such as gtk+. Adding a prefix "libgncmod" filter will prevent
+     * module loader load other libraries. And the filter should works on other platform.
+     */
+    return ((g_str_has_suffix(dent, "." G_MODULE_SUFFIX)
+             || g_str_has_suffix(dent, ".dylib"))
+            && g_str_has_prefix(dent, GNC_MODULE_PREFIX));
+}
+
+static void
+gnc_module_info_free(GNCModuleInfo * info)
+{
+    if (!info) return;
+    g_free(info->module_path);
+    g_free(info->module_description);
+    g_free(info->module_filepath);
+    g_free(info);
+}
+
+/*************************************************************
+ * The module manifest
+ * Each module directory may hold a manifest, written by
+ * gnc_module_system_write_manifests, that records what
+ * gnc_module_get_info found out about each library there, along
+ * with the library's size and modification time.  A library whose
+ * entry still matches is not opened until it is loaded.
+ *************************************************************/
+
+static GKeyFile *
+gnc_module_manifest_read(const gchar * dir)
+{
+    gchar * filename = g_build_filename(dir, GNC_MODULE_MANIFEST, (char*)NULL);
+    GKeyFile * manifest = g_key_file_new();
+
+    if (!g_key_file_load_from_file(manifest, filename, G_KEY_FILE_NONE, NULL))
+    {
+        g_key_file_free(manifest);
+        manifest = NULL;
+    }
+    g_free(filename);
+    return manifest;
+}
+
+static gint64
+gnc_module_manifest_get_int64(GKeyFile * manifest, const gchar * group,
+                              const gchar * key)
+{
+    gchar * str = g_key_file_get_string(manifest, group, key, NULL);
+    gint64 val = str ? g_ascii_strtoll(str, NULL, 10) : -1;
+
+    g_free(str);
+    return val;
+}
+
+static void
+gnc_module_manifest_set_int64(GKeyFile * manifest, const gchar * group,
+                              const gchar * key, gint64 val)
+{
+    gchar * str = g_strdup_printf("%" G_GINT64_FORMAT, val);
+
+    g_key_file_set_string(manifest, group, key, str);
+    g_free(str);
+}
+
+/* Returns TRUE if the manifest has an up to date entry for the library
+ * dent in fullpath.  *info is then set to what the entry records, which
+ * is NULL for a library that is not a gnc_module. */
+static gboolean
+gnc_module_manifest_lookup(GKeyFile * manifest, const gchar * dent,
+                           const gchar * fullpath, GNCModuleInfo ** info)
+{
+    struct stat st;
+    GError * error = NULL;
+    GNCModuleInfo * found;
+    gboolean is_module;
+
+    if (!manifest || !g_key_file_has_group(manifest, dent))
+        return FALSE;
+
+    if (g_stat(fullpath, &st) != 0
+            || gnc_module_manifest_get_int64(manifest, dent, "size") != st.st_size
+            || gnc_module_manifest_get_int64(manifest, dent, "mtime") != st.st_mtime)
+        return FALSE;
+
+    is_module = g_key_file_get_boolean(manifest, dent, "module", &error);
+    if (error)
+    {
+        g_error_free(error);
+        return FALSE;
+    }
+    if (!is_module)
+    {
+        *info = NULL;
+        return TRUE;
+    }
+
+    found = g_new0(GNCModuleInfo, 1);
+    found->module_path =
+        g_key_file_get_string(manifest, dent, "path", NULL);
+    found->module_description =
+        g_key_file_get_string(manifest, dent, "description", NULL);
+    found->module_filepath = g_strdup(fullpath);
+    found->module_interface =
+        g_key_file_get_integer(manifest, dent, "interface", &error);
+    if (!error)
+        found->module_revision =
+            g_key_file_get_integer(manifest, dent, "revision", &error);
+    if (!error)
+        found->module_age =
+            g_key_file_get_integer(manifest, dent, "age", &error);
+
+    if (error || !found->module_path || !found->module_description)
+    {
+        if (error)
+            g_error_free(error);
+        gnc_module_info_free(found);
+        return FALSE;
+    }
+
+    *info = found;
+    return TRUE;
+}
+
+/* Writes the manifest for one directory, leaving out the libraries
+ * that could not be opened: those are looked at again at startup. */
+static gboolean
+gnc_module_manifest_write(const gchar * dir)
+{
+    GDir * d = g_dir_open(dir, 0, NULL);
+    const gchar * dent;
+    GKeyFile * manifest;
+    gchar * filename;
+    gchar * data;
+    gsize length;
+    gboolean ok = TRUE;
+    GError * error = NULL;
+
+    if (!d)
+        return TRUE;
+
+    manifest = g_key_file_new();
+    while ((dent = g_dir_read_name(d)) != NULL)
+    {
+        gchar * fullpath;
+        GNCModuleInfo * info;
+        gboolean inspected;
+        struct stat st;
+
+        if (!gnc_module_is_candidate(dent))
+            continue;
+
+        fullpath = g_build_filename(dir, dent, (char*)NULL);
+        if (g_stat(fullpath, &st) == 0)
+        {
+            info = gnc_module_get_info(fullpath, &inspected);
+            if (inspected)
+            {
+                gnc_module_manifest_set_int64(manifest, dent, "size",
+                                              st.st_size);
+                gnc_module_manifest_set_int64(manifest, dent, "mtime",
+                                              st.st_mtime);
+                g_key_file_set_boolean(manifest, dent, "module", info != NULL);
+            }
+            if (info)
+            {
+                g_key_file_set_string(manifest, dent, "path",
+                                      info->module_path);
+                g_key_file_set_string(manifest, dent, "description",
+                                      info->module_description);
+                g_key_file_set_integer(manifest, dent, "interface",
+                                       info->module_interface);
+                g_key_file_set_integer(manifest, dent, "revision",
+                                       info->module_revision);
+                g_key_file_set_integer(manifest, dent, "age",
+                                       info->module_age);
+                gnc_module_info_free(info);
+            }
+        }
+        g_free(fullpath);
+    }
+    g_dir_close(d);
+
+    filename = g_build_filename(dir, GNC_MODULE_MANIFEST, (char*)NULL);
+    data = g_key_file_to_data(manifest, &length, NULL);
+    if (length == 0)
+    {
+        /* Nothing to record; don't leave an old manifest behind. */
+        g_unlink(filename);
+    }
+    else if (!g_file_set_contents(filename, data, length, &error))
+    {
+        g_warning("Could not write the module manifest %s: %s",
+                  filename, error->message);
+        g_error_free(error);
+        ok = FALSE;
+    }
+    g_free(data);
+    g_free(filename);
+    g_key_file_free(manifest);
+    return ok;
+}
+
+/*************************************************************
+ * gnc_module_system_write_manifests
+ * write a manifest into each directory of the GNC_MODULE_PATH
+ *************************************************************/
+
+gboolean
+gnc_module_system_write_manifests(void)
+{
+    GList * search_dirs = gnc_module_system_search_dirs();
+    GList * current;
+    gboolean ok = TRUE;
+
+    for (current = search_dirs; current; current = current->next)
+    {
+        if (!gnc_module_manifest_write(current->data))
+            ok = FALSE;
+        g_free(current->data);
+    }
+    g_list_free(search_dirs);
+    return ok;
+}
+
 /*************************************************************
  * gnc_module_system_init
  * initialize the module system
@@ -141,7 +382,8 @@ gnc_module_system_init(void)
 /*************************************************************
  * gnc_module_system_refresh
  * build the database of modules by looking through the
- * GNC_MODULE_PATH
+ * GNC_MODULE_PATH.  Libraries are only opened if their
+ * directory's manifest does not describe them.
  *************************************************************/
 
 void
@@ -165,29 +407,25 @@ gnc_module_system_refresh(void)
         const gchar *dent = NULL;
         char * fullpath = NULL;
         GNCModuleInfo * info;
+        GKeyFile * manifest;
 
         if (!d) continue;
 
+        manifest = gnc_module_manifest_read(current->data);
+
         while ((dent = g_dir_read_name(d)) != NULL)
         {
             /* is the file a loadable module? */
-
-            /* Gotcha: On MacOS, G_MODULE_SUFFIX is defined as "so", but if we do
-             * not build clean libtool modules with "-module", we get dynamic
-             * libraries ending on .dylib
-             * On Windows, all modules will move to bin/, so they will be mixed with
-             * other libraries, such as gtk+. Adding a prefix "libgncmod" filter will prevent
-             * module loader load other libraries. And the filter should works on other platform.
-             */
-            if ((g_str_has_suffix(dent, "." G_MODULE_SUFFIX)
-                    || g_str_has_suffix(dent, ".dylib"))
-                    && g_str_has_prefix(dent, GNC_MODULE_PREFIX))
+            if (gnc_module_is_candidate(dent))
             {
-                /* get the full path name, then dlopen the library and see
-                 * if it has the appropriate symbols to be a gnc_module */
+                /* get the full path name, then unless the manifest
+                 * describes it, dlopen the library and see if it has the
+                 * appropriate symbols to be a gnc_module */
                 fullpath = g_build_filename((const gchar *)(current->data),
                                             dent, (char*)NULL);
-                info     = gnc_module_get_info(fullpath);
+                if (!gnc_module_manifest_lookup(manifest, dent, fullpath,
+                                                &info))
+                    info = gnc_module_get_info(fullpath, NULL);
 
                 if (info)
                 {
@@ -197,6 +435,8 @@ gnc_module_system_refresh(void)
             }
         }
         g_dir_close(d);
+        if (manifest)
+            g_key_file_free(manifest);
 
     }
     /* free the search dir strings */
@@ -265,11 +505,12 @@ gnc_module_get_symbol(GModule* gmodule, const char* symbol, gpointer res)
 /*************************************************************
  *  gnc_module_get_info
  *  check a proposed gnc_module by looking for specific symbols in it;
- *  if it's a gnc_module, return a struct describing it.
+ *  if it's a gnc_module, return a struct describing it.  If given,
+ *  *inspected is set to FALSE when the library could not be opened.
  *************************************************************/
 
 static GNCModuleInfo *
-gnc_module_get_info(const char * fullpath)
+gnc_module_get_info(const char * fullpath, gboolean * inspected)
 {
     GModule *gmodule;
     gpointer modsysver;
@@ -279,12 +520,16 @@ gnc_module_get_info(const char * fullpath)
     gchar * (* f_descrip)(void);
 
     /*   g_debug("(init) dlopening '%s'\n", fullpath); */
+    if (inspected)
+        *inspected = FALSE;
     gmodule = g_module_open(fullpath, G_MODULE_BIND_LAZY);
     if (gmodule == NULL)
     {
         g_warning("Failed to dlopen() '%s': %s\n", fullpath, g_module_error());
         return NULL;
     }
+    if (inspected)
+        *inspected = TRUE;
 
     /* the modsysver tells us what the expected symbols and their
      * types are */
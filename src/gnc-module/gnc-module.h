@@ -19,6 +19,11 @@ void            gnc_module_system_init(void);
 void            gnc_module_system_refresh(void);
 GList         * gnc_module_system_modinfo(void);
 
+/* write a manifest of the modules into each directory of the module
+ * path, so that refreshing need only open the libraries that have
+ * changed since.  Returns FALSE if a manifest could not be written. */
+gboolean        gnc_module_system_write_manifests(void);
+
 /* load and unload a module.  gnc_module_system_init() must be called
  * before loading and unloading.
  */
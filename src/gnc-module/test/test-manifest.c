@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libguile.h>
+
+#include "gnc-module.h"
+
+#define AGEDVER_LIB "libgncmod_agedver." G_MODULE_SUFFIX
+
+/* Copies the modules in the GNC_MODULE_PATH into a private directory,
+ * so that the manifests written and changed below can't affect the
+ * other tests, which may be running at the same time. */
+static gchar *
+copy_modules(gchar ** dirs)
+{
+    gchar * tmpdir = g_build_filename(g_get_tmp_dir(), "test-manifest-XXXXXX",
+                                      NULL);
+    gchar ** dir;
+
+    if (g_mkdtemp(tmpdir) == NULL)
+    {
+        g_free(tmpdir);
+        return NULL;
+    }
+
+    for (dir = dirs; *dir; dir++)
+    {
+        GDir * d = g_dir_open(*dir, 0, NULL);
+        const gchar * dent;
+
+        if (!d) continue;
+        while ((dent = g_dir_read_name(d)) != NULL)
+        {
+            gchar * from, * to, * data;
+            gsize length;
+
+            if (!g_str_has_prefix(dent, GNC_MODULE_PREFIX)
+                    || !g_str_has_suffix(dent, "." G_MODULE_SUFFIX))
+                continue;
+
+            from = g_build_filename(*dir, dent, NULL);
+            to = g_build_filename(tmpdir, dent, NULL);
+            if (g_file_get_contents(from, &data, &length, NULL))
+            {
+                g_file_set_contents(to, data, length, NULL);
+                g_free(data);
+            }
+            g_free(from);
+            g_free(to);
+        }
+        g_dir_close(d);
+    }
+    return tmpdir;
+}
+
+static void
+remove_private_dir(const gchar * tmpdir)
+{
+    GDir * d = g_dir_open(tmpdir, 0, NULL);
+    const gchar * dent;
+
+    if (d)
+    {
+        while ((dent = g_dir_read_name(d)) != NULL)
+        {
+            gchar * filename = g_build_filename(tmpdir, dent, NULL);
+            g_unlink(filename);
+            g_free(filename);
+        }
+        g_dir_close(d);
+    }
+    g_rmdir(tmpdir);
+}
+
+/* Makes the manifest claim that agedver supports one interface more
+ * than it does, so that we can tell whether the module system believed
+ * it rather than the library. */
+static gboolean
+mark_agedver(const gchar * dir)
+{
+    gboolean found = FALSE;
+    gchar * filename = g_build_filename(dir, "gnc-module-manifest", NULL);
+    GKeyFile * manifest = g_key_file_new();
+
+    if (g_key_file_load_from_file(manifest, filename, G_KEY_FILE_NONE, NULL)
+            && g_key_file_has_group(manifest, AGEDVER_LIB))
+    {
+        gchar * data;
+        gsize length;
+
+        g_key_file_set_integer(manifest, AGEDVER_LIB, "age", 10);
+        data = g_key_file_to_data(manifest, &length, NULL);
+        found = g_file_set_contents(filename, data, length, NULL);
+        g_free(data);
+    }
+    g_key_file_free(manifest);
+    g_free(filename);
+    return found;
+}
+
+static void
+guile_main(void *closure, int argc, char ** argv)
+{
+    const char * path = g_getenv("GNC_MODULE_PATH");
+    gchar ** dirs = g_strsplit(path ? path : "", G_SEARCHPATH_SEPARATOR_S, 0);
+    gchar * tmpdir;
+    gboolean ok = FALSE;
+
+    printf("  test-manifest.c:  finding a module through its manifest ...");
+
+    tmpdir = copy_modules(dirs);
+    g_strfreev(dirs);
+    if (tmpdir != NULL)
+    {
+        g_setenv("GNC_MODULE_PATH", tmpdir, TRUE);
+        if (gnc_module_system_write_manifests() && mark_agedver(tmpdir))
+        {
+            gnc_module_system_init();
+
+            /* agedver itself only goes back to interface 3. */
+            ok = gnc_module_load("gnucash/agedver", 2) != NULL;
+        }
+        remove_private_dir(tmpdir);
+        g_free(tmpdir);
+    }
+
+    if (ok)
+    {
+        printf("  ok\n");
+        exit(0);
+    }
+    else
+    {
+        printf(" failed\n");
+        exit(-1);
+    }
+}
+
+int
+main(int argc, char ** argv)
+{
+    scm_boot_guile(argc, argv, guile_main, NULL);
+    return 0;
+}
@@ -664,9 +664,14 @@ gnc_ui_start_event_loop (void)
     XSetErrorHandler (gnc_x_error);
 #endif
 
+    /* Let the component manager collapse event bursts into a single
+     * refresh from the idle handler while the main loop is running. */
+    gnc_component_manager_set_coalesce (TRUE);
+
     /* Enter gnome event loop */
     gtk_main ();
 
+    gnc_component_manager_set_coalesce (FALSE);
     g_source_remove (id);
 
     gnome_is_running = FALSE;
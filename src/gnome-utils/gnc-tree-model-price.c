@@ -27,7 +27,14 @@
  * In this model, valid paths take the form "X", "X:Y", or "X:Y:Z", where:
  *   X is an index into the namespaces list held by the commodity db
  *   Y is an index into the commodity list for the namespace
- *   Z is an index into the price list for the commodity
+ *   Z is an index into the model's list of prices for the commodity
+ *
+ * The price lists are built from the price db the first time a
+ * commodity's prices are needed and then kept up to date from the
+ * engine's ADD and REMOVE events, so walking the prices or converting
+ * between paths and iterators never has to copy the price db's lists.
+ * The order of the prices within a list is arbitrary; the view
+ * sorts them.
  *
  * Iterators are populated with the following private data:
  *   iter->user_data   Type NAMESPACE | COMMODITY | PRICE
@@ -129,8 +136,24 @@ typedef struct GncTreeModelPricePrivate
     GNCPriceDB *price_db;
     gint event_handler_id;
     GNCPrintAmountInfo print_info;
+    GHashTable *prices;        /* commodity -> PriceSlots of its prices */
+    GHashTable *price_index;   /* price -> its slot in that list + 1 */
 } GncTreeModelPricePrivate;
 
+/** The prices of one commodity.  A removed price leaves an empty slot
+ *  instead of moving the prices after it, so the slots recorded in
+ *  the price index stay valid.  'counts' is a Fenwick tree over the
+ *  slots holding how many of them are in use, which turns a slot
+ *  into a row number and a row number into a slot in logarithmic
+ *  time.  The empty slots are squeezed out once they outnumber the
+ *  prices. */
+typedef struct
+{
+    GPtrArray *slots;          /* GNCPrice, or NULL once removed */
+    GArray *counts;            /* guint, 1-based Fenwick tree over slots */
+    guint n_prices;
+} PriceSlots;
+
 #define GNC_TREE_MODEL_PRICE_GET_PRIVATE(o)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((o), GNC_TYPE_TREE_MODEL_PRICE, GncTreeModelPricePrivate))
 
@@ -201,6 +224,22 @@ gnc_tree_model_price_init (GncTreeModelPrice *model)
 
     priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
     priv->print_info = gnc_share_print_info_places(6);
+    priv->prices = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->price_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+static void
+free_price_slots (gpointer key, gpointer value, gpointer user_data)
+{
+    PriceSlots *prices = value;
+    guint i;
+
+    for (i = 0; i < prices->slots->len; i++)
+        if (g_ptr_array_index (prices->slots, i))
+            gnc_price_unref (g_ptr_array_index (prices->slots, i));
+    g_ptr_array_free (prices->slots, TRUE);
+    g_array_free (prices->counts, TRUE);
+    g_free (prices);
 }
 
 static void
@@ -220,6 +259,10 @@ gnc_tree_model_price_finalize (GObject *object)
     priv->book = NULL;
     priv->price_db = NULL;
 
+    g_hash_table_foreach (priv->prices, free_price_slots, NULL);
+    g_hash_table_destroy (priv->prices);
+    g_hash_table_destroy (priv->price_index);
+
     G_OBJECT_CLASS (parent_class)->finalize (object);
     LEAVE(" ");
 }
@@ -359,6 +402,249 @@ gnc_tree_model_price_get_price (GncTreeModelPrice *model,
     return (GNCPrice *)iter->user_data2;
 }
 
+/************************************************************/
+/*                  Price List Functions                    */
+/************************************************************/
+
+#define LOWEST_BIT(k) ((k) & -(k))
+
+static PriceSlots *
+price_slots_new (guint size)
+{
+    PriceSlots *prices = g_new0 (PriceSlots, 1);
+
+    prices->slots = g_ptr_array_sized_new (size);
+    prices->counts = g_array_sized_new (FALSE, TRUE, sizeof(guint), size + 1);
+    g_array_set_size (prices->counts, 1);
+    return prices;
+}
+
+/** Return the number of prices in the slots before 'slot'. */
+static guint
+price_slots_count_before (PriceSlots *prices, guint slot)
+{
+    guint count = 0, k;
+
+    for (k = slot; k > 0; k -= LOWEST_BIT(k))
+        count += g_array_index (prices->counts, guint, k);
+    return count;
+}
+
+/** Append a price in a new slot and return the slot. */
+static guint
+price_slots_append (PriceSlots *prices, GNCPrice *price)
+{
+    guint slot = prices->slots->len;
+    guint k = slot + 1;
+    guint count;
+
+    /* The new node counts the slots (k - LOWEST_BIT(k), k]. */
+    count = 1 + price_slots_count_before (prices, slot)
+            - price_slots_count_before (prices, k - LOWEST_BIT(k));
+    g_ptr_array_add (prices->slots, price);
+    g_array_append_val (prices->counts, count);
+    prices->n_prices++;
+    return slot;
+}
+
+/** Empty a slot. */
+static void
+price_slots_clear (PriceSlots *prices, guint slot)
+{
+    guint k;
+
+    g_ptr_array_index (prices->slots, slot) = NULL;
+    for (k = slot + 1; k <= prices->slots->len; k += LOWEST_BIT(k))
+        g_array_index (prices->counts, guint, k)--;
+    prices->n_prices--;
+}
+
+/** Return the price in row 'n', or NULL if there are fewer prices. */
+static GNCPrice *
+price_slots_nth (PriceSlots *prices, gint n)
+{
+    guint size = prices->slots->len;
+    guint slot = 0, step = 1, remaining;
+
+    if (n < 0 || (guint) n >= prices->n_prices)
+        return NULL;
+
+    while (step * 2 <= size)
+        step *= 2;
+
+    /* Find the last slot before which there are at most n prices. */
+    remaining = n + 1;
+    for ( ; step > 0; step /= 2)
+    {
+        if (slot + step <= size &&
+                g_array_index (prices->counts, guint, slot + step) < remaining)
+        {
+            slot += step;
+            remaining -= g_array_index (prices->counts, guint, slot);
+        }
+    }
+    return g_ptr_array_index (prices->slots, slot);
+}
+
+/** Return the model's list of prices for a commodity, building it
+ *  from the price db the first time it is asked for.
+ *
+ *  @internal
+ */
+static PriceSlots *
+gnc_tree_model_price_get_prices (GncTreeModelPrice *model,
+                                 gnc_commodity *commodity)
+{
+    GncTreeModelPricePrivate *priv;
+    PriceSlots *prices;
+    GList *list, *node;
+    guint slot;
+
+    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
+    prices = g_hash_table_lookup (priv->prices, commodity);
+    if (prices)
+        return prices;
+
+    /* The list takes over the references held by the db's list. */
+    list = gnc_pricedb_get_prices (priv->price_db, commodity, NULL);
+    prices = price_slots_new (g_list_length (list));
+    for (node = list; node; node = node->next)
+    {
+        slot = price_slots_append (prices, node->data);
+        g_hash_table_insert (priv->price_index, node->data,
+                             GUINT_TO_POINTER(slot + 1));
+    }
+    g_list_free (list);
+    g_hash_table_insert (priv->prices, commodity, prices);
+    return prices;
+}
+
+/** Return the row of a price within its commodity's list, or -1 if
+ *  the model doesn't hold the price.
+ *
+ *  @internal
+ */
+static gint
+gnc_tree_model_price_index_of (GncTreeModelPrice *model, GNCPrice *price)
+{
+    GncTreeModelPricePrivate *priv;
+    PriceSlots *prices;
+    guint slot;
+
+    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
+    slot = GPOINTER_TO_UINT(g_hash_table_lookup (priv->price_index, price));
+    prices = g_hash_table_lookup (priv->prices, gnc_price_get_commodity (price));
+    if (slot == 0 || !prices)
+        return -1;
+    return price_slots_count_before (prices, slot - 1);
+}
+
+/** Append a price that has just been added to the price db.  Nothing
+ *  needs doing if its commodity's list hasn't been built yet.
+ *
+ *  @internal
+ */
+static void
+gnc_tree_model_price_insert_price (GncTreeModelPrice *model, GNCPrice *price)
+{
+    GncTreeModelPricePrivate *priv;
+    PriceSlots *prices;
+    guint slot;
+
+    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
+    prices = g_hash_table_lookup (priv->prices, gnc_price_get_commodity (price));
+    if (!prices || g_hash_table_lookup (priv->price_index, price))
+        return;
+
+    gnc_price_ref (price);
+    slot = price_slots_append (prices, price);
+    g_hash_table_insert (priv->price_index, price, GUINT_TO_POINTER(slot + 1));
+}
+
+/** Rebuild a commodity's list without its empty slots.
+ *
+ *  @internal
+ */
+static void
+gnc_tree_model_price_compact (GncTreeModelPrice *model, gnc_commodity *commodity,
+                              PriceSlots *prices)
+{
+    GncTreeModelPricePrivate *priv;
+    PriceSlots *compact;
+    GNCPrice *price;
+    guint i, slot;
+
+    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
+    compact = price_slots_new (prices->n_prices);
+    for (i = 0; i < prices->slots->len; i++)
+    {
+        price = g_ptr_array_index (prices->slots, i);
+        if (!price)
+            continue;
+        slot = price_slots_append (compact, price);
+        g_hash_table_insert (priv->price_index, price, GUINT_TO_POINTER(slot + 1));
+    }
+
+    /* The compact list has taken over the references. */
+    g_ptr_array_set_size (prices->slots, 0);
+    g_hash_table_insert (priv->prices, commodity, compact);
+    free_price_slots (commodity, prices, NULL);
+}
+
+/** Drop a price that is about to be removed from the price db.  The
+ *  rows after it move up one place.
+ *
+ *  @internal
+ */
+static void
+gnc_tree_model_price_remove_price (GncTreeModelPrice *model, GNCPrice *price)
+{
+    GncTreeModelPricePrivate *priv;
+    gnc_commodity *commodity;
+    PriceSlots *prices;
+    guint slot;
+
+    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
+    commodity = gnc_price_get_commodity (price);
+    prices = g_hash_table_lookup (priv->prices, commodity);
+    slot = GPOINTER_TO_UINT(g_hash_table_lookup (priv->price_index, price));
+    if (!prices || slot == 0 || slot > prices->slots->len ||
+            g_ptr_array_index (prices->slots, slot - 1) != price)
+        return;
+
+    price_slots_clear (prices, slot - 1);
+    g_hash_table_remove (priv->price_index, price);
+    gnc_price_unref (price);
+
+    if (prices->slots->len > 16 && prices->slots->len > 2 * prices->n_prices)
+        gnc_tree_model_price_compact (model, commodity, prices);
+}
+
+/** Drop the list of a commodity that is being destroyed.
+ *
+ *  @internal
+ */
+static void
+gnc_tree_model_price_forget_commodity (GncTreeModelPrice *model,
+                                       gnc_commodity *commodity)
+{
+    GncTreeModelPricePrivate *priv;
+    PriceSlots *prices;
+    guint i;
+
+    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
+    prices = g_hash_table_lookup (priv->prices, commodity);
+    if (!prices)
+        return;
+
+    g_hash_table_remove (priv->prices, commodity);
+    for (i = 0; i < prices->slots->len; i++)
+        if (g_ptr_array_index (prices->slots, i))
+            g_hash_table_remove (priv->price_index,
+                                 g_ptr_array_index (prices->slots, i));
+    free_price_slots (commodity, prices, NULL);
+}
+
 /************************************************************/
 /*        Gnc Tree Model Debugging Utility Function         */
 /************************************************************/
@@ -520,7 +806,8 @@ gnc_tree_model_price_get_iter (GtkTreeModel *tree_model,
     gnc_commodity_namespace *namespace;
     gnc_commodity *commodity = NULL;
     GNCPrice *price;
-    GList *ns_list, *cm_list, *price_list;
+    GList *ns_list, *cm_list;
+    PriceSlots *prices;
     guint i, depth;
 
     g_return_val_if_fail (GNC_IS_TREE_MODEL_PRICE (tree_model), FALSE);
@@ -594,10 +881,9 @@ gnc_tree_model_price_get_iter (GtkTreeModel *tree_model,
     }
 
     /* Verify the third part of the path: the price. */
-    price_list = gnc_pricedb_get_prices(priv->price_db, commodity, NULL);
+    prices = gnc_tree_model_price_get_prices (model, commodity);
     i = gtk_tree_path_get_indices (path)[2];
-    price = g_list_nth_data (price_list, i);
-    gnc_price_list_destroy(price_list);
+    price = price_slots_nth (prices, i);
     /* There's a race condition here that I can't resolve.
      * Comment this check out for now, and we'll handle the
      * resulting problem elsewhere. */
@@ -816,6 +1102,7 @@ gnc_tree_model_price_iter_next (GtkTreeModel *tree_model,
     gnc_commodity_table *ct;
     gnc_commodity *commodity;
     gnc_commodity_namespace *namespace;
+    PriceSlots *prices;
     GList *list;
     gint n;
 
@@ -860,9 +1147,8 @@ gnc_tree_model_price_iter_next (GtkTreeModel *tree_model,
     {
         commodity = gnc_price_get_commodity((GNCPrice*)iter->user_data2);
         n = GPOINTER_TO_INT(iter->user_data3) + 1;
-        list = gnc_pricedb_get_prices(priv->price_db, commodity, NULL);
-        iter->user_data2 = g_list_nth_data(list, n);
-        gnc_price_list_destroy(list);
+        prices = gnc_tree_model_price_get_prices(model, commodity);
+        iter->user_data2 = price_slots_nth(prices, n);
         if (iter->user_data2 == NULL)
         {
             LEAVE("no next iter");
@@ -889,6 +1175,7 @@ gnc_tree_model_price_iter_children (GtkTreeModel *tree_model,
     gnc_commodity_table *ct;
     gnc_commodity_namespace *namespace;
     gnc_commodity *commodity;
+    PriceSlots *prices;
     GList *list;
 
     g_return_val_if_fail (GNC_IS_TREE_MODEL_PRICE (tree_model), FALSE);
@@ -937,17 +1224,16 @@ gnc_tree_model_price_iter_children (GtkTreeModel *tree_model,
     if (parent->user_data == ITER_IS_COMMODITY)
     {
         commodity = (gnc_commodity *)parent->user_data2;
-        list = gnc_pricedb_get_prices(priv->price_db, commodity, NULL);
-        if (list == NULL)
+        prices = gnc_tree_model_price_get_prices(model, commodity);
+        if (prices->n_prices == 0)
         {
             LEAVE("no prices");
             return FALSE;
         }
         iter->stamp      = model->stamp;
         iter->user_data  = ITER_IS_PRICE;
-        iter->user_data2 = g_list_nth_data(list, 0);
+        iter->user_data2 = price_slots_nth(prices, 0);
         iter->user_data3 = GINT_TO_POINTER(0);
-        gnc_price_list_destroy(list);
         LEAVE("price iter %p (%s)", iter, iter_to_string(model, iter));
         return TRUE;
     }
@@ -961,7 +1247,6 @@ gnc_tree_model_price_iter_has_child (GtkTreeModel *tree_model,
                                      GtkTreeIter *iter)
 {
     GncTreeModelPrice *model;
-    GncTreeModelPricePrivate *priv;
     gnc_commodity_namespace *namespace;
     gnc_commodity *commodity;
     gboolean result;
@@ -973,7 +1258,6 @@ gnc_tree_model_price_iter_has_child (GtkTreeModel *tree_model,
     g_return_val_if_fail (tree_model != NULL, FALSE);
     g_return_val_if_fail (iter != NULL, FALSE);
 
-    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
     if (iter->user_data == ITER_IS_PRICE)
     {
         LEAVE("price has no children");
@@ -991,7 +1275,7 @@ gnc_tree_model_price_iter_has_child (GtkTreeModel *tree_model,
     if (iter->user_data == ITER_IS_COMMODITY)
     {
         commodity = (gnc_commodity *)iter->user_data2;
-        result = gnc_pricedb_has_prices(priv->price_db, commodity, NULL);
+        result = gnc_tree_model_price_get_prices(model, commodity)->n_prices > 0;
         LEAVE("%s children", result ? "has" : "no");
         return result;
     }
@@ -1038,9 +1322,7 @@ gnc_tree_model_price_iter_n_children (GtkTreeModel *tree_model,
     if (iter->user_data == ITER_IS_COMMODITY)
     {
         commodity = (gnc_commodity *)iter->user_data2;
-        list = gnc_pricedb_get_prices(priv->price_db, commodity, NULL);
-        n = g_list_length(list);
-        gnc_price_list_destroy(list);
+        n = gnc_tree_model_price_get_prices(model, commodity)->n_prices;
         LEAVE("price list length %d", n);
         return n;
     }
@@ -1060,6 +1342,7 @@ gnc_tree_model_price_iter_nth_child (GtkTreeModel *tree_model,
     gnc_commodity_table *ct;
     gnc_commodity_namespace *namespace;
     gnc_commodity *commodity;
+    PriceSlots *prices;
     GList *list;
 
     g_return_val_if_fail (GNC_IS_TREE_MODEL_PRICE (tree_model), FALSE);
@@ -1099,13 +1382,12 @@ gnc_tree_model_price_iter_nth_child (GtkTreeModel *tree_model,
     if (parent->user_data == ITER_IS_COMMODITY)
     {
         commodity = (gnc_commodity *)parent->user_data2;
-        list = gnc_pricedb_get_prices(priv->price_db, commodity, NULL);
+        prices = gnc_tree_model_price_get_prices(model, commodity);
 
         iter->stamp      = model->stamp;
         iter->user_data  = ITER_IS_PRICE;
-        iter->user_data2 = g_list_nth_data(list, n);
+        iter->user_data2 = price_slots_nth(prices, n);
         iter->user_data3 = GINT_TO_POINTER(n);
-        gnc_price_list_destroy(list);
         LEAVE("price iter %p (%s)", iter, iter_to_string(model, iter));
         return iter->user_data2 != NULL;
     }
@@ -1182,9 +1464,7 @@ gnc_tree_model_price_get_iter_from_price (GncTreeModelPrice *model,
         GNCPrice *price,
         GtkTreeIter *iter)
 {
-    GncTreeModelPricePrivate *priv;
     gnc_commodity *commodity;
-    GList *list;
     gint n;
 
     ENTER("model %p, price %p, iter %p", model, price, iter);
@@ -1192,7 +1472,6 @@ gnc_tree_model_price_get_iter_from_price (GncTreeModelPrice *model,
     g_return_val_if_fail ((price != NULL), FALSE);
     g_return_val_if_fail ((iter != NULL), FALSE);
 
-    priv = GNC_TREE_MODEL_PRICE_GET_PRIVATE(model);
     commodity = gnc_price_get_commodity(price);
     if (commodity == NULL)
     {
@@ -1200,17 +1479,11 @@ gnc_tree_model_price_get_iter_from_price (GncTreeModelPrice *model,
         return FALSE;
     }
 
-    list = gnc_pricedb_get_prices(priv->price_db, commodity, NULL);
-    if (list == NULL)
-    {
-        LEAVE("empty list");
-        return FALSE;
-    }
-
-    n = g_list_index(list, price);
+    /* Make sure the commodity's prices are in the index. */
+    gnc_tree_model_price_get_prices(model, commodity);
+    n = gnc_tree_model_price_index_of(model, price);
     if (n == -1)
     {
-        gnc_price_list_destroy(list);
         LEAVE("not in list");
         return FALSE;
     }
@@ -1219,7 +1492,6 @@ gnc_tree_model_price_get_iter_from_price (GncTreeModelPrice *model,
     iter->user_data  = ITER_IS_PRICE;
     iter->user_data2 = price;
     iter->user_data3 = GINT_TO_POINTER(n);
-    gnc_price_list_destroy(list);
     LEAVE("iter %s", iter_to_string(model, iter));
     return TRUE;
 }
@@ -1638,8 +1910,9 @@ gnc_tree_model_price_do_deletions (gpointer unused)
  *  row_deleted().  So we will save the path now, then call a function
  *  to delete the row when we receive the next event or we're idle
  *  (whichever comes first.) This is a PITA, but the only other choice
- *  is to have this model mirror the engine's price table instead of
- *  referencing it directly.
+ *  is to have this model mirror the engine's tables instead of
+ *  referencing them directly.  It does that for prices, which are
+ *  removed straight away.
  *
  *  @param entity The affected item.
  *
@@ -1680,7 +1953,9 @@ gnc_tree_model_price_event_handler (QofInstance *entity,
 
         commodity = GNC_COMMODITY(entity);
         name = gnc_commodity_get_mnemonic(commodity);
-        if (event_type != QOF_EVENT_DESTROY)
+        if (event_type == QOF_EVENT_DESTROY)
+            gnc_tree_model_price_forget_commodity (model, commodity);
+        else
         {
             if (!gnc_tree_model_price_get_iter_from_commodity (model, commodity, &iter))
             {
@@ -1710,6 +1985,8 @@ gnc_tree_model_price_event_handler (QofInstance *entity,
 
         price = GNC_PRICE(entity);
         name = "price";
+        if (event_type == QOF_EVENT_ADD)
+            gnc_tree_model_price_insert_price (model, price);
         if (event_type != QOF_EVENT_DESTROY)
         {
             if (!gnc_tree_model_price_get_iter_from_price (model, price, &iter))
@@ -1718,6 +1995,23 @@ gnc_tree_model_price_event_handler (QofInstance *entity,
                 return;
             }
         }
+
+        /* The model holds its own arrays of prices, so unlike a
+         * namespace or a commodity a price can leave the model as
+         * soon as the price db announces its removal. */
+        if (event_type == QOF_EVENT_REMOVE)
+        {
+            DEBUG("remove %s", name);
+            path = gtk_tree_model_get_path (GTK_TREE_MODEL(model), &iter);
+            gnc_tree_model_price_remove_price (model, price);
+            if (path)
+            {
+                gnc_tree_model_price_row_delete (model, path);
+                gtk_tree_path_free (path);
+            }
+            LEAVE(" ");
+            return;
+        }
     }
     else
     {
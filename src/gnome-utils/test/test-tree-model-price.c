@@ -0,0 +1,220 @@
+/* test-tree-model-price.c:
+ *
+ *     Adds prices to and removes them from a price db, and checks
+ * that the price tree model shows each price of a commodity exactly
+ * once, finds the row of every price and signals every change.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+#include "config.h"
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "qof.h"
+#include "cashobjects.h"
+#include "gnc-commodity.h"
+#include "gnc-pricedb.h"
+#include "gnc-tree-model-price.h"
+#include "test-stuff.h"
+
+#define NUM_PRICES 300
+
+static gint rows_inserted = 0;
+static gint rows_deleted = 0;
+
+static void
+row_inserted_cb (GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter,
+                 gpointer user_data)
+{
+    rows_inserted++;
+}
+
+static void
+row_deleted_cb (GtkTreeModel *model, GtkTreePath *path, gpointer user_data)
+{
+    rows_deleted++;
+}
+
+/* Checks that the rows under the commodity are exactly 'prices', and
+ * that every price's path leads back to it. */
+static gboolean
+check_rows (GtkTreeModel *model, gnc_commodity *commodity, GList *prices,
+            const char *when)
+{
+    GncTreeModelPrice *price_model = GNC_TREE_MODEL_PRICE (model);
+    GHashTable *seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GtkTreeIter parent, iter;
+    GList *node;
+    gint n_rows = 0;
+    gboolean ok;
+
+    ok = gnc_tree_model_price_get_iter_from_commodity (price_model, commodity,
+            &parent);
+    if (ok && gtk_tree_model_iter_children (model, &iter, &parent))
+    {
+        do
+        {
+            GNCPrice *price = gnc_tree_model_price_get_price (price_model, &iter);
+
+            if (!price || g_hash_table_lookup (seen, price) ||
+                    !g_list_find (prices, price))
+                ok = FALSE;
+            g_hash_table_insert (seen, price, price);
+            n_rows++;
+        }
+        while (gtk_tree_model_iter_next (model, &iter));
+    }
+    ok = ok && n_rows == (gint) g_list_length (prices) &&
+         n_rows == gtk_tree_model_iter_n_children (model, &parent);
+
+    for (node = prices; node && ok; node = node->next)
+    {
+        GtkTreePath *path;
+
+        path = gnc_tree_model_price_get_path_from_price (price_model, node->data);
+        ok = path && gtk_tree_model_get_iter (model, &iter, path) &&
+             gnc_tree_model_price_get_price (price_model, &iter) == node->data;
+        if (path)
+            gtk_tree_path_free (path);
+    }
+    g_hash_table_destroy (seen);
+
+    if (!ok)
+        failure_args ("price rows", __FILE__, __LINE__,
+                      "%s: %d rows for %d prices", when, n_rows,
+                      g_list_length (prices));
+    else
+        success (when);
+    return ok;
+}
+
+static GNCPrice *
+add_price (QofBook *book, GNCPriceDB *db, gnc_commodity *commodity,
+           gnc_commodity *currency, gint i)
+{
+    GNCPrice *price = gnc_price_create (book);
+    Timespec ts = { 1000000000 + i * 86400, 0 };
+
+    gnc_price_begin_edit (price);
+    gnc_price_set_commodity (price, commodity);
+    gnc_price_set_currency (price, currency);
+    gnc_price_set_time (price, ts);
+    gnc_price_set_value (price, gnc_numeric_create (100 + i, 100));
+    gnc_price_commit_edit (price);
+    gnc_pricedb_add_price (db, price);
+    gnc_price_unref (price);
+    return price;
+}
+
+static void
+run_test (void)
+{
+    QofBook *book = qof_book_new ();
+    gnc_commodity_table *table = gnc_commodity_table_get_table (book);
+    GNCPriceDB *db = gnc_pricedb_get_db (book);
+    gnc_commodity *commodity, *currency;
+    GtkTreeModel *model;
+    GList *prices = NULL, *node;
+    gint i, n_removed;
+
+    currency = gnc_commodity_table_insert (table,
+                                           gnc_commodity_new (book, "Euro", "ISO4217", "EUR", NULL, 100));
+    commodity = gnc_commodity_table_insert (table,
+                                            gnc_commodity_new (book, "Stock", "NASDAQ", "STCK", NULL, 1000));
+
+    model = gnc_tree_model_price_new (book, db);
+    g_signal_connect (model, "row-inserted", G_CALLBACK (row_inserted_cb), NULL);
+    g_signal_connect (model, "row-deleted", G_CALLBACK (row_deleted_cb), NULL);
+
+    for (i = 0; i < NUM_PRICES / 2; i++)
+        prices = g_list_prepend (prices, add_price (book, db, commodity,
+                                 currency, i));
+    if (!check_rows (model, commodity, prices, "prices added"))
+        goto done;
+
+    /* The commodity's rows have been read, so the model now keeps its
+     * list up to date. */
+    rows_inserted = 0;
+    for ( ; i < NUM_PRICES; i++)
+        prices = g_list_prepend (prices, add_price (book, db, commodity,
+                                 currency, i));
+    do_test (rows_inserted == NUM_PRICES - NUM_PRICES / 2,
+             "a row inserted for every price");
+    if (!check_rows (model, commodity, prices, "prices added after reading"))
+        goto done;
+
+    /* Remove every third price, then most of the rest, so that the
+     * model has to drop prices from the middle and squeeze its list. */
+    rows_deleted = 0;
+    n_removed = 0;
+    for (node = prices, i = 0; node; i++)
+    {
+        GList *next = node->next;
+
+        if (i % 3 == 0)
+        {
+            gnc_pricedb_remove_price (db, node->data);
+            prices = g_list_delete_link (prices, node);
+            n_removed++;
+        }
+        node = next;
+    }
+    do_test (rows_deleted == n_removed, "a row deleted for every price");
+    if (!check_rows (model, commodity, prices, "every third price removed"))
+        goto done;
+
+    while (g_list_length (prices) > 5)
+    {
+        gnc_pricedb_remove_price (db, prices->data);
+        prices = g_list_delete_link (prices, prices);
+        n_removed++;
+    }
+    do_test (rows_deleted == n_removed, "a row deleted for every price");
+    if (!check_rows (model, commodity, prices, "most prices removed"))
+        goto done;
+
+    for (i = 0; i < 10; i++)
+        prices = g_list_prepend (prices, add_price (book, db, commodity,
+                                 currency, NUM_PRICES + i));
+    check_rows (model, commodity, prices, "prices added after removals");
+
+done:
+    g_list_free (prices);
+    g_object_unref (model);
+    qof_book_destroy (book);
+}
+
+int
+main (int argc, char **argv)
+{
+    g_type_init ();
+    qof_init ();
+    if (!cashobjects_register ())
+    {
+        failure ("can't register cashobjects");
+        goto cleanup;
+    }
+
+    run_test ();
+
+cleanup:
+    print_test_results ();
+    qof_close ();
+    return get_rv ();
+}
@@ -32,6 +32,7 @@
 #include "SX-book.h"
 #include "Transaction.h"
 #include "dialog-find-transactions.h"
+#include "gnc-text-index.h"
 #include "gnc-main-window.h"
 #include "gnc-plugin-page-register.h"
 #include "search-param.h"
@@ -132,6 +133,10 @@ gnc_ui_find_transactions_dialog_create(GNCLedgerDisplay * orig_ledg)
                                            NULL);
     }
 
+    /* Searches for text are typically refined several times; from now
+     * on let them look at the splits containing the text only. */
+    gnc_text_index_enable (gnc_get_current_book ());
+
     ftd = g_new0 (struct _ftd_data, 1);
 
     if (orig_ledg)
@@ -946,8 +946,9 @@ estimate_budget_helper(GtkTreeModel *model, GtkTreePath *path,
                        GtkTreeIter *iter, gpointer data)
 {
     Account *acct;
+    GList *accts;
     guint num_periods, i;
-    gnc_numeric num;
+    gnc_numeric num, *actuals;
     GncPluginPageBudgetPrivate *priv;
     GncPluginPageBudget *page = data;
 
@@ -959,9 +960,15 @@ estimate_budget_helper(GtkTreeModel *model, GtkTreePath *path,
 
     num_periods = g_list_length(priv->period_col_list);
 
+    /* All the periods in one pass over the account's splits. */
+    accts = g_list_prepend(NULL, acct);
+    actuals = recurrenceGetAccountPeriodValues(&priv->r, accts, num_periods,
+              TRUE);
+    g_list_free(accts);
+
     for (i = 0; i < num_periods; i++)
     {
-        num = recurrenceGetAccountPeriodValue(&priv->r, acct, i);
+        num = actuals[i];
         if (!gnc_numeric_check(num))
         {
             if (gnc_reverse_balance (acct))
@@ -974,6 +981,7 @@ estimate_budget_helper(GtkTreeModel *model, GtkTreePath *path,
                 priv->budget, acct, i, num);
         }
     }
+    g_free(actuals);
 }
 
 static void
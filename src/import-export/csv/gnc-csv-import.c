@@ -1071,6 +1071,10 @@ static int gnc_csv_preview_errors(GncCsvPreview* preview)
     preview->previewing_errors = TRUE;
     preview->approved = FALSE; /* This is FALSE until the user clicks "OK". */
 
+    /* The rows with errors are already in UTF-8; converting the file
+     * again would replace them with the start of the whole file. */
+    gtk_widget_set_sensitive(GTK_WIDGET(preview->encselector), FALSE);
+
     /* Wait until the user clicks "OK" or "Cancel". */
     gnc_csv_preview_update(preview);
 
@@ -1162,8 +1166,17 @@ void gnc_file_csv_import(void)
             return;
         }
 
-        /* Create transactions from the parsed data. */
-        gnc_csv_parse_to_trans(parse_data, account, FALSE);
+        /* Create transactions from the whole file; the preview may
+         * only have seen its start. If that fails, nothing is imported. */
+        if (gnc_csv_parse_to_trans_streaming(parse_data, account, &error))
+        {
+            gnc_error_dialog(NULL, "%s", error->message);
+            g_clear_error(&error);
+            gnc_csv_preview_free(preview);
+            gnc_csv_parse_data_free(parse_data);
+            g_free(selected_filename);
+            return;
+        }
 
         /* If there are errors, let the user try and eliminate them by
          * previewing them. Repeat until either there are no errors or the
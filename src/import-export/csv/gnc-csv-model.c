@@ -12,11 +12,11 @@
 #include <goffice/utils/go-glib-extras.h>
 
 #include <string.h>
+#include <errno.h>
 #include <sys/time.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <regex.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -28,6 +28,11 @@
 
 static QofLogModule log_module = GNC_MOD_IMPORT;
 
+/* How many raw bytes of a file are converted for the preview. */
+#define GNC_CSV_PREVIEW_BYTES (256 * 1024)
+/* How many raw bytes gnc_csv_parse_to_trans_streaming converts at a time. */
+#define GNC_CSV_STREAM_BYTES (256 * 1024)
+
 const int num_date_formats = 5;
 
 const gchar* date_format_user[] = {N_("y-m-d"),
@@ -58,259 +63,225 @@ static StfParseOptions_t* default_parse_options(void)
     return options;
 }
 
-/** Parses a string into a date, given a format. The format must
- * include the year. This function should only be called by
- * parse_date.
- * @param date_str The string containing a date being parsed
+/** A date format from date_format_user, prepared once for scanning
+ * many cells. */
+typedef struct
+{
+    int n_fields; /**< The number of fields in the format, 2 or 3 */
+    char fields[3]; /**< 'y', 'm' or 'd' for each field, in format order */
+    gboolean has_year; /**< TRUE if one of the fields is the year */
+    struct tm now; /**< The current local time, used for the parts of
+                    * the date that are not in the format */
+} GncCsvDateParser;
+
+/** Prepares a GncCsvDateParser for a format.
+ * @param parser The parser to initialize
  * @param format An index specifying a format in date_format_user
- * @return The parsed value of date_str on success or -1 on failure
  */
-static time_t parse_date_with_year(const char* date_str, int format)
+static void gnc_csv_date_parser_init(GncCsvDateParser* parser, int format)
 {
-    time_t rawtime; /* The integer time */
-    struct tm retvalue, test_retvalue; /* The time in a broken-down structure */
-
-    int i, j, mem_length, orig_year = -1, orig_month = -1, orig_day = -1;
-
-    /* Buffer for containing individual parts (e.g. year, month, day) of a date */
-    char date_segment[5];
-
-    /* The compiled regular expression */
-    regex_t preg = {0};
-
-    /* An array containing indices specifying the matched substrings in date_str */
-    regmatch_t pmatch[4] = { {0}, {0}, {0}, {0} };
-
-    /* The regular expression for parsing dates */
-    const char* regex = "^ *([0-9]+) *[-/.'] *([0-9]+) *[-/.'] *([0-9]+).*$|^ *([0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9]).*$";
+    time_t rawtime;
+    int i;
 
-    /* We get our matches using the regular expression. */
-    regcomp(&preg, regex, REG_EXTENDED);
-    regexec(&preg, date_str, 4, pmatch, 0);
-    regfree(&preg);
+    parser->n_fields = 0;
+    parser->has_year = FALSE;
 
-    /* If there wasn't a match, there was an error. */
-    if (pmatch[0].rm_eo == 0)
-        return -1;
+    /* No format selected yet: every date will fail to parse. */
+    if (format < 0 || format >= num_date_formats)
+        return;
 
-    /* If this is a string without separators ... */
-    if (pmatch[1].rm_so == -1)
+    for (i = 0; date_format_user[format][i] && parser->n_fields < 3; i++)
     {
-        /* ... we will fill in the indices based on the user's selection. */
-        int k = 0; /* k traverses date_str by keeping track of where separators "should" be. */
-        j = 1; /* j traverses pmatch. */
-        for (i = 0; date_format_user[format][i]; i++)
+        char segment_type = date_format_user[format][i];
+        /* Only meaningful characters make up a field. */
+        if (segment_type == 'y' || segment_type == 'm' || segment_type == 'd')
         {
-            char segment_type = date_format_user[format][i];
-            /* Only do something if this is a meaningful character */
-            if (segment_type == 'y' || segment_type == 'm' || segment_type == 'd')
-            {
-                pmatch[j].rm_so = k;
-                switch (segment_type)
-                {
-                case 'm':
-                case 'd':
-                    k += 2;
-                    break;
-
-                case 'y':
-                    k += 4;
-                    break;
-                }
-
-                pmatch[j].rm_eo = k;
-                j++;
-            }
+            parser->fields[parser->n_fields++] = segment_type;
+            if (segment_type == 'y')
+                parser->has_year = TRUE;
         }
     }
 
-    /* Put some sane values in retvalue by using the current time for
-     * the non-year-month-day parts of the date. */
+    /* Put some sane values in the non-year-month-day parts of the
+     * date by using the current time. */
     time(&rawtime);
-    localtime_r(&rawtime, &retvalue);
-
-    /* j traverses pmatch (index 0 contains the entire string, so we
-     * start at index 1 for the first meaningful match). */
-    j = 1;
-    /* Go through the date format and interpret the matches in order of
-     * the sections in the date format. */
-    for (i = 0; date_format_user[format][i]; i++)
-    {
-        char segment_type = date_format_user[format][i];
-        /* Only do something if this is a meaningful character */
-        if (segment_type == 'y' || segment_type == 'm' || segment_type == 'd')
-        {
-            /* Copy the matching substring into date_segment so that we can
-             * convert it into an integer. */
-            mem_length = pmatch[j].rm_eo - pmatch[j].rm_so;
-            memcpy(date_segment, date_str + pmatch[j].rm_so, mem_length);
-            date_segment[mem_length] = '\0';
-
-            /* Set the appropriate member of retvalue. Save the original
-             * values so that we can check if the change when we use mktime
-             * below. */
-            switch (segment_type)
-            {
-            case 'y':
-                retvalue.tm_year = atoi(date_segment);
-
-                /* Handle two-digit years. */
-                if (retvalue.tm_year < 100)
-                {
-                    /* We allow two-digit years in the range 1969 - 2068. */
-                    if (retvalue.tm_year < 69)
-                        retvalue.tm_year += 100;
-                }
-                else
-                    retvalue.tm_year -= 1900;
-                orig_year = retvalue.tm_year;
-                break;
+    localtime_r(&rawtime, &parser->now);
+}
 
-            case 'm':
-                orig_month = retvalue.tm_mon = atoi(date_segment) - 1;
-                break;
+/** Reads an unsigned decimal number of at least one and at most
+ * max_digits digits (or any number of digits if max_digits is 0).
+ * @param str Pointer to the position to read from; advanced past the number
+ * @param max_digits The maximum number of digits to read, or 0
+ * @param value Will contain the number on success
+ * @return TRUE if there was a number, FALSE otherwise
+ */
+static gboolean scan_date_number(const char** str, int max_digits, int* value)
+{
+    const char* p = *str;
+    int n = 0;
 
-            case 'd':
-                orig_day = retvalue.tm_mday = atoi(date_segment);
-                break;
-            }
-            j++;
-        }
-    }
-    /* Convert back to an integer. If mktime leaves retvalue unchanged,
-     * everything is okay; otherwise, an error has occurred. */
-    /* We have to use a "test" date value to account for changes in
-     * daylight savings time, which can cause a date change with mktime
-     * near midnight, causing the code to incorrectly think a date is
-     * incorrect. */
-    test_retvalue = retvalue;
-    mktime(&test_retvalue);
-    retvalue.tm_isdst = test_retvalue.tm_isdst;
-    rawtime = mktime(&retvalue);
-    if (retvalue.tm_mday == orig_day &&
-    retvalue.tm_mon == orig_month &&
-    retvalue.tm_year == orig_year)
-    {
-        return rawtime;
-    }
-    else
+    *value = 0;
+    while (*p >= '0' && *p <= '9' && (max_digits == 0 || n < max_digits))
     {
-        return -1;
+        /* Saturate rather than overflow; such a value fails validation anyway. */
+        if (*value < 100000)
+            *value = *value * 10 + (*p - '0');
+        p++;
+        n++;
     }
+
+    *str = p;
+    return n > 0;
 }
 
-/** Parses a string into a date, given a format. The format cannot
- * include the year. This function should only be called by
- * parse_date.
+static gboolean is_date_separator(char c)
+{
+    return c == '-' || c == '/' || c == '.' || c == '\'';
+}
+
+/** Splits a cell into its date fields. The fields are separated by
+ * any of "-/.'", optionally surrounded by spaces; anything following
+ * the last field is ignored. If the format has a year, the fields may
+ * also be written without separators as eight digits, with four
+ * digits for the year and two for month and day.
+ * @param parser The prepared date format
  * @param date_str The string containing a date being parsed
- * @param format An index specifying a format in date_format_user
- * @return The parsed value of date_str on success or -1 on failure
+ * @param values Will contain the fields in the order of the format
+ * @return TRUE on success, FALSE if date_str isn't shaped like a date
  */
-static time_t parse_date_without_year(const char* date_str, int format)
+static gboolean scan_date_fields(const GncCsvDateParser* parser,
+                                 const char* date_str, int values[3])
 {
-    time_t rawtime; /* The integer time */
-    struct tm retvalue, test_retvalue; /* The time in a broken-down structure */
+    const char* p = date_str;
+    const char* digits;
+    int i;
 
-    int i, j, mem_length, orig_year = -1, orig_month = -1, orig_day = -1;
+    while (*p == ' ')
+        p++;
+    digits = p;
 
-    /* Buffer for containing individual parts (e.g. year, month, day) of a date */
-    gchar* date_segment;
+    for (i = 0; i < parser->n_fields; i++)
+    {
+        if (i > 0)
+        {
+            while (*p == ' ')
+                p++;
+            if (!is_date_separator(*p))
+                break;
+            p++;
+            while (*p == ' ')
+                p++;
+        }
+        if (!scan_date_number(&p, 0, &values[i]))
+            break;
+    }
+    if (i == parser->n_fields)
+        return TRUE;
 
-    /* The compiled regular expression */
-    regex_t preg = {0};
+    if (!parser->has_year)
+        return FALSE;
 
-    /* An array containing indices specifying the matched substrings in date_str */
-    regmatch_t pmatch[3] = { {0}, {0}, {0} };
+    /* Try the form without separators, e.g. 20120131. */
+    for (i = 0; i < 8; i++)
+    {
+        if (digits[i] < '0' || digits[i] > '9')
+            return FALSE;
+    }
+
+    p = digits;
+    for (i = 0; i < parser->n_fields; i++)
+        scan_date_number(&p, parser->fields[i] == 'y' ? 4 : 2, &values[i]);
 
-    /* The regular expression for parsing dates */
-    const char* regex = "^ *([0-9]+) *[-/.'] *([0-9]+).*$";
+    return TRUE;
+}
 
-    /* We get our matches using the regular expression. */
-    regcomp(&preg, regex, REG_EXTENDED);
-    regexec(&preg, date_str, 3, pmatch, 0);
-    regfree(&preg);
+/** Parses a string into a date using a prepared format. This only
+ * requires knowing the order in which the year, month and day
+ * appear. For example, 01-02-2003 will be parsed the same way as
+ * 01/02/2003.
+ * @param parser The prepared date format
+ * @param date_str The string containing a date being parsed
+ * @return The parsed value of date_str on success or -1 on failure
+ */
+static time_t gnc_csv_date_parse(const GncCsvDateParser* parser,
+                                 const char* date_str)
+{
+    static const int days_in_month[12] =
+        {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    struct tm retvalue, test_retvalue;
+    int values[3], i, year;
+    time_t rawtime;
 
-    /* If there wasn't a match, there was an error. */
-    if (pmatch[0].rm_eo == 0)
+    if (parser->n_fields == 0 || !scan_date_fields(parser, date_str, values))
         return -1;
 
-    /* Put some sane values in retvalue by using the current time for
-     * the non-year-month-day parts of the date. */
-    time(&rawtime);
-    localtime_r(&rawtime, &retvalue);
-    orig_year = retvalue.tm_year;
-
-    /* j traverses pmatch (index 0 contains the entire string, so we
-     * start at index 1 for the first meaningful match). */
-    j = 1;
-    /* Go through the date format and interpret the matches in order of
-     * the sections in the date format. */
-    for (i = 0; date_format_user[format][i]; i++)
+    retvalue = parser->now;
+    for (i = 0; i < parser->n_fields; i++)
     {
-        char segment_type = date_format_user[format][i];
-        /* Only do something if this is a meaningful character */
-        if (segment_type == 'm' || segment_type == 'd')
+        switch (parser->fields[i])
         {
-            /* Copy the matching substring into date_segment so that we can
-             * convert it into an integer. */
-            mem_length = pmatch[j].rm_eo - pmatch[j].rm_so;
-            date_segment = g_new(gchar, mem_length);
-            memcpy(date_segment, date_str + pmatch[j].rm_so, mem_length);
-            date_segment[mem_length] = '\0';
-
-            /* Set the appropriate member of retvalue. Save the original
-             * values so that we can check if the change when we use mktime
-             * below. */
-            switch (segment_type)
-            {
-            case 'm':
-                orig_month = retvalue.tm_mon = atoi(date_segment) - 1;
-                break;
+        case 'y':
+            retvalue.tm_year = values[i];
 
-            case 'd':
-                orig_day = retvalue.tm_mday = atoi(date_segment);
-                break;
+            /* Handle two-digit years. */
+            if (retvalue.tm_year < 100)
+            {
+                /* We allow two-digit years in the range 1969 - 2068. */
+                if (retvalue.tm_year < 69)
+                    retvalue.tm_year += 100;
             }
-            g_free(date_segment);
-            j++;
+            else
+                retvalue.tm_year -= 1900;
+            break;
+
+        case 'm':
+            retvalue.tm_mon = values[i] - 1;
+            break;
+
+        case 'd':
+            retvalue.tm_mday = values[i];
+            break;
         }
     }
-    /* Convert back to an integer. If mktime leaves retvalue unchanged,
-     * everything is okay; otherwise, an error has occurred. */
+
+    /* Reject impossible dates up front rather than letting mktime
+     * normalize them. */
+    year = retvalue.tm_year + 1900;
+    if (retvalue.tm_mon < 0 || retvalue.tm_mon > 11 || retvalue.tm_mday < 1 ||
+            retvalue.tm_mday > days_in_month[retvalue.tm_mon])
+        return -1;
+    if (retvalue.tm_mon == 1 && retvalue.tm_mday == 29 &&
+            !g_date_is_leap_year(year))
+        return -1;
+
     /* We have to use a "test" date value to account for changes in
      * daylight savings time, which can cause a date change with mktime
-     * near midnight, causing the code to incorrectly think a date is
-     * incorrect. */
+     * near midnight. If mktime still changes the date, it doesn't
+     * exist in this time zone. */
     test_retvalue = retvalue;
     mktime(&test_retvalue);
     retvalue.tm_isdst = test_retvalue.tm_isdst;
+    test_retvalue = retvalue;
     rawtime = mktime(&retvalue);
-    if (retvalue.tm_mday == orig_day &&
-    retvalue.tm_mon == orig_month &&
-    retvalue.tm_year == orig_year)
-    {
+    if (retvalue.tm_mday == test_retvalue.tm_mday &&
+            retvalue.tm_mon == test_retvalue.tm_mon &&
+            retvalue.tm_year == test_retvalue.tm_year)
         return rawtime;
-    }
-    else
-    {
-        return -1;
-    }
+
+    return -1;
 }
 
-/** Parses a string into a date, given a format. This function
- * requires only knowing the order in which the year, month and day
- * appear. For example, 01-02-2003 will be parsed the same way as
- * 01/02/2003.
+/** Parses a single date string; see gnc_csv_date_parse.
  * @param date_str The string containing a date being parsed
  * @param format An index specifying a format in date_format_user
  * @return The parsed value of date_str on success or -1 on failure
  */
-static time_t parse_date(const char* date_str, int format)
+time_t gnc_csv_parse_date(const char* date_str, int format)
 {
-    if (strchr(date_format_user[format], 'y'))
-        return parse_date_with_year(date_str, format);
-    else
-        return parse_date_without_year(date_str, format);
+    GncCsvDateParser parser;
+
+    gnc_csv_date_parser_init(&parser, format);
+    return gnc_csv_date_parse(&parser, date_str);
 }
 
 /** Constructor for GncCsvParseData.
@@ -331,6 +302,7 @@ GncCsvParseData* gnc_csv_new_parse_data(void)
     parse_data->error_lines = parse_data->transactions = NULL;
     parse_data->options = default_parse_options();
     parse_data->date_format = -1;
+    parse_data->preview_only = FALSE;
     parse_data->chunk = g_string_chunk_new(100 * 1024);
     return parse_data;
 }
@@ -383,9 +355,70 @@ void gnc_csv_parse_data_free(GncCsvParseData* parse_data)
     g_free(parse_data);
 }
 
+/** Opens an iconv converter from encoding to UTF-8.
+ * @param encoding Encoding of the raw data
+ * @param error Will point to an error on failure
+ * @return The converter, or (GIConv) -1 on failure
+ */
+static GIConv gnc_csv_open_converter(const char* encoding, GError** error)
+{
+    GIConv converter = g_iconv_open("UTF-8", encoding);
+    if (converter == (GIConv) - 1)
+        g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION,
+                    _("Conversion from character set '%s' to '%s' is not supported"),
+                    encoding, "UTF-8");
+    return converter;
+}
+
+/** Converts the next block of raw data into UTF-8. A multibyte
+ * sequence cut off by the end of the block is left unconverted for
+ * the next call, unless it is at the end of all of the data.
+ * @param converter Converter from gnc_csv_open_converter
+ * @param in Start of the raw data still to convert, advanced past the converted bytes
+ * @param in_left Number of raw bytes still to convert, decreased accordingly
+ * @param max_bytes Maximum number of raw bytes to convert
+ * @param out String to which the UTF-8 text is appended
+ * @param error Will point to an error on failure
+ * @return TRUE on success, FALSE if the data is invalid in the encoding
+ */
+static gboolean gnc_csv_convert_block(GIConv converter, const char** in,
+                                      gsize* in_left, gsize max_bytes,
+                                      GString* out, GError** error)
+{
+    gchar buffer[8192];
+    gchar* inbuf = (gchar*)*in;
+    gsize block = MIN(*in_left, max_bytes);
+    gsize inbytes = block;
+
+    while (inbytes > 0)
+    {
+        gchar* outbuf = buffer;
+        gsize outbytes = sizeof(buffer);
+        gsize result = g_iconv(converter, &inbuf, &inbytes, &outbuf, &outbytes);
+
+        g_string_append_len(out, buffer, outbuf - buffer);
+        if (result == (gsize) - 1)
+        {
+            if (errno == E2BIG)
+                continue;
+            if (errno == EINVAL && block < *in_left)
+                break;
+            g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+                        "%s", _("Invalid byte sequence in conversion input"));
+            return FALSE;
+        }
+    }
+
+    *in += block - inbytes;
+    *in_left -= block - inbytes;
+    return TRUE;
+}
+
 /** Converts raw file data using a new encoding. This function must be
  * called after gnc_csv_load_file only if gnc_csv_load_file guessed
- * the wrong encoding.
+ * the wrong encoding. Only the start of a large file is converted,
+ * which is all the preview needs (parse_data->preview_only is then
+ * TRUE); gnc_csv_parse_to_trans_streaming converts the rest.
  * @param parse_data Data that is being parsed
  * @param encoding Encoding that data should be translated using
  * @param error Will point to an error on failure
@@ -394,7 +427,11 @@ void gnc_csv_parse_data_free(GncCsvParseData* parse_data)
 int gnc_csv_convert_encoding(GncCsvParseData* parse_data, const char* encoding,
 GError** error)
 {
-    gsize bytes_read, bytes_written;
+    GIConv converter;
+    GString* converted;
+    const char* in = parse_data->raw_str.begin;
+    gsize in_left = parse_data->raw_str.end - parse_data->raw_str.begin;
+    gboolean success;
 
     /* If parse_data->file_str has already been initialized it must be
      * freed first. (This should always be the case, since
@@ -402,19 +439,29 @@ GError** error)
      * function.) */
     if (parse_data->file_str.begin != NULL)
         g_free(parse_data->file_str.begin);
+    parse_data->file_str.begin = parse_data->file_str.end = NULL;
+
+    converter = gnc_csv_open_converter(encoding, error);
+    if (converter == (GIConv) - 1)
+        return 1;
 
     /* Do the actual translation to UTF-8. */
-    parse_data->file_str.begin = g_convert(parse_data->raw_str.begin,
-    parse_data->raw_str.end - parse_data->raw_str.begin,
-    "UTF-8", encoding, &bytes_read, &bytes_written,
-    error);
+    converted = g_string_sized_new(MIN(in_left, GNC_CSV_PREVIEW_BYTES) + 1);
+    success = gnc_csv_convert_block(converter, &in, &in_left,
+                                    GNC_CSV_PREVIEW_BYTES, converted, error);
+    g_iconv_close(converter);
     /* Handle errors that occur. */
-    if (parse_data->file_str.begin == NULL)
+    if (!success)
+    {
+        g_string_free(converted, TRUE);
         return 1;
+    }
 
-    /* On success, save the ending pointer of the translated data and
-     * the encoding type and return 0. */
-    parse_data->file_str.end = parse_data->file_str.begin + bytes_written;
+    /* On success, save the translated data and the encoding type and
+     * return 0. */
+    parse_data->preview_only = (in_left > 0);
+    parse_data->file_str.end = converted->str + converted->len;
+    parse_data->file_str.begin = g_string_free(converted, FALSE);
     parse_data->encoding = (gchar*)encoding;
     return 0;
 }
@@ -435,6 +482,7 @@ int gnc_csv_load_file(GncCsvParseData* parse_data, const char* filename,
 GError** error)
 {
     const char* guess_enc;
+    gsize guess_len;
 
     /* Get the raw data first and handle an error if one occurs. */
     parse_data->raw_mapping = g_mapped_file_new(filename, FALSE, error);
@@ -451,10 +499,19 @@ GError** error)
     parse_data->raw_str.begin = g_mapped_file_get_contents(parse_data->raw_mapping);
     parse_data->raw_str.end = parse_data->raw_str.begin + g_mapped_file_get_length(parse_data->raw_mapping);
 
-    /* Make a guess at the encoding of the data. */
+    /* Make a guess at the encoding of the data. Only the start of a
+     * large file is looked at, cut after a line end so that no
+     * character is split. */
+    guess_len = parse_data->raw_str.end - parse_data->raw_str.begin;
+    if (guess_len > GNC_CSV_PREVIEW_BYTES)
+    {
+        gsize line_end = GNC_CSV_PREVIEW_BYTES;
+        while (line_end > 0 && parse_data->raw_str.begin[line_end - 1] != '\n')
+            line_end--;
+        guess_len = line_end > 0 ? line_end : GNC_CSV_PREVIEW_BYTES;
+    }
     guess_enc = go_guess_encoding((const char*)(parse_data->raw_str.begin),
-    (size_t)(parse_data->raw_str.end - parse_data->raw_str.begin),
-    "UTF-8", NULL);
+    (size_t)guess_len, "UTF-8", NULL);
     if (guess_enc == NULL)
     {
         g_set_error(error, 0, GNC_CSV_ENCODING_ERR, "%s", _("Unknown encoding."));
@@ -473,6 +530,48 @@ GError** error)
         return 0;
 }
 
+/** Records the lengths of the rows in parse_data->orig_lines, before
+ * any error messages are appended, in parse_data->orig_row_lengths.
+ * @param parse_data Data that is being parsed
+ */
+static void gnc_csv_record_row_lengths(GncCsvParseData* parse_data)
+{
+    int i;
+
+    if (parse_data->orig_row_lengths != NULL)
+        g_array_free(parse_data->orig_row_lengths, FALSE);
+
+    parse_data->orig_row_lengths =
+    g_array_sized_new(FALSE, FALSE, sizeof(int), parse_data->orig_lines->len);
+    g_array_set_size(parse_data->orig_row_lengths, parse_data->orig_lines->len);
+    parse_data->orig_max_row = 0;
+    for (i = 0; i < parse_data->orig_lines->len; i++)
+    {
+        int length = ((GPtrArray*)parse_data->orig_lines->pdata[i])->len;
+        parse_data->orig_row_lengths->data[i] = length;
+        if (length > parse_data->orig_max_row)
+            parse_data->orig_max_row = length;
+    }
+}
+
+/** Frees a block of rows parsed by gnc_csv_parse_to_trans_streaming,
+ * including their cells: CSV cells are allocated one by one, while
+ * fixed-width cells live in the block's string chunk.
+ * @param parse_data Data that is being parsed
+ * @param lines The rows to free
+ */
+static void gnc_csv_free_block_lines(GncCsvParseData* parse_data, GPtrArray* lines)
+{
+    int i;
+
+    if (parse_data->options->parsetype == PARSE_TYPE_CSV)
+    {
+        for (i = 0; i < lines->len; i++)
+            g_ptr_array_foreach(lines->pdata[i], (GFunc)g_free, NULL);
+    }
+    stf_parse_general_free(lines);
+}
+
 /** Parses a file into cells. This requires having an encoding that
  * works (see gnc_csv_convert_encoding). parse_data->options should be
  * set according to how the user wants before calling this
@@ -502,6 +601,24 @@ int gnc_csv_parse(GncCsvParseData* parse_data, gboolean guessColTypes, GError**
         parse_data->orig_lines = stf_parse_general(parse_data->options, parse_data->chunk,
         parse_data->file_str.begin,
         parse_data->file_str.end);
+
+        /* If file_str is only the start of the file, its last row may
+         * be cut off; the preview gets at most GNC_CSV_PREVIEW_ROWS
+         * of the others. */
+        if (parse_data->preview_only && parse_data->orig_lines != NULL &&
+                parse_data->orig_lines->len > 1)
+        {
+            int rows = MIN(parse_data->orig_lines->len - 1, GNC_CSV_PREVIEW_ROWS);
+            for (i = rows; i < parse_data->orig_lines->len; i++)
+            {
+                GPtrArray* line = parse_data->orig_lines->pdata[i];
+                /* CSV cells are allocated one by one. */
+                if (parse_data->options->parsetype == PARSE_TYPE_CSV)
+                    g_ptr_array_foreach(line, (GFunc)g_free, NULL);
+                g_ptr_array_free(line, TRUE);
+            }
+            g_ptr_array_set_size(parse_data->orig_lines, rows);
+        }
     }
     /* If we couldn't get the encoding right, we just want an empty array. */
     else
@@ -509,22 +626,6 @@ int gnc_csv_parse(GncCsvParseData* parse_data, gboolean guessColTypes, GError**
         parse_data->orig_lines = g_ptr_array_new();
     }
 
-    /* Record the original row lengths of parse_data->orig_lines. */
-    if (parse_data->orig_row_lengths != NULL)
-        g_array_free(parse_data->orig_row_lengths, FALSE);
-
-    parse_data->orig_row_lengths =
-    g_array_sized_new(FALSE, FALSE, sizeof(int), parse_data->orig_lines->len);
-    g_array_set_size(parse_data->orig_row_lengths, parse_data->orig_lines->len);
-    parse_data->orig_max_row = 0;
-    for (i = 0; i < parse_data->orig_lines->len; i++)
-    {
-        int length = ((GPtrArray*)parse_data->orig_lines->pdata[i])->len;
-        parse_data->orig_row_lengths->data[i] = length;
-        if (length > parse_data->orig_max_row)
-            parse_data->orig_max_row = length;
-    }
-
     /* If it failed, generate an error. */
     if (parse_data->orig_lines == NULL)
     {
@@ -532,6 +633,9 @@ int gnc_csv_parse(GncCsvParseData* parse_data, gboolean guessColTypes, GError**
         return 1;
     }
 
+    /* Record the original row lengths of parse_data->orig_lines. */
+    gnc_csv_record_row_lengths(parse_data);
+
     /* Now that we have data, let's set max_cols. */
     for (i = 0; i < parse_data->orig_lines->len; i++)
     {
@@ -577,7 +681,6 @@ int gnc_csv_parse(GncCsvParseData* parse_data, gboolean guessColTypes, GError**
 /** A struct containing TransProperties that all describe a single transaction. */
 typedef struct
 {
-    int date_format; /**< The format for parsing dates */
     Account* account; /**< The account the transaction belongs to */
     GList* properties; /**< List of TransProperties */
 } TransPropertyList;
@@ -587,10 +690,25 @@ typedef struct
 {
     int type; /**< A value from the GncCsvColumnType enum except
              * GNC_CSV_NONE and GNC_CSV_NUM_COL_TYPES */
-    void* value; /**< Pointer to the data that will be used to configure a transaction */
+    void* value; /**< Pointer to the data that will be used to configure
+                  * a transaction; it points into the converted column
+                  * (see GncCsvColumnValues) or the parsed cell and is
+                  * not owned by the property */
     TransPropertyList* list; /**< The list the property belongs to */
 } TransProperty;
 
+/** The cells of one column, converted to the column's type for all
+ * rows in a single pass. The arrays are indexed by row number in
+ * GncCsvParseData.orig_lines. */
+typedef struct
+{
+    int type; /**< A value from the GncCsvColumnType enum */
+    gboolean* valid; /**< FALSE for cells that could not be understood */
+    time_t* dates; /**< The dates of a GNC_CSV_DATE column */
+    gnc_numeric* amounts; /**< The amounts of a balance, deposit or withdrawal column */
+    gboolean* amount_set; /**< FALSE for amounts that are (nearly) zero */
+} GncCsvColumnValues;
+
 /** Constructor for TransProperty.
  * @param type The type of the new property (see TransProperty.type for possible values)
  */
@@ -608,107 +726,189 @@ static TransProperty* trans_property_new(int type, TransPropertyList* list)
  */
 static void trans_property_free(TransProperty* prop)
 {
-    switch (prop->type)
+    /* The value is owned by the converted column or the parsed line. */
+    g_free(prop);
+}
+
+/** Parses a money amount, ignoring the first currency symbol in it.
+ * @param str The string to be parsed
+ * @param scu The smallest currency unit of the account
+ * @param buffer Scratch space, reused across calls
+ * @param amount Will contain the amount if it isn't (nearly) zero
+ * @param amount_set Will be TRUE if amount was set
+ * @return TRUE on success, FALSE if str isn't a number
+ */
+static gboolean parse_amount(const char* str, int scu, GString* buffer,
+                             gnc_numeric* amount, gboolean* amount_set)
+{
+    char *endptr, *possible_currency_symbol, *str_dupe;
+    double value;
+
+    /* First, we make a copy so we can't mess up real data. */
+    g_string_assign(buffer, str);
+    str_dupe = buffer->str;
+
+    /* Go through str_dupe looking for currency symbols. */
+    for (possible_currency_symbol = str_dupe; *possible_currency_symbol;
+            possible_currency_symbol = g_utf8_next_char(possible_currency_symbol))
+    {
+        if (g_unichar_type(g_utf8_get_char(possible_currency_symbol)) == G_UNICODE_CURRENCY_SYMBOL)
+        {
+            /* If we find a currency symbol, save the position just ahead
+             * of the currency symbol (next_symbol), and find the null
+             * terminator of the string (last_symbol). */
+            char *next_symbol = g_utf8_next_char(possible_currency_symbol), *last_symbol = next_symbol;
+            while (*last_symbol)
+                last_symbol = g_utf8_next_char(last_symbol);
+
+            /* Move all of the string (including the null byte, which is
+             * why we have +1 in the size parameter) following the
+             * currency symbol back one character, thereby overwriting the
+             * currency symbol. */
+            memmove(possible_currency_symbol, next_symbol, last_symbol - next_symbol + 1);
+            break;
+        }
+    }
+
+    /* Translate the string (now clean of currency symbols) into a number. */
+    value = strtod(str_dupe, &endptr);
+
+    /* If this isn't a valid numeric string, this is an error. */
+    if (endptr != str_dupe + strlen(str_dupe))
+        return FALSE;
+
+    /* Change abs to fabs, to fix bug 586805 */
+    *amount_set = fabs(value) > 0.00001;
+    if (*amount_set)
+        *amount = double_to_gnc_numeric(value, scu, GNC_HOW_RND_ROUND_HALF_UP);
+    return TRUE;
+}
+
+/** Converts the cells of one column for a set of rows.
+ * @param parse_data Data that is being parsed
+ * @param col The index of the column
+ * @param rows The indices in parse_data->orig_lines of the rows to convert
+ * @param num_rows The number of elements in rows
+ * @param date_parser The prepared date format for date columns
+ * @param scu The smallest currency unit for money columns
+ * @param values Will contain the converted column; free it with
+ * gnc_csv_column_values_free
+ */
+static void gnc_csv_convert_column(GncCsvParseData* parse_data, int col,
+                                   const int* rows, int num_rows,
+                                   const GncCsvDateParser* date_parser, int scu,
+                                   GncCsvColumnValues* values)
+{
+    int i, num_lines = parse_data->orig_lines->len;
+    GString* buffer = NULL;
+
+    values->type = parse_data->column_types->data[col];
+    values->valid = g_new0(gboolean, num_lines);
+    values->dates = NULL;
+    values->amounts = NULL;
+    values->amount_set = NULL;
+
+    switch (values->type)
     {
-        /* The types for "Date" and "Balance" (time_t and gnc_numeric,
-         * respectively) are typically not pointed to, we have to free
-         * them, unlike types like char* ("Description"). */
     case GNC_CSV_DATE:
+        values->dates = g_new(time_t, num_lines);
+        break;
+
     case GNC_CSV_BALANCE:
     case GNC_CSV_DEPOSIT:
     case GNC_CSV_WITHDRAWAL:
-        if (prop->value != NULL)
-            g_free(prop->value);
+        values->amounts = g_new(gnc_numeric, num_lines);
+        values->amount_set = g_new0(gboolean, num_lines);
+        buffer = g_string_sized_new(32);
         break;
     }
-    g_free(prop);
+
+    for (i = 0; i < num_rows; i++)
+    {
+        int row = rows[i];
+        GPtrArray* line = parse_data->orig_lines->pdata[row];
+        const char* str;
+
+        /* Short rows simply don't have this column. */
+        if (col >= line->len)
+            continue;
+        str = line->pdata[col];
+
+        switch (values->type)
+        {
+        case GNC_CSV_DATE:
+            values->dates[row] = gnc_csv_date_parse(date_parser, str);
+            values->valid[row] = values->dates[row] != -1;
+            break;
+
+        case GNC_CSV_DESCRIPTION:
+        case GNC_CSV_NUM:
+            values->valid[row] = TRUE;
+            break;
+
+        case GNC_CSV_BALANCE:
+        case GNC_CSV_DEPOSIT:
+        case GNC_CSV_WITHDRAWAL:
+            values->valid[row] = parse_amount(str, scu, buffer,
+                                              &values->amounts[row],
+                                              &values->amount_set[row]);
+            break;
+        }
+    }
+
+    if (buffer != NULL)
+        g_string_free(buffer, TRUE);
+}
+
+/** Frees the arrays of a converted column.
+ * @param values The converted column
+ */
+static void gnc_csv_column_values_free(GncCsvColumnValues* values)
+{
+    g_free(values->valid);
+    g_free(values->dates);
+    g_free(values->amounts);
+    g_free(values->amount_set);
 }
 
-/** Sets the value of the property by parsing str. Note: this should
- * only be called once on an instance of TransProperty, as calling it
- * more than once can cause memory leaks.
+/** Sets the value of the property from a converted column.
  * @param prop The property being set
- * @param str The string to be parsed
- * @return TRUE on success, FALSE on failure
+ * @param values The converted column
+ * @param row The row of the cell
+ * @param str The original text of the cell
  */
-static gboolean trans_property_set(TransProperty* prop, char* str)
+static void trans_property_set(TransProperty* prop, GncCsvColumnValues* values,
+                               int row, char* str)
 {
-    char *endptr, *possible_currency_symbol, *str_dupe;
-    double value;
     switch (prop->type)
     {
     case GNC_CSV_DATE:
-        prop->value = g_new(time_t, 1);
-        *((time_t*)(prop->value)) = parse_date(str, prop->list->date_format);
-        return *((time_t*)(prop->value)) != -1;
+        prop->value = &values->dates[row];
+        break;
 
     case GNC_CSV_DESCRIPTION:
     case GNC_CSV_NUM:
-        prop->value = g_strdup(str);
-        return TRUE;
+        prop->value = str;
+        break;
 
     case GNC_CSV_BALANCE:
     case GNC_CSV_DEPOSIT:
     case GNC_CSV_WITHDRAWAL:
-        str_dupe = g_strdup(str); /* First, we make a copy so we can't mess up real data. */
-
-        /* Go through str_dupe looking for currency symbols. */
-        for (possible_currency_symbol = str_dupe; *possible_currency_symbol;
-        possible_currency_symbol = g_utf8_next_char(possible_currency_symbol))
-        {
-            if (g_unichar_type(g_utf8_get_char(possible_currency_symbol)) == G_UNICODE_CURRENCY_SYMBOL)
-            {
-                /* If we find a currency symbol, save the position just ahead
-                 * of the currency symbol (next_symbol), and find the null
-                 * terminator of the string (last_symbol). */
-                char *next_symbol = g_utf8_next_char(possible_currency_symbol), *last_symbol = next_symbol;
-                while (*last_symbol)
-                    last_symbol = g_utf8_next_char(last_symbol);
-
-                /* Move all of the string (including the null byte, which is
-                 * why we have +1 in the size parameter) following the
-                 * currency symbol back one character, thereby overwriting the
-                 * currency symbol. */
-                memmove(possible_currency_symbol, next_symbol, last_symbol - next_symbol + 1);
-                break;
-            }
-        }
-
-        /* Translate the string (now clean of currency symbols) into a number. */
-        value = strtod(str_dupe, &endptr);
-
-        /* If this isn't a valid numeric string, this is an error. */
-        if (endptr != str_dupe + strlen(str_dupe))
-        {
-            g_free(str_dupe);
-            return FALSE;
-        }
-
-        g_free(str_dupe);
-
-        /* Change abs to fabs, to fix bug 586805 */
-        if (fabs(value) > 0.00001)
-        {
-            prop->value = g_new(gnc_numeric, 1);
-            *((gnc_numeric*)(prop->value)) =
-            double_to_gnc_numeric(value, xaccAccountGetCommoditySCU(prop->list->account),
-            GNC_HOW_RND_ROUND_HALF_UP);
-        }
-        return TRUE;
+        /* Amounts that are zero are left unset. */
+        if (values->amount_set[row])
+            prop->value = &values->amounts[row];
+        break;
     }
-    return FALSE; /* We should never actually get here. */
 }
 
 /** Constructor for TransPropertyList.
  * @param account The account with which transactions should be built
- * @param date_format An index from date_format_user for how date properties should be parsed
  * @return A pointer to a new TransPropertyList
  */
-static TransPropertyList* trans_property_list_new(Account* account, int date_format)
+static TransPropertyList* trans_property_list_new(Account* account)
 {
     TransPropertyList* list = g_new(TransPropertyList, 1);
     list->account = account;
-    list->date_format = date_format;
     list->properties = NULL;
     return list;
 }
@@ -950,105 +1150,74 @@ static GncCsvTransLine* trans_property_list_to_trans(TransPropertyList* list, gc
     return trans_line;
 }
 
-/** Creates a list of transactions from parsed data. Transactions that
- * could be created from rows are placed in parse_data->transactions;
- * rows that fail are placed in parse_data->error_lines. (Note: there
- * is no way for this function to "fail," i.e. it only returns 0, so
- * it may be changed to a void function in the future.)
+/** Converts some of the rows in parse_data->orig_lines into
+ * transactions. Transactions are inserted, sorted by date, into
+ * parse_data->transactions; the numbers of rows that fail are
+ * appended to parse_data->error_lines, and an error message is
+ * appended to (or replaced at the end of) each such row.
  * @param parse_data Data that is being parsed
  * @param account Account with which transactions are created
- * @param redo_errors TRUE to convert only error data, FALSE for all data
- * @return 0 on success, 1 on failure
+ * @param rows Indices into parse_data->orig_lines of the rows to convert
+ * @param num_rows Number of elements in rows
+ * @param line_offset Added to the row index to get the line number of the file
+ * @param last_transaction Last element of parse_data->transactions
+ * (or NULL if it's empty), updated as transactions are added
  */
-int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
-                           gboolean redo_errors)
+static void gnc_csv_rows_to_trans(GncCsvParseData* parse_data, Account* account,
+                                  const int* rows, int num_rows, int line_offset,
+                                  GList** last_transaction)
 {
-    gboolean hasBalanceColumn;
-    int i, j, max_cols = 0;
+    int i, j, k, num_columns;
     GArray* column_types = parse_data->column_types;
-    GList *error_lines = NULL, *begin_error_lines = NULL;
-
-    /* last_transaction points to the last element in
-     * parse_data->transactions, or NULL if it's empty. */
-    GList* last_transaction = NULL;
-
-    /* Free parse_data->error_lines and parse_data->transactions if they
-     * already exist. */
-    if (redo_errors) /* If we're redoing errors, we save freeing until the end. */
-    {
-        begin_error_lines = error_lines = parse_data->error_lines;
-    }
-    else
+    GncCsvColumnValues* columns;
+    GncCsvDateParser date_parser;
+    GList* error_lines = NULL;
+
+    /* Convert the cells column by column, so that the per-type set up
+     * (such as preparing the date format) happens only once. */
+    gnc_csv_date_parser_init(&date_parser, parse_data->date_format);
+    num_columns = column_types->len;
+    columns = g_new0(GncCsvColumnValues, num_columns);
+    for (j = 0; j < num_columns; j++)
     {
-        if (parse_data->error_lines != NULL)
-        {
-            g_list_free(parse_data->error_lines);
-        }
-        if (parse_data->transactions != NULL)
-        {
-            g_list_free(parse_data->transactions);
-        }
+        if (column_types->data[j] != GNC_CSV_NONE)
+            gnc_csv_convert_column(parse_data, j, rows, num_rows, &date_parser,
+                                   xaccAccountGetCommoditySCU(account),
+                                   &columns[j]);
     }
-    parse_data->error_lines = NULL;
 
-    if (redo_errors) /* If we're looking only at error data ... */
+    for (k = 0; k < num_rows; k++)
     {
-        if (parse_data->transactions == NULL)
-        {
-            last_transaction = NULL;
-        }
-        else
-        {
-            /* Move last_transaction to the end. */
-            last_transaction = parse_data->transactions;
-            while (g_list_next(last_transaction) != NULL)
-            {
-                last_transaction = g_list_next(last_transaction);
-            }
-        }
-        /* ... we use only the lines in error_lines. */
-        if (error_lines == NULL)
-            i = parse_data->orig_lines->len; /* Don't go into the for loop. */
-        else
-            i = GPOINTER_TO_INT(error_lines->data);
-    }
-    else /* Otherwise, we look at all the data. */
-    {
-        /* The following while-loop effectively behaves like the following for-loop:
-         * for(i = 0; i < parse_data->orig_lines->len; i++). */
-        i = 0;
-        last_transaction = NULL;
-    }
-    while (i < parse_data->orig_lines->len)
-    {
-        GPtrArray* line = parse_data->orig_lines->pdata[i];
+        GPtrArray* line;
         /* This flag is TRUE if there are any errors in this row. */
         gboolean errors = FALSE;
         gchar* error_message = NULL;
-        TransPropertyList* list = trans_property_list_new(account, parse_data->date_format);
+        TransPropertyList* list = trans_property_list_new(account);
         GncCsvTransLine* trans_line = NULL;
 
-        for (j = 0; j < line->len; j++)
+        i = rows[k];
+        line = parse_data->orig_lines->pdata[i];
+
+        for (j = 0; j < line->len && j < num_columns; j++)
         {
             /* We do nothing in "None" columns. */
             if (column_types->data[j] != GNC_CSV_NONE)
             {
                 /* Affect the transaction appropriately. */
-                TransProperty* property = trans_property_new(column_types->data[j], list);
-                gboolean succeeded = trans_property_set(property, line->pdata[j]);
+                TransProperty* property;
+
                 /* TODO Maybe move error handling to within TransPropertyList functions? */
-                if (succeeded)
-                {
-                    trans_property_list_add(property);
-                }
-                else
+                if (!columns[j].valid[i])
                 {
                     errors = TRUE;
                     error_message = g_strdup_printf(_("%s column could not be understood."),
-                                                    _(gnc_csv_column_type_strs[property->type]));
-                    trans_property_free(property);
+                                                    _(gnc_csv_column_type_strs[columns[j].type]));
                     break;
                 }
+
+                property = trans_property_new(column_types->data[j], list);
+                trans_property_set(property, &columns[j], i, line->pdata[j]);
+                trans_property_list_add(property);
             }
         }
 
@@ -1064,8 +1233,7 @@ int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
         /* If there were errors, add this line to parse_data->error_lines. */
         if (errors)
         {
-            parse_data->error_lines = g_list_append(parse_data->error_lines,
-                                                    GINT_TO_POINTER(i));
+            error_lines = g_list_prepend(error_lines, GINT_TO_POINTER(i));
             /* If there's already an error message, we need to replace it. */
             if (line->len > (int)(parse_data->orig_row_lengths->data[i]))
             {
@@ -1081,7 +1249,7 @@ int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
         else
         {
             /* If all went well, add this transaction to the list. */
-            trans_line->line_no = i;
+            trans_line->line_no = line_offset + i;
 
             /* We keep the transactions sorted by date. We start at the end
              * of the list and go backward, simply because the file itself
@@ -1089,20 +1257,26 @@ int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
              * exception anyway). */
 
             /* If we can just put it at the end, do so and increment last_transaction. */
-            if (last_transaction == NULL ||
-                    xaccTransGetDate(((GncCsvTransLine*)(last_transaction->data))->trans) <= xaccTransGetDate(trans_line->trans))
+            if (*last_transaction == NULL ||
+                    xaccTransGetDate(((GncCsvTransLine*)((*last_transaction)->data))->trans) <= xaccTransGetDate(trans_line->trans))
             {
-                parse_data->transactions = g_list_append(parse_data->transactions, trans_line);
-                /* If this is the first transaction, we need to get last_transaction on track. */
-                if (last_transaction == NULL)
-                    last_transaction = parse_data->transactions;
-                else /* Otherwise, we can just continue. */
-                    last_transaction = g_list_next(last_transaction);
+                /* Append after last_transaction directly, instead of
+                 * walking the whole list with g_list_append. */
+                if (*last_transaction == NULL)
+                {
+                    parse_data->transactions = g_list_append(parse_data->transactions, trans_line);
+                    *last_transaction = parse_data->transactions;
+                }
+                else
+                {
+                    *last_transaction = g_list_append(*last_transaction, trans_line);
+                    *last_transaction = g_list_next(*last_transaction);
+                }
             }
             /* Otherwise, search backward for the correct spot. */
             else
             {
-                GList* insertion_spot = last_transaction;
+                GList* insertion_spot = *last_transaction;
                 while (insertion_spot != NULL &&
                         xaccTransGetDate(((GncCsvTransLine*)(insertion_spot->data))->trans) > xaccTransGetDate(trans_line->trans))
                 {
@@ -1118,23 +1292,26 @@ int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
                 parse_data->transactions = g_list_insert_before(parse_data->transactions, insertion_spot, trans_line);
             }
         }
-
-        /* Increment to the next row. */
-        if (redo_errors)
-        {
-            /* Move to the next error line in the list. */
-            error_lines = g_list_next(error_lines);
-            if (error_lines == NULL)
-                i = parse_data->orig_lines->len; /* Don't continue the for loop. */
-            else
-                i = GPOINTER_TO_INT(error_lines->data);
-        }
-        else
-        {
-            i++;
-        }
     }
 
+    parse_data->error_lines = g_list_concat(parse_data->error_lines,
+                                            g_list_reverse(error_lines));
+
+    for (j = 0; j < num_columns; j++)
+        gnc_csv_column_values_free(&columns[j]);
+    g_free(columns);
+}
+
+/** Sets the amounts of the transactions that got their balance from
+ * a balance column, now that all of them are in date order.
+ * @param parse_data Data that is being parsed
+ * @param account Account with which transactions are created
+ */
+static void gnc_csv_apply_balances(GncCsvParseData* parse_data, Account* account)
+{
+    gboolean hasBalanceColumn;
+    int i;
+
     /* If we have a balance column, set the appropriate amounts on the transactions. */
     hasBalanceColumn = FALSE;
     for (i = 0; i < parse_data->column_types->len; i++)
@@ -1194,13 +1371,17 @@ int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
             transactions = g_list_next(transactions);
         }
     }
+}
 
-    if (redo_errors) /* Now that we're at the end, we do the freeing. */
-    {
-        g_list_free(begin_error_lines);
-    }
+/** Resizes parse_data->column_types to the widest row in
+ * parse_data->orig_lines, since error messages may have added
+ * columns. New columns are "None".
+ * @param parse_data Data that is being parsed
+ */
+static void gnc_csv_fit_column_types(GncCsvParseData* parse_data)
+{
+    int i, max_cols = 0;
 
-    /* We need to resize parse_data->column_types since errors may have added columns. */
     for (i = 0; i < parse_data->orig_lines->len; i++)
     {
         if (max_cols < ((GPtrArray*)(parse_data->orig_lines->pdata[i]))->len)
@@ -1212,6 +1393,279 @@ int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
     {
         parse_data->column_types->data[i] = GNC_CSV_NONE;
     }
+}
+
+/** Creates a list of transactions from parsed data. Transactions that
+ * could be created from rows are placed in parse_data->transactions;
+ * rows that fail are placed in parse_data->error_lines. (Note: there
+ * is no way for this function to "fail," i.e. it only returns 0, so
+ * it may be changed to a void function in the future.)
+ * @param parse_data Data that is being parsed
+ * @param account Account with which transactions are created
+ * @param redo_errors TRUE to convert only error data, FALSE for all data
+ * @return 0 on success, 1 on failure
+ */
+int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account,
+                           gboolean redo_errors)
+{
+    int num_rows = 0;
+    int* rows;
+    GList *error_lines = NULL, *begin_error_lines = NULL;
+
+    /* last_transaction points to the last element in
+     * parse_data->transactions, or NULL if it's empty. */
+    GList* last_transaction = NULL;
+
+    /* Free parse_data->error_lines and parse_data->transactions if they
+     * already exist. */
+    if (redo_errors) /* If we're redoing errors, we save freeing until the end. */
+    {
+        begin_error_lines = error_lines = parse_data->error_lines;
+    }
+    else
+    {
+        if (parse_data->error_lines != NULL)
+        {
+            g_list_free(parse_data->error_lines);
+        }
+        if (parse_data->transactions != NULL)
+        {
+            g_list_free(parse_data->transactions);
+        }
+        parse_data->transactions = NULL;
+    }
+    parse_data->error_lines = NULL;
+
+    /* Collect the rows to convert: only the lines in error_lines if
+     * we're looking only at error data, all rows otherwise. */
+    if (redo_errors)
+    {
+        if (parse_data->transactions == NULL)
+        {
+            last_transaction = NULL;
+        }
+        else
+        {
+            /* Move last_transaction to the end. */
+            last_transaction = g_list_last(parse_data->transactions);
+        }
+        rows = g_new(int, g_list_length(error_lines));
+        for (; error_lines != NULL; error_lines = g_list_next(error_lines))
+            rows[num_rows++] = GPOINTER_TO_INT(error_lines->data);
+    }
+    else
+    {
+        last_transaction = NULL;
+        rows = g_new(int, parse_data->orig_lines->len);
+        for (; num_rows < parse_data->orig_lines->len; num_rows++)
+            rows[num_rows] = num_rows;
+    }
+
+    gnc_csv_rows_to_trans(parse_data, account, rows, num_rows, 0,
+                          &last_transaction);
+    g_free(rows);
+
+    gnc_csv_apply_balances(parse_data, account);
+
+    if (redo_errors) /* Now that we're at the end, we do the freeing. */
+    {
+        g_list_free(begin_error_lines);
+    }
+
+    /* We need to resize parse_data->column_types since errors may have added columns. */
+    gnc_csv_fit_column_types(parse_data);
+
+    return 0;
+}
+
+/** Destroys the transactions in parse_data->transactions, which are
+ * still open for editing, and empties the list. This is used when a
+ * file can't be imported completely, so that none of it is.
+ * @param parse_data Data that is being parsed
+ */
+static void gnc_csv_destroy_transactions(GncCsvParseData* parse_data)
+{
+    GList* transactions;
+
+    for (transactions = parse_data->transactions; transactions != NULL;
+            transactions = g_list_next(transactions))
+    {
+        GncCsvTransLine* trans_line = transactions->data;
+        xaccTransDestroy(trans_line->trans);
+        xaccTransCommitEdit(trans_line->trans);
+        g_free(trans_line);
+    }
+    g_list_free(parse_data->transactions);
+    parse_data->transactions = NULL;
+}
+
+/** Creates the transactions for a whole file, with the same results
+ * as gnc_csv_parse_to_trans with redo_errors FALSE, but without
+ * holding all of the file's text and cells in memory. When
+ * gnc_csv_convert_encoding only converted the start of the file for
+ * the preview, the raw data is converted to UTF-8, parsed and turned
+ * into transactions a block of rows at a time, and only the rows that
+ * fail are kept. Afterwards parse_data->file_str and
+ * parse_data->orig_lines contain just those rows, all of which are
+ * listed in parse_data->error_lines, so they can be previewed and
+ * corrected with gnc_csv_parse_to_trans as usual. If a block can't be
+ * converted or parsed, the transactions created from the blocks before
+ * it are destroyed and parse_data->transactions is left empty, so that
+ * a damaged file is never imported in part.
+ * @param parse_data Data that is being parsed
+ * @param account Account with which transactions are created
+ * @param error Will contain an error if there is a failure
+ * @return 0 on success, 1 on failure
+ */
+int gnc_csv_parse_to_trans_streaming(GncCsvParseData* parse_data, Account* account,
+                                     GError** error)
+{
+    GIConv converter;
+    GString *pending, *error_text;
+    GStringChunk* chunk;
+    GArray* row_ends;
+    GList* last_transaction = NULL;
+    const char* in = parse_data->raw_str.begin;
+    gsize in_left = parse_data->raw_str.end - parse_data->raw_str.begin;
+    int line_offset = 0, num_rows, i;
+    int* rows;
+    gboolean success = TRUE;
+
+    /* A file that fit into the preview has already been parsed completely. */
+    if (!parse_data->preview_only)
+        return gnc_csv_parse_to_trans(parse_data, account, FALSE);
+
+    converter = gnc_csv_open_converter(parse_data->encoding, error);
+    if (converter == (GIConv) - 1)
+        return 1;
+
+    if (parse_data->error_lines != NULL)
+        g_list_free(parse_data->error_lines);
+    if (parse_data->transactions != NULL)
+        g_list_free(parse_data->transactions);
+    parse_data->error_lines = parse_data->transactions = NULL;
+
+    /* The preview rows are dropped; while streaming,
+     * parse_data->orig_lines holds the current block. */
+    if (parse_data->orig_lines != NULL)
+        stf_parse_general_free(parse_data->orig_lines);
+    parse_data->orig_lines = NULL;
+
+    pending = g_string_sized_new(2 * GNC_CSV_STREAM_BYTES);
+    error_text = g_string_new(NULL);
+    chunk = g_string_chunk_new(100 * 1024);
+    row_ends = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+    while (in_left > 0 || pending->len > 0)
+    {
+        GPtrArray* lines;
+        GList* error_lines;
+
+        if (in_left > 0 &&
+                !gnc_csv_convert_block(converter, &in, &in_left,
+                                       GNC_CSV_STREAM_BYTES, pending, error))
+        {
+            success = FALSE;
+            break;
+        }
+
+        g_array_set_size(row_ends, 0);
+        lines = stf_parse_general_offsets(parse_data->options, chunk,
+                                          pending->str,
+                                          pending->str + pending->len,
+                                          row_ends);
+        if (lines == NULL)
+        {
+            g_set_error(error, 0, 0, "Parsing failed.");
+            success = FALSE;
+            break;
+        }
+
+        /* Unless all of the input has been converted, the last row may
+         * continue in the next block, so it is left for the next round. */
+        num_rows = lines->len;
+        if (in_left > 0 && num_rows > 0)
+            num_rows--;
+        if (num_rows == 0)
+        {
+            gnc_csv_free_block_lines(parse_data, lines);
+            g_string_chunk_clear(chunk);
+            if (in_left == 0)
+                break;
+            continue;
+        }
+
+        parse_data->orig_lines = lines;
+        gnc_csv_record_row_lengths(parse_data);
+        rows = g_new(int, num_rows);
+        for (i = 0; i < num_rows; i++)
+            rows[i] = i;
+        gnc_csv_rows_to_trans(parse_data, account, rows, num_rows, line_offset,
+                              &last_transaction);
+        g_free(rows);
+
+        /* Keep the text of the rows that failed for the error preview;
+         * their error messages are generated again from it. */
+        for (error_lines = parse_data->error_lines; error_lines != NULL;
+                error_lines = g_list_next(error_lines))
+        {
+            int row = GPOINTER_TO_INT(error_lines->data);
+            GPtrArray* line = lines->pdata[row];
+            gsize begin = row == 0 ? 0 : g_array_index(row_ends, gsize, row - 1);
+            gsize end = g_array_index(row_ends, gsize, row);
+
+            g_string_append_len(error_text, pending->str + begin, end - begin);
+            if (error_text->str[error_text->len - 1] != '\n')
+                g_string_append_c(error_text, '\n');
+
+            g_free(line->pdata[line->len - 1]);
+            g_ptr_array_remove_index(line, line->len - 1);
+        }
+        g_list_free(parse_data->error_lines);
+        parse_data->error_lines = NULL;
+
+        gnc_csv_free_block_lines(parse_data, lines);
+        parse_data->orig_lines = NULL;
+        g_string_chunk_clear(chunk);
+        g_string_erase(pending, 0, g_array_index(row_ends, gsize, num_rows - 1));
+        line_offset += num_rows;
+    }
+
+    g_iconv_close(converter);
+    g_array_free(row_ends, TRUE);
+    g_string_chunk_free(chunk);
+    g_string_free(pending, TRUE);
+
+    if (!success)
+    {
+        g_string_free(error_text, TRUE);
+        gnc_csv_destroy_transactions(parse_data);
+        return 1;
+    }
+
+    /* From here on, parse_data->file_str holds just the rows that failed. */
+    g_free(parse_data->file_str.begin);
+    parse_data->file_str.end = error_text->str + error_text->len;
+    parse_data->file_str.begin = g_string_free(error_text, FALSE);
+    parse_data->preview_only = FALSE;
+    if (gnc_csv_parse(parse_data, FALSE, error))
+    {
+        gnc_csv_destroy_transactions(parse_data);
+        return 1;
+    }
+
+    /* Attach the error messages to the failed rows again and list them
+     * in parse_data->error_lines. */
+    num_rows = parse_data->orig_lines->len;
+    rows = g_new(int, num_rows);
+    for (i = 0; i < num_rows; i++)
+        rows[i] = i;
+    gnc_csv_rows_to_trans(parse_data, account, rows, num_rows, line_offset,
+                          &last_transaction);
+    g_free(rows);
+
+    gnc_csv_apply_balances(parse_data, account);
+    gnc_csv_fit_column_types(parse_data);
 
     return 0;
 }
@@ -82,6 +82,10 @@ typedef struct
     gboolean balance_set; /**< TRUE if balance has been set from user data, FALSE otherwise */
 } GncCsvTransLine;
 
+/** The most rows the preview shows of a file that is too large to be
+ * converted at once. */
+#define GNC_CSV_PREVIEW_ROWS 1000
+
 extern const int num_date_formats;
 /* A set of date formats that the user sees. */
 extern const gchar* date_format_user[];
@@ -96,6 +100,7 @@ typedef struct
     GMappedFile* raw_mapping; /**< The mapping containing raw_str */
     GncCsvStr raw_str; /**< Untouched data from the file as a string */
     GncCsvStr file_str; /**< raw_str translated into UTF-8 */
+    gboolean preview_only; /**< TRUE if file_str is only the start of raw_str */
     GPtrArray* orig_lines; /**< file_str parsed into a two-dimensional array of strings */
     GArray* orig_row_lengths; /**< The lengths of rows in orig_lines
                              * before error messages are appended */
@@ -121,4 +126,9 @@ int gnc_csv_parse(GncCsvParseData* parse_data, gboolean guessColTypes, GError**
 
 int gnc_csv_parse_to_trans(GncCsvParseData* parse_data, Account* account, gboolean redo_errors);
 
+int gnc_csv_parse_to_trans_streaming(GncCsvParseData* parse_data, Account* account,
+                                     GError** error);
+
+time_t gnc_csv_parse_date(const char* date_str, int format);
+
 #endif
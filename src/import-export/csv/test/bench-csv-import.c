@@ -0,0 +1,166 @@
+/*
+ * bench-csv-import.c -- Time the CSV importer on a large bank export.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Usage: bench-csv-import [rows]
+ *
+ * Writes a bank export with 'rows' rows (500000 by default) to a
+ * temporary file and runs it through the importer the way the import
+ * dialog does: load and parse the start of the file for the preview,
+ * then stream the whole file into transactions. The time taken by
+ * each stage and the peak resident size are printed. This is not run
+ * as part of "make check". */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <sys/resource.h>
+
+#include "cashobjects.h"
+#include "gnc-commodity.h"
+#include "gnc-csv-model.h"
+
+static gchar *
+write_bank_export (int rows)
+{
+    GError *error = NULL;
+    gchar *filename;
+    GString *line;
+    FILE *file;
+    gint fd;
+    int i;
+
+    fd = g_file_open_tmp ("bench-csv-XXXXXX.csv", &filename, &error);
+    if (fd == -1)
+    {
+        g_printerr ("Cannot create temporary file: %s\n", error->message);
+        exit (1);
+    }
+    file = fdopen (fd, "w");
+
+    line = g_string_new (NULL);
+    for (i = 0; i < rows; i++)
+    {
+        /* Dates cycle through ten years, amounts alternate in sign. */
+        g_string_printf (line, "%04d-%02d-%02d,Payment to shop %d,%s%d.%02d\n",
+                         2000 + (i / 336) % 10, 1 + (i / 28) % 12, 1 + i % 28,
+                         i % 1000, (i % 3) ? "-" : "", i % 5000, i % 100);
+        fputs (line->str, file);
+    }
+    g_string_free (line, TRUE);
+    fclose (file);
+
+    return filename;
+}
+
+static void
+report (const char *stage, GTimer *timer, int rows)
+{
+    gdouble secs = g_timer_elapsed (timer, NULL);
+
+    printf ("%-22s %8.3f s  %12.0f rows/s\n", stage, secs,
+            secs > 0 ? rows / secs : 0.0);
+    g_timer_start (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+    GncCsvParseData *parse_data;
+    GError *error = NULL;
+    gnc_commodity *currency;
+    QofBook *book;
+    Account *account;
+    GTimer *timer, *total;
+    gchar *filename;
+    int rows = 500000;
+
+    if (argc > 1)
+        rows = atoi (argv[1]);
+
+    qof_init ();
+    cashobjects_register ();
+
+    book = qof_book_new ();
+    currency = gnc_commodity_new (book, "US Dollar", "ISO4217", "USD", NULL, 100);
+    account = xaccMallocAccount (book);
+    xaccAccountBeginEdit (account);
+    xaccAccountSetName (account, "Checking");
+    xaccAccountSetType (account, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (account, currency);
+    xaccAccountCommitEdit (account);
+
+    filename = write_bank_export (rows);
+    printf ("%d rows in %s\n", rows, filename);
+
+    timer = g_timer_new ();
+    total = g_timer_new ();
+
+    parse_data = gnc_csv_new_parse_data ();
+    if (gnc_csv_load_file (parse_data, filename, &error))
+    {
+        g_printerr ("Loading failed: %s\n", error->message);
+        return 1;
+    }
+    report ("load preview", timer, rows);
+
+    if (gnc_csv_parse (parse_data, TRUE, &error))
+    {
+        g_printerr ("Parsing failed: %s\n", error->message);
+        return 1;
+    }
+    report ("parse preview", timer, rows);
+    printf ("%d preview rows\n", parse_data->orig_lines->len);
+
+    parse_data->column_types->data[0] = GNC_CSV_DATE;
+    parse_data->column_types->data[1] = GNC_CSV_DESCRIPTION;
+    parse_data->column_types->data[2] = GNC_CSV_DEPOSIT;
+    parse_data->date_format = 0;
+
+    if (gnc_csv_parse_to_trans_streaming (parse_data, account, &error))
+    {
+        g_printerr ("Import failed: %s\n", error->message);
+        return 1;
+    }
+    report ("create transactions", timer, rows);
+
+    printf ("%-22s %8.3f s  %12.0f rows/s\n", "total",
+            g_timer_elapsed (total, NULL),
+            rows / g_timer_elapsed (total, NULL));
+    printf ("%d transactions, %d error lines\n",
+            g_list_length (parse_data->transactions),
+            g_list_length (parse_data->error_lines));
+    {
+        struct rusage usage;
+        getrusage (RUSAGE_SELF, &usage);
+        printf ("peak resident size %ld kB\n", usage.ru_maxrss);
+    }
+
+    gnc_csv_parse_data_free (parse_data);
+    g_unlink (filename);
+    g_free (filename);
+    g_timer_destroy (timer);
+    g_timer_destroy (total);
+    qof_close ();
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * test-csv-date.c -- Test the CSV importer's date parsing.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* Parses dates in every format of date_format_user, with two- and
+ * four-digit years, with and without separators, and with different
+ * separators in one date, and checks that impossible dates are
+ * rejected rather than moved to a nearby day. */
+
+#include "config.h"
+#include <time.h>
+#include <glib.h>
+
+#include "gnc-csv-model.h"
+
+#include "test-stuff.h"
+
+#ifndef HAVE_LOCALTIME_R
+#include "localtime_r.h"
+#endif
+
+/* The indexes of the formats in date_format_user. */
+enum { YMD, DMY, MDY, DM, MD };
+
+/* The year dates without one are given. */
+static int this_year;
+
+static void
+check_date (const char *date_str, int format, int year, int month, int day)
+{
+    time_t t = gnc_csv_parse_date (date_str, format);
+    struct tm tm;
+
+    if (t == -1)
+    {
+        failure_args ("date parse", __FILE__, __LINE__,
+                      "\"%s\" as %s not parsed", date_str,
+                      date_format_user[format]);
+        return;
+    }
+    localtime_r (&t, &tm);
+    if (tm.tm_year + 1900 != year || tm.tm_mon + 1 != month || tm.tm_mday != day)
+        failure_args ("date parse", __FILE__, __LINE__,
+                      "\"%s\" as %s gave %d-%02d-%02d", date_str,
+                      date_format_user[format], tm.tm_year + 1900,
+                      tm.tm_mon + 1, tm.tm_mday);
+    else
+        success ("date parse");
+}
+
+static void
+check_rejected (const char *date_str, int format)
+{
+    if (gnc_csv_parse_date (date_str, format) != -1)
+        failure_args ("date reject", __FILE__, __LINE__,
+                      "\"%s\" as %s not rejected", date_str,
+                      format >= 0 ? date_format_user[format] : "no format");
+    else
+        success ("date reject");
+}
+
+static void
+test_formats (void)
+{
+    check_date ("2012-01-31", YMD, 2012, 1, 31);
+    check_date ("31-01-2012", DMY, 2012, 1, 31);
+    check_date ("01-31-2012", MDY, 2012, 1, 31);
+    check_date ("31-01", DM, this_year, 1, 31);
+    check_date ("01-31", MD, this_year, 1, 31);
+
+    /* Single digits, spaces and trailing text. */
+    check_date (" 2012-1-5", YMD, 2012, 1, 5);
+    check_date ("5/1/2012 10:15", DMY, 2012, 1, 5);
+    check_date ("1 - 5", MD, this_year, 1, 5);
+}
+
+static void
+test_two_digit_years (void)
+{
+    check_date ("12-01-31", YMD, 2012, 1, 31);
+    check_date ("31-01-12", DMY, 2012, 1, 31);
+    check_date ("01-31-99", MDY, 1999, 1, 31);
+    check_date ("70-06-15", YMD, 1970, 6, 15);
+    check_date ("15-06-00", DMY, 2000, 6, 15);
+}
+
+static void
+test_compact (void)
+{
+    check_date ("20120131", YMD, 2012, 1, 31);
+    check_date ("31012012", DMY, 2012, 1, 31);
+    check_date ("01312012", MDY, 2012, 1, 31);
+
+    /* Only eight digits make a compact date, and only with a year. */
+    check_rejected ("2012131", YMD);
+    check_rejected ("0131", MD);
+    check_rejected ("20121301", YMD);
+}
+
+static void
+test_mixed_separators (void)
+{
+    check_date ("2012/01-31", YMD, 2012, 1, 31);
+    check_date ("31.01/2012", DMY, 2012, 1, 31);
+    check_date ("01'31.2012", MDY, 2012, 1, 31);
+    check_date ("2012 / 01 . 31", YMD, 2012, 1, 31);
+    check_date ("31/01", DM, this_year, 1, 31);
+}
+
+static void
+test_invalid (void)
+{
+    check_date ("2012-02-29", YMD, 2012, 2, 29);
+    check_date ("29.02.2000", DMY, 2000, 2, 29);
+    check_rejected ("2011-02-29", YMD);
+    check_rejected ("29-02-1900", DMY);
+    check_rejected ("02-29-11", MDY);
+    check_rejected ("2012-13-01", YMD);
+    check_rejected ("2012-00-10", YMD);
+    check_rejected ("2012-01-00", YMD);
+    check_rejected ("2012-04-31", YMD);
+    check_rejected ("32-01", DM);
+    check_rejected ("13-01", MD);
+
+    /* Text that isn't shaped like a date. */
+    check_rejected ("", YMD);
+    check_rejected ("2012-01", YMD);
+    check_rejected ("2012 01 31", YMD);
+    check_rejected ("Jan 31, 2012", MDY);
+    check_rejected ("2012-01-31", -1);
+}
+
+int
+main (int argc, char **argv)
+{
+    time_t now = time (NULL);
+    struct tm tm;
+
+    localtime_r (&now, &tm);
+    this_year = tm.tm_year + 1900;
+
+    test_formats ();
+    test_two_digit_years ();
+    test_compact ();
+    test_mixed_separators ();
+    test_invalid ();
+
+    print_test_results ();
+    return get_rv ();
+}
@@ -0,0 +1,315 @@
+/*
+ * test-csv-import.c -- Test streaming a CSV file into transactions.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+/* The file written here is several times larger than the preview, so
+ * gnc_csv_parse_to_trans_streaming has to parse it in blocks and carry
+ * the rows cut off at the end of each block over to the next one. Some
+ * rows have a quoted description that spans two lines, and some have
+ * an amount that can't be parsed; those must be the only rows left for
+ * the error preview, with their text intact.
+ *
+ * A second file has a byte that isn't valid UTF-8 well past the first
+ * block; streaming it must fail without leaving any of the blocks
+ * before it imported. */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "cashobjects.h"
+#include "gnc-commodity.h"
+#include "gnc-csv-model.h"
+
+#include "test-stuff.h"
+
+#define NUM_ROWS 40000
+#define MULTILINE_EVERY 7
+#define BAD_EVERY 4999
+#define INVALID_BYTE_ROW (NUM_ROWS - 99)
+
+static gboolean
+is_bad_row (int i)
+{
+    return i % BAD_EVERY == BAD_EVERY - 1;
+}
+
+static gboolean
+is_multiline_row (int i)
+{
+    return i % MULTILINE_EVERY == 0;
+}
+
+/* The description of row i as it is written (quoted, when it spans
+ * two lines) or as it is parsed. */
+static gchar *
+row_description (int i, gboolean quoted)
+{
+    if (!is_multiline_row (i))
+        return g_strdup_printf ("Shop %d", i);
+    if (quoted)
+        return g_strdup_printf ("\"Shop %d, \"\"main\"\"\nbranch\"", i);
+    return g_strdup_printf ("Shop %d, \"main\"\nbranch", i);
+}
+
+/* Writes the test file and returns its name; *cents is the sum of the
+ * amounts of the rows that can be imported. With invalid_bytes, row
+ * INVALID_BYTE_ROW has a byte in its description that isn't UTF-8. */
+static gchar *
+write_export (gint64 *cents, gboolean invalid_bytes)
+{
+    GError *error = NULL;
+    gchar *filename;
+    FILE *file;
+    gint fd;
+    int i;
+
+    fd = g_file_open_tmp ("test-csv-XXXXXX.csv", &filename, &error);
+    if (fd == -1)
+    {
+        failure_args ("temporary file", __FILE__, __LINE__, "%s", error->message);
+        return NULL;
+    }
+    file = fdopen (fd, "w");
+
+    *cents = 0;
+    for (i = 0; i < NUM_ROWS; i++)
+    {
+        gint64 amount = (i % 5000) * 100 + i % 100;
+        gchar *description = row_description (i, TRUE);
+
+        if (i % 3)
+            amount = -amount;
+        fprintf (file, "%04d-%02d-%02d,%s%s,", 2000 + i % 10, 1 + i % 12,
+                 1 + i % 28, description,
+                 invalid_bytes && i == INVALID_BYTE_ROW ? "\xff" : "");
+        g_free (description);
+        if (is_bad_row (i))
+            fprintf (file, "bad %d\n", i);
+        else
+        {
+            fprintf (file, "%s%" G_GINT64_FORMAT ".%02d\n", amount < 0 ? "-" : "",
+                     ABS (amount) / 100, (int)(ABS (amount) % 100));
+            *cents += amount;
+        }
+    }
+    fclose (file);
+
+    return filename;
+}
+
+static void
+check_transactions (GncCsvParseData *parse_data, Account *account, gint64 cents)
+{
+    GList *node;
+    gnc_numeric sum = gnc_numeric_zero ();
+    int n_trans = 0, n_multiline = 0, n_expected_multiline = 0, i;
+
+    for (i = 0; i < NUM_ROWS; i++)
+        if (is_multiline_row (i) && !is_bad_row (i))
+            n_expected_multiline++;
+
+    for (node = parse_data->transactions; node != NULL; node = node->next)
+    {
+        Transaction *trans = ((GncCsvTransLine*)node->data)->trans;
+        Split *split = xaccTransFindSplitByAccount (trans, account);
+
+        n_trans++;
+        if (split != NULL)
+            sum = gnc_numeric_add (sum, xaccSplitGetAmount (split), 100,
+                                   GNC_HOW_RND_NEVER);
+        if (strstr (xaccTransGetDescription (trans), "\"main\"\nbranch"))
+            n_multiline++;
+    }
+
+    do_test (n_trans == NUM_ROWS - NUM_ROWS / BAD_EVERY,
+             "one transaction for every good row");
+    do_test (gnc_numeric_equal (sum, gnc_numeric_create (cents, 100)),
+             "amounts of all good rows imported once");
+    do_test (n_multiline == n_expected_multiline,
+             "quoted descriptions kept across line and block ends");
+}
+
+static void
+check_error_rows (GncCsvParseData *parse_data)
+{
+    GList *node;
+    int i = BAD_EVERY - 1, n_errors = 0;
+
+    do_test (parse_data->orig_lines->len == NUM_ROWS / BAD_EVERY,
+             "only the failed rows are kept");
+    for (node = parse_data->error_lines; node != NULL; node = node->next)
+    {
+        GPtrArray *line = parse_data->orig_lines->pdata[GPOINTER_TO_INT (node->data)];
+        gchar *shop = row_description (i, FALSE);
+        gchar *amount = g_strdup_printf ("bad %d", i);
+
+        if (line->len < 3 || strcmp (line->pdata[1], shop) ||
+                strcmp (line->pdata[2], amount))
+        {
+            failure_args ("error rows", __FILE__, __LINE__,
+                          "row %d not kept intact", i);
+            g_free (shop);
+            g_free (amount);
+            return;
+        }
+        g_free (shop);
+        g_free (amount);
+        i += BAD_EVERY;
+        n_errors++;
+    }
+    do_test (n_errors == NUM_ROWS / BAD_EVERY, "every failed row listed");
+}
+
+static Account *
+make_account (QofBook *book)
+{
+    gnc_commodity *currency;
+    Account *account;
+
+    currency = gnc_commodity_new (book, "US Dollar", "ISO4217", "USD", NULL, 100);
+    account = xaccMallocAccount (book);
+    xaccAccountBeginEdit (account);
+    xaccAccountSetName (account, "Checking");
+    xaccAccountSetType (account, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (account, currency);
+    xaccAccountCommitEdit (account);
+    return account;
+}
+
+/* Loads the file and sets up its columns for the import; returns
+ * NULL if that fails. */
+static GncCsvParseData *
+load_export (const gchar *filename)
+{
+    GncCsvParseData *parse_data;
+    GError *error = NULL;
+
+    parse_data = gnc_csv_new_parse_data ();
+    if (gnc_csv_load_file (parse_data, filename, &error) ||
+            gnc_csv_parse (parse_data, TRUE, &error))
+    {
+        failure_args ("load", __FILE__, __LINE__, "%s", error->message);
+        g_error_free (error);
+        gnc_csv_parse_data_free (parse_data);
+        return NULL;
+    }
+    do_test (parse_data->preview_only, "file is larger than the preview");
+    do_test (parse_data->orig_lines->len <= GNC_CSV_PREVIEW_ROWS,
+             "preview is truncated");
+
+    parse_data->column_types->data[0] = GNC_CSV_DATE;
+    parse_data->column_types->data[1] = GNC_CSV_DESCRIPTION;
+    parse_data->column_types->data[2] = GNC_CSV_DEPOSIT;
+    parse_data->date_format = 0;
+    return parse_data;
+}
+
+static void
+test_streaming (void)
+{
+    GncCsvParseData *parse_data;
+    GError *error = NULL;
+    QofBook *book;
+    Account *account;
+    gchar *filename;
+    gint64 cents;
+
+    filename = write_export (&cents, FALSE);
+    if (filename == NULL)
+        return;
+
+    book = qof_book_new ();
+    account = make_account (book);
+
+    parse_data = load_export (filename);
+    if (parse_data == NULL)
+        goto cleanup;
+
+    if (gnc_csv_parse_to_trans_streaming (parse_data, account, &error))
+    {
+        failure_args ("streaming", __FILE__, __LINE__, "%s", error->message);
+        g_error_free (error);
+        goto cleanup;
+    }
+    check_transactions (parse_data, account, cents);
+    check_error_rows (parse_data);
+
+cleanup:
+    if (parse_data != NULL)
+        gnc_csv_parse_data_free (parse_data);
+    g_unlink (filename);
+    g_free (filename);
+}
+
+static void
+test_invalid_bytes (void)
+{
+    GncCsvParseData *parse_data;
+    GError *error = NULL;
+    QofBook *book;
+    Account *account;
+    gchar *filename;
+    gint64 cents;
+
+    filename = write_export (&cents, TRUE);
+    if (filename == NULL)
+        return;
+
+    book = qof_book_new ();
+    account = make_account (book);
+
+    parse_data = load_export (filename);
+    if (parse_data == NULL)
+        goto cleanup;
+
+    do_test (gnc_csv_parse_to_trans_streaming (parse_data, account, &error) != 0,
+             "invalid byte sequence fails the import");
+    do_test (error != NULL && error->domain == G_CONVERT_ERROR &&
+             error->code == G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+             "invalid byte sequence reported");
+    do_test (parse_data->transactions == NULL,
+             "no transactions kept from the blocks before the error");
+    do_test (xaccAccountGetSplitList (account) == NULL,
+             "blocks before the error not imported");
+    if (error != NULL)
+        g_error_free (error);
+    gnc_csv_parse_data_free (parse_data);
+
+cleanup:
+    g_unlink (filename);
+    g_free (filename);
+}
+
+int
+main (int argc, char **argv)
+{
+    qof_init ();
+    cashobjects_register ();
+
+    test_streaming ();
+    test_invalid_bytes ();
+
+    print_test_results ();
+    qof_close ();
+    return get_rv ();
+}
@@ -71,7 +71,19 @@ gnc_commodity * gnc_import_select_commodity(const char * cusip,
     DEBUG("Looking for commodity with exchange_code: %s", cusip);
 
     g_assert(commodity_table);
-    namespace_list = gnc_commodity_table_get_namespaces(commodity_table);
+
+    /* An exact match comes straight from the table's index; only look
+     * for a commodity whose code merely starts with the given one if
+     * there is none. */
+    retval = gnc_commodity_table_find_by_cusip(commodity_table, cusip);
+    if (retval != NULL)
+    {
+        DEBUG("Commodity %s%s", gnc_commodity_get_fullname(retval), " matches.");
+    }
+    else
+    {
+        namespace_list = gnc_commodity_table_get_namespaces(commodity_table);
+    }
 
 
     namespace_list = g_list_first(namespace_list);
@@ -149,6 +149,7 @@ on_matcher_ok_clicked (GtkButton *button,
     /* Don't run any queries and/or split sorts while processing the matcher
     results. */
     gnc_suspend_gui_refresh();
+    qof_event_begin_batch();
 
     do
     {
@@ -197,7 +198,8 @@ on_matcher_ok_clicked (GtkButton *button,
     }
     g_slist_free(refs_list);
 
-    /* Allow GUI refresh again. */
+    /* Deliver the collected events, then allow GUI refresh again. */
+    qof_event_end_batch();
     gnc_resume_gui_refresh();
 
     gnc_gen_trans_list_delete (info);
@@ -93,111 +93,49 @@
                 (gnc-progress-dialog-set-sub progress-dialog
                                          (_ "Finding duplicate transactions")))
 
-            ;; For each transaction in the new account tree, build a query
-            ;; that matches possibly duplicate transactions in the old tree.
-            (for-each
-              (lambda (xtn)
-                (let ((query (qof-query-create-for-splits))
-                      (num-splits 0))
-                  (qof-query-set-book query (gnc-account-get-book old-root))
-
-                  ;; First, we only want to find only transactions
-                  ;; from accounts in the old tree.
-                  (xaccQueryAddAccountMatch query
-                                            old-accounts
-                                            QOF-GUID-MATCH-ANY QOF-QUERY-AND)
-
-                  ;; The date should be close to the same.. +/- a week.
-                  (let ((date (gnc-transaction-get-date-posted xtn)))
-                    (xaccQueryAddDateMatchTS query #t
-                                             (decdate date WeekDelta) #t
-                                             (incdate date WeekDelta)
-                                             QOF-QUERY-AND))
-
-                  ;; For each split in the new transaction, add a
-                  ;; term that can match on its properties.
-                  (let ((q-splits (qof-query-create-for-splits)))
-                    (for-each
-                      (lambda (split)
-                        (set! num-splits (+ num-splits 1))
-                        (let ((sq (qof-query-create-for-splits)))
-                          (qof-query-set-book sq (gnc-account-get-book old-root))
-
-                          ;; Require a match on the account name. If the name
-                          ;; doesn't exist in the old tree (indicating a new
-                          ;; account), the match will be NULL and the query
-                          ;; won't find anything.  Optimize this later.
-                          (xaccQueryAddSingleAccountMatch
-                            sq
-                            (gnc-account-lookup-by-full-name old-root
-                              (gnc-account-get-full-name
-                                (xaccSplitGetAccount split)))
-                            QOF-QUERY-AND)
-
-                          ;; Require the value of the split in the new tree
-                          ;; to match the the value of the split in the old
-                          ;; tree.  We should really check for fuzziness.
-                          (xaccQueryAddValueMatch sq
-                                                  (xaccSplitGetValue split)
-                                                  QOF-NUMERIC-MATCH-ANY
-                                                  QOF-COMPARE-EQUAL
-                                                  QOF-QUERY-AND)
-
-                          ;; Now merge into the split query.  Reminder: q-splits
-                          ;; must be merged with an OR. Otherwise, nothing will
-                          ;; match. (For example, something can be equal to 4 or
-                          ;; to -4, but not both.)
-                          (let ((q-new (qof-query-merge q-splits
-                                                        sq
-                                                        QOF-QUERY-OR)))
-                            (qof-query-destroy q-splits)
-                            (qof-query-destroy sq)
-                            (set! q-splits q-new))))
-                      (xaccTransGetSplitList xtn))
-
-                    ;; Now q-splits will find every split that is the same as
-                    ;; any one split of the new-root transaction.  Merge it in.
-                    (let ((q-new (qof-query-merge query
-                                                  q-splits
-                                                  QOF-QUERY-AND)))
-                      (qof-query-destroy query)
-                      (qof-query-destroy q-splits)
-                      (set! query q-new)))
-
-                  ;; Now that we have built a query that finds matching splits
-                  ;; in the old tree, run it and build a list of transactions
-                  ;; from the results.
-                  ;;
-                  ;; If the transaction from the new tree has more than two
-                  ;; splits, then we'll assume that it fully reflects what
-                  ;; occurred, and only consider transactions in the old tree
-                  ;; that match with every single split.
-                  ;;
-                  ;; All other new transactions could be incomplete, so we'll
-                  ;; consider transactions from the old tree to be possible
-                  ;; duplicates even if only one split matches.
-                  ;;
-                  ;; For more information, see bug 481528.
-                  (let ((old-xtns (xaccQueryGetTransactions
-                                    query
-                                    (if (> num-splits 2)
-                                        QUERY-TXN-MATCH-ALL
-                                        QUERY-TXN-MATCH-ANY))))
-
-                    ;; Turn the resulting list of possibly duplicated
-                    ;; transactions into an association list.
-                    (set! old-xtns (map
-                                     (lambda (elt)
-                                       (cons elt #f)) old-xtns))
-
-                    ;; If anything matched the query, add it to our "matches"
-                    ;; association list, keyed by the new-root transaction.
-                    (if (not (null? old-xtns))
-                        (set! matches (cons (cons xtn old-xtns) matches))))
-
-                  (qof-query-destroy query))
-                (update-progress))
-              new-xtns)
+            ;; Index the old tree once, by account, value and week, so that
+            ;; finding the candidates for each new transaction is cheap.
+            ;; A transaction in the old tree is a possible duplicate if it
+            ;; has a split in the same account (by full name), with the
+            ;; same value, dated within a week of the new transaction.
+            (let ((finder #f))
+              (dynamic-wind
+                (lambda ()
+                  (set! finder (gnc-duplicate-finder-new old-root)))
+                (lambda ()
+                  (for-each
+                    (lambda (xtn)
+                      ;; If the transaction from the new tree has more than
+                      ;; two splits, then we'll assume that it fully reflects
+                      ;; what occurred, and only consider transactions in the
+                      ;; old tree that match with every single split.
+                      ;;
+                      ;; All other new transactions could be incomplete, so
+                      ;; we'll consider transactions from the old tree to be
+                      ;; possible duplicates even if only one split matches.
+                      ;;
+                      ;; For more information, see bug 481528.
+                      (let ((old-xtns (gnc-duplicate-finder-find
+                                        finder xtn
+                                        (if (> (length (xaccTransGetSplitList xtn)) 2)
+                                            QUERY-TXN-MATCH-ALL
+                                            QUERY-TXN-MATCH-ANY))))
+
+                        ;; Turn the resulting list of possibly duplicated
+                        ;; transactions into an association list.
+                        (set! old-xtns (map
+                                         (lambda (elt)
+                                           (cons elt #f)) old-xtns))
+
+                        ;; If anything matched, add it to our "matches"
+                        ;; association list, keyed by the new-root transaction.
+                        (if (not (null? old-xtns))
+                            (set! matches (cons (cons xtn old-xtns) matches))))
+                      (update-progress))
+                    new-xtns))
+                (lambda ()
+                  (gnc-duplicate-finder-destroy finder)
+                  (set! finder #f))))
 
             ;; Finished.
             (if progress-dialog
@@ -1150,17 +1150,283 @@ xaccDateUtilGetStampNow (void)
     return xaccDateUtilGetStamp (now);
 }
 
+/********************************************************************\
+ * Civil date <-> seconds arithmetic.  The day counts use the
+ * proleptic Gregorian calendar in 400 year eras, so they are right
+ * for any date, before 1970 and after 2038 included.
+\********************************************************************/
+
+/* Days from 1970-01-01 to the given date; month is 1..12. */
+static gint64
+gnc_days_from_civil (gint64 year, gint month, gint mday)
+{
+    gint64 era, yoe, doy, doe;
+
+    year -= month <= 2;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = year - era * 400;
+    doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void
+gnc_civil_from_days (gint64 days, gint64 *year, gint *month, gint *mday)
+{
+    gint64 era, doe, yoe, doy, mp;
+
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    doe = days - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    *mday = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = yoe + era * 400 + (*month <= 2);
+}
+
+gint64
+gnc_date_civil_to_secs (gint year, gint month, gint mday,
+                        gint hour, gint min, gint sec)
+{
+    gint64 y = year;
+
+    /* Bring the month into 1..12; everything else carries over by
+     * itself. */
+    month -= 1;
+    y += month / 12;
+    month %= 12;
+    if (month < 0)
+    {
+        month += 12;
+        y--;
+    }
+
+    return gnc_days_from_civil (y, month + 1, mday) * 86400 +
+           (gint64) hour * 3600 + (gint64) min * 60 + sec;
+}
+
+void
+gnc_date_secs_to_civil (gint64 secs, struct tm *tm)
+{
+    gint64 days, rem, year;
+    gint month, mday;
+
+    g_return_if_fail (tm != NULL);
+
+    days = secs / 86400;
+    rem = secs % 86400;
+    if (rem < 0)
+    {
+        rem += 86400;
+        days--;
+    }
+    gnc_civil_from_days (days, &year, &month, &mday);
+
+    memset (tm, 0, sizeof (*tm));
+    tm->tm_year = year - 1900;
+    tm->tm_mon = month - 1;
+    tm->tm_mday = mday;
+    tm->tm_hour = rem / 3600;
+    tm->tm_min = (rem % 3600) / 60;
+    tm->tm_sec = rem % 60;
+    /* 1970-01-01 was a Thursday. */
+    tm->tm_wday = ((days + 4) % 7 + 7) % 7;
+    tm->tm_yday = days - gnc_days_from_civil (year, 1, 1);
+}
+
+/********************************************************************\
+ * The UTC offset of the local time zone stays the same for long
+ * stretches of time between daylight saving transitions.  Rather than
+ * asking localtime about every date, remember the stretches found so
+ * far.  Each one is found by stepping a week at a time away from the
+ * date asked about until the offset changes, then narrowing down to
+ * the second of the change; this assumes that transitions are at
+ * least a week apart.  The local time zone must not change while the
+ * program runs.
+\********************************************************************/
+
+typedef struct
+{
+    gint64 start;               /* first second of the stretch */
+    gint64 end;                 /* last second of the stretch */
+    glong tz;                   /* seconds *west* of UTC */
+    gint isdst;
+} GncTzSpan;
+
+#define GNC_TZ_PROBE_STEP (7 * 24 * 3600)
+#define GNC_TZ_SPAN_MAX (366 * 24 * 3600)
+/* Keep clear of overflows; this is some hundred million years. */
+#define GNC_TZ_SECS_LIMIT (G_GINT64_CONSTANT(1) << 52)
+
+G_LOCK_DEFINE_STATIC (gnc_tz_spans);
+static GArray *gnc_tz_spans = NULL;     /* GncTzSpan, sorted, disjoint */
+static guint gnc_tz_last_span = 0;
+
+static glong
+gnc_tz_probe (gint64 secs, gint *isdst)
+{
+    struct tm tm;
+    time_t t;
+
+    if (sizeof (time_t) < sizeof (gint64))
+        secs = CLAMP (secs, G_MININT32, G_MAXINT32);
+    t = (time_t) secs;
+
+    if (!localtime_r (&t, &tm))
+    {
+        *isdst = 0;
+        return 0;
+    }
+    *isdst = tm.tm_isdst;
+    return gnc_timezone (&tm);
+}
+
+/* The last second, going from inside towards limit, at which the
+ * local offset is still tz/isdst. */
+static gint64
+gnc_tz_span_edge (gint64 inside, gint64 limit, glong tz, gint isdst)
+{
+    gint64 step = limit > inside ? GNC_TZ_PROBE_STEP : -GNC_TZ_PROBE_STEP;
+    gint64 good = inside, bad;
+    gint probe_dst;
+
+    for (;;)
+    {
+        gint64 next = good + step;
+        if ((step > 0 && next > limit) || (step < 0 && next < limit))
+            next = limit;
+        if (gnc_tz_probe (next, &probe_dst) != tz || probe_dst != isdst)
+        {
+            bad = next;
+            break;
+        }
+        good = next;
+        if (good == limit)
+            return good;
+    }
+
+    while (bad - good > 1 || good - bad > 1)
+    {
+        gint64 mid = good + (bad - good) / 2;
+        if (gnc_tz_probe (mid, &probe_dst) == tz && probe_dst == isdst)
+            good = mid;
+        else
+            bad = mid;
+    }
+    return good;
+}
+
+/* Index of the last span starting at or before secs, or -1. */
+static gint
+gnc_tz_span_search (gint64 secs)
+{
+    gint lo = 0, hi = (gint) gnc_tz_spans->len - 1, found = -1;
+
+    while (lo <= hi)
+    {
+        gint mid = (lo + hi) / 2;
+        if (g_array_index (gnc_tz_spans, GncTzSpan, mid).start <= secs)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+    return found;
+}
+
+static GncTzSpan
+gnc_tz_span_lookup (gint64 secs)
+{
+    GncTzSpan span, *neighbour;
+    gint index;
+
+    secs = CLAMP (secs, -GNC_TZ_SECS_LIMIT, GNC_TZ_SECS_LIMIT);
+
+    G_LOCK (gnc_tz_spans);
+    if (!gnc_tz_spans)
+        gnc_tz_spans = g_array_new (FALSE, FALSE, sizeof (GncTzSpan));
+
+    if (gnc_tz_last_span < gnc_tz_spans->len)
+    {
+        span = g_array_index (gnc_tz_spans, GncTzSpan, gnc_tz_last_span);
+        if (span.start <= secs && secs <= span.end)
+        {
+            G_UNLOCK (gnc_tz_spans);
+            return span;
+        }
+    }
+
+    index = gnc_tz_span_search (secs);
+    if (index >= 0)
+    {
+        span = g_array_index (gnc_tz_spans, GncTzSpan, index);
+        if (secs <= span.end)
+        {
+            gnc_tz_last_span = index;
+            G_UNLOCK (gnc_tz_spans);
+            return span;
+        }
+    }
+
+    span.tz = gnc_tz_probe (secs, &span.isdst);
+    span.start = gnc_tz_span_edge (secs, secs - GNC_TZ_SPAN_MAX,
+                                   span.tz, span.isdst);
+    span.end = gnc_tz_span_edge (secs, secs + GNC_TZ_SPAN_MAX,
+                                 span.tz, span.isdst);
+
+    /* Don't overlap the neighbours, neither of which holds secs. */
+    if (index >= 0)
+    {
+        neighbour = &g_array_index (gnc_tz_spans, GncTzSpan, index);
+        if (span.start <= neighbour->end)
+            span.start = neighbour->end + 1;
+    }
+    if (index + 1 < (gint) gnc_tz_spans->len)
+    {
+        neighbour = &g_array_index (gnc_tz_spans, GncTzSpan, index + 1);
+        if (span.end >= neighbour->start)
+            span.end = neighbour->start - 1;
+    }
+
+    g_array_insert_val (gnc_tz_spans, index + 1, span);
+    gnc_tz_last_span = index + 1;
+    G_UNLOCK (gnc_tz_spans);
+    return span;
+}
+
+glong
+gnc_timezone_at (gint64 secs)
+{
+    return gnc_tz_span_lookup (secs).tz;
+}
+
+void
+gnc_date_secs_to_local_civil (gint64 secs, struct tm *tm)
+{
+    GncTzSpan span;
+
+    g_return_if_fail (tm != NULL);
+
+    span = gnc_tz_span_lookup (secs);
+    gnc_date_secs_to_civil (secs - span.tz, tm);
+    tm->tm_isdst = span.isdst;
+#ifdef HAVE_STRUCT_TM_GMTOFF
+    tm->tm_gmtoff = -span.tz;
+#endif
+}
+
 /********************************************************************\
  * iso 8601 datetimes should look like 1998-07-02 11:00:00.68-05
 \********************************************************************/
-/* hack alert -- this routine returns incorrect values for
- * dates before 1970 */
 
 Timespec
 gnc_iso8601_to_timespec_gmt(const char *str)
 {
     char buf[4];
-    gchar *dupe;
     Timespec ts;
     struct tm stm;
     long int nsec = 0;
@@ -1168,7 +1434,6 @@ gnc_iso8601_to_timespec_gmt(const char *str)
     ts.tv_sec = 0;
     ts.tv_nsec = 0;
     if (!str) return ts;
-    dupe = g_strdup(str);
     stm.tm_year = atoi(str) - 1900;
     str = strchr (str, '-');
     if (str)
@@ -1232,7 +1497,6 @@ gnc_iso8601_to_timespec_gmt(const char *str)
         for (i = 0; i < decimals; i++) multiplier /= 10;
         nsec = atoi(str) * multiplier;
     }
-    stm.tm_isdst = -1;
 
     /* Timezone format can be +hh or +hhmm or +hh.mm (or -) (or not present) */
     str += strcspn (str, "+-");
@@ -1266,87 +1530,12 @@ gnc_iso8601_to_timespec_gmt(const char *str)
         }
     }
 
-    /* Note that mktime returns 'local seconds' which is the true time
-     * minus the timezone offset.  We don't want to work with local
-     * seconds, since they swim around acording to daylight savings, etc.
-     * We want to work with universal time.  Thus, add an offset
-     * to undo the damage that mktime causes.
-     */
-    {
-        struct tm tmp_tm;
-        struct tm tm;
-        long int tz;
-        int tz_hour;
-        time_t secs;
-
-        /* Use a temporary tm struct so the mktime call below
-         * doesn't mess up stm. */
-        tmp_tm = stm;
-        tmp_tm.tm_isdst = -1;
-
-        secs = mktime (&tmp_tm);
-
-        if (secs < 0)
-        {
-            /* Workaround buggy mktime implementations that get confused
-               on the day daylight saving starts or ends. (OSX) */
-            PWARN (" mktime failed to handle daylight saving: "
-                   "tm_hour=%d tm_year=%d tm_min=%d tm_sec=%d tm_isdst=%d for string=%s",
-                   stm.tm_hour, stm.tm_year, stm.tm_min,
-                   stm.tm_sec, stm.tm_isdst, dupe );
-            tmp_tm.tm_hour++;
-            secs = mktime (&tmp_tm);
-            if (secs < 0)
-            {
-                /* if, for some strange reason, first attempt didn't fix it,
-                   try reversing the workaround. */
-                tmp_tm.tm_hour -= 2;
-                secs = mktime (&tmp_tm);
-            }
-            /* CAS: Even correct implementations of mktime can return
-               (time_t)(-1): From the libc info page: "If the specified
-               broken-down time cannot be represented as a simple time,
-               `mktime' returns a value of `(time_t)(-1)' and does not modify
-               the contents of BROKENTIME."  This happens for dates after 2038
-               when time_t is 32 bits.  In those cases, this code above is
-               just noisy and has a slight risk of returning the incorrect
-               time.
-             */
-            if (secs < 0)
-            {
-                /* Seriously buggy mktime - give up.  */
-                PERR (" unable to recover from buggy mktime ");
-                g_free(dupe);
-                return ts;
-            }
-        }
-
-        /* The call to localtime is 'bogus', but it forces 'timezone' to
-         * be set. Note that we must use the accurate date, since the
-         * value of 'gnc_timezone' includes daylight savings corrections
-         * for that date. */
-
-        localtime_r (&secs, &tm);
-
-        tz = gnc_timezone (&tmp_tm);
-
-        tz_hour = tz / 3600;
-        stm.tm_hour -= tz_hour;
-        stm.tm_min -= (tz % 3600) / 60;
-        stm.tm_isdst = tmp_tm.tm_isdst;
-        ts.tv_sec = mktime (&stm);
-        if (ts.tv_sec < 0)
-        {
-            PWARN (" mktime failed to adjust calculated time:"
-                   " tm_hour=%d tm_year=%d tm_min=%d tm_sec=%d tm_isdst=%d",
-                   stm.tm_hour, stm.tm_year, stm.tm_min,
-                   stm.tm_sec, stm.tm_isdst );
-            /* Try and make some sense of the result. */
-            ts.tv_sec = secs - tz;
-        }
-        ts.tv_nsec = nsec;
-    }
-    g_free(dupe);
+    /* The fields are now UTC, give or take some overflow, which the
+     * arithmetic takes care of. */
+    ts.tv_sec = gnc_date_civil_to_secs (stm.tm_year + 1900, stm.tm_mon + 1,
+                                        stm.tm_mday, stm.tm_hour,
+                                        stm.tm_min, stm.tm_sec);
+    ts.tv_nsec = nsec;
     return ts;
 }
 
@@ -1359,13 +1548,10 @@ gnc_timespec_to_iso8601_buff (Timespec ts, char * buff)
     int len, tz_hour, tz_min;
     long int secs;
     char cyn;
-    time_t tmp;
     struct tm parsed;
 
-    tmp = ts.tv_sec;
-    localtime_r(&tmp, &parsed);
-
-    secs = gnc_timezone (&parsed);
+    secs = gnc_timezone_at (ts.tv_sec);
+    gnc_date_secs_to_civil (ts.tv_sec - secs, &parsed);
 
     /* We also have to print the sign by hand, to work around a bug
      * in the glibc 2.1.3 printf (where %+02d fails to zero-pad).
@@ -245,9 +245,6 @@ Timespec gnc_dmy2timespec_end (gint day, gint month, gint year);
  *    is 680 milliseconds after 11 o'clock, central daylight time
  *    It is also 680 millisecs after 16:00:00 hours UTC.
  *    \return The universl time.
- *
- * XXX Caution: this routine does not handle strings that specify
- * times before January 1 1970.
  */
 Timespec gnc_iso8601_to_timespec_gmt(const gchar *);
 
@@ -296,6 +293,32 @@ time_t xaccDMYToSec (gint day, gint month, gint year);
  * standardized and is a big mess.
  */
 glong gnc_timezone (const struct tm *tm);
+
+/** The gnc_timezone_at function returns the number of seconds *west*
+ * of UTC of the local time zone at the given time, adjusted for
+ * daylight savings time.  Unlike gnc_timezone it needs no struct tm;
+ * the offsets are looked up once and cached, which makes it much
+ * cheaper than localtime.
+ */
+glong gnc_timezone_at (gint64 secs);
+
+/** The gnc_date_civil_to_secs function converts a UTC date and time to
+ * seconds since the epoch by plain arithmetic, for any date.  The
+ * month runs from 1 to 12; all fields may be out of range, and
+ * overflow into the next larger field as with mktime.
+ */
+gint64 gnc_date_civil_to_secs (gint year, gint month, gint mday,
+                               gint hour, gint min, gint sec);
+
+/** The gnc_date_secs_to_civil function is gmtime_r done by plain
+ * arithmetic, for any date.  tm_isdst is always 0.
+ */
+void gnc_date_secs_to_civil (gint64 secs, struct tm *tm);
+
+/** The gnc_date_secs_to_local_civil function is localtime_r using the
+ * offsets cached by gnc_timezone_at.  tm_zone is not set.
+ */
+void gnc_date_secs_to_local_civil (gint64 secs, struct tm *tm);
 // @}
 
 /* ------------------------------------------------------------------------ */
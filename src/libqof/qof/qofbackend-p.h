@@ -310,6 +310,12 @@ struct QofBackend_s
     void (*free_query) (QofBackend *, gpointer);
     void (*run_query) (QofBackend *, gpointer);
 
+    /** Load the objects which refer to an instance but which a partial
+     * load left out, e.g. the transactions of an account when they are
+     * only loaded as they are needed.  NULL if the backend always loads
+     * everything. */
+    void (*load_related) (QofBackend *, QofInstance *);
+
     void (*sync) (QofBackend *, /*@ dependent @*/ QofBook *);
     void (*safe_sync) (QofBackend *, /*@ dependent @*/ QofBook *);
     void (*load_config) (QofBackend *, KvpFrame *);
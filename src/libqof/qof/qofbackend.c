@@ -127,6 +127,7 @@ qof_backend_init(QofBackend *be)
     be->compile_query = NULL;
     be->free_query = NULL;
     be->run_query = NULL;
+    be->load_related = NULL;
 
     be->sync = NULL;
     be->safe_sync = NULL;
@@ -169,6 +170,20 @@ qof_backend_run_begin(QofBackend *be, QofInstance *inst)
     (be->begin) (be, inst);
 }
 
+void
+qof_backend_run_load_related(QofBackend *be, QofInstance *inst)
+{
+    if (!be || !inst)
+    {
+        return;
+    }
+    if (!be->load_related)
+    {
+        return;
+    }
+    (be->load_related) (be, inst);
+}
+
 gboolean
 qof_backend_begin_exists(const QofBackend *be)
 {
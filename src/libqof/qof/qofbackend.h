@@ -155,6 +155,10 @@ gboolean qof_backend_begin_exists(const QofBackend *be);
 void qof_backend_run_commit(QofBackend *be, QofInstance *inst);
 
 gboolean qof_backend_commit_exists(const QofBackend *be);
+
+/** Make sure that everything referring to the instance is in memory,
+ *  for backends which only load part of the book up front. */
+void qof_backend_run_load_related(QofBackend *be, QofInstance *inst);
 //@}
 
 /** The qof_backend_set_error() routine pushes an error code onto the error
@@ -31,9 +31,11 @@
 typedef struct
 {
     QofEventHandler handler;
+    QofEventBatchHandler batch_handler;
     gpointer user_data;
 
     gint handler_id;
+    gint priority;
 } HandlerInfo;
 
 /* generates an event even when events are suspended! */
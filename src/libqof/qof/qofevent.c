@@ -24,16 +24,29 @@
 
 #include "config.h"
 #include <glib.h>
+#include <string.h>
 #include "qof.h"
 #include "qofevent-p.h"
 
 /* Static Variables ************************************************/
 static guint   suspend_counter   = 0;
+static guint64 suppressed_serial = 0;
 static gint    next_handler_id   = 1;
 static guint   handler_run_level = 0;
 static guint   pending_deletes   = 0;
 static GList   *handlers  =   NULL;
 
+/* Event batches. batch_entries holds the consolidated events of the
+ * open batch, batch_index maps an entity to a GSList of the indexes of
+ * its entries in batch_entries. Events are only recorded if at least
+ * one batch handler is registered. */
+static guint   batch_level       = 0;
+static guint   batch_handlers    = 0;
+static GArray     *batch_entries = NULL;
+static GHashTable *batch_index   = NULL;
+
+static QofEventStats event_stats;
+
 /* This static indicates the debugging module that this .o belongs to.  */
 static QofLogModule log_module = QOF_MOD_ENGINE;
 
@@ -68,16 +81,38 @@ find_next_handler_id(void)
     return handler_id;
 }
 
-gint
-qof_event_register_handler (QofEventHandler handler, gpointer user_data)
+/* Insert the handler in front of all handlers with the same or a
+ * lower priority, so that for equal priorities the most recently
+ * registered handler runs first. */
+static void
+insert_handler (HandlerInfo *hi)
+{
+    GList *node;
+
+    for (node = handlers; node; node = node->next)
+    {
+        HandlerInfo *other = node->data;
+
+        if (other->priority <= hi->priority)
+            break;
+    }
+
+    handlers = g_list_insert_before (handlers, node, hi);
+}
+
+static gint
+register_handler_internal (QofEventHandler handler,
+                           QofEventBatchHandler batch_handler,
+                           gpointer user_data, gint priority)
 {
     HandlerInfo *hi;
     gint handler_id;
 
-    ENTER ("(handler=%p, data=%p)", handler, user_data);
+    ENTER ("(handler=%p, batch_handler=%p, data=%p, priority=%d)",
+           handler, batch_handler, user_data, priority);
 
     /* sanity check */
-    if (!handler)
+    if (!handler && !batch_handler)
     {
         PERR ("no handler specified");
         return 0;
@@ -90,14 +125,62 @@ qof_event_register_handler (QofEventHandler handler, gpointer user_data)
     hi = g_new0 (HandlerInfo, 1);
 
     hi->handler = handler;
+    hi->batch_handler = batch_handler;
     hi->user_data = user_data;
     hi->handler_id = handler_id;
+    hi->priority = priority;
+
+    if (batch_handler)
+        batch_handlers++;
 
-    handlers = g_list_prepend (handlers, hi);
+    insert_handler (hi);
     LEAVE ("(handler=%p, data=%p) handler_id=%d", handler, user_data, handler_id);
     return handler_id;
 }
 
+gint
+qof_event_register_handler (QofEventHandler handler, gpointer user_data)
+{
+    if (!handler)
+    {
+        PERR ("no handler specified");
+        return 0;
+    }
+
+    return register_handler_internal (handler, NULL, user_data,
+                                      QOF_EVENT_PRIORITY_DEFAULT);
+}
+
+gint
+qof_event_register_handler_with_priority (QofEventHandler handler,
+        gpointer user_data,
+        gint priority)
+{
+    if (!handler)
+    {
+        PERR ("no handler specified");
+        return 0;
+    }
+
+    return register_handler_internal (handler, NULL, user_data, priority);
+}
+
+gint
+qof_event_register_batch_handler (QofEventHandler handler,
+                                  QofEventBatchHandler batch_handler,
+                                  gpointer user_data,
+                                  gint priority)
+{
+    if (!batch_handler)
+    {
+        PERR ("no batch handler specified");
+        return 0;
+    }
+
+    return register_handler_internal (handler, batch_handler, user_data,
+                                      priority);
+}
+
 void
 qof_event_unregister_handler (gint handler_id)
 {
@@ -116,12 +199,16 @@ qof_event_unregister_handler (gint handler_id)
            of a generated event, such as QOF_EVENT_DESTROY.  In that case,
            we're in the middle of walking the GList and it is wrong to
            modify the list. So, instead, we just NULL the handler. */
-        if (hi->handler)
+        if (hi->handler || hi->batch_handler)
             LEAVE ("(handler_id=%d) handler=%p data=%p", handler_id,
                    hi->handler, hi->user_data);
 
+        if (hi->batch_handler)
+            batch_handlers--;
+
         /* safety -- clear the handler in case we're running events now */
         hi->handler = NULL;
+        hi->batch_handler = NULL;
 
         if (handler_run_level == 0)
         {
@@ -163,6 +250,184 @@ qof_event_resume (void)
     suspend_counter--;
 }
 
+/* Remove the handlers unregistered while events were being run. Only
+ * the outermost event runner may do this. */
+static void
+purge_pending_deletes (void)
+{
+    GList *node;
+    GList *next_node = NULL;
+
+    if (handler_run_level != 0 || !pending_deletes)
+        return;
+
+    for (node = handlers; node; node = next_node)
+    {
+        HandlerInfo *hi = node->data;
+        next_node = node->next;
+        if (hi->handler == NULL && hi->batch_handler == NULL)
+        {
+            /* remove this node from the list, then free this node */
+            handlers = g_list_remove_link (handlers, node);
+            g_list_free_1 (node);
+            g_free (hi);
+        }
+    }
+    pending_deletes = 0;
+}
+
+static void
+batch_record (QofInstance *entity, QofEventId event_id)
+{
+    QofEventBatchEntry entry;
+    GSList *indexes;
+    GSList *node;
+
+    if (!batch_entries)
+    {
+        batch_entries = g_array_new (FALSE, FALSE, sizeof (QofEventBatchEntry));
+        batch_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+    event_stats.events_batched++;
+
+    indexes = g_hash_table_lookup (batch_index, entity);
+    for (node = indexes; node; node = node->next)
+    {
+        QofEventBatchEntry *e = &g_array_index (batch_entries,
+                                                QofEventBatchEntry,
+                                                GPOINTER_TO_UINT (node->data));
+        if (e->event_id == event_id)
+            break;
+    }
+
+    if (node)
+    {
+        event_stats.events_merged++;
+    }
+    else
+    {
+        entry.entity = entity;
+        entry.guid = *qof_instance_get_guid (entity);
+        entry.type = entity->e_type;
+        entry.event_id = event_id;
+        g_array_append_val (batch_entries, entry);
+
+        indexes = g_slist_prepend (indexes,
+                                   GUINT_TO_POINTER (batch_entries->len - 1));
+        g_hash_table_insert (batch_index, entity, indexes);
+    }
+
+    if (event_id != QOF_EVENT_DESTROY)
+        return;
+
+    /* The entity is going away: detach its entries so that the batch
+     * handlers don't see a dangling pointer, and forget it so that a
+     * new entity allocated at the same address starts afresh. */
+    for (node = indexes; node; node = node->next)
+        g_array_index (batch_entries, QofEventBatchEntry,
+                       GPOINTER_TO_UINT (node->data)).entity = NULL;
+
+    g_hash_table_remove (batch_index, entity);
+    g_slist_free (indexes);
+}
+
+static gboolean
+free_batch_index_helper (gpointer key, gpointer value, gpointer user_data)
+{
+    g_slist_free (value);
+    return TRUE;
+}
+
+static void
+dispatch_batch (const QofEventBatchEntry *entries, guint n_entries,
+                gboolean include_event_handlers)
+{
+    GList *node;
+    GList *next_node = NULL;
+
+    handler_run_level++;
+    for (node = handlers; node; node = next_node)
+    {
+        HandlerInfo *hi = node->data;
+
+        next_node = node->next;
+        if (!hi->batch_handler)
+            continue;
+        if (!include_event_handlers && hi->handler)
+            continue;
+
+        PINFO("id=%d hi=%p batch_han=%p entries=%u", hi->handler_id, hi,
+              hi->batch_handler, n_entries);
+        event_stats.batch_calls++;
+        hi->batch_handler (entries, n_entries, hi->user_data);
+    }
+    handler_run_level--;
+
+    purge_pending_deletes ();
+}
+
+void
+qof_event_begin_batch (void)
+{
+    batch_level++;
+
+    if (batch_level == 0)
+    {
+        PERR ("batch level overflow");
+    }
+}
+
+void
+qof_event_end_batch (void)
+{
+    GArray *entries;
+
+    if (batch_level == 0)
+    {
+        PERR ("batch level underflow");
+        return;
+    }
+
+    batch_level--;
+    if (batch_level > 0 || !batch_entries)
+        return;
+
+    /* Detach the batch before dispatching it; the batch handlers may
+     * well generate new events. */
+    entries = batch_entries;
+    batch_entries = NULL;
+    g_hash_table_foreach_remove (batch_index, free_batch_index_helper, NULL);
+    g_hash_table_destroy (batch_index);
+    batch_index = NULL;
+
+    if (entries->len > 0)
+        dispatch_batch ((QofEventBatchEntry *) entries->data, entries->len,
+                        TRUE);
+
+    g_array_free (entries, TRUE);
+}
+
+gboolean
+qof_event_in_batch (void)
+{
+    return batch_level != 0;
+}
+
+void
+qof_event_get_stats (QofEventStats *stats)
+{
+    g_return_if_fail (stats);
+
+    *stats = event_stats;
+}
+
+void
+qof_event_reset_stats (void)
+{
+    memset (&event_stats, 0, sizeof (event_stats));
+}
+
 static void
 qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
                              gpointer event_data)
@@ -170,6 +435,8 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
     GList *node;
     GList *next_node = NULL;
     gboolean use_old_handlers = FALSE;
+    gboolean batched = FALSE;
+    gboolean unbatched_only = FALSE;
 
     g_return_if_fail(entity);
 
@@ -187,16 +454,37 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
     }
     }
 
+    event_stats.events_generated++;
+
+    /* Inside a batch the batch handlers get the event at the end of
+     * the batch; only the plain handlers are run now. */
+    if (batch_level > 0 && batch_handlers > 0)
+    {
+        batch_record (entity, event_id);
+        unbatched_only = TRUE;
+    }
+
     handler_run_level++;
     for (node = handlers; node; node = next_node)
     {
         HandlerInfo *hi = node->data;
 
         next_node = node->next;
+        if (hi->batch_handler)
+        {
+            if (unbatched_only)
+                continue;
+            if (!hi->handler)
+            {
+                batched = TRUE;
+                continue;
+            }
+        }
         if (hi->handler)
         {
             PINFO("id=%d hi=%p han=%p data=%p", hi->handler_id, hi,
                   hi->handler, event_data);
+            event_stats.handler_calls++;
             hi->handler (entity, event_id, hi->user_data, event_data);
         }
     }
@@ -205,21 +493,19 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
     /* If we're the outermost event runner and we have pending deletes
      * then go delete the handlers now.
      */
-    if (handler_run_level == 0 && pending_deletes)
+    purge_pending_deletes ();
+
+    /* Batch-only handlers get events outside a batch as a batch of one. */
+    if (batched)
     {
-        for (node = handlers; node; node = next_node)
-        {
-            HandlerInfo *hi = node->data;
-            next_node = node->next;
-            if (hi->handler == NULL)
-            {
-                /* remove this node from the list, then free this node */
-                handlers = g_list_remove_link (handlers, node);
-                g_list_free_1 (node);
-                g_free (hi);
-            }
-        }
-        pending_deletes = 0;
+        QofEventBatchEntry entry;
+
+        entry.entity = (event_id == QOF_EVENT_DESTROY) ? NULL : entity;
+        entry.guid = *qof_instance_get_guid (entity);
+        entry.type = entity->e_type;
+        entry.event_id = event_id;
+
+        dispatch_batch (&entry, 1, FALSE);
     }
 }
 
@@ -239,9 +525,18 @@ qof_event_gen (QofInstance *entity, QofEventId event_id, gpointer event_data)
         return;
 
     if (suspend_counter)
+    {
+        suppressed_serial++;
         return;
+    }
 
     qof_event_generate_internal (entity, event_id, event_data);
 }
 
+guint64
+qof_event_get_suppressed_serial (void)
+{
+    return suppressed_serial;
+}
+
 /* =========================== END OF FILE ======================= */
@@ -84,6 +84,40 @@ for future libqof1 or libqof2 usage.
 typedef void (*QofEventHandler) (QofInstance *ent,  QofEventId event_type,
                                  gpointer handler_data, gpointer event_data);
 
+/** \brief One consolidated entry of an event batch.
+ *
+ * All events of the same type generated by the same entity while a
+ * batch was open are collapsed into a single entry.
+ */
+typedef struct
+{
+    /** The entity which generated the event, or NULL if the entity was
+     * destroyed before the batch was closed. */
+    QofInstance *entity;
+    /** The GncGUID of the entity, valid even after it was destroyed. */
+    GncGUID guid;
+    /** The type of the entity. */
+    QofIdTypeConst type;
+    /** The id of the event. */
+    QofEventId event_id;
+} QofEventBatchEntry;
+
+/** \brief Handler invoked once when an event batch is closed.
+ *
+ * @param entries:      the consolidated events, in the order in which
+ *                      they were first generated.
+ * @param n_entries:    the number of entries.
+ * @param handler_data: data supplied when handler was registered.
+ */
+typedef void (*QofEventBatchHandler) (const QofEventBatchEntry *entries,
+                                      guint n_entries,
+                                      gpointer handler_data);
+
+/** Priority of handlers registered with qof_event_register_handler().
+ * Handlers with a higher priority are invoked first; handlers of the
+ * same priority are invoked most recently registered first. */
+#define QOF_EVENT_PRIORITY_DEFAULT (0)
+
 /** \brief Register a handler for events.
  *
  * @param handler:   handler to register
@@ -93,6 +127,39 @@ typedef void (*QofEventHandler) (QofInstance *ent,  QofEventId event_type,
  */
 gint qof_event_register_handler (QofEventHandler handler, gpointer handler_data);
 
+/** \brief Register a handler for events which understands batches.
+ *
+ * Outside of an event batch, 'handler' is invoked for every event just
+ * like a handler registered with qof_event_register_handler(). While a
+ * batch is open the handler is not invoked; instead 'batch_handler' is
+ * invoked once with all consolidated events when the outermost batch
+ * is closed. If 'handler' is NULL, events generated outside of a batch
+ * are delivered to 'batch_handler' as a batch of one.
+ *
+ * @param handler:       per event handler, may be NULL
+ * @param batch_handler: batch handler to register
+ * @param handler_data:  data provided when either handler is invoked
+ * @param priority:      dispatch priority, see QOF_EVENT_PRIORITY_DEFAULT
+ *
+ * @return id identifying handler
+ */
+gint qof_event_register_batch_handler (QofEventHandler handler,
+                                       QofEventBatchHandler batch_handler,
+                                       gpointer handler_data,
+                                       gint priority);
+
+/** \brief Register a per event handler with the given priority.
+ *
+ * @param handler:      handler to register
+ * @param handler_data: data provided when handler is invoked
+ * @param priority:     dispatch priority, see QOF_EVENT_PRIORITY_DEFAULT
+ *
+ * @return id identifying handler
+ */
+gint qof_event_register_handler_with_priority (QofEventHandler handler,
+        gpointer handler_data,
+        gint priority);
+
 /** \brief Unregister an event handler.
  *
  * @param handler_id: the id of the handler to unregister
@@ -134,5 +201,49 @@ void qof_event_suspend (void);
 /** Resume engine event generation. */
 void qof_event_resume (void);
 
+/** Return the number of events dropped because events were suspended
+ * since the program started.  Caches maintained from events can compare
+ * it with the value they saw last to find out if they missed changes. */
+guint64 qof_event_get_suppressed_serial (void);
+
+/** \brief Open an event batch.
+ *
+ * Until the matching qof_event_end_batch(), events are collected and
+ * consolidated per entity and event type for the handlers registered
+ * with qof_event_register_batch_handler(). Handlers registered with
+ * qof_event_register_handler() still receive every event as it is
+ * generated. Batches may be nested; the events are delivered when the
+ * outermost batch is closed.
+ */
+void qof_event_begin_batch (void);
+
+/** \brief Close an event batch, delivering the collected events to the
+ * batch handlers if this was the outermost batch. */
+void qof_event_end_batch (void);
+
+/** Return TRUE if an event batch is open. */
+gboolean qof_event_in_batch (void);
+
+/** Counters of the event dispatcher. */
+typedef struct
+{
+    /** Events generated and not suppressed by qof_event_suspend(). */
+    guint64 events_generated;
+    /** Events recorded while a batch was open. */
+    guint64 events_batched;
+    /** Batched events folded into an already recorded entry. */
+    guint64 events_merged;
+    /** Invocations of per event handlers. */
+    guint64 handler_calls;
+    /** Invocations of batch handlers. */
+    guint64 batch_calls;
+} QofEventStats;
+
+/** Copy the current dispatcher counters into 'stats'. */
+void qof_event_get_stats (QofEventStats *stats);
+
+/** Reset the dispatcher counters to zero. */
+void qof_event_reset_stats (void);
+
 #endif
 /** @} */
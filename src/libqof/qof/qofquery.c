@@ -38,6 +38,9 @@
 
 static QofLogModule log_module = QOF_MOD_QUERY;
 
+/* Map of search-for type to the QofQueryCandidatesFcn narrowing it */
+static GHashTable *candidatesTable = NULL;
+
 struct _QofQueryTerm
 {
     QofQueryParamList *     param_list;
@@ -798,6 +801,116 @@ static GList * qof_query_run_internal (QofQuery *q,
     return matching_objects;
 }
 
+/* Asks the candidates function registered for the query's type for the
+ * objects of 'book' which can match one of the AND-terms in 'and_terms'.
+ * Only terms which check_object will evaluate, and which are not
+ * inverted, can narrow the search.  Returns FALSE if none could. */
+static gboolean
+and_terms_candidates (QofQuery *q, QofQueryCandidatesFcn fcn, QofBook *book,
+                      const GList *and_terms, GList **candidates)
+{
+    const GList *node;
+
+    for (node = and_terms; node; node = node->next)
+    {
+        QofQueryTerm *qt = node->data;
+        gchar **literals;
+        gboolean found;
+
+        if (!qt->param_fcns || !qt->pred_fcn || qt->invert)
+            continue;
+
+        literals = qof_query_core_string_literals (qt->pdata);
+        if (!literals)
+            continue;
+
+        found = fcn (book, q->search_for, qt->param_list,
+                     (const gchar * const *) literals, candidates);
+        g_strfreev (literals);
+        if (found)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Returns TRUE and sets 'candidates' to the objects of 'book' which can
+ * match 'q' if each of its OR-terms can be narrowed by an index, and
+ * FALSE if all of the objects must be checked. */
+static gboolean
+query_candidates (QofQuery *q, QofBook *book, GList **candidates)
+{
+    QofQueryCandidatesFcn fcn;
+    GHashTable *seen = NULL;
+    GList *result = NULL;
+    const GList *or_ptr;
+
+    if (!candidatesTable || !q->terms)
+        return FALSE;
+    fcn = g_hash_table_lookup (candidatesTable, q->search_for);
+    if (!fcn)
+        return FALSE;
+
+    if (q->terms->next)
+        seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (or_ptr = q->terms; or_ptr; or_ptr = or_ptr->next)
+    {
+        GList *objs = NULL, *node;
+
+        if (!and_terms_candidates (q, fcn, book, or_ptr->data, &objs))
+        {
+            g_list_free (result);
+            if (seen) g_hash_table_destroy (seen);
+            return FALSE;
+        }
+
+        if (!seen)
+        {
+            result = objs;
+            break;
+        }
+        /* An object may be a candidate for more than one OR-term */
+        for (node = objs; node; node = node->next)
+        {
+            if (g_hash_table_lookup (seen, node->data)) continue;
+            g_hash_table_insert (seen, node->data, node->data);
+            result = g_list_prepend (result, node->data);
+        }
+        g_list_free (objs);
+    }
+
+    if (seen) g_hash_table_destroy (seen);
+    *candidates = result;
+    return TRUE;
+}
+
+gboolean
+qof_query_get_candidates (QofQuery *q, QofBook *book, GList **candidates)
+{
+    g_return_val_if_fail (q, FALSE);
+    g_return_val_if_fail (book, FALSE);
+    g_return_val_if_fail (candidates, FALSE);
+
+    return query_candidates (q, book, candidates);
+}
+
+/* Has the backend of 'book', if any, load the objects 'q' can match */
+static void
+run_backend_query (QofQuery *q, QofBook *book)
+{
+    QofBackend *be = book->backend;
+
+    if (be)
+    {
+        gpointer compiled_query = g_hash_table_lookup (q->be_compiled, book);
+
+        if (compiled_query && be->run_query)
+        {
+            (be->run_query) (be, compiled_query);
+        }
+    }
+}
+
 static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg)
 {
     GList *node;
@@ -808,23 +921,25 @@ static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg)
     for (node = qcb->query->books; node; node = node->next)
     {
         QofBook *book = node->data;
-        QofBackend *be = book->backend;
 
         /* run the query in the backend */
-        if (be)
+        run_backend_query (qcb->query, book);
+
+        /* And then iterate over the objects which can match, all of
+         * them unless an index can narrow them down */
         {
-            gpointer compiled_query = g_hash_table_lookup (qcb->query->be_compiled,
-                                      book);
+            GList *candidates = NULL;
 
-            if (compiled_query && be->run_query)
+            if (query_candidates (qcb->query, book, &candidates))
             {
-                (be->run_query) (be, compiled_query);
+                PINFO ("checking %d candidates", g_list_length (candidates));
+                g_list_foreach (candidates, check_item_cb, qcb);
+                g_list_free (candidates);
             }
+            else
+                qof_object_foreach (qcb->query->search_for, book,
+                                    (QofInstanceForeachCB) check_item_cb, qcb);
         }
-
-        /* And then iterate over all the objects */
-        qof_object_foreach (qcb->query->search_for, book,
-                            (QofInstanceForeachCB) check_item_cb, qcb);
     }
 }
 
@@ -834,6 +949,36 @@ GList * qof_query_run (QofQuery *q)
     return qof_query_run_internal(q, qof_query_run_cb, NULL);
 }
 
+void
+qof_query_prepare (QofQuery *q)
+{
+    GList *node;
+
+    g_return_if_fail (q);
+    g_return_if_fail (q->search_for);
+    ENTER (" q=%p", q);
+
+    if (q->changed)
+    {
+        query_clear_compiles (q);
+        compile_terms (q);
+        q->changed = 0;
+    }
+
+    for (node = q->books; node; node = node->next)
+        run_backend_query (q, node->data);
+    LEAVE (" q=%p", q);
+}
+
+gboolean
+qof_query_object_matches (const QofQuery *q, gpointer object)
+{
+    g_return_val_if_fail (q, FALSE);
+    g_return_val_if_fail (object, FALSE);
+
+    return check_object (q, object) != 0;
+}
+
 static void qof_query_run_subq_cb(QofQueryCB* qcb, gpointer cb_arg)
 {
     QofQuery* pq = cb_arg;
@@ -1330,10 +1475,30 @@ void qof_query_init (void)
 
 void qof_query_shutdown (void)
 {
+    if (candidatesTable)
+    {
+        g_hash_table_destroy (candidatesTable);
+        candidatesTable = NULL;
+    }
     qof_class_shutdown ();
     qof_query_core_shutdown ();
 }
 
+void
+qof_query_register_candidates (QofIdTypeConst search_for,
+                               QofQueryCandidatesFcn fcn)
+{
+    g_return_if_fail (search_for);
+
+    if (!candidatesTable)
+        candidatesTable = g_hash_table_new (g_str_hash, g_str_equal);
+
+    if (fcn)
+        g_hash_table_insert (candidatesTable, (gpointer) search_for, fcn);
+    else
+        g_hash_table_remove (candidatesTable, search_for);
+}
+
 int qof_query_get_max_results (const QofQuery *q)
 {
     if (!q) return 0;
@@ -204,6 +204,29 @@ void qof_query_add_boolean_match (QofQuery *q,
                                   gboolean value,
                                   QofQueryOp op);
 
+/** A function which narrows the objects a query must check, typically
+ * with an index.  Given one term of a query for 'search_for' objects in
+ * 'book', whose parameter path is 'param_list' and whose matches all
+ * contain each of 'literals' once folded by qof_utf8_fold, it returns
+ * FALSE if it cannot tell which objects match, or TRUE after setting
+ * '*candidates' to a list, which the query frees, of objects including
+ * every one that can.  The query verifies the candidates against all of
+ * its terms, so the list may hold objects which do not match.
+ */
+typedef gboolean (*QofQueryCandidatesFcn) (QofBook *book,
+        QofIdTypeConst search_for,
+        const QofQueryParamList *param_list,
+        const gchar * const *literals,
+        GList **candidates);
+
+/** Register the function which narrows queries for 'search_for'
+ *  objects, replacing any registered before.  A NULL 'fcn'
+ *  unregisters it.  When each OR-term of a query has a string term
+ *  the function can narrow, qof_query_run() checks only the
+ *  candidates it returns instead of every object in the book. */
+void qof_query_register_candidates (QofIdTypeConst search_for,
+                                    QofQueryCandidatesFcn fcn);
+
 /** Perform the query, return the results.
  *  The returned list is a list of the 'search-for' type that was
  *  previously set with the qof_query_search_for() or the
@@ -232,6 +255,30 @@ GList * qof_query_last_run (QofQuery *query);
 GList * qof_query_run_subquery (QofQuery *subquery,
                                 const QofQuery* primary_query);
 
+/** Get the query ready for qof_query_object_matches(): compile it if
+ *  it changed, and have the backends of its books load the objects it
+ *  can match, but do not search them.  This lets the caller test the
+ *  objects it reaches some other way, such as the splits of each
+ *  transaction, and stop as soon as it knows the answer.
+ */
+void qof_query_prepare (QofQuery *query);
+
+/** Return TRUE if 'object', which must be of the query's search-for
+ *  type, passes its terms.  The query must have been prepared with
+ *  qof_query_prepare() since it was last changed.
+ */
+gboolean qof_query_object_matches (const QofQuery *query, gpointer object);
+
+/** Return TRUE and set '*candidates' to a list, which the caller frees,
+ *  of the objects of 'book' including every one the query can match,
+ *  when the function registered with qof_query_register_candidates()
+ *  can narrow each of its OR-terms.  Return FALSE if every object must
+ *  be checked.  Like qof_query_object_matches(), this needs a query
+ *  prepared with qof_query_prepare().
+ */
+gboolean qof_query_get_candidates (QofQuery *query, QofBook *book,
+                                   GList **candidates);
+
 /** Remove all query terms from query.  query matches nothing
  *  after qof_query_clear().
  */
@@ -52,6 +52,14 @@ QofCompareFunc qof_query_core_get_compare (gchar const *type);
 /* Compare two predicates */
 gboolean qof_query_core_predicate_equal (const QofQueryPredData *p1, const QofQueryPredData *p2);
 
+/* Return the strings which the text of every object matched by a string
+ * predicate contains once it is folded with qof_utf8_fold, themselves
+ * folded, as a NULL terminated vector to free with g_strfreev.  Literals
+ * are taken from the match string, or from the runs of plain characters
+ * of a regular expression without alternation.  Returns NULL if the
+ * predicate is not a string equality or no literal could be found. */
+gchar ** qof_query_core_string_literals (const QofQueryPredData *pd);
+
 /* Predicate Data Structures:
  *
  * These are defined such that you can cast between these types and
@@ -68,6 +76,8 @@ typedef struct
     QofStringMatch	options;
     gboolean		is_regex;
     gchar *		matchstring;
+    gchar *		folded;		/* matchstring folded by qof_utf8_fold, for
+					 * case insensitive substring matches */
     regex_t		compiled;
 } query_string_def, *query_string_t;
 
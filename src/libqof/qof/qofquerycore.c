@@ -151,9 +151,11 @@ string_match_predicate (gpointer object,
     }
     else if (pdata->options == QOF_STRING_MATCH_CASEINSENSITIVE)
     {
-        if (qof_utf8_substr_nocase (s, pdata->matchstring))
-            ret = 1;
+        gchar *folded = qof_utf8_fold (s);
 
+        if (folded && pdata->folded && strstr (folded, pdata->folded))
+            ret = 1;
+        g_free (folded);
     }
     else
     {
@@ -230,6 +232,7 @@ string_free_pdata (QofQueryPredData *pd)
         regfree (&pdata->compiled);
 
     g_free (pdata->matchstring);
+    g_free (pdata->folded);
     g_free (pdata);
 }
 
@@ -289,10 +292,170 @@ qof_query_string_predicate (QofQueryCompare how,
         }
         pdata->is_regex = TRUE;
     }
+    else if (options == QOF_STRING_MATCH_CASEINSENSITIVE)
+        pdata->folded = qof_utf8_fold (str);
 
     return ((QofQueryPredData*)pdata);
 }
 
+/* Appends to 'literals' the runs of plain characters outside of any
+ * group, bracket expression or optional repetition of an extended
+ * regular expression.  These must appear in every string it matches.
+ * Returns FALSE if there is alternation, which makes no run certain. */
+static gboolean
+regex_required_literals (const gchar *re, GPtrArray *literals)
+{
+    GString *run = g_string_new (NULL);
+    gint depth = 0;
+    const gchar *p;
+
+    for (p = re; *p; p++)
+    {
+        gboolean literal = FALSE;
+        gchar c = *p;
+
+        switch (c)
+        {
+        case '|':
+            g_string_free (run, TRUE);
+            return FALSE;
+        case '\\':
+            if (p[1] && !g_ascii_isalnum (p[1]))
+            {
+                c = *++p;
+                literal = depth == 0;
+            }
+            else if (p[1])
+                p++;
+            break;
+        case '[':
+            /* Skip the bracket expression; a ']' first in it is literal */
+            p++;
+            if (*p == '^') p++;
+            if (*p == ']') p++;
+            while (*p && *p != ']')
+            {
+                if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '='))
+                {
+                    gchar close = p[1];
+                    for (p += 2; *p && !(*p == close && p[1] == ']'); p++);
+                    if (*p) p++;
+                }
+                if (*p) p++;
+            }
+            if (!*p) p--;
+            break;
+        case '(':
+            depth++;
+            break;
+        case ')':
+            if (depth > 0) depth--;
+            break;
+        case '*':
+        case '?':
+        case '{':
+            /* The preceding character may not appear at all */
+            if (run->len)
+            {
+                gchar *prev = g_utf8_find_prev_char (run->str, run->str + run->len);
+                g_string_truncate (run, prev ? prev - run->str : 0);
+            }
+            if (c == '{')
+                while (p[1] && *p != '}') p++;
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            break;
+        default:
+            literal = depth == 0;
+            break;
+        }
+
+        if (literal)
+        {
+            /* A multibyte character is only literal as a whole */
+            g_string_append_c (run, c);
+            continue;
+        }
+        if (run->len)
+            g_ptr_array_add (literals, g_strndup (run->str, run->len));
+        g_string_truncate (run, 0);
+    }
+    if (run->len)
+        g_ptr_array_add (literals, g_strndup (run->str, run->len));
+    g_string_free (run, TRUE);
+    return TRUE;
+}
+
+/* Strips combining marks from either end of a folded literal: at its
+ * edges normalization may order them differently than in the text. */
+static gchar *
+trim_combining_marks (gchar *folded)
+{
+    gchar *start = folded;
+    gchar *end = folded + strlen (folded);
+
+    while (*start && g_unichar_combining_class (g_utf8_get_char (start)))
+        start = g_utf8_next_char (start);
+    while (end > start)
+    {
+        gchar *prev = g_utf8_prev_char (end);
+        if (!g_unichar_combining_class (g_utf8_get_char (prev)))
+            break;
+        end = prev;
+    }
+    *end = '\0';
+    memmove (folded, start, end - start + 1);
+    return folded;
+}
+
+gchar **
+qof_query_core_string_literals (const QofQueryPredData *pd)
+{
+    const query_string_t pdata = (const query_string_t) pd;
+    GPtrArray *raw, *literals;
+    guint i;
+
+    g_return_val_if_fail (pd, NULL);
+    if (safe_strcmp (pd->type_name, query_string_type) ||
+            pd->how != QOF_COMPARE_EQUAL)
+        return NULL;
+
+    raw = g_ptr_array_new ();
+    if (!pdata->is_regex)
+        g_ptr_array_add (raw, g_strdup (pdata->matchstring));
+    else if (!regex_required_literals (pdata->matchstring, raw))
+    {
+        g_ptr_array_free (raw, TRUE);
+        return NULL;
+    }
+
+    literals = g_ptr_array_new ();
+    for (i = 0; i < raw->len; i++)
+    {
+        gchar *folded = NULL;
+
+        if (g_utf8_validate (raw->pdata[i], -1, NULL))
+            folded = qof_utf8_fold (raw->pdata[i]);
+        if (folded && *trim_combining_marks (folded))
+            g_ptr_array_add (literals, folded);
+        else
+            g_free (folded);
+        g_free (raw->pdata[i]);
+    }
+    g_ptr_array_free (raw, TRUE);
+
+    if (literals->len == 0)
+    {
+        g_ptr_array_free (literals, TRUE);
+        return NULL;
+    }
+    g_ptr_array_add (literals, NULL);
+    return (gchar **) g_ptr_array_free (literals, FALSE);
+}
+
 static char *
 string_to_string (gpointer object, QofParam *getter)
 {
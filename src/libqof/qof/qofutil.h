@@ -172,6 +172,11 @@ void qof_close (void);
  *  and the given user_data parameter. */
 void g_hash_table_foreach_sorted(GHashTable *hash_table, GHFunc func, gpointer user_data, GCompareFunc compare_func);
 
+/** Case fold and normalize a utf8 string the way
+ * qof_utf8_substr_nocase compares it.  Returns a newly allocated
+ * string, or NULL if the string could not be normalized. */
+gchar * qof_utf8_fold (const gchar *str);
+
 /** Search for an occurence of the substring needle in the string
  * haystack, ignoring case. Return TRUE if one is found or FALSE
  * otherwise. */
@@ -0,0 +1,195 @@
+/********************************************************************
+ * test_qofevent.c: GLib g_test test suite for qofevent.            *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+\********************************************************************/
+#include <config.h>
+#include <glib.h>
+#include <qof.h>
+
+#define SUITENAME "/qof/qofevent"
+void test_suite_qofevent ( void );
+
+#define TEST_ID_TYPE "TestEventType"
+
+typedef struct
+{
+    QofBook *book;
+    QofInstance *inst1;
+    QofInstance *inst2;
+    GList *calls;
+    guint n_events;
+    guint n_batches;
+    guint n_entries;
+    QofEventBatchEntry last_entry;
+} Fixture;
+
+static void
+setup( Fixture *fixture, gconstpointer pData )
+{
+    fixture->book = qof_book_new();
+    fixture->inst1 = g_object_new(QOF_TYPE_INSTANCE, NULL);
+    qof_instance_init_data( fixture->inst1, TEST_ID_TYPE, fixture->book );
+    fixture->inst2 = g_object_new(QOF_TYPE_INSTANCE, NULL);
+    qof_instance_init_data( fixture->inst2, TEST_ID_TYPE, fixture->book );
+    fixture->calls = NULL;
+    fixture->n_events = 0;
+    fixture->n_batches = 0;
+    fixture->n_entries = 0;
+    qof_event_reset_stats();
+}
+
+static void
+teardown( Fixture *fixture, gconstpointer pData )
+{
+    g_list_free( fixture->calls );
+    g_object_unref( fixture->inst1 );
+    g_object_unref( fixture->inst2 );
+    qof_book_destroy( fixture->book );
+}
+
+static void
+event_handler_a( QofInstance *ent, QofEventId event_type,
+                 gpointer handler_data, gpointer event_data )
+{
+    Fixture *fixture = handler_data;
+    fixture->calls = g_list_append( fixture->calls, GINT_TO_POINTER( 'a' ) );
+    fixture->n_events++;
+}
+
+static void
+event_handler_b( QofInstance *ent, QofEventId event_type,
+                 gpointer handler_data, gpointer event_data )
+{
+    Fixture *fixture = handler_data;
+    fixture->calls = g_list_append( fixture->calls, GINT_TO_POINTER( 'b' ) );
+}
+
+static void
+batch_handler( const QofEventBatchEntry *entries, guint n_entries,
+               gpointer handler_data )
+{
+    Fixture *fixture = handler_data;
+    fixture->n_batches++;
+    fixture->n_entries += n_entries;
+    if (n_entries > 0)
+        fixture->last_entry = entries[n_entries - 1];
+}
+
+static void
+test_event_priority( Fixture *fixture, gconstpointer pData )
+{
+    gint id_a, id_b;
+
+    id_a = qof_event_register_handler_with_priority( event_handler_a,
+            fixture, 10 );
+    id_b = qof_event_register_handler( event_handler_b, fixture );
+
+    qof_event_gen( fixture->inst1, QOF_EVENT_MODIFY, NULL );
+
+    g_assert_cmpint( g_list_length( fixture->calls ), ==, 2 );
+    g_assert_cmpint( GPOINTER_TO_INT( g_list_nth_data( fixture->calls, 0 ) ),
+                     ==, 'a' );
+    g_assert_cmpint( GPOINTER_TO_INT( g_list_nth_data( fixture->calls, 1 ) ),
+                     ==, 'b' );
+
+    qof_event_unregister_handler( id_a );
+    qof_event_unregister_handler( id_b );
+}
+
+static void
+test_event_batch( Fixture *fixture, gconstpointer pData )
+{
+    QofEventStats stats;
+    gint id_a, id_batch;
+
+    id_a = qof_event_register_handler( event_handler_a, fixture );
+    id_batch = qof_event_register_batch_handler( NULL, batch_handler,
+               fixture, QOF_EVENT_PRIORITY_DEFAULT );
+
+    qof_event_begin_batch();
+    g_assert( qof_event_in_batch() );
+    qof_event_gen( fixture->inst1, QOF_EVENT_MODIFY, NULL );
+    qof_event_gen( fixture->inst1, QOF_EVENT_MODIFY, NULL );
+    qof_event_begin_batch();
+    qof_event_gen( fixture->inst2, QOF_EVENT_MODIFY, NULL );
+    qof_event_gen( fixture->inst1, QOF_EVENT_ADD, NULL );
+    qof_event_end_batch();
+
+    /* Plain handlers see every event, the batch waits for the end. */
+    g_assert_cmpint( fixture->n_events, ==, 4 );
+    g_assert_cmpint( fixture->n_batches, ==, 0 );
+
+    qof_event_end_batch();
+    g_assert( !qof_event_in_batch() );
+
+    g_assert_cmpint( fixture->n_batches, ==, 1 );
+    g_assert_cmpint( fixture->n_entries, ==, 3 );
+    g_assert( fixture->last_entry.entity == fixture->inst1 );
+    g_assert_cmpint( fixture->last_entry.event_id, ==, QOF_EVENT_ADD );
+
+    qof_event_get_stats( &stats );
+    g_assert_cmpint( stats.events_generated, ==, 4 );
+    g_assert_cmpint( stats.events_batched, ==, 4 );
+    g_assert_cmpint( stats.events_merged, ==, 1 );
+    g_assert_cmpint( stats.handler_calls, ==, 4 );
+    g_assert_cmpint( stats.batch_calls, ==, 1 );
+
+    /* Outside a batch a batch-only handler gets batches of one. */
+    qof_event_gen( fixture->inst2, QOF_EVENT_MODIFY, NULL );
+    g_assert_cmpint( fixture->n_batches, ==, 2 );
+    g_assert_cmpint( fixture->n_entries, ==, 4 );
+    g_assert( fixture->last_entry.entity == fixture->inst2 );
+
+    qof_event_unregister_handler( id_a );
+    qof_event_unregister_handler( id_batch );
+}
+
+static void
+test_event_batch_destroy( Fixture *fixture, gconstpointer pData )
+{
+    gint id_batch;
+
+    id_batch = qof_event_register_batch_handler( NULL, batch_handler,
+               fixture, QOF_EVENT_PRIORITY_DEFAULT );
+
+    qof_event_begin_batch();
+    qof_event_gen( fixture->inst1, QOF_EVENT_MODIFY, NULL );
+    qof_event_gen( fixture->inst1, QOF_EVENT_DESTROY, NULL );
+    qof_event_end_batch();
+
+    g_assert_cmpint( fixture->n_batches, ==, 1 );
+    g_assert_cmpint( fixture->n_entries, ==, 2 );
+    g_assert( fixture->last_entry.entity == NULL );
+    g_assert( guid_equal( &fixture->last_entry.guid,
+                          qof_instance_get_guid( fixture->inst1 ) ) );
+    g_assert_cmpstr( fixture->last_entry.type, ==, TEST_ID_TYPE );
+
+    qof_event_unregister_handler( id_batch );
+}
+
+void
+test_suite_qofevent ( void )
+{
+    g_test_add( SUITENAME "/priority", Fixture, NULL, setup,
+                test_event_priority, teardown );
+    g_test_add( SUITENAME "/batch", Fixture, NULL, setup,
+                test_event_batch, teardown );
+    g_test_add( SUITENAME "/batch destroy", Fixture, NULL, setup,
+                test_event_batch_destroy, teardown );
+}
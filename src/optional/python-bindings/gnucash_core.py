@@ -512,6 +512,8 @@ commoditytable_dict =   {
                             'lookup' : GncCommodity,
                             'lookup_unique' : GncCommodity,
                             'find_full' : GncCommodity,
+                            'find_by_fullname' : GncCommodity,
+                            'find_by_cusip' : GncCommodity,
                             'insert' : GncCommodity,
                             'add_namespace': GncCommodityNamespace,
                             'find_namespace': GncCommodityNamespace,
@@ -933,11 +933,17 @@
   (let*
     (
       (period start-period)
+      (budgeted (list-tail (gnc-budget-account-values-to-scm budget account)
+                           (min start-period
+                                (gnc-budget-get-num-periods budget))))
       (net (gnc:make-commodity-collector))
       (acct-comm (xaccAccountGetCommodity account)))
     (while (< period end-period)
       (net 'add acct-comm
-          (gnc-budget-get-account-period-value budget account period))
+          (if (pair? budgeted)
+              (or (car budgeted) (gnc-numeric-zero))
+              (gnc-budget-get-account-period-value budget account period)))
+      (if (pair? budgeted) (set! budgeted (cdr budgeted)))
       (set! period (+ period 1)))
     net))
 
@@ -212,20 +212,19 @@
   ;; This is the sum of the actuals for each of the periods.
   ;;
   ;; Parameters:
-  ;;   budget - budget to use
-  ;;   acct - account
+  ;;   actuals - list of the account's actual values for every budget period
   ;;   periodlist - list of budget periods to use
   ;;
   ;; Return value:
-  ;;   Budget sum
-  (define (gnc:get-account-periodlist-actual-value budget acct periodlist)
+  ;;   Actual sum
+  (define (gnc:get-account-periodlist-actual-value actuals periodlist)
     (cond
       ((= (length periodlist) 1)
-        (gnc-budget-get-account-period-actual-value budget acct (car periodlist)))
+        (list-ref actuals (car periodlist)))
       (else
         (gnc-numeric-add
-          (gnc-budget-get-account-period-actual-value budget acct (car periodlist))
-          (gnc:get-account-periodlist-actual-value budget acct (cdr periodlist))
+          (list-ref actuals (car periodlist))
+          (gnc:get-account-periodlist-actual-value actuals (cdr periodlist))
           GNC-DENOM-AUTO GNC-RND-ROUND))
     )
   )
@@ -238,11 +237,12 @@
   ;;   colnum - starting column number
   ;;   budget - budget to use
   ;;   acct - account being displayed
+  ;;   actuals - list of the account's actual values for every budget period
   ;;   rollup-budget? - rollup budget values for account children if account budget not set
   ;;   exchange-fn - exchange function (not used)
   (define (gnc:html-table-add-budget-line!
            html-table rownum colnum
-           budget acct rollup-budget? column-list exchange-fn)
+           budget acct actuals rollup-budget? column-list exchange-fn)
     (let* (
            (period 0)
            (current-col (+ colnum 1))
@@ -321,7 +321,7 @@
           (bgt-numeric-val (gnc:get-account-periodlist-budget-value budget acct period-list))
 
           ;; actual amount
-          (act-numeric-abs (gnc:get-account-periodlist-actual-value budget acct period-list))
+          (act-numeric-abs (gnc:get-account-periodlist-actual-value actuals period-list))
           (act-numeric-val
             (if reverse-balance?
               (gnc-numeric-neg act-numeric-abs)
@@ -482,6 +482,8 @@
          ;; assumption.
          (colnum (quotient numcolumns 2))
 		 (period 0)
+         (row-accounts '())
+         (row-actuals #f)
 
 	 )
 
@@ -494,6 +496,18 @@
 
 (gnc:debug "column-info-list=" column-info-list)
 
+    ;; find the actual values of every account in every period at once
+    (let loop ((row (- num-rows 1)))
+      (if (>= row 0)
+        (begin
+          (set! row-accounts
+            (cons (get-val (gnc:html-acct-table-get-row-env acct-table row)
+                           'account)
+                  row-accounts))
+          (loop (- row 1)))))
+    (set! row-actuals
+      (list->vector (gnc-budget-accounts-actuals-to-scm budget row-accounts #t)))
+
     ;; call gnc:html-table-add-budget-line! for each account
     (while (< rownum num-rows)
        (let*
@@ -505,7 +519,8 @@
          )
          (gnc:html-table-add-budget-line!
             html-table rownum colnum
-            budget acct rollup-budget? column-info-list exchange-fn)
+            budget acct (vector-ref row-actuals rownum)
+            rollup-budget? column-info-list exchange-fn)
          (set! rownum (+ rownum 1)) ;; increment rownum
        )
     ) ;; end of while